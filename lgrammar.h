@@ -0,0 +1,110 @@
+/* Generated by mpc_table_export */
+
+static const int lgrammar_code[] = {
+  24, 0, 1, 0, 2, 35, 6, 7, 1, 24, 1, 2, 0, 2, 35, 8,
+  9, 1, 24, 2, 3, 0, 3, 33, 10, 11, 12, 3, 3, 24, 3, 4,
+  0, 3, 33, 13, 14, 15, 3, 3, 23, 4, 5, 0, 4, 16, 17, 18,
+  19, 24, 5, 6, 0, 3, 33, 20, 21, 22, 3, 3, 7, -1, 0, 0,
+  15, -1, 0, 0, 23, 34, 7, -1, 0, 0, 15, -1, 0, 0, 24, 34,
+  24, -1, 0, 0, 2, 35, 25, 26, 1, 20, -1, 0, 0, 0, 33, 27,
+  0, 24, -1, 0, 0, 2, 35, 28, 29, 1, 24, -1, 0, 0, 2, 35,
+  30, 31, 1, 20, -1, 0, 0, 0, 33, 32, 0, 24, -1, 0, 0, 2,
+  35, 33, 34, 1, 24, -1, 0, 0, 2, 35, 35, 36, 1, 24, -1, 0,
+  0, 2, 35, 37, 38, 1, 24, -1, 0, 0, 2, 35, 39, 40, 1, 24,
+  -1, 0, 0, 2, 35, 41, 42, 1, 24, -1, 0, 0, 2, 35, 43, 44,
+  1, 20, -1, 0, 0, 0, 33, 45, 0, 24, -1, 0, 0, 2, 35, 46,
+  47, 1, 24, -1, 0, 0, 2, 24, 48, 49, 4, 24, -1, 0, 0, 2,
+  24, 50, 51, 4, 7, -1, 0, 0, 15, -1, 0, 0, 52, 34, 24, -1,
+  0, 0, 2, 35, 53, 54, 1, 7, -1, 0, 0, 15, -1, 0, 0, 55,
+  34, 7, -1, 0, 0, 15, -1, 0, 0, 56, 34, 24, -1, 0, 0, 2,
+  35, 57, 58, 1, 7, -1, 0, 0, 15, -1, 0, 0, 59, 34, 7, -1,
+  0, 0, 15, -1, 0, 0, 60, 36, 7, -1, 0, 0, 15, -1, 0, 0,
+  61, 36, 7, -1, 0, 0, 15, -1, 0, 0, 62, 36, 7, -1, 0, 0,
+  15, -1, 0, 0, 63, 36, 7, -1, 0, 0, 15, -1, 0, 0, 64, 34,
+  24, -1, 0, 0, 2, 35, 65, 66, 1, 7, -1, 0, 0, 15, -1, 0,
+  0, 67, 34, 29, -1, 0, 0, 68, 5, -1, 0, 0, 69, 6, 29, -1,
+  0, 0, 70, 5, -1, 0, 0, 71, 6, 24, -1, 0, 0, 2, 24, 72,
+  73, 4, 7, -1, 0, 0, 15, -1, 0, 0, 74, 36, 24, -1, 0, 0,
+  2, 24, 75, 76, 4, 24, -1, 0, 0, 2, 24, 77, 78, 4, 7, -1,
+  0, 0, 15, -1, 0, 0, 79, 36, 24, -1, 0, 0, 2, 24, 80, 81,
+  4, 16, -1, 0, 0, 0, 40, 2, 0, 16, -1, 0, 0, 1, 40, 2,
+  1, 16, -1, 0, 0, 2, 40, 2, 2, 16, -1, 0, 0, 3, 40, 2,
+  3, 24, -1, 0, 0, 2, 24, 82, 83, 4, 7, -1, 0, 0, 15, -1,
+  0, 0, 84, 36, 24, -1, 0, 0, 2, 24, 85, 86, 4, 24, -1, 0,
+  0, 4, 31, 87, 88, 89, 90, 1, 1, 1, 15, -1, 0, 0, 91, 7,
+  21, -1, 0, 0, 0, 31, 92, 0, 15, -1, 0, 0, 93, 7, 5, -1,
+  0, 0, 94, 7, 5, -1, 0, 0, 95, 6, 16, -1, 0, 0, 4, 40,
+  2, 4, 5, -1, 0, 0, 96, 8, 5, -1, 0, 0, 97, 6, 5, -1,
+  0, 0, 98, 9, 5, -1, 0, 0, 99, 6, 16, -1, 0, 0, 4, 40,
+  2, 4, 5, -1, 0, 0, 100, 10, 5, -1, 0, 0, 101, 6, 24, -1,
+  0, 0, 2, 25, 102, 103, 1, 5, -1, 0, 0, 104, 6, 16, -1, 0,
+  0, 4, 40, 2, 4, 23, -1, 0, 0, 2, 105, 106, 5, -1, 0, 0,
+  107, 6, 19, -1, 0, 0, 108, 0, 6, 21, -1, 0, 0, 0, 31, 109,
+  0, 19, -1, 0, 0, 110, 0, 6, 19, -1, 0, 0, 111, 0, 6, 5,
+  -1, 0, 0, 112, 11, 5, -1, 0, 0, 113, 12, 5, -1, 0, 0, 114,
+  11, 9, -1, 0, 0, 40, 15, -1, 0, 0, 115, 7, 9, -1, 0, 0,
+  41, 15, -1, 0, 0, 116, 7, 9, -1, 0, 0, 123, 15, -1, 0, 0,
+  117, 7, 9, -1, 0, 0, 125, 15, -1, 0, 0, 118, 7, 5, -1, 0,
+  0, 119, 13, 3, -1, 0, 0, 6, 15, -1, 0, 0, 120, 7, 24, -1,
+  0, 0, 2, 24, 121, 122, 1, 24, -1, 0, 0, 2, 25, 123, 124, 1,
+  15, -1, 0, 0, 125, 7, 5, -1, 0, 0, 126, 14, 5, -1, 0, 0,
+  127, 15, 24, -1, 0, 0, 2, 31, 128, 129, 1, 24, -1, 0, 0, 3,
+  31, 130, 131, 132, 1, 1, 20, -1, 0, 0, 0, 31, 133, 0, 10, -1,
+  0, 0, 16, 20, -1, 0, 0, 0, 31, 134, 0, 5, -1, 0, 0, 135,
+  11, 5, -1, 0, 0, 136, 11, 5, -1, 0, 0, 137, 11, 5, -1, 0,
+  0, 138, 11, 27, -1, 0, 0, 5, -1, 0, 0, 139, 11, 5, -1, 0,
+  0, 140, 17, 5, -1, 0, 0, 141, 18, 5, -1, 0, 0, 142, 18, 3,
+  -1, 0, 0, 6, 5, -1, 0, 0, 143, 11, 9, -1, 0, 0, 45, 10,
+  -1, 0, 0, 19, 5, -1, 0, 0, 144, 20, 21, -1, 0, 0, 0, 31,
+  145, 0, 5, -1, 0, 0, 146, 21, 19, -1, 0, 0, 147, 0, 6, 21,
+  -1, 0, 0, 0, 31, 148, 0, 5, -1, 0, 0, 149, 6, 5, -1, 0,
+  0, 150, 6, 20, -1, 0, 0, 0, 31, 151, 0, 20, -1, 0, 0, 0,
+  31, 152, 0, 20, -1, 0, 0, 0, 31, 153, 0, 20, -1, 0, 0, 0,
+  31, 154, 0, 20, -1, 0, 0, 0, 31, 155, 0, 5, -1, 0, 0, 156,
+  22, 28, -1, 0, 0, 28, -1, 0, 0, 20, -1, 0, 0, 0, 31, 157,
+  0, 9, -1, 0, 0, 46, 5, -1, 0, 0, 158, 15, 10, -1, 0, 0,
+  23, 5, -1, 0, 0, 159, 24, 5, -1, 0, 0, 160, 15, 5, -1, 0,
+  0, 161, 25, 5, -1, 0, 0, 162, 25, 5, -1, 0, 0, 163, 6, 5,
+  -1, 0, 0, 164, 6, 5, -1, 0, 0, 165, 6, 5, -1, 0, 0, 166,
+  6, 5, -1, 0, 0, 167, 6, 9, -1, 0, 0, 10, 5, -1, 0, 0,
+  168, 6, 10, -1, 0, 0, 19, 10, -1, 0, 0, 26, 10, -1, 0, 0,
+  19, 10, -1, 0, 0, 27, 10, -1, 0, 0, 27, 5, -1, 0, 0, 169,
+  25, 5, -1, 0, 0, 170, 25, 5, -1, 0, 0, 171, 25, 5, -1, 0,
+  0, 172, 25, 5, -1, 0, 0, 173, 25, 5, -1, 0, 0, 174, 25, 10,
+  -1, 0, 0, 27, 10, -1, 0, 0, 27, 10, -1, 0, 0, 27, 10, -1,
+  0, 0, 27, 10, -1, 0, 0, 27, 10, -1, 0, 0, 27,};
+
+static const char *const lgrammar_strings[] = {
+  "number",
+  "symbol",
+  "sexpr",
+  "qexpr",
+  "expr",
+  "lispy",
+  "whitespace",
+  "'('",
+  "')'",
+  "'{'",
+  "'}'",
+  "spaces",
+  "one of 'abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_+-*/\\=<>!&'",
+  "start of input",
+  "'-'",
+  "one of '0123456789'",
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_+-*/\\=<>!&",
+  "newline",
+  "end of input",
+  "0123456789",
+  "'.'",
+  "one of 'eE'",
+  "'\n'",
+  "eE",
+  "one of '-+'",
+  "one of ' \f\n\r\t\v'",
+  "-+",
+  " \f\n\r\t\v",
+  NULL};
+
+static const mpc_table_t lgrammar = {
+  "number : /-?[0-9]+(\\.[0-9]+)?([eE][-+]?[0-9]+)?/ ;\nsymbol : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;\nsexpr  : '(' <expr>* ')' ;\nqexpr  : '{' <expr>* '}' ;\nexpr   : <number> | <symbol> | <sexpr> | <qexpr> ;\nlispy  : /^/ <expr>* /$/ ;\n",
+  6, 175, 1149, lgrammar_code, lgrammar_strings};
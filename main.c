@@ -1,6 +1,8 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "mpc.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 
 #ifdef _WIN32
 
@@ -18,1011 +20,5519 @@ char *readline(char *prompt)
 
 void add_history(char *unused) {}
 
-#else
+#elif !defined(LISPY_AOT)
 // Linux or Mac
 #include <editline/readline.h>
 #include <editline/history.h>
 #endif
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
 /********************************************************/
 
 /*         초기 선언          */
 
 struct lval;
 struct lenv;
+struct latom;
 typedef struct lval lval;
 typedef struct lenv lenv;
+typedef struct latom latom;
 
 // lval value
 enum
 {
 	LVAL_ERR,
 	LVAL_NUM,
+	LVAL_DBL,
+	LVAL_BIG,
 	LVAL_SYM,
 	LVAL_FUN,
 	LVAL_SEXPR,
-	LVAL_QEXPR
+	LVAL_QEXPR,
+	LVAL_VEC,
+	LVAL_REF,
+	LVAL_CODE,
+	LVAL_MEMO
 }; // 0,1,2,3,4
 
 typedef lval *(*lbuiltin)(lenv *, lval *);
 
+/* memo 함수의 cache (LRU). 정의는 Memo 부분에 */
+typedef struct lmemo lmemo;
+
+/* LOP_GLOBAL 마다 하나씩 두는 inline cache. version 이 lenv_version 과 같을 때만 유효 */
+typedef struct
+{
+	lval *value;
+	unsigned long version;
+} licache;
+
 // Lisp Value
+/* type 별로 필요한 field 만 union 으로 겹쳐서 저장한다 (48 bytes)
+	 만들어진 값은 수정하지 않고 공유하며, 메모리는 GC 가 회수한다 */
 struct lval
 {
-	int type;
-
-	/*Basic*/
-	long num;
-	char *err;
-	char *sym;
-
-	/*Function*/
-	lbuiltin builtin;
-	lenv *env;
-	lval *formals;
-	lval *body;
+	unsigned char type;
+	unsigned char gc;
 
 	/*Expression*/
 	int count;
-	lval **cell;
+
+	union
+	{
+		/*Basic*/
+		long num;
+		double dbl;
+
+		/*Bignum : 2^32 진법 절댓값 (낮은 자리부터, count 자리) 과 부호 (1 또는 -1)*/
+		struct
+		{
+			uint32_t *limbs;
+			int sign;
+		} big;
+		char *err;
+		latom *sym;
+
+		/*Expression : cell 은 첫 원소를 가리키고 cap 은 할당된 칸 수.
+			owner 가 있으면 owner 의 배열 일부를 빌려 쓰는 것 (tail 등) */
+		struct
+		{
+			lval **cell;
+			lval *owner;
+			int cap;
+		} list;
+
+		/*Vector : count 개의 int64_t 를 연속으로 저장. owner 가 있으면 owner 의 배열 일부 (vslice)*/
+		struct
+		{
+			int64_t *data;
+			lval *owner;
+		} vec;
+
+		/*Reference : lambda body 안에서 미리 찾아둔 formal (capture, let 포함) 의 slot*/
+		struct
+		{
+			latom *sym;
+			int slot;
+		} ref;
+
+		/*Bytecode : compile 된 lambda body. (사용자에게는 보이지 않는다) count 는 op 수*/
+		struct
+		{
+			int *ops;
+			lval **consts;
+			licache *caches; /* consts 와 같은 번호 */
+			int nconsts;
+		} code;
+
+		/*Function : code 가 있으면 VM 으로, 없으면 body 를 tree walker 로 실행*/
+		struct
+		{
+			lbuiltin builtin;
+			lenv *env;
+			lval *formals;
+			lval *body;
+			lval *code;
+		} fun;
+
+		/*Memo : fn 을 호출한 결과를 인자로 찾는 cache 를 가진 함수 (memo 가 만든다)*/
+		struct
+		{
+			lval *fn;
+			lmemo *table;
+		} memo;
+	} as;
 };
 
-/* number 형 lval pointer */
+/* Fixnum : 작은 정수는 할당하지 않고 pointer word 에 직접 저장한다.
+	 최하위 bit 가 1 이면 fixnum (lval 구조체는 항상 정렬되어 있으므로 0) */
+#define LFIX_MIN (LONG_MIN / 2)
+#define LFIX_MAX (LONG_MAX / 2)
+#define LFIXNUM_P(v) (((uintptr_t)(v)) & 1)
+#define LFIX_MAKE(x) ((lval *)(((uintptr_t)(x) << 1) | 1))
+#define LFIX_VALUE(v) ((long)((intptr_t)(v) >> 1))
 
-lval *lval_num(long x)
-{
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_NUM;
-	v->num = x;
-	return v;
-}
+/* fixnum 을 포함한 모든 lval 의 type 과 숫자 값 */
+#define LTYPE(v) (LFIXNUM_P(v) ? LVAL_NUM : (v)->type)
+#define LNUM(v) (LFIXNUM_P(v) ? LFIX_VALUE(v) : (v)->as.num)
 
-/* Error 형 lval pointer */
+// Environment
 
-lval *lval_err(char *fmt, ...)
+/* 심볼/값은 추가된 순서대로 dense 배열에 저장하고,
+	 count 가 LENV_HASH_MIN 을 넘으면 open addressing hash index 를 함께 둔다 */
+struct lenv
 {
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_ERR;
-	/* va list를 만들고 초기화함 */
-	va_list va;
-	va_start(va, fmt);
+	lenv *par;
+	unsigned char gc;
+	int count;
+	latom **syms;
+	lval **vals;
 
-	/*512바이트 할당*/
-	v->err = malloc(512);
+	/* activation frame 은 syms 와 index 를 lambda 의 frame 원본(proto)과 공유한다 */
+	lenv *proto;
 
-	/*최대 511개의 문자를 도달하면 Error 출력*/
-	vsnprintf(v->err, 511, fmt, va);
-	/* 실제 사용되는 byte의 수를 재할당한다.*/
-	v->err = realloc(v->err, strlen(v->err) + 1);
+	/* tree walker 에서 값을 넣은 let slot 의 끝 (let slot 이 없으면 formal 과 capture 의 끝).
+		 이 뒤의 slot 은 비어 있다 */
+	int live;
 
-	/*va list 해제*/
-	va_end(va);
+	/* dense 배열 위치 + 1 (0 은 빈 칸), 크기는 2의 거듭제곱 */
+	int *index;
+	int nindex;
+};
 
-	return v;
-}
+// Symbol
+/* 같은 이름의 심볼은 프로세스 전체에서 하나의 atom 만 존재하므로 pointer 로 비교한다 */
+struct latom
+{
+	char *name;
+	unsigned long hash;
+	int id;
+	latom *next;
+};
 
-/* Symbol lval pointer */
+/********************************************************/
 
-lval *lval_sym(char *s)
-{
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_SYM;
-	v->sym = malloc(strlen(s) + 1);
-	strcpy(v->sym, s);
-	return v;
-}
+/*         메모리 풀(Slab Allocator)          */
 
-//함수포인터
+/* slab 하나에 담기는 object 수 */
+#define LPOOL_SLAB 1024
 
-lval *lval_builtin(lbuiltin func)
+/* cell 배열은 2의 거듭제곱 크기(1 ~ 256개)별로 풀을 따로 둔다 */
+#define LCELL_CLASSES 9
+
+typedef struct lpool
 {
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_FUN;
-	v->builtin = func;
-	return v;
-}
+	char *name;
+	size_t size;
 
-lenv *lenv_new(void);
+	/* 반환된 object 들의 free list */
+	void *free;
 
-lval *lval_lambda(lval *formals, lval *body)
+	/* 현재 slab 에서 아직 나눠주지 않은 영역 */
+	char *next;
+	char *end;
+
+	/* 통계 */
+	long live;
+	long recycled;
+	long slabs;
+} lpool;
+
+void *lpool_alloc(lpool *p)
 {
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_FUN;
+	void *x;
 
-	/*Builtin NULL할당*/
-	v->builtin = NULL;
+	/* free list 에 반환된 object 가 있으면 재사용 */
+	if (p->free)
+	{
+		x = p->free;
+		p->free = *(void **)x;
+		p->recycled++;
+		p->live++;
+		return x;
+	}
 
-	/*새 환경을 만들기*/
-	v->env = lenv_new();
+	/* 현재 slab 을 다 썼다면 새 slab 할당 */
+	if (p->next == p->end)
+	{
+		p->next = malloc(p->size * LPOOL_SLAB);
+		p->end = p->next + p->size * LPOOL_SLAB;
+		p->slabs++;
+	}
 
-	/*formals and body 설정하기*/
-	v->formals = formals;
-	v->body = body;
-	return v;
+	x = p->next;
+	p->next += p->size;
+	p->live++;
+	return x;
 }
 
-/* Sexpr lval pointer */
-
-lval *lval_sexpr(void)
+void lpool_free(lpool *p, void *x)
 {
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_SEXPR;
-	v->count = 0;
-	v->cell = NULL;
-	return v;
+	/* object 의 첫 word 를 free list 의 link 로 사용 */
+	*(void **)x = p->free;
+	p->free = x;
+	p->live--;
 }
 
-lval *lval_qexpr(void)
+lpool lval_pool = {"lval", sizeof(lval), NULL, NULL, NULL, 0, 0, 0};
+lpool lenv_pool = {"lenv", sizeof(lenv), NULL, NULL, NULL, 0, 0, 0};
+lpool lcell_pool[LCELL_CLASSES];
+
+/* 마지막 GC 이후 새로 할당한 cell 배열의 byte 수 */
+long lcell_alloc_bytes = 0;
+
+/* count 개의 pointer 를 담을 수 있는 size class */
+int lcell_class(int count)
 {
-	lval *v = malloc(sizeof(lval));
-	v->type = LVAL_QEXPR;
-	v->count = 0;
-	v->cell = NULL;
-	return v;
+	int c = 0;
+	while ((1 << c) < count)
+	{
+		c++;
+	}
+	return c;
 }
 
-void lenv_del(lenv *e);
-
-void lval_del(lval *v)
+/* cell 배열을 old 개에서 count 개로 재할당 (size class 가 같으면 그대로) */
+void *lcell_resize(void *cell, int old, int count)
 {
-	switch (v->type)
+	if (count == 0)
 	{
-		/* Number 타입은 del함수가 동작하지 않는다.*/
-	case LVAL_NUM:
-		break;
-		/* Err 와 Sym 은 문자열 Data(malloc 사용)이므로 free 함수 호출 */
-	case LVAL_ERR:
-		free(v->err);
-		break;
-	case LVAL_SYM:
-		free(v->sym);
-		break;
-		/*함수포인터는 del함수가 동작하지 않는다.*/
-	case LVAL_FUN:
-		if (!v->builtin)
-		{
-			lenv_del(v->env);
-			lval_del(v->formals);
-			lval_del(v->body);
-		}
-		break;
-	/* Sexpr or Qexpr 가 존재하면 내부의 모든 요소 삭제 */
-	case LVAL_QEXPR:
-	case LVAL_SEXPR:
-		for (int i = 0; i < v->count; i++)
+		if (old > 0)
 		{
-			lval_del(v->cell[i]);
+			int oc = lcell_class(old);
+			oc < LCELL_CLASSES ? lpool_free(&lcell_pool[oc], cell) : free(cell);
 		}
-		/* cell 변수는 2중 포인터이므로 다시 free함수 호출하여 메모리 해제 */
-		free(v->cell);
-		break;
+		return NULL;
 	}
 
-	/* lval 구조체 포인터 해제(매개변수) */
-	free(v);
-}
+	int nc = lcell_class(count);
+	if (old > 0 && lcell_class(old) == nc)
+	{
+		return cell;
+	}
 
-lenv *lenv_copy(lenv *e);
+	lcell_alloc_bytes += sizeof(void *) << nc;
 
-lval *lval_copy(lval *v)
-{
-	lval *x = malloc(sizeof(lval));
-	x->type = v->type;
+	/* 큰 배열은 그냥 realloc 사용 */
+	if (nc >= LCELL_CLASSES && old > 0 && lcell_class(old) >= LCELL_CLASSES)
+	{
+		return realloc(cell, sizeof(void *) * ((size_t)1 << nc));
+	}
 
-	switch (v->type)
+	void *n;
+	if (nc < LCELL_CLASSES)
 	{
-	/*함수와 정수는 바로 복사*/
-	case LVAL_FUN:
-		if (v->builtin)
-		{
-			x->builtin = v->builtin;
-		}
-		else
-		{
-			x->builtin = NULL;
-			x->env = lenv_copy(v->env);
-			x->formals = lval_copy(v->formals);
-			x->body = lval_copy(v->body);
-		}
-		break;
-	case LVAL_NUM:
-		x->num = v->num;
-		break;
-	/* malloc과 strcpy를 사용하여 문자열을 복사*/
-	case LVAL_ERR:
-		x->err = malloc(strlen(v->err) + 1);
-		strcpy(x->err, v->err);
-		break;
-	case LVAL_SYM:
-		x->sym = malloc(strlen(v->sym) + 1);
-		strcpy(x->sym, v->sym);
-		break;
-	/*각각 sub 표현식를 복사한 list들을 저장*/
-	case LVAL_SEXPR:
-	case LVAL_QEXPR:
-		x->count = v->count;
-		x->cell = malloc(sizeof(lval *) * x->count); // check
-		for (int i = 0; i < x->count; i++)
+		if (lcell_pool[nc].size == 0)
 		{
-			x->cell[i] = lval_copy(v->cell[i]);
+			lcell_pool[nc].name = "cell";
+			lcell_pool[nc].size = sizeof(void *) << nc;
 		}
-		break;
+		n = lpool_alloc(&lcell_pool[nc]);
+	}
+	else
+	{
+		n = malloc(sizeof(void *) * ((size_t)1 << nc));
 	}
 
-	return x;
-}
-
-lval *lval_add(lval *v, lval *x)
-{
-	v->count++;
-	v->cell = realloc(v->cell, sizeof(lval *) * v->count);
-	v->cell[v->count - 1] = x;
-	return v;
+	if (old > 0)
+	{
+		memcpy(n, cell, sizeof(void *) * (old < count ? old : count));
+		lcell_resize(cell, old, 0);
+	}
+	return n;
 }
 
-lval *lval_join(lval *x, lval *y)
+/* 비어있는 배열(NULL)도 허용하는 pointer 배열 복사 */
+void lcell_copy(void *dst, void *src, int count)
 {
-	/*y에 있는 모든 cell을 순회하면서 x 에 할당*/
-	for (int i = 0; i < y->count; i++)
+	if (count > 0)
 	{
-		x = lval_add(x, y->cell[i]);
+		memcpy(dst, src, sizeof(void *) * count);
 	}
-
-	/*비어있는 y를 삭제 후 x를 리턴*/
-	free(y->cell);
-	free(y);
-	return x;
 }
 
-lval *lval_pop(lval *v, int i)
+void lpool_print(lpool *p)
 {
-	/* i(cell index)의 해당하는 item을 find 후 할당 */
-	lval *x = v->cell[i];
+	printf("%-5s %5lu bytes  live %8li  recycled %10li  slabs %li\n",
+				 p->name, (unsigned long)p->size, p->live, p->recycled, p->slabs);
+}
 
-	/* i의 해당하눈 item을 메모리 최상단(top)으로 이동  */
-	memmove(&v->cell[i], &v->cell[i + 1], sizeof(lval *) * (v->count - i - 1));
+/********************************************************/
 
-	/* list 안의 item 수 감소 */
-	v->count--;
+/*         Garbage Collector          */
 
-	/* 사용된 메모리 재할당 */
-	v->cell = realloc(v->cell, sizeof(lval *) * v->count);
-	return x;
-}
+/* 모든 lval 과 lenv 는 GC 가 소유한다. (manual lval_del 없음)
+	 - precise mark & sweep : root 는 전역 환경과 root stack (평가 중인 값, REPL 의 현재 값)
+	 - generational : 마지막 GC 이후 할당된 object 는 nursery 에 있고,
+		 minor GC 는 nursery 만 sweep 하며 살아남은 object 는 old 로 승격된다.
+		 old object 에 young object 를 저장할 때는 write barrier 로 remembered set 에 기록한다.
+	 - GC 는 S-Expression 을 적용하기 직전의 safepoint(lgc_poll)에서만 실행되므로
+		 builtin 안의 임시 값은 다시 평가를 호출하기 전까지 root 에 등록하지 않아도 된다. */
 
-lval *lval_take(lval *v, int i)
+#ifndef LGC_NURSERY
+#define LGC_NURSERY 65536 /* minor GC 를 시작하는 nursery 크기 (object 수) */
+#endif
+#define LGC_NURSERY_BYTES (4L << 20) /* 또는 새로 할당한 cell 배열 크기 */
+
+enum
 {
-	lval *x = lval_pop(v, i);
-	lval_del(v);
-	return x;
-}
+	LGC_MARK = 1,
+	LGC_OLD = 2,
+	LGC_REMEMBERED = 4
+};
 
-void lval_print(lval *v);
+/* object pointer 배열. lenv 는 pointer 에 LGC_ENV_TAG bit 를 붙여서 구분한다 */
+#define LGC_ENV_TAG 2
 
-void lval_print_expr(lval *v, char open, char close)
+typedef struct lgc_vec
 {
-	putchar(open);
-	for (int i = 0; i < v->count; i++)
-	{
-		/* 값 출력 */
-		lval_print(v->cell[i]);
+	void **items;
+	int count;
+	int cap;
+} lgc_vec;
 
-		/* 마지막 요소가 공백이라면 출력하지 않기  */
-		if (i != (v->count - 1))
-		{
-			putchar(' ');
-		}
-	}
-	putchar(close);
-}
+lgc_vec lgc_nursery;
+lgc_vec lgc_old;
+lgc_vec lgc_remembered;
+lgc_vec lgc_roots;
+lgc_vec lgc_stack;
 
-// lval 출력
-void lval_print(lval *v)
-{
-	switch (v->type)
-	{
-	case LVAL_NUM:
-		printf("%li", v->num);
-		break;
+/* 다음 major GC 를 시작하는 old object 수 */
+int lgc_old_limit = LGC_NURSERY * 4;
 
-	case LVAL_ERR:
-		printf("Error: %s", v->err);
-		break;
-	case LVAL_SYM:
-		printf("%s", v->sym);
-		break;
-	case LVAL_FUN:
-		if (v->builtin)
-		{
-			printf("<Function>");
-		}
-		else
-		{
-			printf("(\\ ");
-			lval_print(v->formals);
-			putchar(' ');
-			lval_print(v->body);
-			putchar(')');
-		}
+long lgc_minor_count = 0;
+long lgc_major_count = 0;
 
-		break;
-	case LVAL_SEXPR:
-		lval_print_expr(v, '(', ')');
-		break;
-	case LVAL_QEXPR:
-		lval_print_expr(v, '{', '}');
-		break;
+void lgc_vec_push(lgc_vec *v, void *x)
+{
+	if (v->count == v->cap)
+	{
+		v->cap = v->cap ? v->cap * 2 : 1024;
+		v->items = realloc(v->items, sizeof(void *) * v->cap);
 	}
+	v->items[v->count++] = x;
 }
 
-void lval_println(lval *v)
+lval *lval_alloc(void)
 {
-	lval_print(v);
-	putchar('\n');
+	lval *v = lpool_alloc(&lval_pool);
+	v->gc = 0;
+	lgc_vec_push(&lgc_nursery, v);
+	return v;
 }
 
-char *ltype_name(int t)
+lenv *lenv_alloc(void)
 {
-	switch (t)
-	{
-	case LVAL_FUN:
-		return "Function";
-	case LVAL_NUM:
-		return "Number";
-	case LVAL_ERR:
-		return "Error";
-	case LVAL_SYM:
-		return "Symbol";
-	case LVAL_SEXPR:
-		return "S-Expression";
-	case LVAL_QEXPR:
-		return "Q-Expression";
-	default:
-		return "Unknown";
-	}
+	lenv *e = lpool_alloc(&lenv_pool);
+	e->gc = 0;
+	lgc_vec_push(&lgc_nursery, (void *)((uintptr_t)e | LGC_ENV_TAG));
+	return e;
 }
 
-// Environment
+/* root stack : 평가 중인 값을 등록하고, 끝나면 저장해 둔 높이로 되돌린다 */
+int lgc_save(void)
+{
+	return lgc_roots.count;
+}
 
-struct lenv
+void lgc_restore(int sp)
 {
-	lenv *par;
-	int count;
-	char **syms;
-	lval **vals;
-};
+	lgc_roots.count = sp;
+}
 
-lenv *lenv_new(void)
+void lgc_push(lval *v)
 {
-	lenv *e = malloc(sizeof(lenv));
-	e->par = NULL;
-	e->count = 0;
-	e->syms = NULL;
-	e->vals = NULL;
+	lgc_vec_push(&lgc_roots, v);
+}
 
-	return e;
+void lgc_push_env(lenv *e)
+{
+	lgc_vec_push(&lgc_roots, (void *)((uintptr_t)e | LGC_ENV_TAG));
 }
 
-void lenv_del(lenv *e)
+/* write barrier : old object 에 새 값을 저장한 뒤 호출 */
+void lgc_barrier(lval *v)
 {
-	for (int i = 0; i < e->count; i++)
+	if ((v->gc & (LGC_OLD | LGC_REMEMBERED)) == LGC_OLD)
 	{
-		free(e->syms[i]);
-		lval_del(e->vals[i]);
+		v->gc |= LGC_REMEMBERED;
+		lgc_vec_push(&lgc_remembered, v);
 	}
-	free(e->syms);
-	free(e->vals);
-	free(e);
 }
 
-lval *lenv_get(lenv *e, lval *k)
+void lgc_barrier_env(lenv *e)
 {
-	/*Environment의 모든 item들을 반복 순회*/
-	for (int i = 0; i < e->count; i++)
+	if ((e->gc & (LGC_OLD | LGC_REMEMBERED)) == LGC_OLD)
 	{
-		/*저장된 문자열이 Symbol 문자열과 일치하는지 확인*/
-		/*만약 일치한다면, value을 복사하여 리턴*/
-		if (strcmp(e->syms[i], k->sym) == 0)
-		{
-			return lval_copy(e->vals[i]);
-		}
+		e->gc |= LGC_REMEMBERED;
+		lgc_vec_push(&lgc_remembered, (void *)((uintptr_t)e | LGC_ENV_TAG));
 	}
+}
 
-	if (e->par)
-	{
-		return lenv_get(e->par, k);
-	}
-	else
-	{
-		return lval_err("unbound symbol! '%s'", k->sym);
+int lgc_major;
+
+/* object 의 gc flag 위치 */
+unsigned char *lgc_flags(void *p)
+{
+	return ((uintptr_t)p & LGC_ENV_TAG)
+						 ? &((lenv *)((uintptr_t)p & ~(uintptr_t)LGC_ENV_TAG))->gc
+						 : &((lval *)p)->gc;
+}
+
+
+void lgc_mark(void *p)
+{
+	/* NULL (빈 slot) 과 fixnum 은 표시할 것이 없다 */
+	if (!p || LFIXNUM_P(p))
+	{
+		return;
+	}
+
+	unsigned char *gc = lgc_flags(p);
+
+	/* minor GC 에서는 old object 를 살아있는 것으로 보고 따라가지 않는다 */
+	if ((*gc & LGC_MARK) || (!lgc_major && (*gc & LGC_OLD)))
+	{
+		return;
+	}
+	*gc |= LGC_MARK;
+	lgc_vec_push(&lgc_stack, p);
+}
+
+void lmemo_scan(lmemo *t);
+void lmemo_free(lmemo *t);
+
+/* object 가 가리키는 자식들을 표시 */
+void lgc_scan(void *p)
+{
+	if ((uintptr_t)p & LGC_ENV_TAG)
+	{
+		lenv *e = (lenv *)((uintptr_t)p & ~(uintptr_t)LGC_ENV_TAG);
+		if (e->par)
+		{
+			lgc_mark((void *)((uintptr_t)e->par | LGC_ENV_TAG));
+		}
+		if (e->proto)
+		{
+			lgc_mark((void *)((uintptr_t)e->proto | LGC_ENV_TAG));
+		}
+		for (int i = 0; i < e->count; i++)
+		{
+			lgc_mark(e->vals[i]);
+		}
+		return;
+	}
+
+	lval *v = p;
+	switch (v->type)
+	{
+	case LVAL_FUN:
+		if (!v->as.fun.builtin)
+		{
+			lgc_mark((void *)((uintptr_t)v->as.fun.env | LGC_ENV_TAG));
+			lgc_mark(v->as.fun.formals);
+			lgc_mark(v->as.fun.body);
+			lgc_mark(v->as.fun.code);
+		}
+		break;
+	case LVAL_CODE:
+		for (int i = 0; i < v->as.code.nconsts; i++)
+		{
+			lgc_mark(v->as.code.consts[i]);
+		}
+		break;
+	case LVAL_VEC:
+		lgc_mark(v->as.vec.owner);
+		break;
+	case LVAL_MEMO:
+		lgc_mark(v->as.memo.fn);
+		lmemo_scan(v->as.memo.table);
+		break;
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		/* 빌려 쓰는 list 의 요소는 모두 owner 의 요소이므로 owner 만 표시 */
+		if (v->as.list.owner)
+		{
+			lgc_mark(v->as.list.owner);
+			break;
+		}
+		for (int i = 0; i < v->count; i++)
+		{
+			lgc_mark(v->as.list.cell[i]);
+		}
+		break;
+	}
+}
+
+void lgc_free(void *p)
+{
+	if ((uintptr_t)p & LGC_ENV_TAG)
+	{
+		lenv *e = (lenv *)((uintptr_t)p & ~(uintptr_t)LGC_ENV_TAG);
+		if (!e->proto)
+		{
+			lcell_resize(e->syms, e->count, 0);
+			free(e->index);
+		}
+		lcell_resize(e->vals, e->count, 0);
+		lpool_free(&lenv_pool, e);
+		return;
+	}
+
+	lval *v = p;
+	switch (v->type)
+	{
+	/* Err 는 문자열 Data(malloc 사용)이므로 free 함수 호출 */
+	case LVAL_ERR:
+		free(v->as.err);
+		break;
+	case LVAL_CODE:
+		free(v->as.code.ops);
+		free(v->as.code.consts);
+		free(v->as.code.caches);
+		break;
+	case LVAL_VEC:
+		if (!v->as.vec.owner)
+		{
+			free(v->as.vec.data);
+		}
+		break;
+	case LVAL_BIG:
+		free(v->as.big.limbs);
+		break;
+	case LVAL_MEMO:
+		lmemo_free(v->as.memo.table);
+		break;
+	/* cell 배열은 size class 풀로 반환 (빌려 쓴 배열은 owner 가 반환) */
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		if (!v->as.list.owner)
+		{
+			lcell_resize(v->as.list.cell, v->as.list.cap, 0);
+		}
+		break;
+	}
+	lpool_free(&lval_pool, v);
+}
+
+void lgc_collect(int major)
+{
+	lgc_major = major;
+
+	/* root 들을 표시 */
+	for (int i = 0; i < lgc_roots.count; i++)
+	{
+		lgc_mark(lgc_roots.items[i]);
+	}
+
+	/* minor GC 에서는 young object 를 가리키는 old object 의 자식들도 root */
+	for (int i = 0; i < lgc_remembered.count; i++)
+	{
+		void *p = lgc_remembered.items[i];
+		*lgc_flags(p) &= ~LGC_REMEMBERED;
+		if (!major)
+		{
+			lgc_scan(p);
+		}
+	}
+	lgc_remembered.count = 0;
+
+	/* 표시된 object 들의 자식을 따라간다 (재귀 대신 mark stack 사용) */
+	while (lgc_stack.count)
+	{
+		lgc_scan(lgc_stack.items[--lgc_stack.count]);
+	}
+
+	/* old 영역 sweep (major GC) */
+	if (major)
+	{
+		int n = 0;
+		for (int i = 0; i < lgc_old.count; i++)
+		{
+			void *p = lgc_old.items[i];
+			unsigned char *gc = lgc_flags(p);
+			if (*gc & LGC_MARK)
+			{
+				*gc &= ~LGC_MARK;
+				lgc_old.items[n++] = p;
+			}
+			else
+			{
+				lgc_free(p);
+			}
+		}
+		lgc_old.count = n;
+		lgc_major_count++;
+	}
+	else
+	{
+		lgc_minor_count++;
+	}
+
+	/* nursery sweep : 살아남은 object 는 old 로 승격 */
+	for (int i = 0; i < lgc_nursery.count; i++)
+	{
+		void *p = lgc_nursery.items[i];
+		unsigned char *gc = lgc_flags(p);
+		if (*gc & LGC_MARK)
+		{
+			*gc = LGC_OLD;
+			lgc_vec_push(&lgc_old, p);
+		}
+		else
+		{
+			lgc_free(p);
+		}
+	}
+	lgc_nursery.count = 0;
+	lcell_alloc_bytes = 0;
+
+	if (major)
+	{
+		lgc_old_limit = lgc_old.count * 2 > LGC_NURSERY * 4 ? lgc_old.count * 2 : LGC_NURSERY * 4;
+	}
+}
+
+/* safepoint : nursery 가 가득 찼다면 GC 실행 */
+void lgc_poll(void)
+{
+	if (lgc_nursery.count >= LGC_NURSERY || lcell_alloc_bytes >= LGC_NURSERY_BYTES)
+	{
+		lgc_collect(lgc_old.count >= lgc_old_limit);
+	}
+}
+
+/********************************************************/
+
+/*         심볼 Intern 테이블          */
+
+#define LATOM_INIT_BUCKETS 256
+
+latom **latom_buckets = NULL;
+int latom_nbuckets = 0;
+int latom_count = 0;
+
+lpool latom_pool = {"atom", sizeof(latom), NULL, NULL, NULL, 0, 0, 0};
+
+/* 자주 비교하는 심볼 */
+latom *latom_amp;
+
+/* special form 의 이름 */
+latom *latom_if;
+latom *latom_cond;
+latom *latom_let;
+latom *latom_and;
+latom *latom_or;
+
+unsigned long latom_hash(char *s)
+{
+	/* FNV-1a */
+	unsigned long h = 2166136261UL;
+	while (*s)
+	{
+		h = (h ^ (unsigned char)*s++) * 16777619UL;
+	}
+	return h;
+}
+
+void latom_grow(void)
+{
+	int n = latom_nbuckets ? latom_nbuckets * 2 : LATOM_INIT_BUCKETS;
+	latom **b = calloc(n, sizeof(latom *));
+
+	/* 기존 atom 들을 새 bucket 으로 옮긴다 */
+	for (int i = 0; i < latom_nbuckets; i++)
+	{
+		latom *a = latom_buckets[i];
+		while (a)
+		{
+			latom *next = a->next;
+			a->next = b[a->hash & (n - 1)];
+			b[a->hash & (n - 1)] = a;
+			a = next;
+		}
+	}
+	free(latom_buckets);
+	latom_buckets = b;
+	latom_nbuckets = n;
+}
+
+latom *latom_intern(char *s)
+{
+	if (latom_count >= latom_nbuckets)
+	{
+		latom_grow();
+	}
+
+	/* 이미 존재하는 이름이면 그 atom 을 리턴 */
+	unsigned long h = latom_hash(s);
+	latom **b = &latom_buckets[h & (latom_nbuckets - 1)];
+	for (latom *a = *b; a; a = a->next)
+	{
+		if (a->hash == h && strcmp(a->name, s) == 0)
+		{
+			return a;
+		}
+	}
+
+	/* 새 atom 등록 (해제하지 않는다) */
+	latom *a = lpool_alloc(&latom_pool);
+	a->name = malloc(strlen(s) + 1);
+	strcpy(a->name, s);
+	a->hash = h;
+	a->id = latom_count++;
+	a->next = *b;
+	*b = a;
+	return a;
+}
+
+void latom_init(void)
+{
+	latom_amp = latom_intern("&");
+	latom_if = latom_intern("if");
+	latom_cond = latom_intern("cond");
+	latom_let = latom_intern("let");
+	latom_and = latom_intern("and");
+	latom_or = latom_intern("or");
+}
+
+/* number 형 lval pointer */
+
+lval *lval_num(long x)
+{
+	/* fixnum 범위 안이면 할당하지 않는다 */
+	if (x >= LFIX_MIN && x <= LFIX_MAX)
+	{
+		return LFIX_MAKE(x);
+	}
+
+	lval *v = lval_alloc();
+	v->type = LVAL_NUM;
+	v->as.num = x;
+	return v;
+}
+
+/* Error 형 lval pointer */
+
+lval *lval_err(char *fmt, ...)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_ERR;
+	/* va list를 만들고 초기화함 */
+	va_list va;
+	va_start(va, fmt);
+
+	/*512바이트 할당*/
+	v->as.err = malloc(512);
+
+	/*최대 511개의 문자를 도달하면 Error 출력*/
+	vsnprintf(v->as.err, 511, fmt, va);
+	/* 실제 사용되는 byte의 수를 재할당한다.*/
+	v->as.err = realloc(v->as.err, strlen(v->as.err) + 1);
+
+	/*va list 해제*/
+	va_end(va);
+
+	return v;
+}
+
+/* Symbol lval pointer */
+
+lval *lval_sym(char *s)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_SYM;
+	v->as.sym = latom_intern(s);
+	return v;
+}
+
+//함수포인터
+
+lval *lval_builtin(lbuiltin func)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_FUN;
+	v->as.fun.builtin = func;
+	return v;
+}
+
+lenv *lenv_new(void);
+void lenv_add(lenv *e, latom *k, lval *v);
+
+lval *lval_lambda(lval *formals, lval *body)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_FUN;
+
+	/*Builtin NULL할당*/
+	v->as.fun.builtin = NULL;
+
+	/*새 환경을 만들기*/
+	v->as.fun.env = lenv_new();
+
+	/*'&' 를 제외한 formal 마다 빈 slot 을 순서대로 만든다*/
+	for (int i = 0; i < formals->count; i++)
+	{
+		if (formals->as.list.cell[i]->as.sym != latom_amp)
+		{
+			lenv_add(v->as.fun.env, formals->as.list.cell[i]->as.sym, NULL);
+		}
+	}
+
+	/*formals and body 설정하기*/
+	v->as.fun.formals = formals;
+	v->as.fun.body = body;
+	v->as.fun.code = NULL;
+	return v;
+}
+
+/* 이미 찾아둔 slot 을 가리키는 심볼 */
+
+lval *lval_ref(latom *sym, int slot)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_REF;
+	v->as.ref.sym = sym;
+	v->as.ref.slot = slot;
+	return v;
+}
+
+/* Sexpr lval pointer */
+
+lval *lval_sexpr(void)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_SEXPR;
+	v->count = 0;
+	v->as.list.cell = NULL;
+	v->as.list.owner = NULL;
+	v->as.list.cap = 0;
+	return v;
+}
+
+lval *lval_qexpr(void)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_QEXPR;
+	v->count = 0;
+	v->as.list.cell = NULL;
+	v->as.list.owner = NULL;
+	v->as.list.cap = 0;
+	return v;
+}
+
+/* n 개의 int64_t 를 담는 vector (값은 채우지 않는다) */
+lval *lval_vec(int n)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_VEC;
+	v->count = n;
+	v->as.vec.data = n > 0 ? malloc(sizeof(int64_t) * n) : NULL;
+	v->as.vec.owner = NULL;
+	lcell_alloc_bytes += sizeof(int64_t) * n;
+	return v;
+}
+
+lmemo *lmemo_new(int cap);
+int lmemo_cap(lmemo *t);
+
+/* 한 단계만 복사한다. 자식 요소(env, formals, body, cell)는 공유 */
+lval *lval_copy(lval *v)
+{
+	if (LFIXNUM_P(v))
+	{
+		return v;
+	}
+
+	lval *x = lval_alloc();
+	x->type = v->type;
+
+	switch (v->type)
+	{
+	/*함수와 정수는 바로 복사*/
+	case LVAL_FUN:
+		x->as.fun = v->as.fun;
+		break;
+	case LVAL_NUM:
+		x->as.num = v->as.num;
+		break;
+	case LVAL_DBL:
+		x->as.dbl = v->as.dbl;
+		break;
+	case LVAL_BIG:
+		x->count = v->count;
+		x->as.big.sign = v->as.big.sign;
+		x->as.big.limbs = malloc(sizeof(uint32_t) * (v->count > 0 ? v->count : 1));
+		memcpy(x->as.big.limbs, v->as.big.limbs, sizeof(uint32_t) * v->count);
+		break;
+	/* malloc과 strcpy를 사용하여 문자열을 복사*/
+	case LVAL_ERR:
+		x->as.err = malloc(strlen(v->as.err) + 1);
+		strcpy(x->as.err, v->as.err);
+		break;
+	case LVAL_SYM:
+		x->as.sym = v->as.sym;
+		break;
+	case LVAL_REF:
+		x->as.ref = v->as.ref;
+		break;
+	/*memo 는 같은 크기의 빈 cache 로 (결과는 같으므로)*/
+	case LVAL_MEMO:
+		x->as.memo.fn = v->as.memo.fn;
+		x->as.memo.table = lmemo_new(lmemo_cap(v->as.memo.table));
+		break;
+	/*sub 표현식들은 공유하고 list 만 새로 만든다*/
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		x->count = v->count;
+		x->as.list.cell = lcell_resize(NULL, 0, x->count);
+		x->as.list.owner = NULL;
+		x->as.list.cap = x->count;
+		lcell_copy(x->as.list.cell, v->as.list.cell, x->count);
+		break;
+	/*vector 는 배열까지 복사*/
+	case LVAL_VEC:
+		x->count = v->count;
+		x->as.vec.data = v->count > 0 ? malloc(sizeof(int64_t) * v->count) : NULL;
+		x->as.vec.owner = NULL;
+		if (v->count > 0)
+		{
+			memcpy(x->as.vec.data, v->as.vec.data, sizeof(int64_t) * v->count);
+		}
+		lcell_alloc_bytes += sizeof(int64_t) * v->count;
+		break;
+	}
+
+	return x;
+}
+
+/* cell 배열을 cap 칸으로 늘린다. 빌려 쓰던 배열이면 새로 할당해서 복사 */
+void lval_reserve(lval *v, int cap)
+{
+	if (v->as.list.owner)
+	{
+		lval **cell = lcell_resize(NULL, 0, cap);
+		lcell_copy(cell, v->as.list.cell, v->count);
+		v->as.list.cell = cell;
+		v->as.list.owner = NULL;
+	}
+	else
+	{
+		v->as.list.cell = lcell_resize(v->as.list.cell, v->as.list.cap, cap);
+	}
+	v->as.list.cap = cap;
+}
+
+/* 값은 공유되므로 list 를 수정하는 함수는 새로 만든 list 에만 사용한다
+	 칸이 모자라면 두 배로 늘리므로 n 번 추가는 O(n) */
+lval *lval_add(lval *v, lval *x)
+{
+	if (v->count == v->as.list.cap)
+	{
+		lval_reserve(v, v->as.list.cap < 4 ? 4 : v->as.list.cap * 2);
+	}
+	v->as.list.cell[v->count++] = x;
+	lgc_barrier(v);
+	return v;
+}
+
+/* v 의 from 번째부터의 요소들을 보는 새 list (O(1)).
+	 배열은 복사하지 않고 v 에게서 빌려 쓰므로, 완성된 list 에만 사용한다 */
+lval *lval_slice(lval *v, int from, int type)
+{
+	lval *x = lval_alloc();
+	x->type = type;
+	x->count = v->count - from;
+	x->as.list.cell = NULL;
+	x->as.list.owner = NULL;
+	x->as.list.cap = 0;
+	if (x->count > 0)
+	{
+		x->as.list.cell = v->as.list.cell + from;
+		x->as.list.owner = v->as.list.owner ? v->as.list.owner : v;
+		x->as.list.cap = x->count;
+	}
+	return x;
+}
+
+/* cell 배열의 count 개 요소를 복사한 새 list */
+lval *lval_array(int type, lval **cell, int count)
+{
+	lval *x = type == LVAL_QEXPR ? lval_qexpr() : lval_sexpr();
+	lval_reserve(x, count);
+	lcell_copy(x->as.list.cell, cell, count);
+	x->count = count;
+	return x;
+}
+
+/********************************************************/
+
+/*         숫자 : double, bignum          */
+
+/* 정수는 fixnum -> long (boxed) -> bignum 순서로 커진다.
+	 bignum 은 long 연산이 overflow 했을 때만 만들고, 결과가 long 범위면 다시 LVAL_NUM 으로 돌린다.
+	 bignum 은 항상 가장 높은 자리가 0 이 아니도록 (lbig_trim) 유지한다 */
+
+lval *lval_dbl(double x)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_DBL;
+	v->as.dbl = x;
+	return v;
+}
+
+/* 0 으로 채운 n 자리 bignum */
+lval *lbig_new(int n, int sign)
+{
+	lval *v = lval_alloc();
+	v->type = LVAL_BIG;
+	v->count = n;
+	v->as.big.sign = sign;
+	v->as.big.limbs = calloc(n > 0 ? n : 1, sizeof(uint32_t));
+	lcell_alloc_bytes += sizeof(uint32_t) * n;
+	return v;
+}
+
+lval *lbig_trim(lval *b)
+{
+	while (b->count > 0 && b->as.big.limbs[b->count - 1] == 0)
+	{
+		b->count--;
+	}
+	return b;
+}
+
+/* int64_t 를 bignum 으로 */
+lval *lbig_from64(int64_t n)
+{
+	uint64_t m = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+	lval *b = lbig_new(2, n < 0 ? -1 : 1);
+	b->as.big.limbs[0] = (uint32_t)m;
+	b->as.big.limbs[1] = (uint32_t)(m >> 32);
+	return lbig_trim(b);
+}
+
+/* 정수 lval 을 bignum 으로 */
+lval *lbig_from(lval *x)
+{
+	if (LTYPE(x) == LVAL_BIG)
+	{
+		return x;
+	}
+	return lbig_from64(LNUM(x));
+}
+
+/* long 범위 안이면 LVAL_NUM 으로 바꾼다 */
+lval *lbig_norm(lval *b)
+{
+	lbig_trim(b);
+	if (b->count > 2)
+	{
+		return b;
+	}
+	uint64_t m = 0;
+	for (int i = b->count - 1; i >= 0; i--)
+	{
+		m = (m << 32) | b->as.big.limbs[i];
+	}
+	if (b->as.big.sign > 0 && m <= (uint64_t)LONG_MAX)
+	{
+		return lval_num((long)m);
+	}
+	if (b->as.big.sign < 0 && m <= (uint64_t)LONG_MAX + 1)
+	{
+		return lval_num(m == 0 ? 0 : -(long)(m - 1) - 1);
+	}
+	return b;
+}
+
+/* 절댓값 비교 */
+int lbig_cmp(lval *a, lval *b)
+{
+	if (a->count != b->count)
+	{
+		return a->count < b->count ? -1 : 1;
+	}
+	for (int i = a->count - 1; i >= 0; i--)
+	{
+		if (a->as.big.limbs[i] != b->as.big.limbs[i])
+		{
+			return a->as.big.limbs[i] < b->as.big.limbs[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+/* |a| + |b| */
+lval *lbig_addmag(lval *a, lval *b, int sign)
+{
+	if (a->count < b->count)
+	{
+		lval *t = a;
+		a = b;
+		b = t;
+	}
+	lval *r = lbig_new(a->count + 1, sign);
+	uint64_t carry = 0;
+	for (int i = 0; i < a->count; i++)
+	{
+		carry += (uint64_t)a->as.big.limbs[i] + (i < b->count ? b->as.big.limbs[i] : 0);
+		r->as.big.limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	r->as.big.limbs[a->count] = (uint32_t)carry;
+	return lbig_trim(r);
+}
+
+/* |a| - |b| (|a| >= |b|) */
+lval *lbig_submag(lval *a, lval *b, int sign)
+{
+	lval *r = lbig_new(a->count, sign);
+	int64_t borrow = 0;
+	for (int i = 0; i < a->count; i++)
+	{
+		borrow += (int64_t)a->as.big.limbs[i] - (i < b->count ? b->as.big.limbs[i] : 0);
+		r->as.big.limbs[i] = (uint32_t)borrow;
+		borrow = borrow < 0 ? -1 : 0;
+	}
+	return lbig_trim(r);
+}
+
+lval *lbig_add(lval *a, lval *b, int bsign)
+{
+	int as = a->as.big.sign;
+	if (as == bsign)
+	{
+		return lbig_addmag(a, b, as);
+	}
+	return lbig_cmp(a, b) >= 0 ? lbig_submag(a, b, as) : lbig_submag(b, a, bsign);
+}
+
+lval *lbig_mul(lval *a, lval *b)
+{
+	lval *r = lbig_new(a->count + b->count, a->as.big.sign * b->as.big.sign);
+	for (int i = 0; i < a->count; i++)
+	{
+		uint64_t carry = 0;
+		for (int j = 0; j < b->count; j++)
+		{
+			carry += (uint64_t)a->as.big.limbs[i] * b->as.big.limbs[j] + r->as.big.limbs[i + j];
+			r->as.big.limbs[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		r->as.big.limbs[i + b->count] = (uint32_t)carry;
+	}
+	return lbig_trim(r);
+}
+
+/* b 를 한 자리 수 d 로 나눈 몫 (b 를 직접 바꾼다), 나머지를 리턴 */
+uint32_t lbig_divsmall(lval *b, uint32_t d)
+{
+	uint64_t rem = 0;
+	for (int i = b->count - 1; i >= 0; i--)
+	{
+		rem = (rem << 32) | b->as.big.limbs[i];
+		b->as.big.limbs[i] = (uint32_t)(rem / d);
+		rem %= d;
+	}
+	lbig_trim(b);
+	return (uint32_t)rem;
+}
+
+/* 0 을 향해 버리는 나눗셈 a / b (b 는 0 이 아님) */
+lval *lbig_div(lval *a, lval *b)
+{
+	int sign = a->as.big.sign * b->as.big.sign;
+	lval *q = lbig_new(a->count, sign);
+	memcpy(q->as.big.limbs, a->as.big.limbs, sizeof(uint32_t) * a->count);
+	if (b->count == 1)
+	{
+		lbig_divsmall(q, b->as.big.limbs[0]);
+		return q;
+	}
+
+	/* 한 bit 씩 내려오며 나머지 r 에서 |b| 를 빼는 긴 나눗셈 */
+	memset(q->as.big.limbs, 0, sizeof(uint32_t) * a->count);
+	lval *r = lbig_new(b->count + 1, 1);
+	r->count = 0;
+	for (long bit = (long)a->count * 32 - 1; bit >= 0; bit--)
+	{
+		/* r = r * 2 + (a 의 bit) */
+		uint32_t in = (a->as.big.limbs[bit / 32] >> (bit % 32)) & 1;
+		for (int i = 0; i <= b->count; i++)
+		{
+			uint32_t out = r->as.big.limbs[i] >> 31;
+			r->as.big.limbs[i] = (r->as.big.limbs[i] << 1) | in;
+			in = out;
+		}
+		r->count = b->count + 1;
+		lbig_trim(r);
+
+		if (lbig_cmp(r, b) >= 0)
+		{
+			int64_t borrow = 0;
+			for (int i = 0; i < r->count; i++)
+			{
+				borrow += (int64_t)r->as.big.limbs[i] - (i < b->count ? b->as.big.limbs[i] : 0);
+				r->as.big.limbs[i] = (uint32_t)borrow;
+				borrow = borrow < 0 ? -1 : 0;
+			}
+			lbig_trim(r);
+			q->as.big.limbs[bit / 32] |= (uint32_t)1 << (bit % 32);
+		}
+	}
+	return lbig_trim(q);
+}
+
+/* 10진수 문자열 (앞에 '-' 가능) 을 bignum 으로 */
+lval *lbig_parse(char *s)
+{
+	int sign = 1;
+	if (*s == '-')
+	{
+		sign = -1;
+		s++;
+	}
+	lval *b = lbig_new((int)strlen(s) / 9 + 2, sign);
+	b->count = 0;
+	for (; *s; s++)
+	{
+		uint64_t carry = (uint64_t)(*s - '0');
+		for (int i = 0; i < b->count; i++)
+		{
+			carry += (uint64_t)b->as.big.limbs[i] * 10;
+			b->as.big.limbs[i] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		if (carry)
+		{
+			b->as.big.limbs[b->count++] = (uint32_t)carry;
+		}
+	}
+	return lbig_norm(b);
+}
+
+void lbig_print(FILE *f, lval *b)
+{
+	/* 10^9 으로 나눈 나머지들을 낮은 자리부터 모은다 */
+	lval *t = lval_copy(b);
+	uint32_t *chunks = malloc(sizeof(uint32_t) * (b->count * 10 / 9 + 2));
+	int n = 0;
+	while (t->count > 0)
+	{
+		chunks[n++] = lbig_divsmall(t, 1000000000u);
+	}
+
+	if (b->as.big.sign < 0)
+	{
+		fputc('-', f);
+	}
+	fprintf(f, "%lu", (unsigned long)(n ? chunks[n - 1] : 0));
+	for (int i = n - 2; i >= 0; i--)
+	{
+		fprintf(f, "%09lu", (unsigned long)chunks[i]);
+	}
+	free(chunks);
+}
+
+/* 숫자 lval 의 double 값 */
+double lnum_dbl(lval *v)
+{
+	switch (LTYPE(v))
+	{
+	case LVAL_DBL:
+		return v->as.dbl;
+	case LVAL_BIG:
+	{
+		double d = 0;
+		for (int i = v->count - 1; i >= 0; i--)
+		{
+			d = d * 4294967296.0 + v->as.big.limbs[i];
+		}
+		return v->as.big.sign * d;
+	}
+	default:
+		return (double)LNUM(v);
+	}
+}
+
+/* 다시 읽었을 때 같은 값이 되는 가장 짧은 표기, 정수처럼 보이면 .0 을 붙인다 */
+void ldbl_print(double x)
+{
+	char buf[32];
+	for (int prec = 15; prec <= 17; prec++)
+	{
+		sprintf(buf, "%.*g", prec, x);
+		if (strtod(buf, NULL) == x)
+		{
+			break;
+		}
+	}
+	fputs(buf, stdout);
+	if (!strpbrk(buf, ".eni"))
+	{
+		fputs(".0", stdout);
+	}
+}
+
+void lval_print(lval *v);
+
+void lval_print_expr(lval *v, char open, char close)
+{
+	putchar(open);
+	for (int i = 0; i < v->count; i++)
+	{
+		/* 값 출력 */
+		lval_print(v->as.list.cell[i]);
+
+		/* 마지막 요소가 공백이라면 출력하지 않기  */
+		if (i != (v->count - 1))
+		{
+			putchar(' ');
+		}
+	}
+	putchar(close);
+}
+
+// lval 출력
+void lval_print(lval *v)
+{
+	switch (LTYPE(v))
+	{
+	case LVAL_NUM:
+		printf("%li", LNUM(v));
+		break;
+	case LVAL_DBL:
+		ldbl_print(v->as.dbl);
+		break;
+	case LVAL_BIG:
+		lbig_print(stdout, v);
+		break;
+
+	case LVAL_ERR:
+		printf("Error: %s", v->as.err);
+		break;
+	case LVAL_SYM:
+		printf("%s", v->as.sym->name);
+		break;
+	case LVAL_REF:
+		printf("%s", v->as.ref.sym->name);
+		break;
+	case LVAL_FUN:
+		if (v->as.fun.builtin)
+		{
+			printf("<Function>");
+		}
+		else
+		{
+			/* 부분 적용된 함수는 아직 bind 되지 않은 formal 만 출력 */
+			lval *formals = v->as.fun.formals;
+			int i = 0;
+			while (i < formals->count && v->as.fun.env->vals[i])
+			{
+				i++;
+			}
+			printf("(\\ {");
+			for (int j = i; j < formals->count; j++)
+			{
+				lval_print(formals->as.list.cell[j]);
+				if (j != formals->count - 1)
+				{
+					putchar(' ');
+				}
+			}
+			printf("} ");
+			lval_print(v->as.fun.body);
+			putchar(')');
+		}
+
+		break;
+	case LVAL_MEMO:
+		printf("(memo ");
+		lval_print(v->as.memo.fn);
+		putchar(')');
+		break;
+	case LVAL_SEXPR:
+		lval_print_expr(v, '(', ')');
+		break;
+	case LVAL_QEXPR:
+		lval_print_expr(v, '{', '}');
+		break;
+	case LVAL_VEC:
+		putchar('[');
+		for (int i = 0; i < v->count; i++)
+		{
+			printf(i ? " %lld" : "%lld", (long long)v->as.vec.data[i]);
+		}
+		putchar(']');
+		break;
+	}
+}
+
+void lval_println(lval *v)
+{
+	lval_print(v);
+	putchar('\n');
+}
+
+char *ltype_name(int t)
+{
+	switch (t)
+	{
+	case LVAL_FUN:
+		return "Function";
+	case LVAL_NUM:
+		return "Number";
+	case LVAL_DBL:
+		return "Float";
+	case LVAL_BIG:
+		return "Bignum";
+	case LVAL_ERR:
+		return "Error";
+	case LVAL_SYM:
+		return "Symbol";
+	case LVAL_SEXPR:
+		return "S-Expression";
+	case LVAL_QEXPR:
+		return "Q-Expression";
+	case LVAL_VEC:
+		return "Vector";
+	case LVAL_CODE:
+		return "Bytecode";
+	case LVAL_MEMO:
+		return "Memo";
+	default:
+		return "Unknown";
+	}
+}
+
+lenv *lenv_new(void)
+{
+	lenv *e = lenv_alloc();
+	e->par = NULL;
+	e->count = 0;
+	e->syms = NULL;
+	e->vals = NULL;
+	e->proto = NULL;
+	e->live = 0;
+	e->index = NULL;
+	e->nindex = 0;
+
+	return e;
+}
+
+#define LENV_HASH_MIN 8
+
+/* 전역 환경이 바뀔 때마다 증가. inline cache 는 이 값이 같을 때만 사용한다 */
+unsigned long lenv_version = 1;
+
+long lic_hits = 0;
+long lic_misses = 0;
+
+/* 심볼 k 의 dense 배열 위치, 없으면 -1 */
+int lenv_find(lenv *e, latom *k)
+{
+	/* 작은 환경은 배열을 그대로 순회 (같은 이름의 formal 이 있으면 마지막 것) */
+	if (!e->index)
+	{
+		for (int i = e->count - 1; i >= 0; i--)
+		{
+			if (e->syms[i] == k)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	unsigned long mask = e->nindex - 1;
+	for (unsigned long h = k->hash & mask;; h = (h + 1) & mask)
+	{
+		int i = e->index[h];
+		if (i == 0)
+		{
+			return -1;
+		}
+		if (e->syms[i - 1] == k)
+		{
+			return i - 1;
+		}
+	}
+}
+
+/* 값이 있는 k 의 위치, 없으면 -1. 비어 있는 slot (끝난 let, bind 되지 않은 formal) 이면
+	 그 앞의 같은 이름을 찾는다 */
+int lenv_find_val(lenv *e, latom *k)
+{
+	int i = lenv_find(e, k);
+	while (i >= 0 && !e->vals[i])
+	{
+		for (i--; i >= 0 && e->syms[i] != k; i--)
+		{
+		}
+	}
+	return i;
+}
+
+void lenv_index_add(lenv *e, int i)
+{
+	unsigned long mask = e->nindex - 1;
+	unsigned long h = e->syms[i]->hash & mask;
+	while (e->index[h])
+	{
+		/* 같은 이름이 이미 있으면 나중에 추가한 쪽을 찾도록 바꾼다 (배열 순회와 같은 결과) */
+		if (e->syms[e->index[h] - 1] == e->syms[i])
+		{
+			e->index[h] = i + 1;
+			return;
+		}
+		h = (h + 1) & mask;
+	}
+	e->index[h] = i + 1;
+}
+
+/* load factor 가 1/2 을 넘지 않도록 hash index 를 다시 만든다 */
+void lenv_reindex(lenv *e)
+{
+	int n = 16;
+	while (n < e->count * 4)
+	{
+		n *= 2;
+	}
+
+	free(e->index);
+	e->index = calloc(n, sizeof(int));
+	e->nindex = n;
+	for (int i = 0; i < e->count; i++)
+	{
+		lenv_index_add(e, i);
+	}
+}
+
+lval *lenv_get(lenv *e, lval *k)
+{
+	/*현재 환경부터 부모 환경 방향으로 찾는다*/
+	for (; e; e = e->par)
+	{
+		/*만약 일치한다면, value을 공유하여 리턴*/
+		int i = lenv_find_val(e, k->as.sym);
+		if (i >= 0)
+		{
+			return e->vals[i];
+		}
+	}
+
+	return lval_err("unbound symbol! '%s'", k->as.sym->name);
+}
+
+/* 새 entry 를 추가한다. (빈 slot 이면 v 는 NULL) */
+void lenv_add(lenv *e, latom *k, lval *v)
+{
+	/* 빌려 쓰던 syms 는 복사해서 자기 것으로 만든다 (index 는 아래에서 다시 만든다) */
+	if (e->proto)
+	{
+		latom **syms = lcell_resize(NULL, 0, e->count);
+		lcell_copy(syms, e->syms, e->count);
+		e->syms = syms;
+		e->index = NULL;
+		e->nindex = 0;
+		e->proto = NULL;
+	}
+
+	e->vals = lcell_resize(e->vals, e->count, e->count + 1);
+	e->syms = lcell_resize(e->syms, e->count, e->count + 1);
+	e->count++;
+
+	e->vals[e->count - 1] = v;
+	e->syms[e->count - 1] = k;
+	lgc_barrier_env(e);
+
+	/*hash index 갱신*/
+	if (e->index && e->count * 2 <= e->nindex)
+	{
+		lenv_index_add(e, e->count - 1);
+	}
+	else if (e->count > LENV_HASH_MIN)
+	{
+		lenv_reindex(e);
+	}
+}
+
+void lenv_put(lenv *e, lval *k, lval *v)
+{
+	/* 전역 정의가 바뀌면 모든 inline cache 무효화 */
+	if (!e->par)
+	{
+		lenv_version++;
+	}
+
+	/*변수들이 이미 존재한다면, user가 제공한 변수로 대체함*/
+	int i = lenv_find(e, k->as.sym);
+	if (i >= 0)
+	{
+		e->vals[i] = v;
+		lgc_barrier_env(e);
+		return;
+	}
+
+	/*존재하는 entry를 찾지 못한다면, 새로운 entry를 추가한다.*/
+	lenv_add(e, k->as.sym, v);
+}
+
+/* e 와 같은 심볼을 가진 activation frame. 값 배열만 새로 만들고
+	 syms 와 hash index 는 원본과 공유한다 (원본은 만든 뒤 수정하지 않는다) */
+lenv *lenv_frame(lenv *e)
+{
+	lenv *n = lenv_alloc();
+	n->par = e->par;
+	n->proto = e->proto ? e->proto : e;
+	n->count = e->count;
+	n->syms = e->syms;
+	n->vals = lcell_resize(NULL, 0, n->count);
+	lcell_copy(n->vals, e->vals, n->count);
+	n->live = e->live;
+	n->index = e->index;
+	n->nindex = e->nindex;
+	return n;
+}
+
+void lenv_def(lenv *e, lval *k, lval *v)
+{
+	/* Iterate till e has no parent */
+	while (e->par)
+	{
+		e = e->par;
+	}
+	/* Put value in e */
+	lenv_put(e, k, v);
+}
+
+/********************************************************/
+
+/*         Special Forms          */
+
+/* 인자를 먼저 평가하지 않고 평가기가 직접 처리하는 form. 이름으로 알아보므로 재정의할 수 없다.
+	 (def 와 = 로 그 이름을 정의하면 에러)
+	 (formal 이 같은 이름이면 slot 참조로 바뀌어서 form 이 아니게 된다)
+	 - if c a [b]           : c 가 참이면 a, 아니면 b (없으면 ())
+	 - cond (c1 e1) (c2 e2) : 처음으로 참인 c 의 e. e 가 없으면 c 의 값
+	 - let ((x 1) (y x)) e  : 앞에서부터 차례로 bind 한 뒤 e
+	 - and a b .. / or a b .. : 결과가 정해지는 곳까지만 평가하고 그 값을 리턴
+	 if/cond/let 의 branch 자리에 있는 Q-Expression 은 eval 과 같이 S-Expression 으로 평가한다.
+	 각 form 의 마지막 식은 꼬리 위치이다 */
+enum
+{
+	LFORM_NONE,
+	LFORM_IF,
+	LFORM_COND,
+	LFORM_LET,
+	LFORM_AND,
+	LFORM_OR
+};
+
+/* 이름 k 가 나타내는 form */
+int lform_name(latom *k)
+{
+	if (k == latom_if)
+	{
+		return LFORM_IF;
+	}
+	if (k == latom_cond)
+	{
+		return LFORM_COND;
+	}
+	if (k == latom_let)
+	{
+		return LFORM_LET;
+	}
+	if (k == latom_and)
+	{
+		return LFORM_AND;
+	}
+	if (k == latom_or)
+	{
+		return LFORM_OR;
+	}
+	return LFORM_NONE;
+}
+
+int lform_kind(lval *v)
+{
+	if (v->count == 0 || LTYPE(v->as.list.cell[0]) != LVAL_SYM)
+	{
+		return LFORM_NONE;
+	}
+	return lform_name(v->as.list.cell[0]->as.sym);
+}
+
+int lval_list_p(lval *v)
+{
+	return LTYPE(v) == LVAL_SEXPR || LTYPE(v) == LVAL_QEXPR;
+}
+
+/* 거짓은 0, 0.0 과 빈 list ({} 와 ()). 나머지는 모두 참 */
+int lval_true(lval *v)
+{
+	switch (LTYPE(v))
+	{
+	case LVAL_NUM:
+		return LNUM(v) != 0;
+	case LVAL_DBL:
+		return v->as.dbl != 0;
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		return v->count != 0;
+	default:
+		return 1;
+	}
+}
+
+/* form 의 모양 확인. 잘못되었으면 에러, 아니면 NULL */
+lval *lform_check(lval *v)
+{
+	lval **cell = v->as.list.cell;
+	char *name = cell[0]->as.sym->name;
+	int n = v->count - 1;
+
+	switch (lform_kind(v))
+	{
+	case LFORM_IF:
+		if (n != 2 && n != 3)
+		{
+			return lval_err("Function '%s' passed incorrect number of arguments. "
+											"Got %i, Expected 2 or 3.",
+											name, n);
+		}
+		break;
+	case LFORM_COND:
+		for (int i = 1; i <= n; i++)
+		{
+			if (!lval_list_p(cell[i]) || cell[i]->count < 1 || cell[i]->count > 2)
+			{
+				return lval_err("Function '%s' passed invalid clause %i. Expected (test value).",
+												name, i - 1);
+			}
+		}
+		break;
+	case LFORM_LET:
+		if (n != 2)
+		{
+			return lval_err("Function '%s' passed incorrect number of arguments. "
+											"Got %i, Expected %i.",
+											name, n, 2);
+		}
+		if (!lval_list_p(cell[1]))
+		{
+			return lval_err("Function '%s' passed incorrect type for argument %i. "
+											"Got %s, Expected %s.",
+											name, 0, ltype_name(LTYPE(cell[1])), ltype_name(LVAL_SEXPR));
+		}
+		for (int i = 0; i < cell[1]->count; i++)
+		{
+			lval *b = cell[1]->as.list.cell[i];
+			if (!lval_list_p(b) || b->count != 2 ||
+					(LTYPE(b->as.list.cell[0]) != LVAL_SYM && LTYPE(b->as.list.cell[0]) != LVAL_REF))
+			{
+				return lval_err("Function '%s' passed invalid binding %i. Expected (symbol value).",
+												name, i);
+			}
+		}
+		break;
+	}
+	return NULL;
+}
+
+/********************************************************/
+
+/*         Bytecode Compiler          */
+
+/* lambda body 는 만들 때 한번 compile 해서 stack VM(lvm_run) 으로 실행한다.
+	 op 뒤에는 operand 가 하나씩 붙는다. (LOP_NIL, LOP_RET 제외)
+	 - LOP_CONST k  : consts[k] 를 push (숫자, Q-Expression, 함수 등 평가해도 그대로인 값)
+	 - LOP_LOAD  i  : 현재 frame 의 slot i 를 push (lval_resolve 가 찾아둔 formal)
+	 - LOP_GLOBAL k : 심볼 consts[k] 를 환경에서 찾아서 push (전역 값은 caches[k] 에 기억)
+	 - LOP_NIL      : 빈 S-Expression 을 push
+	 - LOP_CALL  n  : stack 위의 n 개 (함수 + 인자) 를 lval_eval_sexpr 와 같은 규칙으로 적용
+	 - LOP_TAIL  n  : body 의 마지막 적용. 현재 activation 을 새 함수로 바꿔서 계속 실행
+	 - LOP_RET      : stack 맨 위의 값을 리턴
+	 - LOP_JUMP  a  : ops[a] 로 이동
+	 - LOP_JFALSE a : stack 맨 위를 꺼내서 거짓이면 ops[a] 로 이동
+	 - LOP_AND   a  : 맨 위가 거짓이면 그대로 두고 ops[a] 로, 참이면 꺼낸다 (LOP_OR 은 반대)
+	 - LOP_STORE i  : stack 맨 위를 꺼내서 현재 frame 의 slot i 에 저장 (let)
+	 - LOP_DROP  i  : 현재 frame 의 slot i 를 비운다 (끝난 let)
+	 JFALSE, AND, OR, STORE 는 맨 위가 에러라면 바로 리턴한다 */
+enum
+{
+	LOP_CONST,
+	LOP_LOAD,
+	LOP_GLOBAL,
+	LOP_NIL,
+	LOP_CALL,
+	LOP_TAIL,
+	LOP_RET,
+	LOP_JUMP,
+	LOP_JFALSE,
+	LOP_AND,
+	LOP_OR,
+	LOP_STORE,
+	LOP_DROP
+};
+
+/* 1 이면 lambda 를 compile 하지 않고 tree walker 로만 평가한다 (--tree) */
+int lval_tree = 0;
+
+/* compile 중인 code lval 에 op 하나를 추가 */
+void lcode_emit(lval *c, int op)
+{
+	if ((c->count & (c->count - 1)) == 0)
+	{
+		c->as.code.ops = realloc(c->as.code.ops, sizeof(int) * (c->count ? c->count * 2 : 1));
+	}
+	c->as.code.ops[c->count++] = op;
+}
+
+/* 상수 하나를 추가하고 그 번호를 리턴 */
+int lcode_const(lval *c, lval *v)
+{
+	int k = c->as.code.nconsts;
+	if ((k & (k - 1)) == 0)
+	{
+		c->as.code.consts = realloc(c->as.code.consts, sizeof(lval *) * (k ? k * 2 : 1));
+	}
+	c->as.code.consts[c->as.code.nconsts++] = v;
+	return k;
+}
+
+void lcode_sexpr(lval *c, lval *v, int tail);
+
+/* lval_eval 과 같은 일을 하는 code */
+void lcode_expr(lval *c, lval *v)
+{
+	switch (LTYPE(v))
+	{
+	case LVAL_SYM:
+		lcode_emit(c, LOP_GLOBAL);
+		lcode_emit(c, lcode_const(c, v));
+		break;
+	case LVAL_REF:
+		lcode_emit(c, LOP_LOAD);
+		lcode_emit(c, v->as.ref.slot);
+		break;
+	case LVAL_SEXPR:
+		lcode_sexpr(c, v, 0);
+		break;
+	default:
+		lcode_emit(c, LOP_CONST);
+		lcode_emit(c, lcode_const(c, v));
+		break;
+	}
+}
+
+/* jump 를 추가하고 나중에 채울 주소 operand 의 위치를 리턴 */
+int lcode_jump(lval *c, int op)
+{
+	lcode_emit(c, op);
+	lcode_emit(c, 0);
+	return c->count - 1;
+}
+
+/* at 의 jump 가 지금 위치로 오도록 */
+void lcode_patch(lval *c, int at)
+{
+	c->as.code.ops[at] = c->count;
+}
+
+/* form 의 꼬리 식. branch 라면 Q-Expression 도 S-Expression 처럼 평가한다 */
+void lcode_value(lval *c, lval *x, int tail, int branch)
+{
+	if (LTYPE(x) == LVAL_SEXPR || (branch && LTYPE(x) == LVAL_QEXPR))
+	{
+		lcode_sexpr(c, x, tail);
+		return;
+	}
+	lcode_expr(c, x);
+}
+
+/* special form : 조건은 jump 로, 꼬리 위치라면 각 branch 가 끝날 때 바로 리턴한다 */
+void lcode_form(lval *c, lval *v, int tail)
+{
+	lval *err = lform_check(v);
+	if (err)
+	{
+		lcode_emit(c, LOP_CONST);
+		lcode_emit(c, lcode_const(c, err));
+		return;
+	}
+
+	lval **cell = v->as.list.cell;
+	int form = lform_kind(v);
+	int *ends = malloc(sizeof(int) * v->count);
+	int nends = 0;
+
+	switch (form)
+	{
+	case LFORM_IF:
+	{
+		lcode_expr(c, cell[1]);
+		int jf = lcode_jump(c, LOP_JFALSE);
+		lcode_value(c, cell[2], tail, 1);
+		if (tail)
+		{
+			lcode_emit(c, LOP_RET);
+		}
+		else
+		{
+			ends[nends++] = lcode_jump(c, LOP_JUMP);
+		}
+		lcode_patch(c, jf);
+		if (v->count == 4)
+		{
+			lcode_value(c, cell[3], tail, 1);
+		}
+		else
+		{
+			lcode_emit(c, LOP_NIL);
+		}
+		break;
+	}
+	case LFORM_COND:
+		for (int i = 1; i < v->count; i++)
+		{
+			lval *clause = cell[i];
+			lcode_expr(c, clause->as.list.cell[0]);
+
+			/* (c) 는 c 가 참이면 그 값 */
+			if (clause->count == 1)
+			{
+				ends[nends++] = lcode_jump(c, LOP_OR);
+				continue;
+			}
+			int jf = lcode_jump(c, LOP_JFALSE);
+			lcode_value(c, clause->as.list.cell[1], tail, 1);
+			if (tail)
+			{
+				lcode_emit(c, LOP_RET);
+			}
+			else
+			{
+				ends[nends++] = lcode_jump(c, LOP_JUMP);
+			}
+			lcode_patch(c, jf);
+		}
+		lcode_emit(c, LOP_NIL);
+		break;
+	case LFORM_LET:
+		/* lval_resolve 가 변수를 slot 으로 바꿔 두었다 */
+		for (int i = 0; i < cell[1]->count; i++)
+		{
+			lval *b = cell[1]->as.list.cell[i];
+			lcode_expr(c, b->as.list.cell[1]);
+			lcode_emit(c, LOP_STORE);
+			lcode_emit(c, b->as.list.cell[0]->as.ref.slot);
+		}
+		lcode_value(c, cell[2], tail, 1);
+
+		/* 꼬리 위치가 아니면 let 이 끝난 뒤에 이름으로 찾지 못하게 비운다 */
+		for (int i = 0; !tail && i < cell[1]->count; i++)
+		{
+			lcode_emit(c, LOP_DROP);
+			lcode_emit(c, cell[1]->as.list.cell[i]->as.list.cell[0]->as.ref.slot);
+		}
+		break;
+	case LFORM_AND:
+	case LFORM_OR:
+		if (v->count == 1)
+		{
+			lcode_emit(c, LOP_CONST);
+			lcode_emit(c, lcode_const(c, lval_num(form == LFORM_AND)));
+			break;
+		}
+		for (int i = 1; i < v->count - 1; i++)
+		{
+			lcode_expr(c, cell[i]);
+			ends[nends++] = lcode_jump(c, form == LFORM_AND ? LOP_AND : LOP_OR);
+		}
+		lcode_value(c, cell[v->count - 1], tail, 0);
+		break;
+	}
+
+	for (int i = 0; i < nends; i++)
+	{
+		lcode_patch(c, ends[i]);
+	}
+	free(ends);
+}
+
+/* lval_eval_sexpr 와 같은 일을 하는 code : 요소를 차례로 push 하고 한번에 적용 */
+void lcode_sexpr(lval *c, lval *v, int tail)
+{
+	if (lform_kind(v) != LFORM_NONE)
+	{
+		lcode_form(c, v, tail);
+		return;
+	}
+	if (v->count == 0)
+	{
+		lcode_emit(c, LOP_NIL);
+		return;
+	}
+	for (int i = 0; i < v->count; i++)
+	{
+		lcode_expr(c, v->as.list.cell[i]);
+	}
+	lcode_emit(c, tail ? LOP_TAIL : LOP_CALL);
+	lcode_emit(c, v->count);
+}
+
+/* lambda body (Q-Expression) 를 S-Expression 으로 compile */
+lval *lval_compile(lval *body)
+{
+	lval *c = lval_alloc();
+	c->type = LVAL_CODE;
+	c->count = 0;
+	c->as.code.ops = NULL;
+	c->as.code.consts = NULL;
+	c->as.code.nconsts = 0;
+
+	lcode_sexpr(c, body, 1);
+	lcode_emit(c, LOP_RET);
+	c->as.code.caches = calloc(c->as.code.nconsts, sizeof(licache));
+	return c;
+}
+
+/*Builtins*/
+
+#define LASSERT(args, cond, fmt, ...) \
+	if (!(cond))                        \
+	{                                   \
+		return lval_err(fmt, __VA_ARGS__); \
+	}
+
+#define LASSERT_TYPE(func, args, index, expect)                                        \
+	LASSERT(args, LTYPE(args->as.list.cell[index]) == expect,                                     \
+					"Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.", \
+					func, index, ltype_name(LTYPE(args->as.list.cell[index])), ltype_name(expect))
+
+#define LASSERT_NUM(func, args, num)                                                  \
+	LASSERT(args, args->count == num,                                                   \
+					"Function '%s' passed incorrect number of arguments. Got %i, Expected %i.", \
+					func, args->count, num)
+
+#define LASSERT_NOT_EMPTY(func, args, index)   \
+	LASSERT(args, args->as.list.cell[index]->count != 0, \
+					"Function '%s' passed {} for argument %i.", func, index);
+
+lval *lval_eval(lenv *e, lval *v);
+lval *lval_eval_sexpr(lenv *e, lval *v);
+
+/* lambda body 를 바꾸는 동안 보이는 let 변수. 안쪽 let 이 앞에 온다 */
+typedef struct lscope
+{
+	latom *sym;
+	int slot;
+	struct lscope *next;
+} lscope;
+
+/* k 의 slot : let 변수를 먼저 찾고, 다음은 frame 앞쪽 nfixed 개 (formal 과 capture). 없으면 -1 */
+int lscope_find(lscope *s, lenv *frame, int nfixed, latom *k)
+{
+	for (; s; s = s->next)
+	{
+		if (s->sym == k)
+		{
+			return s->slot;
+		}
+	}
+
+	/* 이 범위 밖의 let slot 에 가려졌다면 앞쪽에서 다시 찾는다 */
+	int i = lenv_find(frame, k);
+	if (i >= nfixed)
+	{
+		for (i = nfixed - 1; i >= 0 && frame->syms[i] != k; i--)
+		{
+		}
+	}
+	return i;
+}
+
+lval *lval_resolve(lval *v, lenv *frame, int nfixed, lscope *scope, int clause);
+
+/* 식 하나를 바꾼다. code 가 아니면 Q-Expression 은 data 이므로 그대로 공유한다 */
+lval *lval_resolve_expr(lval *c, lenv *frame, int nfixed, lscope *scope, int code)
+{
+	switch (LTYPE(c))
+	{
+	case LVAL_SYM:
+	{
+		int slot = lscope_find(scope, frame, nfixed, c->as.sym);
+		return slot >= 0 ? lval_ref(c->as.sym, slot) : c;
+	}
+	case LVAL_SEXPR:
+		return lval_resolve(c, frame, nfixed, scope, 0);
+	case LVAL_QEXPR:
+		return code ? lval_resolve(c, frame, nfixed, scope, 0) : c;
+	default:
+		return c;
+	}
+}
+
+/* let 의 변수마다 frame 에 새 slot 을 만들고, 초기값과 body 를 그 scope 에서 바꾼다 */
+lval *lval_resolve_let(lval *x, lenv *frame, int nfixed, lscope *scope)
+{
+	lval *b = lval_copy(x->as.list.cell[1]);
+	x->as.list.cell[1] = b;
+
+	lscope *s = malloc(sizeof(lscope) * (b->count ? b->count : 1));
+	for (int i = 0; i < b->count; i++)
+	{
+		lval *p = lval_copy(b->as.list.cell[i]);
+		b->as.list.cell[i] = p;
+
+		/* 초기값에서는 앞의 변수까지 보인다 */
+		p->as.list.cell[1] = lval_resolve_expr(p->as.list.cell[1], frame, nfixed, scope, 0);
+
+		latom *k = p->as.list.cell[0]->as.sym;
+		s[i].sym = k;
+		s[i].slot = frame->count;
+		s[i].next = scope;
+		scope = &s[i];
+		lenv_add(frame, k, NULL);
+		p->as.list.cell[0] = lval_ref(k, s[i].slot);
+	}
+	x->as.list.cell[2] = lval_resolve_expr(x->as.list.cell[2], frame, nfixed, scope, 1);
+	free(s);
+	return x;
+}
+
+/* lambda body 안에서 formal, capture 한 변수, let 변수를 가리키는 심볼을 slot 참조로 바꾼 새 list 를 만든다.
+	 평가되는 위치(body 자신, S-Expression, special form 의 branch)만 바꾸고 나머지 Q-Expression 은 그대로 둔다.
+	 frame 의 앞쪽 nfixed 개가 formal 과 capture 이고, let 변수는 그 뒤에 slot 을 추가한다.
+	 clause 이면 cond 의 절이므로 두번째 요소가 branch 이다 */
+lval *lval_resolve(lval *v, lenv *frame, int nfixed, lscope *scope, int clause)
+{
+	lval *x = lval_copy(v);
+	if (x->count == 0)
+	{
+		return x;
+	}
+	x->as.list.cell[0] = lval_resolve_expr(x->as.list.cell[0], frame, nfixed, scope, 0);
+
+	int form = clause ? LFORM_NONE : lform_kind(x);
+	if (form == LFORM_LET && !lform_check(x))
+	{
+		return lval_resolve_let(x, frame, nfixed, scope);
+	}
+	for (int i = 1; i < x->count; i++)
+	{
+		lval *c = x->as.list.cell[i];
+		if (form == LFORM_COND && lval_list_p(c))
+		{
+			x->as.list.cell[i] = lval_resolve(c, frame, nfixed, scope, 1);
+			continue;
+		}
+		x->as.list.cell[i] = lval_resolve_expr(c, frame, nfixed, scope, clause || (form == LFORM_IF && i >= 2));
+	}
+	return x;
+}
+
+/* v 안의 (Q-Expression 포함) 심볼 중 frame e 에 있고 t 에는 없는 것을 t 에 추가한다.
+	 eval 로 나중에 평가될 Q-Expression 안의 심볼도 잡기 위해 전부 살펴본다 */
+void lval_capture(lenv *t, lval *v, lenv *e)
+{
+	for (int i = 0; i < v->count; i++)
+	{
+		lval *c = v->as.list.cell[i];
+		switch (LTYPE(c))
+		{
+		case LVAL_SYM:
+		{
+			int j = lenv_find_val(e, c->as.sym);
+			if (j >= 0 && lenv_find(t, c->as.sym) < 0)
+			{
+				lenv_add(t, c->as.sym, e->vals[j]);
+			}
+			break;
+		}
+		case LVAL_SEXPR:
+		case LVAL_QEXPR:
+			lval_capture(t, c, e);
+			break;
+		}
+	}
+}
+
+lval *builtin_lambda(lenv *e, lval *a)
+{
+	LASSERT_NUM("\\", a, 2);
+	LASSERT_TYPE("\\", a, 0, LVAL_QEXPR);
+	LASSERT_TYPE("\\", a, 1, LVAL_QEXPR);
+
+	for (int i = 0; i < a->as.list.cell[0]->count; i++)
+	{
+		LASSERT(a, (LTYPE(a->as.list.cell[0]->as.list.cell[i]) == LVAL_SYM),
+						"Cannot define non-symbol. Got %s, Expected %s.",
+						ltype_name(LTYPE(a->as.list.cell[0]->as.list.cell[i])), ltype_name(LVAL_SYM));
+	}
+	lval *f = lval_lambda(a->as.list.cell[0], a->as.list.cell[1]);
+
+	/* 호출 frame 의 부모는 항상 전역 환경 (lexical scope) */
+	lenv *g = e;
+	while (g->par)
+	{
+		g = g->par;
+	}
+	f->as.fun.env->par = g;
+
+	/* lambda 안에서 만들었다면 자유 변수의 현재 값을 formal 뒤의 slot 에 담아 둔다
+		 (let 이 만든 환경 안이라면 바깥쪽 frame 까지) */
+	for (lenv *x = e; x != g; x = x->par)
+	{
+		lval_capture(f->as.fun.env, f->as.fun.body, x);
+	}
+	f->as.fun.env->live = f->as.fun.env->count;
+	f->as.fun.body = lval_resolve(f->as.fun.body, f->as.fun.env, f->as.fun.env->count, NULL, 0);
+	if (!lval_tree)
+	{
+		f->as.fun.code = lval_compile(f->as.fun.body);
+	}
+	return f;
+}
+
+lval *builtin_list(lenv *e, lval *a)
+{
+	/* a 는 평가기가 새로 만든 인자 list 이므로 그대로 바꿔서 사용 */
+	a->type = LVAL_QEXPR;
+	return a;
+}
+
+lval *builtin_head(lenv *e, lval *a)
+{
+	/* 에러 확인 */
+	LASSERT_NUM("head", a, 1);
+	LASSERT_TYPE("head", a, 0, LVAL_QEXPR);
+	LASSERT_NOT_EMPTY("head", a, 0);
+
+	/*첫번째 요소만 공유하는 새 list 를 리턴*/
+	return lval_add(lval_qexpr(), a->as.list.cell[0]->as.list.cell[0]);
+}
+
+lval *builtin_tail(lenv *e, lval *a)
+{
+	/* 에러 확인 */
+	LASSERT_NUM("tail", a, 1);
+	LASSERT_TYPE("tail", a, 0, LVAL_QEXPR);
+	LASSERT_NOT_EMPTY("tail", a, 0);
+
+	/*첫번째 요소를 제외한 나머지를 공유하는 새 list 를 리턴*/
+	return lval_slice(a->as.list.cell[0], 1, LVAL_QEXPR);
+}
+
+lval *builtin_eval(lenv *e, lval *a)
+{
+	LASSERT_NUM("eval", a, 1);
+	LASSERT_TYPE("eval", a, 0, LVAL_QEXPR);
+
+	/* Q-Expression 을 복사하지 않고 S-Expression 으로 평가 */
+	return lval_eval_sexpr(e, a->as.list.cell[0]);
+}
+
+lval *builtin_join(lenv *e, lval *a)
+{
+	for (int i = 0; i < a->count; i++)
+	{
+		LASSERT_TYPE("join", a, i, LVAL_QEXPR);
+	}
+
+	/* 전체 크기만큼 한번에 할당하고 요소들을 복사 */
+	int total = 0;
+	for (int i = 0; i < a->count; i++)
+	{
+		total += a->as.list.cell[i]->count;
+	}
+
+	lval *x = lval_qexpr();
+	lval_reserve(x, total);
+	for (int i = 0; i < a->count; i++)
+	{
+		lval *y = a->as.list.cell[i];
+		lcell_copy(x->as.list.cell + x->count, y->as.list.cell, y->count);
+		x->count += y->count;
+	}
+	return x;
+}
+
+/* 산술 연산 : 연산자마다 따로 kernel 을 두고 인자 cell 배열을 그대로 순회한다.
+	 모두 정수면 long 으로 계산하고, overflow 가 나면 bignum 으로 다시 계산한다.
+	 double 이 하나라도 있으면 double 로 계산 */
+
+#define LHALF (sizeof(long) * CHAR_BIT / 2)
+#define LHALF_MASK ((1UL << LHALF) - 1)
+#define LSUM_BLOCK 4096
+
+/* 인자 중 가장 넓은 숫자 종류 */
+enum
+{
+	LNUM_INT,
+	LNUM_BIG,
+	LNUM_DBL
+};
+
+/* 모든 인자가 숫자인지 확인하고 (아니면 에러) 가장 넓은 종류를 *rank 에 */
+lval *builtin_nums(char *op, lval *a, int *rank)
+{
+	*rank = LNUM_INT;
+
+	/* 전부 fixnum 이면 tag bit 만 모아서 한번에 확인 */
+	uintptr_t tags = 1;
+	for (int i = 0; i < a->count; i++)
+	{
+		tags &= (uintptr_t)a->as.list.cell[i];
+	}
+	if (tags & 1)
+	{
+		return NULL;
+	}
+
+	for (int i = 0; i < a->count; i++)
+	{
+		int t = LTYPE(a->as.list.cell[i]);
+		LASSERT(a, t == LVAL_NUM || t == LVAL_DBL || t == LVAL_BIG,
+						"Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.",
+						op, i, ltype_name(t), ltype_name(LVAL_NUM));
+		if (t == LVAL_DBL)
+		{
+			*rank = LNUM_DBL;
+		}
+		else if (t == LVAL_BIG && *rank == LNUM_INT)
+		{
+			*rank = LNUM_BIG;
+		}
+	}
+	return NULL;
+}
+
+/* long 로 계산할 수 없을 때 : 인자들을 차례로 double 또는 bignum 으로 계산 */
+lval *lnum_fold(lval *a, char op, int rank)
+{
+	lval **cell = a->as.list.cell;
+
+	if (rank == LNUM_DBL)
+	{
+		double x = lnum_dbl(cell[0]);
+		if (op == '-' && a->count == 1)
+		{
+			return lval_dbl(-x);
+		}
+		for (int i = 1; i < a->count; i++)
+		{
+			double y = lnum_dbl(cell[i]);
+			switch (op)
+			{
+			case '+':
+				x += y;
+				break;
+			case '-':
+				x -= y;
+				break;
+			case '*':
+				x *= y;
+				break;
+			case '/':
+				if (y == 0)
+				{
+					return lval_err("Division By Zero.");
+				}
+				x /= y;
+				break;
+			}
+		}
+		return lval_dbl(x);
+	}
+
+	lval *x = lbig_from(cell[0]);
+	if (op == '-' && a->count == 1)
+	{
+		return lbig_norm(lbig_add(lbig_new(0, 1), x, -x->as.big.sign));
+	}
+	for (int i = 1; i < a->count; i++)
+	{
+		lval *y = lbig_from(cell[i]);
+		switch (op)
+		{
+		case '+':
+			x = lbig_add(x, y, y->as.big.sign);
+			break;
+		case '-':
+			x = lbig_add(x, y, -y->as.big.sign);
+			break;
+		case '*':
+			x = lbig_mul(x, y);
+			break;
+		case '/':
+			if (y->count == 0)
+			{
+				return lval_err("Division By Zero.");
+			}
+			x = lbig_div(x, y);
+			break;
+		}
+	}
+	return lbig_norm(x);
+}
+
+/* cell[0..n) 의 합을 *out 에 저장. overflow 면 0 을 리턴.
+	 fixnum 은 상위/하위 절반으로 나눠 block 단위로 따로 누적하므로
+	 block 안에서는 검사 없이 더하기만 한다 (vectorize 가능) */
+int lsum(lval **cell, int n, long *out)
+{
+	long hi = 0;
+	unsigned long lo = 0;
+	long x = 0;
+	int i = 0;
+
+	while (i < n)
+	{
+		/* fixnum 이 이어지는 구간을 block 단위로 */
+		int end = i;
+		while (end < n && end - i < LSUM_BLOCK && LFIXNUM_P(cell[end]))
+		{
+			end++;
+		}
+
+		long bhi = 0;
+		unsigned long blo = 0;
+		for (int j = i; j < end; j++)
+		{
+			long v = LFIX_VALUE(cell[j]);
+			bhi += v >> LHALF;
+			blo += (unsigned long)v & LHALF_MASK;
+		}
+		bhi += (long)(blo >> LHALF);
+		lo += blo & LHALF_MASK;
+
+		if ((bhi > 0 && hi > LONG_MAX - bhi) || (bhi < 0 && hi < LONG_MIN - bhi))
+		{
+			return 0;
+		}
+		hi += bhi;
+		i = end;
+
+		/* 큰 숫자는 하나씩 검사하며 더한다 */
+		if (i < n && !LFIXNUM_P(cell[i]))
+		{
+			long y = cell[i]->as.num;
+			if ((y > 0 && x > LONG_MAX - y) || (y < 0 && x < LONG_MIN - y))
+			{
+				return 0;
+			}
+			x += y;
+			i++;
+		}
+	}
+
+	/* hi * 2^LHALF + lo 가 long 범위 안인지 확인하고 합친다 */
+	hi += (long)(lo >> LHALF);
+	lo &= LHALF_MASK;
+	if (hi > (LONG_MAX >> LHALF) || hi < (LONG_MIN >> LHALF))
+	{
+		return 0;
+	}
+	long y = hi * (1L << LHALF) + (long)lo;
+	if ((y > 0 && x > LONG_MAX - y) || (y < 0 && x < LONG_MIN - y))
+	{
+		return 0;
+	}
+	*out = x + y;
+	return 1;
+}
+
+lval *builtin_add(lenv *e, lval *a)
+{
+	int rank;
+	lval *err = builtin_nums("+", a, &rank);
+	if (err)
+	{
+		return err;
+	}
+
+	long x;
+	if (rank == LNUM_INT && lsum(a->as.list.cell, a->count, &x))
+	{
+		return lval_num(x);
+	}
+	return lnum_fold(a, '+', rank == LNUM_DBL ? LNUM_DBL : LNUM_BIG);
+}
+
+lval *builtin_sub(lenv *e, lval *a)
+{
+	int rank;
+	lval *err = builtin_nums("-", a, &rank);
+	if (err)
+	{
+		return err;
+	}
+	if (rank != LNUM_INT)
+	{
+		return lnum_fold(a, '-', rank);
+	}
+
+	/* 인자가 하나뿐이라면 음수 기호로 수행 */
+	long x = LNUM(a->as.list.cell[0]);
+	if (a->count == 1)
+	{
+		return x == LONG_MIN ? lnum_fold(a, '-', LNUM_BIG) : lval_num(-x);
+	}
+
+	/* 나머지의 합을 한번에 뺀다 */
+	long y;
+	if (!lsum(a->as.list.cell + 1, a->count - 1, &y) ||
+			(y < 0 && x > LONG_MAX + y) || (y > 0 && x < LONG_MIN + y))
+	{
+		return lnum_fold(a, '-', LNUM_BIG);
+	}
+	return lval_num(x - y);
+}
+
+lval *builtin_mul(lenv *e, lval *a)
+{
+	int rank;
+	lval *err = builtin_nums("*", a, &rank);
+	if (err)
+	{
+		return err;
+	}
+	if (rank != LNUM_INT)
+	{
+		return lnum_fold(a, '*', rank);
+	}
+
+	long x = LNUM(a->as.list.cell[0]);
+	for (int i = 1; i < a->count; i++)
+	{
+		long y = LNUM(a->as.list.cell[i]);
+		if (x > 0 ? (y > 0 ? x > LONG_MAX / y : y < LONG_MIN / x)
+							: (y > 0 ? x < LONG_MIN / y : (x != 0 && y < LONG_MAX / x)))
+		{
+			return lnum_fold(a, '*', LNUM_BIG);
+		}
+		x *= y;
+	}
+	return lval_num(x);
+}
+
+lval *builtin_div(lenv *e, lval *a)
+{
+	int rank;
+	lval *err = builtin_nums("/", a, &rank);
+	if (err)
+	{
+		return err;
+	}
+	if (rank != LNUM_INT)
+	{
+		return lnum_fold(a, '/', rank);
+	}
+
+	long x = LNUM(a->as.list.cell[0]);
+	for (int i = 1; i < a->count; i++)
+	{
+		long y = LNUM(a->as.list.cell[i]);
+		if (y == 0)
+		{
+			return lval_err("Division By Zero.");
+		}
+		if (x == LONG_MIN && y == -1)
+		{
+			return lnum_fold(a, '/', LNUM_BIG);
+		}
+		x /= y;
+	}
+	return lval_num(x);
+}
+
+/* 비교 : 숫자는 종류가 달라도 값으로 비교하고, == 와 != 는 모든 값을 구조로 비교한다.
+	 memo 의 key 는 exact 로 비교해서 숫자도 종류까지 같아야 한다 (1 과 1.0 은 결과가 다를 수 있다) */
+
+/* x 와 y 의 대소 (-1, 0, 1). NaN 이 있으면 2 */
+int lnum_cmp(lval *x, lval *y)
+{
+	int tx = LTYPE(x);
+	int ty = LTYPE(y);
+	if (tx == LVAL_NUM && ty == LVAL_NUM)
+	{
+		long a = LNUM(x);
+		long b = LNUM(y);
+		return (a > b) - (a < b);
+	}
+	if (tx == LVAL_DBL || ty == LVAL_DBL)
+	{
+		double a = lnum_dbl(x);
+		double b = lnum_dbl(y);
+		return a < b ? -1 : a > b ? 1 : a == b ? 0 : 2;
+	}
+
+	/* bignum : 부호, 다음은 절댓값 */
+	lval *a = lbig_from(x);
+	lval *b = lbig_from(y);
+	if (a->as.big.sign != b->as.big.sign && (a->count || b->count))
+	{
+		return a->as.big.sign < b->as.big.sign ? -1 : 1;
+	}
+	return lbig_cmp(a, b) * a->as.big.sign;
+}
+
+int lnum_p(int t)
+{
+	return t == LVAL_NUM || t == LVAL_DBL || t == LVAL_BIG;
+}
+
+int lval_eq(lval *x, lval *y, int exact)
+{
+	if (x == y)
+	{
+		return !(LTYPE(x) == LVAL_DBL && x->as.dbl != x->as.dbl);
+	}
+
+	int t = LTYPE(x);
+	if (lnum_p(t) && lnum_p(LTYPE(y)) && (!exact || t == LTYPE(y)))
+	{
+		return lnum_cmp(x, y) == 0;
+	}
+	if (t != LTYPE(y))
+	{
+		return 0;
+	}
+
+	switch (t)
+	{
+	case LVAL_ERR:
+		return strcmp(x->as.err, y->as.err) == 0;
+	case LVAL_SYM:
+		return x->as.sym == y->as.sym;
+	case LVAL_REF:
+		return x->as.ref.sym == y->as.ref.sym && x->as.ref.slot == y->as.ref.slot;
+	case LVAL_FUN:
+	{
+		/* lambda 는 formal, body 와 이미 bind 된 값 (capture, 부분 적용) 이 같으면 같다 */
+		if (x->as.fun.builtin || y->as.fun.builtin)
+		{
+			return x->as.fun.builtin == y->as.fun.builtin;
+		}
+		lenv *a = x->as.fun.env;
+		lenv *b = y->as.fun.env;
+		if (a->count != b->count ||
+				!lval_eq(x->as.fun.formals, y->as.fun.formals, exact) ||
+				!lval_eq(x->as.fun.body, y->as.fun.body, exact))
+		{
+			return 0;
+		}
+		for (int i = 0; i < a->count; i++)
+		{
+			if (a->vals[i] != b->vals[i] &&
+					(!a->vals[i] || !b->vals[i] || !lval_eq(a->vals[i], b->vals[i], exact)))
+			{
+				return 0;
+			}
+		}
+		return 1;
+	}
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		if (x->count != y->count)
+		{
+			return 0;
+		}
+		for (int i = 0; i < x->count; i++)
+		{
+			if (!lval_eq(x->as.list.cell[i], y->as.list.cell[i], exact))
+			{
+				return 0;
+			}
+		}
+		return 1;
+	case LVAL_VEC:
+		return x->count == y->count &&
+					 memcmp(x->as.vec.data, y->as.vec.data, sizeof(int64_t) * x->count) == 0;
+	default:
+		return 0;
+	}
+}
+
+lval *builtin_ord(lval *a, char *op)
+{
+	LASSERT_NUM(op, a, 2);
+	int rank;
+	lval *err = builtin_nums(op, a, &rank);
+	if (err)
+	{
+		return err;
+	}
+
+	int r = lnum_cmp(a->as.list.cell[0], a->as.list.cell[1]);
+	switch (op[0])
+	{
+	case '<':
+		return lval_num(op[1] ? r == -1 || r == 0 : r == -1);
+	default:
+		return lval_num(op[1] ? r == 1 || r == 0 : r == 1);
+	}
+}
+
+lval *builtin_lt(lenv *e, lval *a)
+{
+	return builtin_ord(a, "<");
+}
+
+lval *builtin_gt(lenv *e, lval *a)
+{
+	return builtin_ord(a, ">");
+}
+
+lval *builtin_le(lenv *e, lval *a)
+{
+	return builtin_ord(a, "<=");
+}
+
+lval *builtin_ge(lenv *e, lval *a)
+{
+	return builtin_ord(a, ">=");
+}
+
+lval *builtin_eq(lenv *e, lval *a)
+{
+	LASSERT_NUM("==", a, 2);
+	return lval_num(lval_eq(a->as.list.cell[0], a->as.list.cell[1], 0));
+}
+
+lval *builtin_ne(lenv *e, lval *a)
+{
+	LASSERT_NUM("!=", a, 2);
+	return lval_num(!lval_eq(a->as.list.cell[0], a->as.list.cell[1], 0));
+}
+
+/* Vector 연산 : 연속된 int64_t 배열 위에서 분기 없는 loop 로 계산해서
+	 compiler 가 SIMD 로 vectorize 할 수 있게 한다. overflow 는 loop 가 끝난 뒤 한번에 확인 */
+
+/* int64_t 결과를 숫자 lval 로 */
+lval *lval_num64(int64_t x)
+{
+	if (x < LONG_MIN || x > LONG_MAX)
+	{
+		return lbig_from64(x);
+	}
+	return lval_num((long)x);
+}
+
+/* x (y 가 있으면 x*y) 의 합. 32 bit 절반씩 block 단위로 누적한다 (lsum 과 같은 방식).
+	 y 가 있으면 모든 값의 절댓값이 2^31 미만이어야 한다. overflow 면 0 */
+int lvec_sum(const int64_t *x, const int64_t *y, int n, int64_t *out)
+{
+	int64_t hi = 0;
+	uint64_t lo = 0;
+	for (int i = 0; i < n; i += LSUM_BLOCK)
+	{
+		int end = n - i < LSUM_BLOCK ? n : i + LSUM_BLOCK;
+		int64_t bhi = 0;
+		uint64_t blo = 0;
+		if (y)
+		{
+			for (int j = i; j < end; j++)
+			{
+				int64_t p = x[j] * y[j];
+				bhi += p >> 32;
+				blo += (uint64_t)p & 0xffffffffu;
+			}
+		}
+		else
+		{
+			for (int j = i; j < end; j++)
+			{
+				bhi += x[j] >> 32;
+				blo += (uint64_t)x[j] & 0xffffffffu;
+			}
+		}
+		bhi += (int64_t)(blo >> 32);
+		lo += blo & 0xffffffffu;
+		if ((bhi > 0 && hi > INT64_MAX - bhi) || (bhi < 0 && hi < INT64_MIN - bhi))
+		{
+			return 0;
+		}
+		hi += bhi;
+	}
+
+	hi += (int64_t)(lo >> 32);
+	lo &= 0xffffffffu;
+	if (hi > (INT64_MAX >> 32) || hi < (INT64_MIN >> 32))
+	{
+		return 0;
+	}
+	*out = hi * ((int64_t)1 << 32) + (int64_t)lo;
+	return 1;
+}
+
+/* 모든 값의 절댓값이 2^31 미만인지 (곱해도 overflow 가 없는지) */
+int lvec_small(const int64_t *x, int n)
+{
+	uint64_t bits = 0;
+	for (int i = 0; i < n; i++)
+	{
+		bits |= (uint64_t)(x[i] ^ (x[i] >> 63));
+	}
+	return bits < ((uint64_t)1 << 31);
+}
+
+/* 검사하는 int64_t 곱셈. overflow 면 0 */
+int lmul64(int64_t x, int64_t y, int64_t *out)
+{
+	if (x > 0 ? (y > 0 ? x > INT64_MAX / y : y < INT64_MIN / x)
+						: (y > 0 ? x < INT64_MIN / y : (x != 0 && y < INT64_MAX / x)))
+	{
+		return 0;
+	}
+	*out = x * y;
+	return 1;
+}
+
+/* lvec_sum 이 overflow 일 때 : int64_t 로 더하다가 넘치기 전에 bignum 에 옮긴다 (+ 와 같은 결과) */
+lval *lvec_big_sum(const int64_t *x, const int64_t *y, int n)
+{
+	lval *s = lbig_new(0, 1);
+	int64_t acc = 0;
+	for (int i = 0; i < n; i++)
+	{
+		int64_t p = x[i];
+		if (y && !lmul64(x[i], y[i], &p))
+		{
+			lval *b = lbig_mul(lbig_from64(x[i]), lbig_from64(y[i]));
+			s = lbig_add(s, b, b->as.big.sign);
+			continue;
+		}
+		if ((p > 0 && acc > INT64_MAX - p) || (p < 0 && acc < INT64_MIN - p))
+		{
+			lval *b = lbig_from64(acc);
+			s = lbig_add(s, b, b->as.big.sign);
+			acc = 0;
+		}
+		acc += p;
+	}
+	lval *b = lbig_from64(acc);
+	return lbig_norm(lbig_add(s, b, b->as.big.sign));
+}
+
+/* vec 1 2 3 또는 vec {1 2 3} */
+lval *builtin_vec(lenv *e, lval *a)
+{
+	lval *src = a;
+	if (a->count == 1 && LTYPE(a->as.list.cell[0]) == LVAL_QEXPR)
+	{
+		src = a->as.list.cell[0];
+	}
+	for (int i = 0; i < src->count; i++)
+	{
+		LASSERT(a, LTYPE(src->as.list.cell[i]) == LVAL_NUM,
+						"Function 'vec' passed incorrect type for element %i. Got %s, Expected %s.",
+						i, ltype_name(LTYPE(src->as.list.cell[i])), ltype_name(LVAL_NUM));
+	}
+
+	lval *v = lval_vec(src->count);
+	for (int i = 0; i < src->count; i++)
+	{
+		v->as.vec.data[i] = LNUM(src->as.list.cell[i]);
+	}
+	return v;
+}
+
+lval *builtin_vsum(lenv *e, lval *a)
+{
+	LASSERT_NUM("vsum", a, 1);
+	LASSERT_TYPE("vsum", a, 0, LVAL_VEC);
+
+	lval *v = a->as.list.cell[0];
+	int64_t x;
+	if (!lvec_sum(v->as.vec.data, NULL, v->count, &x))
+	{
+		return lvec_big_sum(v->as.vec.data, NULL, v->count);
+	}
+	return lval_num64(x);
+}
+
+/* vmap+ / v* 의 두번째 인자 : 숫자이거나 길이가 같은 vector */
+lval *lvec_operand(char *func, lval *a)
+{
+	LASSERT_NUM(func, a, 2);
+	LASSERT_TYPE(func, a, 0, LVAL_VEC);
+	lval *y = a->as.list.cell[1];
+	LASSERT(a, LTYPE(y) == LVAL_NUM || LTYPE(y) == LVAL_VEC,
+					"Function '%s' passed incorrect type for argument 1. Got %s, Expected %s or %s.",
+					func, ltype_name(LTYPE(y)), ltype_name(LVAL_NUM), ltype_name(LVAL_VEC));
+	LASSERT(a, LTYPE(y) == LVAL_NUM || y->count == a->as.list.cell[0]->count,
+					"Function '%s' passed vectors of different length. Got %i, Expected %i.",
+					func, y->count, a->as.list.cell[0]->count);
+	return NULL;
+}
+
+lval *builtin_vadd(lenv *e, lval *a)
+{
+	lval *err = lvec_operand("vmap+", a);
+	if (err)
+	{
+		return err;
+	}
+
+	lval *v = a->as.list.cell[0];
+	lval *w = a->as.list.cell[1];
+	int n = v->count;
+	lval *r = lval_vec(n);
+	const int64_t *x = v->as.vec.data;
+	int64_t *z = r->as.vec.data;
+
+	/* 부호가 같은 두 값을 더해서 부호가 바뀌면 overflow : 부호 bit 만 모아 둔다 */
+	int64_t ovf = 0;
+	if (LTYPE(w) == LVAL_NUM)
+	{
+		int64_t k = LNUM(w);
+		for (int i = 0; i < n; i++)
+		{
+			z[i] = (int64_t)((uint64_t)x[i] + (uint64_t)k);
+			ovf |= (x[i] ^ z[i]) & (k ^ z[i]);
+		}
+	}
+	else
+	{
+		const int64_t *y = w->as.vec.data;
+		for (int i = 0; i < n; i++)
+		{
+			z[i] = (int64_t)((uint64_t)x[i] + (uint64_t)y[i]);
+			ovf |= (x[i] ^ z[i]) & (y[i] ^ z[i]);
+		}
+	}
+	if (ovf < 0)
+	{
+		return lval_err("Integer Overflow.");
+	}
+	return r;
+}
+
+lval *builtin_vmul(lenv *e, lval *a)
+{
+	lval *err = lvec_operand("v*", a);
+	if (err)
+	{
+		return err;
+	}
+
+	lval *v = a->as.list.cell[0];
+	lval *w = a->as.list.cell[1];
+	int n = v->count;
+	lval *r = lval_vec(n);
+	const int64_t *x = v->as.vec.data;
+	int64_t *z = r->as.vec.data;
+
+	if (LTYPE(w) == LVAL_NUM)
+	{
+		int64_t k = LNUM(w);
+		if (k > -((int64_t)1 << 31) && k < ((int64_t)1 << 31) && lvec_small(x, n))
+		{
+			for (int i = 0; i < n; i++)
+			{
+				z[i] = x[i] * k;
+			}
+			return r;
+		}
+		for (int i = 0; i < n; i++)
+		{
+			if (!lmul64(x[i], k, &z[i]))
+			{
+				return lval_err("Integer Overflow.");
+			}
+		}
+		return r;
+	}
+
+	/* 절댓값이 작으면 검사 없이 곱한다 */
+	const int64_t *y = w->as.vec.data;
+	if (lvec_small(x, n) && lvec_small(y, n))
+	{
+		for (int i = 0; i < n; i++)
+		{
+			z[i] = x[i] * y[i];
+		}
+		return r;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		if (!lmul64(x[i], y[i], &z[i]))
+		{
+			return lval_err("Integer Overflow.");
+		}
+	}
+	return r;
+}
+
+lval *builtin_vdot(lenv *e, lval *a)
+{
+	LASSERT_NUM("vdot", a, 2);
+	LASSERT_TYPE("vdot", a, 0, LVAL_VEC);
+	LASSERT_TYPE("vdot", a, 1, LVAL_VEC);
+	lval *v = a->as.list.cell[0];
+	lval *w = a->as.list.cell[1];
+	LASSERT(a, v->count == w->count,
+					"Function 'vdot' passed vectors of different length. Got %i, Expected %i.",
+					w->count, v->count);
+
+	int n = v->count;
+	const int64_t *x = v->as.vec.data;
+	const int64_t *y = w->as.vec.data;
+	int64_t sum = 0;
+	if (lvec_small(x, n) && lvec_small(y, n) && lvec_sum(x, y, n, &sum))
+	{
+		return lval_num64(sum);
+	}
+	return lvec_big_sum(x, y, n);
+}
+
+lval *builtin_vmin(lenv *e, lval *a)
+{
+	LASSERT_NUM("vmin", a, 1);
+	LASSERT_TYPE("vmin", a, 0, LVAL_VEC);
+	LASSERT(a, a->as.list.cell[0]->count != 0, "Function '%s' passed empty vector.", "vmin");
+
+	lval *v = a->as.list.cell[0];
+	const int64_t *x = v->as.vec.data;
+	int64_t m = x[0];
+	for (int i = 1; i < v->count; i++)
+	{
+		m = x[i] < m ? x[i] : m;
+	}
+	return lval_num64(m);
+}
+
+lval *builtin_vmax(lenv *e, lval *a)
+{
+	LASSERT_NUM("vmax", a, 1);
+	LASSERT_TYPE("vmax", a, 0, LVAL_VEC);
+	LASSERT(a, a->as.list.cell[0]->count != 0, "Function '%s' passed empty vector.", "vmax");
+
+	lval *v = a->as.list.cell[0];
+	const int64_t *x = v->as.vec.data;
+	int64_t m = x[0];
+	for (int i = 1; i < v->count; i++)
+	{
+		m = x[i] > m ? x[i] : m;
+	}
+	return lval_num64(m);
+}
+
+/* vslice v from to : [from, to) 구간. 배열은 복사하지 않고 v 의 것을 빌려 쓴다 */
+lval *builtin_vslice(lenv *e, lval *a)
+{
+	LASSERT_NUM("vslice", a, 3);
+	LASSERT_TYPE("vslice", a, 0, LVAL_VEC);
+	LASSERT_TYPE("vslice", a, 1, LVAL_NUM);
+	LASSERT_TYPE("vslice", a, 2, LVAL_NUM);
+
+	lval *v = a->as.list.cell[0];
+	long from = LNUM(a->as.list.cell[1]);
+	long to = LNUM(a->as.list.cell[2]);
+	LASSERT(a, 0 <= from && from <= to && to <= v->count,
+					"Function 'vslice' passed invalid range %li..%li for length %i.",
+					from, to, v->count);
+
+	lval *x = lval_vec(0);
+	x->count = (int)(to - from);
+	if (x->count > 0)
+	{
+		x->as.vec.data = v->as.vec.data + from;
+		x->as.vec.owner = v->as.vec.owner ? v->as.vec.owner : v;
+	}
+	return x;
+}
+
+/* Memo : memo f [capacity] 는 f 의 결과를 인자별로 기억하는 함수를 만든다.
+	 인자 list 의 구조 hash 로 찾고 lval_eq (exact) 로 확인하며,
+	 capacity 개를 넘으면 가장 오래 사용하지 않은 것부터 버린다 (LRU). 에러 결과는 기억하지 않는다 */
+
+#define LMEMO_CAP 1024
+
+typedef struct
+{
+	unsigned long hash;
+	lval *args; /* Q-Expression */
+	lval *value;
+	int next;		/* 같은 bucket 의 다음 entry */
+	int newer;	/* LRU 목록 */
+	int older;
+} lmemo_entry;
+
+struct lmemo
+{
+	lmemo_entry *entries;
+	int count;
+	int ecap; /* entries 에 할당된 칸 수 (cap 까지 늘린다) */
+	int cap;
+	int *buckets; /* 첫 entry 번호, 없으면 -1 */
+	int nbuckets;
+	int newest;
+	int oldest;
+};
+
+long lmemo_hits = 0;
+long lmemo_misses = 0;
+long lmemo_evictions = 0;
+
+unsigned long lhash_mix(unsigned long h, unsigned long x)
+{
+	return (h ^ x) * 1099511628211UL;
+}
+
+/* lval_eq (exact) 로 같은 값은 같은 hash */
+unsigned long lval_hash(lval *v)
+{
+	unsigned long h = lhash_mix(14695981039346656037UL, LTYPE(v));
+	switch (LTYPE(v))
+	{
+	case LVAL_NUM:
+		return lhash_mix(h, (unsigned long)LNUM(v));
+	case LVAL_DBL:
+	{
+		/* 0.0 과 -0.0 은 같다 */
+		double d = v->as.dbl == 0 ? 0 : v->as.dbl;
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		return lhash_mix(h, (unsigned long)bits);
+	}
+	case LVAL_BIG:
+		for (int i = 0; i < v->count; i++)
+		{
+			h = lhash_mix(h, v->as.big.limbs[i]);
+		}
+		return lhash_mix(h, (unsigned long)v->as.big.sign);
+	case LVAL_ERR:
+		return lhash_mix(h, latom_hash(v->as.err));
+	case LVAL_SYM:
+		return lhash_mix(h, v->as.sym->hash);
+	case LVAL_REF:
+		return lhash_mix(lhash_mix(h, v->as.ref.sym->hash), (unsigned long)v->as.ref.slot);
+	case LVAL_FUN:
+		if (v->as.fun.builtin)
+		{
+			return lhash_mix(h, (unsigned long)(uintptr_t)v->as.fun.builtin);
+		}
+		return lhash_mix(lval_hash(v->as.fun.formals), lval_hash(v->as.fun.body));
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		for (int i = 0; i < v->count; i++)
+		{
+			h = lhash_mix(h, lval_hash(v->as.list.cell[i]));
+		}
+		return h;
+	case LVAL_VEC:
+		for (int i = 0; i < v->count; i++)
+		{
+			h = lhash_mix(h, (unsigned long)v->as.vec.data[i]);
+		}
+		return h;
+	default:
+		return lhash_mix(h, (unsigned long)(uintptr_t)v);
+	}
+}
+
+/* 인자 배열 전체의 hash */
+unsigned long lval_hash_args(lval **argv, int n)
+{
+	unsigned long h = lhash_mix(14695981039346656037UL, (unsigned long)n);
+	for (int i = 0; i < n; i++)
+	{
+		h = lhash_mix(h, lval_hash(argv[i]));
+	}
+	return h;
+}
+
+lmemo *lmemo_new(int cap)
+{
+	lmemo *t = malloc(sizeof(lmemo));
+	t->entries = NULL;
+	t->count = 0;
+	t->ecap = 0;
+	t->cap = cap;
+	t->buckets = NULL;
+	t->nbuckets = 0;
+	t->newest = -1;
+	t->oldest = -1;
+	return t;
+}
+
+int lmemo_cap(lmemo *t)
+{
+	return t->cap;
+}
+
+void lmemo_free(lmemo *t)
+{
+	free(t->entries);
+	free(t->buckets);
+	free(t);
+}
+
+void lmemo_scan(lmemo *t)
+{
+	for (int i = 0; i < t->count; i++)
+	{
+		lgc_mark(t->entries[i].args);
+		lgc_mark(t->entries[i].value);
+	}
+}
+
+/* entry i 를 LRU 목록에서 뺀다 */
+void lmemo_unlink(lmemo *t, int i)
+{
+	lmemo_entry *x = &t->entries[i];
+	if (x->newer >= 0)
+	{
+		t->entries[x->newer].older = x->older;
+	}
+	else
+	{
+		t->newest = x->older;
+	}
+	if (x->older >= 0)
+	{
+		t->entries[x->older].newer = x->newer;
+	}
+	else
+	{
+		t->oldest = x->newer;
+	}
+}
+
+/* entry i 를 가장 최근 것으로 */
+void lmemo_link(lmemo *t, int i)
+{
+	lmemo_entry *x = &t->entries[i];
+	x->newer = -1;
+	x->older = t->newest;
+	if (t->newest >= 0)
+	{
+		t->entries[t->newest].newer = i;
+	}
+	t->newest = i;
+	if (t->oldest < 0)
+	{
+		t->oldest = i;
+	}
+}
+
+/* hash 가 h 이고 인자가 argv 와 같은 entry, 없으면 -1 */
+int lmemo_find(lmemo *t, unsigned long h, lval **argv, int n)
+{
+	if (!t->nbuckets)
+	{
+		return -1;
+	}
+	for (int i = t->buckets[h & (t->nbuckets - 1)]; i >= 0; i = t->entries[i].next)
+	{
+		lmemo_entry *x = &t->entries[i];
+		if (x->hash != h || x->args->count != n)
+		{
+			continue;
+		}
+		int j = 0;
+		while (j < n && lval_eq(x->args->as.list.cell[j], argv[j], 1))
+		{
+			j++;
+		}
+		if (j == n)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* entry 를 늘리고 bucket 을 다시 만든다 (load factor 1/2 이하) */
+void lmemo_grow(lmemo *t)
+{
+	int ecap = t->ecap ? t->ecap * 2 : 16;
+	if (ecap > t->cap)
+	{
+		ecap = t->cap;
+	}
+	t->entries = realloc(t->entries, sizeof(lmemo_entry) * ecap);
+	lcell_alloc_bytes += sizeof(lmemo_entry) * (ecap - t->ecap);
+	t->ecap = ecap;
+
+	int n = 16;
+	while (n < ecap * 2)
+	{
+		n *= 2;
+	}
+	if (n == t->nbuckets)
+	{
+		return;
+	}
+	free(t->buckets);
+	t->buckets = malloc(sizeof(int) * n);
+	t->nbuckets = n;
+	for (int i = 0; i < n; i++)
+	{
+		t->buckets[i] = -1;
+	}
+	for (int i = 0; i < t->count; i++)
+	{
+		int *b = &t->buckets[t->entries[i].hash & (n - 1)];
+		t->entries[i].next = *b;
+		*b = i;
+	}
+}
+
+/* 새 결과를 기억한다. 가득 찼으면 가장 오래된 entry 자리를 다시 쓴다 */
+void lmemo_put(lval *m, unsigned long h, lval *args, lval *value)
+{
+	lmemo *t = m->as.memo.table;
+	int i;
+	if (t->count == t->cap)
+	{
+		i = t->oldest;
+		lmemo_unlink(t, i);
+		int *p = &t->buckets[t->entries[i].hash & (t->nbuckets - 1)];
+		while (*p != i)
+		{
+			p = &t->entries[*p].next;
+		}
+		*p = t->entries[i].next;
+		lmemo_evictions++;
+	}
+	else
+	{
+		if (t->count == t->ecap)
+		{
+			lmemo_grow(t);
+		}
+		i = t->count++;
+	}
+
+	lmemo_entry *x = &t->entries[i];
+	x->hash = h;
+	x->args = args;
+	x->value = value;
+	int *b = &t->buckets[h & (t->nbuckets - 1)];
+	x->next = *b;
+	*b = i;
+	lmemo_link(t, i);
+	lgc_barrier(m);
+}
+
+/* 인자에 대해 기억한 결과를 찾는다. 없으면 NULL 을 리턴하고 *h 에 인자의 hash 를 남긴다 */
+lval *lmemo_lookup(lval *m, lval **args, int n, unsigned long *h)
+{
+	lmemo *t = m->as.memo.table;
+	*h = lval_hash_args(args, n);
+
+	int i = lmemo_find(t, *h, args, n);
+	if (i >= 0)
+	{
+		lmemo_hits++;
+		lmemo_unlink(t, i);
+		lmemo_link(t, i);
+		return t->entries[i].value;
+	}
+	lmemo_misses++;
+	return NULL;
+}
+
+/* 원래 함수가 돌려준 결과를 기억한다. 에러는 기억하지 않는다 */
+void lmemo_store(lval *m, unsigned long h, lval **args, int n, lval *result)
+{
+	if (LTYPE(result) != LVAL_ERR)
+	{
+		lmemo_put(m, h, lval_array(LVAL_QEXPR, args, n), result);
+	}
+}
+
+lval *lval_call(lenv *e, int base, int n);
+
+/* C stack 으로 재귀하는 memo 호출의 최대 깊이 */
+#define LMEMO_DEPTH_MAX 10000
+int lmemo_depth = 0;
+
+/* root stack 의 base 부터 n 개 (memo 함수와 인자) 를 적용한다.
+	 VM 은 compile 된 lambda 의 memo 를 lvm_frames 로 부르므로 여기는 tree 와 builtin 경로이다 */
+lval *lval_memo_call(lenv *e, int base, int n)
+{
+	lval *m = lgc_roots.items[base];
+	unsigned long h;
+	lval *result = lmemo_lookup(m, (lval **)lgc_roots.items + base + 1, n - 1, &h);
+	if (result)
+	{
+		return result;
+	}
+	if (lmemo_depth >= LMEMO_DEPTH_MAX)
+	{
+		return lval_err("Memo call depth exceeded %d.", LMEMO_DEPTH_MAX);
+	}
+
+	/* 원래 함수와 인자를 다시 쌓아서 호출 (m 은 base 에 남아 있다) */
+	int sp = lgc_save();
+	lgc_push(m->as.memo.fn);
+	for (int j = 1; j < n; j++)
+	{
+		lgc_push(lgc_roots.items[base + j]);
+	}
+	lmemo_depth++;
+	result = lval_call(e, sp, n);
+	lmemo_depth--;
+	lgc_restore(sp);
+
+	lmemo_store(m, h, (lval **)lgc_roots.items + base + 1, n - 1, result);
+	return result;
+}
+
+lval *builtin_memo(lenv *e, lval *a)
+{
+	LASSERT(a, a->count == 1 || a->count == 2,
+					"Function '%s' passed incorrect number of arguments. Got %i, Expected %s.",
+					"memo", a->count, "1 or 2");
+	LASSERT(a, LTYPE(a->as.list.cell[0]) == LVAL_FUN || LTYPE(a->as.list.cell[0]) == LVAL_MEMO,
+					"Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.",
+					"memo", 0, ltype_name(LTYPE(a->as.list.cell[0])), ltype_name(LVAL_FUN));
+
+	int cap = LMEMO_CAP;
+	if (a->count == 2)
+	{
+		LASSERT_TYPE("memo", a, 1, LVAL_NUM);
+		long c = LNUM(a->as.list.cell[1]);
+		LASSERT(a, c > 0 && c <= INT_MAX / 2,
+						"Function '%s' passed invalid capacity %li.", "memo", c);
+		cap = (int)c;
+	}
+
+	lval *m = lval_alloc();
+	m->type = LVAL_MEMO;
+	m->as.memo.fn = a->as.list.cell[0];
+	m->as.memo.table = lmemo_new(cap);
+	return m;
+}
+
+lval *builtin_def(lenv *e, lval *a)
+{
+	LASSERT_TYPE("def", a, 0, LVAL_QEXPR);
+
+	/*첫번째 인자는 심볼리스트이다.*/
+	lval *syms = a->as.list.cell[0];
+
+	/*첫번째 리스트의 모든 요소는 심볼이라는 것을 보장한다.*/
+	for (int i = 0; i < syms->count; i++)
+	{
+		LASSERT(a, (LTYPE(syms->as.list.cell[i]) == LVAL_SYM),
+						"Function 'def' cannot define non-symbol. "
+						"Got %s, Expected %s.",
+						ltype_name(LTYPE(syms->as.list.cell[i])), ltype_name(LVAL_SYM));
+		LASSERT(a, lform_name(syms->as.list.cell[i]->as.sym) == LFORM_NONE,
+						"Function 'def' cannot redefine special form '%s'.",
+						syms->as.list.cell[i]->as.sym->name);
+	}
+
+	/*정확한 심볼과 value값들을 확인한다.*/
+	LASSERT(a, (syms->count == a->count - 1),
+					"Function 'def' passed too many arguments for symbols. "
+					"Got %i, Expected %i.",
+					syms->count, a->count - 1);
+
+	/*심볼에 value값들을 할당한다.*/
+	for (int i = 0; i < syms->count; i++)
+	{
+		lenv_put(e, syms->as.list.cell[i], a->as.list.cell[i + 1]);
+	}
+	return lval_sexpr();
+}
+
+lval *builtin_var(lenv *e, lval *a, char *func)
+{
+	LASSERT_TYPE(func, a, 0, LVAL_QEXPR);
+
+	lval *syms = a->as.list.cell[0];
+	for (int i = 0; i < syms->count; i++)
+	{
+		LASSERT(a, (LTYPE(syms->as.list.cell[i]) == LVAL_SYM),
+						"Function '%s' cannot define non-symbol. "
+						"Got %s, Expected %s.",
+						func,
+						ltype_name(LTYPE(syms->as.list.cell[i])),
+						ltype_name(LVAL_SYM));
+		LASSERT(a, lform_name(syms->as.list.cell[i]->as.sym) == LFORM_NONE,
+						"Function '%s' cannot redefine special form '%s'.",
+						func, syms->as.list.cell[i]->as.sym->name);
+	}
+
+	LASSERT(a, (syms->count == a->count - 1),
+					"Function '%s' passed too many arguments for symbols. "
+					"Got %i, Expected %i.",
+					func, syms->count, a->count - 1);
+
+	for (int i = 0; i < syms->count; i++)
+	{
+		/* If 'def' define in globally. If 'put' define in locally */
+		if (strcmp(func, "def") == 0)
+		{
+			lenv_def(e, syms->as.list.cell[i], a->as.list.cell[i + 1]);
+		}
+
+		if (strcmp(func, "=") == 0)
+		{
+			lenv_put(e, syms->as.list.cell[i], a->as.list.cell[i + 1]);
+		}
+	}
+
+	return lval_sexpr();
+}
+
+lval *builtin_put(lenv *e, lval *a)
+{
+	return builtin_var(e, a, "=");
+}
+
+lval *builtin_mem(lenv *e, lval *a)
+{
+	/* 인자는 사용하지 않는다. (인자가 없으면 함수 자체가 평가되므로 'mem ()' 처럼 호출) */
+	lpool_print(&lval_pool);
+	lpool_print(&lenv_pool);
+	lpool_print(&latom_pool);
+	for (int i = 0; i < LCELL_CLASSES; i++)
+	{
+		if (lcell_pool[i].size)
+		{
+			lpool_print(&lcell_pool[i]);
+		}
+	}
+	printf("gc    minor %li  major %li  nursery %i  old %i\n",
+				 lgc_minor_count, lgc_major_count, lgc_nursery.count, lgc_old.count);
+	printf("ic    hit %li  miss %li\n", lic_hits, lic_misses);
+	printf("memo  hit %li  miss %li  evict %li\n", lmemo_hits, lmemo_misses, lmemo_evictions);
+	return lval_sexpr();
+}
+
+void lenv_add_builtin(lenv *e, char *name, lbuiltin func)
+{
+	lenv_put(e, lval_sym(name), lval_builtin(func));
+}
+
+void lenv_add_builtins(lenv *e)
+{
+
+	/*Function */
+	lenv_add_builtin(e, "\\", builtin_lambda);
+
+	/* Variable Functions */
+	lenv_add_builtin(e, "def", builtin_def);
+	lenv_add_builtin(e, "=", builtin_put);
+
+	/*list 함수*/
+	lenv_add_builtin(e, "list", builtin_list);
+	lenv_add_builtin(e, "head", builtin_head);
+	lenv_add_builtin(e, "tail", builtin_tail);
+	lenv_add_builtin(e, "eval", builtin_eval);
+	lenv_add_builtin(e, "join", builtin_join);
+
+	/*수학적 함수*/
+	lenv_add_builtin(e, "+", builtin_add);
+	lenv_add_builtin(e, "-", builtin_sub);
+	lenv_add_builtin(e, "*", builtin_mul);
+	lenv_add_builtin(e, "/", builtin_div);
+
+	/*비교 함수*/
+	lenv_add_builtin(e, "<", builtin_lt);
+	lenv_add_builtin(e, ">", builtin_gt);
+	lenv_add_builtin(e, "<=", builtin_le);
+	lenv_add_builtin(e, ">=", builtin_ge);
+	lenv_add_builtin(e, "==", builtin_eq);
+	lenv_add_builtin(e, "!=", builtin_ne);
+
+	/*vector 함수*/
+	lenv_add_builtin(e, "vec", builtin_vec);
+	lenv_add_builtin(e, "vsum", builtin_vsum);
+	lenv_add_builtin(e, "vmap+", builtin_vadd);
+	lenv_add_builtin(e, "v*", builtin_vmul);
+	lenv_add_builtin(e, "vdot", builtin_vdot);
+	lenv_add_builtin(e, "vmin", builtin_vmin);
+	lenv_add_builtin(e, "vmax", builtin_vmax);
+	lenv_add_builtin(e, "vslice", builtin_vslice);
+
+	/*memo 함수*/
+	lenv_add_builtin(e, "memo", builtin_memo);
+
+	/*메모리 통계*/
+	lenv_add_builtin(e, "mem", builtin_mem);
+}
+
+/*평가*/
+
+/* 꼬리 호출 : lambda body 의 가장 바깥 적용 (그 자리의 eval 도) 은 C 재귀를 하지 않는다.
+	 lval_eval_body 의 trampoline 과 VM 의 LOP_TAIL 이 현재 activation 을 바꿔서 계속한다.
+	 모든 frame 의 부모는 전역 환경이므로 이전 frame 을 붙잡아 두는 것은 없다 */
+
+lval *lvm_run(lenv *frame, lval *code);
+lval *lval_eval_body(lenv *e, lval *v);
+lval *lval_form(lenv **e, lval **v);
+
+/* argv 의 argc 개 인자를 f 의 frame 복사본에 bind 한다. 모든 formal 에 값이 있으면
+	 frame 을 *out 에 저장하고 NULL 을, 아니면 에러나 부분 적용된 함수를 리턴한다.
+	 argv 는 root stack 을 가리킬 수 있으므로 여기서는 push 하지 않는다 */
+lval *lval_bind(lval *f, lval **argv, int argc, lenv **out)
+{
+	/* 호출마다 함수의 심볼을 공유하는 새 activation 에 bind */
+	lenv *frame = lenv_frame(f->as.fun.env);
+	lval *formals = f->as.fun.formals;
+
+	/* 아직 bind 되지 않은 첫 formal (앞의 것은 부분 적용된 것, capture 한 변수는 formal 뒤에 있다) */
+	int i = 0;
+	while (i < formals->count && frame->vals[i])
+	{
+		i++;
+	}
+
+	/* Record Argument Counts */
+	int given = argc;
+	int total = formals->count - i;
+
+	/* While arguments still remain to be processed */
+	for (int j = 0; j < argc; j++)
+	{
+
+		/* If we've ran out of formal arguments to bind */
+		if (i == formals->count)
+		{
+			return lval_err("Function passed too many arguments. "
+											"Got %i, Expected %i.",
+											given, total);
+		}
+
+		/* Special Case to deal with '&' */
+		if (formals->as.list.cell[i]->as.sym == latom_amp)
+		{
+
+			/* Ensure '&' is followed by another symbol */
+			if (formals->count - i != 2)
+			{
+				return lval_err("Function format invalid. "
+												"Symbol '&' not followed by single symbol.");
+			}
+
+			/* '&' 뒤의 심볼은 slot i 에 두고 남은 인자를 모두 받는다 */
+			frame->vals[i] = lval_array(LVAL_QEXPR, argv + j, argc - j);
+			i = formals->count;
+			break;
+		}
+
+		/* 다음 인자를 그 slot 에 바로 bind */
+		frame->vals[i] = argv[j];
+		i++;
+	}
+
+	/* If '&' remains in formal list bind to empty list */
+	if (i < formals->count &&
+			formals->as.list.cell[i]->as.sym == latom_amp)
+	{
+
+		/* Check to ensure that & is not passed invalidly. */
+		if (formals->count - i != 2)
+		{
+			return lval_err("Function format invalid. "
+											"Symbol '&' not followed by single symbol.");
+		}
+
+		frame->vals[i] = lval_qexpr();
+		i = formals->count;
+	}
+
+	/* 모든 formal 이 bind 되었으면 body 는 호출한 쪽이 평가한다 */
+	if (i == formals->count)
+	{
+		*out = frame;
+		return NULL;
+	}
+
+	/* Otherwise return partially evaluated function */
+	lval *g = lval_copy(f);
+	g->as.fun.env = frame;
+	return g;
+}
+
+/* 꼬리 위치가 아닌 곳에서 lambda f 를 호출 */
+lval *lval_apply(lval *f, lval **argv, int argc)
+{
+	lenv *frame;
+	lval *result = lval_bind(f, argv, argc, &frame);
+	if (result)
+	{
+		return result;
+	}
+
+	/* compile 된 body 는 VM 으로, 아니면 S-Expression 으로 평가 */
+	return f->as.fun.code ? lvm_run(frame, f->as.fun.code)
+												: lval_eval_body(frame, f->as.fun.body);
+}
+
+/* root stack 의 base 부터 n 개 (평가가 끝난 함수와 인자들) 중 에러, 단일 표현식,
+	 함수가 아닌 경우의 결과. 적용해야 한다면 NULL */
+lval *lval_call_check(int base, int n)
+{
+	lval **v = (lval **)lgc_roots.items + base;
+	lval *f = v[0];
+
+	/* Error 체크 */
+	if (LTYPE(f) == LVAL_ERR)
+	{
+		return f;
+	}
+	for (int i = 1; i < n; i++)
+	{
+		if (LTYPE(v[i]) == LVAL_ERR)
+		{
+			return v[i];
+		}
+	}
+
+	/* 단일 표현식이라면 */
+	if (n == 1)
+	{
+		return f;
+	}
+
+	/* 첫번째 요소가 함수인지 확인 */
+	if (LTYPE(f) != LVAL_FUN && LTYPE(f) != LVAL_MEMO)
+	{
+		return lval_err(
+				"S-Expression starts with incorrect type. "
+				"Got %s, Expected %s.",
+				ltype_name(LTYPE(f)), ltype_name(LVAL_FUN));
+	}
+	return NULL;
+}
+
+/* 인자 list 를 붙잡아 두지도, 평가를 다시 호출하지도 않는 builtin (산술, 비교) */
+int lbuiltin_borrows(lbuiltin f)
+{
+	return f == builtin_add || f == builtin_sub || f == builtin_mul || f == builtin_div ||
+				 f == builtin_lt || f == builtin_gt || f == builtin_le || f == builtin_ge ||
+				 f == builtin_eq || f == builtin_ne;
+}
+
+/* fixnum 두 개의 산술과 비교는 builtin 을 거치지 않고 바로 계산한다. 해당하지 않으면 NULL.
+	 fixnum 은 long 의 절반 범위이므로 더하고 빼도 넘치지 않는다 (* 와 / 는 builtin 이 검사) */
+lval *lval_call_fixnum(lbuiltin f, lval *a, lval *b)
+{
+	if (!LFIXNUM_P(a) || !LFIXNUM_P(b))
+	{
+		return NULL;
+	}
+	long x = LFIX_VALUE(a);
+	long y = LFIX_VALUE(b);
+	if (f == builtin_add)
+	{
+		return lval_num(x + y);
+	}
+	if (f == builtin_sub)
+	{
+		return lval_num(x - y);
+	}
+	if (f == builtin_lt)
+	{
+		return lval_num(x < y);
+	}
+	if (f == builtin_gt)
+	{
+		return lval_num(x > y);
+	}
+	if (f == builtin_le)
+	{
+		return lval_num(x <= y);
+	}
+	if (f == builtin_ge)
+	{
+		return lval_num(x >= y);
+	}
+	if (f == builtin_eq)
+	{
+		return lval_num(x == y);
+	}
+	if (f == builtin_ne)
+	{
+		return lval_num(x != y);
+	}
+	return NULL;
+}
+
+/* builtin 함수 호출 : 인자 list 는 builtin 이 평가를 다시 호출할 수 있으므로 root 에 등록 */
+lval *lval_call_builtin(lenv *e, int base, int n)
+{
+	lval **v = (lval **)lgc_roots.items + base;
+	lval *r;
+	if (n == 3 && (r = lval_call_fixnum(v[0]->as.fun.builtin, v[1], v[2])))
+	{
+		return r;
+	}
+
+	/* 산술과 비교는 새 list 를 만들지 않고 root stack 의 인자를 그대로 빌려준다 */
+	if (lbuiltin_borrows(v[0]->as.fun.builtin))
+	{
+		lval args;
+		args.type = LVAL_SEXPR;
+		args.gc = 0;
+		args.count = n - 1;
+		args.as.list.cell = v + 1;
+		args.as.list.owner = NULL;
+		args.as.list.cap = n - 1;
+		return v[0]->as.fun.builtin(e, &args);
+	}
+	lval *args = lval_array(LVAL_SEXPR, v + 1, n - 1);
+	lgc_push(args);
+	return v[0]->as.fun.builtin(e, args);
+}
+
+/* root stack 의 base 부터 n 개를 적용한다. (꼬리 위치가 아닌 경우) */
+lval *lval_call(lenv *e, int base, int n)
+{
+	lval *result = lval_call_check(base, n);
+	if (result)
+	{
+		return result;
+	}
+
+	/* lambda 는 stack 에서 바로 인자를 bind 한다 */
+	lval *f = lgc_roots.items[base];
+	if (f->type == LVAL_MEMO)
+	{
+		return lval_memo_call(e, base, n);
+	}
+	if (!f->as.fun.builtin)
+	{
+		return lval_apply(f, (lval **)lgc_roots.items + base + 1, n - 1);
+	}
+	return lval_call_builtin(e, base, n);
+}
+
+/* 꼬리 위치에서 적용한다. 계속 평가할 것이 있으면 NULL 을 리턴하고
+	 lambda 라면 *e 를 새 frame, *v 를 함수로, eval 이라면 *v 를 평가할 Q-Expression 으로 바꾼다 */
+lval *lval_call_tail(lenv **e, lval **v, int base, int n)
+{
+	lval *result = lval_call_check(base, n);
+	if (result)
+	{
+		return result;
+	}
+
+	lval *f = lgc_roots.items[base];
+	if (f->type == LVAL_MEMO)
+	{
+		return lval_memo_call(*e, base, n);
+	}
+	if (!f->as.fun.builtin)
+	{
+		lenv *frame;
+		result = lval_bind(f, (lval **)lgc_roots.items + base + 1, n - 1, &frame);
+		if (!result)
+		{
+			*e = frame;
+			*v = f;
+		}
+		return result;
+	}
+
+	/* eval {..} 은 같은 환경에서 Q-Expression 을 이어서 평가 */
+	lval *q = lgc_roots.items[base + 1];
+	if (f->as.fun.builtin == builtin_eval && n == 2 && LTYPE(q) == LVAL_QEXPR)
+	{
+		*v = q;
+		return NULL;
+	}
+	return lval_call_builtin(*e, base, n);
+}
+
+/* VM 에서 꼬리 위치가 아닌 lambda 호출이 C stack 대신 쌓는 호출 정보 */
+typedef struct
+{
+	int *ip;
+	lval *code;
+	lenv *env;
+	int sp;		/* 호출한 쪽 activation 의 시작 */
+	int base; /* 호출한 쪽 operand (함수 + 인자) 의 시작 */
+	lval *memo;				/* memo 의 cache miss 라면 리턴할 때 결과를 기억할 memo */
+	unsigned long hash; /* memo 인자의 hash */
+} lvm_frame;
+
+lvm_frame *lvm_frames = NULL;
+int lvm_nframes = 0;
+int lvm_capframes = 0;
+
+/* compile 된 lambda body 를 frame 에서 실행한다.
+	 operand 는 root stack 에 쌓고, 각 activation 은 자신의 env 와 code 를 먼저 push 해 둔다.
+	 compile 된 lambda 끼리의 호출은 lvm_frames 를 사용하므로 C stack 이 늘어나지 않는다 */
+lval *lvm_run(lenv *frame, lval *code)
+{
+	int *ip = code->as.code.ops;
+	lval **k = code->as.code.consts;
+	int entry = lvm_nframes;
+	int sp = lgc_save();
+	lgc_push_env(frame);
+	lgc_push(code);
+
+	while (1)
+	{
+		switch (*ip++)
+		{
+		case LOP_CONST:
+			lgc_push(k[*ip++]);
+			break;
+		case LOP_LOAD:
+			lgc_push(frame->vals[*ip++]);
+			break;
+		case LOP_GLOBAL:
+		{
+			/* 원본 frame 그대로라면 (proto 가 있으면) 이 심볼은 frame 에 없으므로 전역 cache 를 본다 */
+			int i = *ip++;
+			licache *c = &code->as.code.caches[i];
+			if (frame->proto && c->version == lenv_version)
+			{
+				lic_hits++;
+				lgc_push(c->value);
+				break;
+			}
+			lic_misses++;
+
+			/* resolve 된 code 의 심볼은 원본 frame 의 formal, capture, let 이 아니다 */
+			int j = frame->proto ? -1 : lenv_find_val(frame, k[i]->as.sym);
+			if (j >= 0)
+			{
+				lgc_push(frame->vals[j]);
+				break;
+			}
+			lval *x = lenv_get(frame->par, k[i]);
+			if (frame->proto && LTYPE(x) != LVAL_ERR)
+			{
+				c->value = x;
+				c->version = lenv_version;
+			}
+			lgc_push(x);
+			break;
+		}
+		case LOP_NIL:
+			lgc_push(lval_sexpr());
+			break;
+		case LOP_CALL:
+		lvm_call:
+		{
+			/* GC safepoint : 모든 operand 가 root stack 에 있다 */
+			lgc_poll();
+			int n = *ip++;
+			int base = lgc_save() - n;
+			lval *f = lgc_roots.items[base];
+			lval *result = lval_call_check(base, n);
+
+			/* compile 된 lambda 의 memo 는 cache miss 일 때 원래 lambda 를 frame 으로 부른다 */
+			lval *memo = NULL;
+			unsigned long h = 0;
+			if (!result && f->type == LVAL_MEMO && f->as.memo.fn->type == LVAL_FUN &&
+					!f->as.memo.fn->as.fun.builtin && f->as.memo.fn->as.fun.code)
+			{
+				memo = f;
+				f = memo->as.memo.fn;
+				result = lmemo_lookup(memo, (lval **)lgc_roots.items + base + 1, n - 1, &h);
+			}
+
+			/* compile 된 lambda 는 호출 정보를 저장하고 callee 의 code 로 넘어간다 */
+			lenv *callee = NULL;
+			if (!result && f->type == LVAL_FUN && !f->as.fun.builtin && f->as.fun.code)
+			{
+				result = lval_bind(f, (lval **)lgc_roots.items + base + 1, n - 1, &callee);
+				if (memo && result)
+				{
+					lmemo_store(memo, h, (lval **)lgc_roots.items + base + 1, n - 1, result);
+				}
+			}
+			if (callee)
+			{
+				if (lvm_nframes == lvm_capframes)
+				{
+					lvm_capframes = lvm_capframes ? lvm_capframes * 2 : 64;
+					lvm_frames = realloc(lvm_frames, sizeof(lvm_frame) * lvm_capframes);
+				}
+				lvm_frame *r = &lvm_frames[lvm_nframes++];
+				r->ip = ip;
+				r->code = code;
+				r->env = frame;
+				r->sp = sp;
+				r->base = base;
+				r->memo = memo;
+				r->hash = h;
+
+				frame = callee;
+				code = f->as.fun.code;
+				ip = code->as.code.ops;
+				k = code->as.code.consts;
+				sp = lgc_save();
+				lgc_push_env(frame);
+				lgc_push(code);
+				break;
+			}
+
+			if (!result)
+			{
+				result = f->type == LVAL_FUN && f->as.fun.builtin ? lval_call_builtin(frame, base, n)
+																												 : lval_call(frame, base, n);
+			}
+			lgc_restore(base);
+			lgc_push(result);
+			break;
+		}
+		case LOP_TAIL:
+		{
+			/* memo 는 결과를 기억해야 하므로 LOP_CALL 로 부르고 이어지는 LOP_RET 이 리턴한다 */
+			if (LTYPE((lval *)lgc_roots.items[lgc_save() - *ip]) == LVAL_MEMO)
+			{
+				goto lvm_call;
+			}
+			lgc_poll();
+			int n = *ip++;
+			int base = lgc_save() - n;
+			lval *v = NULL;
+			lval *result;
+			while (!(result = lval_call_tail(&frame, &v, base, n)) && LTYPE(v) == LVAL_QEXPR)
+			{
+				/* eval {..} : Q-Expression 의 요소를 평가해서 같은 자리에서 다시 적용 */
+				lgc_restore(sp);
+				lgc_push_env(frame);
+				lgc_push(code);
+				lgc_push(v);
+				base = lgc_save();
+				if ((result = lval_form(&frame, &v)))
+				{
+					break;
+				}
+				base = lgc_save();
+				if (v->count == 0)
+				{
+					result = lval_sexpr();
+					break;
+				}
+				n = v->count;
+				for (int i = 0; i < n; i++)
+				{
+					lgc_push(lval_eval(frame, v->as.list.cell[i]));
+				}
+				lgc_poll();
+			}
+			if (result)
+			{
+				/* 이어지는 LOP_RET 이 리턴한다 */
+				lgc_restore(base);
+				lgc_push(result);
+				break;
+			}
+
+			/* lambda 는 그 code 로 현재 activation 을 바꾼다 */
+			code = v->as.fun.code ? v->as.fun.code : lval_compile(v->as.fun.body);
+			ip = code->as.code.ops;
+			k = code->as.code.consts;
+			lgc_restore(sp);
+			lgc_push_env(frame);
+			lgc_push(code);
+			break;
+		}
+		case LOP_RET:
+		{
+			lval *result = lgc_roots.items[lgc_save() - 1];
+			if (lvm_nframes == entry)
+			{
+				lgc_restore(sp);
+				return result;
+			}
+
+			/* 호출한 쪽으로 돌아가서 operand 대신 결과를 push */
+			lvm_frame *r = &lvm_frames[--lvm_nframes];
+			if (r->memo)
+			{
+				lmemo_store(r->memo, r->hash, (lval **)lgc_roots.items + r->base + 1, sp - r->base - 1, result);
+			}
+			ip = r->ip;
+			code = r->code;
+			k = code->as.code.consts;
+			frame = r->env;
+			sp = r->sp;
+			lgc_restore(r->base);
+			lgc_push(result);
+			break;
+		}
+		case LOP_JUMP:
+			ip = code->as.code.ops + *ip;
+			break;
+		case LOP_JFALSE:
+		{
+			lval *x = lgc_roots.items[lgc_save() - 1];
+			if (LTYPE(x) == LVAL_ERR)
+			{
+				ip = code->as.code.ops + code->count - 1;
+				break;
+			}
+			lgc_restore(lgc_save() - 1);
+			ip = lval_true(x) ? ip + 1 : code->as.code.ops + *ip;
+			break;
+		}
+		case LOP_AND:
+		case LOP_OR:
+		{
+			/* 결과가 정해졌으면 그 값을 남기고 끝으로 */
+			lval *x = lgc_roots.items[lgc_save() - 1];
+			if (LTYPE(x) == LVAL_ERR)
+			{
+				ip = code->as.code.ops + code->count - 1;
+				break;
+			}
+			if (lval_true(x) == (ip[-1] == LOP_OR))
+			{
+				ip = code->as.code.ops + *ip;
+				break;
+			}
+			lgc_restore(lgc_save() - 1);
+			ip++;
+			break;
+		}
+		case LOP_STORE:
+		{
+			lval *x = lgc_roots.items[lgc_save() - 1];
+			if (LTYPE(x) == LVAL_ERR)
+			{
+				ip = code->as.code.ops + code->count - 1;
+				break;
+			}
+			lgc_restore(lgc_save() - 1);
+			frame->vals[*ip++] = x;
+			lgc_barrier_env(frame);
+			break;
+		}
+		case LOP_DROP:
+			frame->vals[*ip++] = NULL;
+			break;
+		}
+	}
+}
+
+/* *v 가 special form 이면 꼬리 위치의 식까지 평가한다. 값이 정해졌으면 리턴하고,
+	 아니면 NULL 을 리턴하며 *v 를 이어서 S-Expression 으로 평가할 list 로 바꾼다.
+	 resolve 되지 않은 let 은 새 환경을 만들고 *e 를 그 환경으로 바꾼다 (root stack 에 등록).
+	 호출하는 쪽은 *e 와 *v 를 root 에 등록해 둔다 */
+lval *lval_form(lenv **e, lval **v)
+{
+	int form;
+	while ((form = lform_kind(*v)) != LFORM_NONE)
+	{
+		lval *err = lform_check(*v);
+		if (err)
+		{
+			return err;
+		}
+
+		lval **cell = (*v)->as.list.cell;
+		int n = (*v)->count;
+		lval *x = NULL;
+		int branch = 1;
+
+		switch (form)
+		{
+		case LFORM_IF:
+		{
+			lval *c = lval_eval(*e, cell[1]);
+			if (LTYPE(c) == LVAL_ERR)
+			{
+				return c;
+			}
+			if (lval_true(c))
+			{
+				x = cell[2];
+			}
+			else if (n == 4)
+			{
+				x = cell[3];
+			}
+			else
+			{
+				return lval_sexpr();
+			}
+			break;
+		}
+		case LFORM_COND:
+			for (int i = 1; i < n && !x; i++)
+			{
+				lval *clause = cell[i];
+				lval *c = lval_eval(*e, clause->as.list.cell[0]);
+				if (LTYPE(c) == LVAL_ERR || (lval_true(c) && clause->count == 1))
+				{
+					return c;
+				}
+				if (lval_true(c))
+				{
+					x = clause->as.list.cell[1];
+				}
+			}
+			if (!x)
+			{
+				return lval_sexpr();
+			}
+			break;
+		case LFORM_LET:
+		{
+			/* lambda 안에서 resolve 된 let 은 frame 의 slot 에 저장한다 */
+			lval *b = cell[1];
+			lenv *f = *e;
+			if (b->count && LTYPE(b->as.list.cell[0]->as.list.cell[0]) == LVAL_SYM)
+			{
+				f = lenv_new();
+				f->par = *e;
+				lgc_push_env(f);
+			}
+			for (int i = 0; i < b->count; i++)
+			{
+				lval *p = b->as.list.cell[i];
+				lval *y = lval_eval(f, p->as.list.cell[1]);
+				if (LTYPE(y) == LVAL_ERR)
+				{
+					return y;
+				}
+				if (LTYPE(p->as.list.cell[0]) == LVAL_REF)
+				{
+					f->live = p->as.list.cell[0]->as.ref.slot + 1;
+					f->vals[f->live - 1] = y;
+					lgc_barrier_env(f);
+				}
+				else
+				{
+					lenv_put(f, p->as.list.cell[0], y);
+				}
+			}
+			*e = f;
+			x = cell[2];
+			break;
+		}
+		case LFORM_AND:
+		case LFORM_OR:
+			if (n == 1)
+			{
+				return lval_num(form == LFORM_AND);
+			}
+			for (int i = 1; i < n - 1; i++)
+			{
+				lval *c = lval_eval(*e, cell[i]);
+				if (LTYPE(c) == LVAL_ERR || lval_true(c) == (form == LFORM_OR))
+				{
+					return c;
+				}
+			}
+			x = cell[n - 1];
+			branch = 0;
+			break;
+		}
+
+		/* 꼬리 식이 list 라면 호출한 쪽에서 이어서 평가 */
+		if (LTYPE(x) != LVAL_SEXPR && !(branch && LTYPE(x) == LVAL_QEXPR))
+		{
+			return lval_eval(*e, x);
+		}
+		*v = x;
+	}
+	return NULL;
+}
+
+/* v 의 요소들을 S-Expression 으로 평가하는 trampoline.
+	 꼬리 위치의 lambda 호출과 eval 은 C 재귀 대신 e 와 v 를 바꿔서 반복한다 */
+lval *lval_eval_body(lenv *e, lval *v)
+{
+	/* 여기서 시작한 let 은 여기서 끝나므로 마지막에 그 slot 을 비운다.
+		 꼬리 호출로 e 가 바뀌어도 처음 환경은 root 에 남겨 둔다 */
+	lenv *top = e;
+	int live = e->live;
+	lgc_push_env(top);
+
+	int sp = lgc_save();
+	lval *result = NULL;
+	while (!result)
+	{
+		/* 현재 환경과 평가 중인 list 는 GC root */
+		lgc_restore(sp);
+		lgc_push_env(e);
+		lgc_push(v);
+
+		/* GC safepoint */
+		lgc_poll();
+
+		/* special form 은 꼬리 위치의 식까지 바로 평가 */
+		result = lval_form(&e, &v);
+		if (result)
+		{
+			break;
+		}
+
+		/* 표현식(Expression)이 비어있다면 */
+		if (v->count == 0)
+		{
+			result = lval_sexpr();
+			break;
+		}
+
+		/* 자식 요소 평가 : 평가한 값은 차례로 root stack 에 쌓는다 */
+		int base = lgc_save();
+		int n = v->count;
+		for (int i = 0; i < n; i++)
+		{
+			lgc_push(lval_eval(e, v->as.list.cell[i]));
+		}
+
+		result = lval_call_tail(&e, &v, base, n);
+		if (!result && LTYPE(v) == LVAL_FUN)
+		{
+			/* compile 된 lambda 는 VM 이 이어서 실행한다 */
+			if (v->as.fun.code)
+			{
+				result = lvm_run(e, v->as.fun.code);
+				break;
+			}
+			v = v->as.fun.body;
+		}
+	}
+	lgc_restore(sp - 1);
+	for (int i = live; i < top->live; i++)
+	{
+		top->vals[i] = NULL;
+	}
+	top->live = live;
+	return result;
+}
+
+/* v 의 요소들을 S-Expression 으로 평가한다. v 는 수정하지 않는다 (Q-Expression 도 가능) */
+lval *lval_eval_sexpr(lenv *e, lval *v)
+{
+	return lval_eval_body(e, v);
+}
+
+lval *lval_eval(lenv *e, lval *v)
+{
+	if (LTYPE(v) == LVAL_SYM)
+	{
+		return lenv_get(e, v);
+	}
+	/* formal 참조는 현재 frame 의 slot 에서 바로 읽는다 */
+	if (LTYPE(v) == LVAL_REF)
+	{
+		return e->vals[v->as.ref.slot];
+	}
+	/* SexPression 평가 */
+	if (LTYPE(v) == LVAL_SEXPR)
+		return lval_eval_sexpr(e, v);
+
+	/* 나머지 lval type들이 같다면 */
+	return v;
+}
+
+// mpc.h 에 있는 mpc_ast_t 구조체(Tree)
+/*
+typedef struct mpc_ast_t {
+	char *tag; //expr,number,regex 등의 구문 분석 목록
+	char *contents; // 실제 input값
+	mpc_state_t state; //Node를 찾았을 때의 state의 대한 정보(사용하지 않음)
+	int children_num; //Node에 자식의 수가 저장되어있는 변수
+	struct mpc_ast_t** children; //자식의 목록(이중포인터)
+	int tag_id; //Node를 만든 가장 안쪽 rule 번호 (mpca_lang 에 넘긴 순서, 괄호나 regex 는 0)
+	unsigned long tag_ids; //Node의 모든 rule 번호 bitset
+} mpc_ast_t;
+*/
+
+/* mpca_lang 에 parser 를 넘기는 순서. MPCA_LANG_TAG_IDS 로 tag 문자열 대신 이 번호만 기록한다 */
+enum
+{
+	LREAD_NUMBER = 1,
+	LREAD_SYMBOL,
+	LREAD_SEXPR,
+	LREAD_QEXPR,
+	LREAD_EXPR,
+	LREAD_LISPY
+};
+
+/* Reading */
+
+lval *lval_read_num(char *s)
+{
+	/* 소수점이나 지수가 있으면 double */
+	if (strpbrk(s, ".eE"))
+	{
+		return lval_dbl(strtod(s, NULL));
+	}
+
+	/* long 범위를 넘으면 bignum */
+	errno = 0;
+	long x = strtol(s, NULL, 10);
+	return errno != ERANGE ? lval_num(x) : lbig_parse(s);
+}
+
+lval *lval_read(mpc_ast_t *t)
+{
+	/* Symbol이나 Number 라면 형변환 */
+	switch (t->tag_id)
+	{
+	case LREAD_NUMBER:
+		return lval_read_num(t->contents);
+	case LREAD_SYMBOL:
+		return lval_sym(t->contents);
+	}
+
+	/* root(>) 또는 sexpr 이면 빈 S-Expression, qexpr 이면 빈 Q-Expression */
+	lval *x = t->tag_id == LREAD_QEXPR ? lval_qexpr() : lval_sexpr();
+
+	/* 유효한 표현식이 포함되어 있는 리스트 채우기 (괄호와 regex 는 rule 이 아니라서 tag_id 가 0) */
+	for (int i = 0; i < t->children_num; i++)
+	{
+		if (t->children[i]->tag_id == 0)
+			continue;
+
+		x = lval_add(x, lval_read(t->children[i]));
+	}
+
+	return x;
+}
+
+/* 직접 읽기 : mpc AST 를 거치지 않고 입력에서 바로 lval 을 만든다.
+	 grammar 와 같이 number 를 symbol 보다 먼저 보고 ("1a" 는 1 과 a), 토큰 뒤의 공백을 건너뛴다.
+	 grammar 에 맞지 않으면 NULL 이고, 그때는 mpc 로 다시 읽어서 에러를 보고한다 */
+
+int lread_space(char c)
+{
+	return c && strchr(" \f\n\r\t\v", c);
+}
+
+int lread_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+int lread_symbol_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || lread_digit(c) || (c && strchr("_+-*/\\=<>!&", c));
+}
+
+/* [s, end) 를 NUL 로 끝나는 문자열로 만들어서 read 에 넘긴다 */
+lval *lread_token(char *s, char *end, lval *(*read)(char *))
+{
+	char buf[64];
+	size_t n = end - s;
+	char *t = n < sizeof(buf) ? buf : malloc(n + 1);
+	memcpy(t, s, n);
+	t[n] = '\0';
+	lval *v = read(t);
+	if (t != buf)
+	{
+		free(t);
 	}
+	return v;
 }
 
-void lenv_put(lenv *e, lval *k, lval *v)
+lval *lread_expr(char **s)
 {
-	/*Environment의 모든 item들을 반복 순회*/
-	/*for문은 변수들이 이미 존재하는지를 보기 위해 쓰임*/
-	for (int i = 0; i < e->count; i++)
+	char *p = *s;
+	char *q = p;
+	lval *v;
+
+	/* number : -?[0-9]+(\.[0-9]+)?([eE][-+]?[0-9]+)? */
+	q += *q == '-';
+	if (lread_digit(*q))
 	{
-		/*변수들이 발견된다면, 현재 위치에서 삭제 */
-		/*그리고 user가 제공한 변수로 대체함*/
-		if (strcmp(e->syms[i], k->sym) == 0)
+		while (lread_digit(*q))
 		{
-			lval_del(e->vals[i]);
-			e->vals[i] = lval_copy(v);
-			return;
+			q++;
+		}
+		if (*q == '.' && lread_digit(q[1]))
+		{
+			for (q++; lread_digit(*q); q++)
+			{
+			}
+		}
+		if (*q == 'e' || *q == 'E')
+		{
+			char *r = q + 1;
+			r += *r == '-' || *r == '+';
+			if (lread_digit(*r))
+			{
+				for (q = r; lread_digit(*q); q++)
+				{
+				}
+			}
+		}
+		v = lread_token(p, q, lval_read_num);
+	}
+	else if (lread_symbol_char(*p))
+	{
+		for (q = p; lread_symbol_char(*q); q++)
+		{
+		}
+		v = lread_token(p, q, lval_sym);
+	}
+	else if (*p == '(' || *p == '{')
+	{
+		char close = *p == '(' ? ')' : '}';
+		v = *p == '(' ? lval_sexpr() : lval_qexpr();
+		for (q = p + 1; lread_space(*q); q++)
+		{
+		}
+		while (*q != close)
+		{
+			lval *x = lread_expr(&q);
+			if (!x)
+			{
+				return NULL;
+			}
+			lval_add(v, x);
 		}
+		q++;
+	}
+	else
+	{
+		return NULL;
 	}
 
-	/*존재하는 entry를 찾지 못한다면, 새로운 entry를 위해 공간을 할당한다.*/
-	e->count++;
-	e->vals = realloc(e->vals, sizeof(lval *) * e->count);
-	e->syms = realloc(e->syms, sizeof(char *) * e->count);
+	while (lread_space(*q))
+	{
+		q++;
+	}
+	*s = q;
+	return v;
+}
 
-	/*lval과 symbol 문자열을 새로 할당한 곳에 복사한다.*/
-	e->vals[e->count - 1] = lval_copy(v);
-	e->syms[e->count - 1] = malloc(strlen(k->sym) + 1);
-	strcpy(e->syms[e->count - 1], k->sym);
+/* 한 줄 전체를 S-Expression 으로 (lval_read 의 root 와 같다) */
+lval *lval_read_str(char *s)
+{
+	while (lread_space(*s))
+	{
+		s++;
+	}
+	lval *x = lval_sexpr();
+	while (*s)
+	{
+		lval *v = lread_expr(&s);
+		if (!v)
+		{
+			return NULL;
+		}
+		lval_add(x, v);
+	}
+	return x;
 }
 
-lenv *lenv_copy(lenv *e)
+/* mpc 는 REPL, --stream, --compile 에서만 쓴다 (compile 된 program 은 mpc 없이 link 한다) */
+#ifndef LISPY_AOT
+
+/* 직접 읽고, 읽지 못하면 mpc 로 읽는다. mpc 도 실패하면 에러를 출력하고 NULL */
+lval *lval_parse(char *name, char *s, mpc_parser_t *p)
 {
-	lenv *n = malloc(sizeof(lenv));
-	n->par = e->par;
-	n->count = e->count;
-	n->syms = malloc(sizeof(char *) * n->count);
-	n->vals = malloc(sizeof(lval *) * n->count);
-	for (int i = 0; i < e->count; i++)
+	lval *x = lval_read_str(s);
+	if (x)
 	{
-		n->syms[i] = malloc(strlen(e->syms[i]) + 1);
-		strcpy(n->syms[i], e->syms[i]);
-		n->vals[i] = lval_copy(e->vals[i]);
+		return x;
 	}
-	return n;
+
+	mpc_result_t r;
+	if (!mpc_parse(name, s, p, &r))
+	{
+		mpc_err_print(r.error);
+		mpc_err_delete(r.error);
+		return NULL;
+	}
+	x = lval_read(r.output);
+	mpc_ast_delete(r.output);
+	return x;
 }
 
-void lenv_def(lenv *e, lval *k, lval *v)
+/* --stream : 입력에서 식 하나를 다 읽을 때마다 mpc_parse_stream 이 부른다.
+	 입력 끝의 공백만 남았을 때는 x 가 NULL */
+int lval_stream_eval(mpc_val_t *x, void *e)
 {
-	/* Iterate till e has no parent */
-	while (e->par)
+	if (!x)
 	{
-		e = e->par;
+		return 1;
 	}
-	/* Put value in e */
-	lenv_put(e, k, v);
+
+	lval *v = lval_read(x);
+	mpc_ast_delete(x);
+
+	int sp = lgc_save();
+	lgc_push(v);
+	lval_println(lval_eval(e, v));
+	lgc_restore(sp);
+
+	/* pipe 건너편이 결과를 바로 볼 수 있게 */
+	fflush(stdout);
+	return 1;
 }
 
-/*Builtins*/
+#endif
 
-#define LASSERT(args, cond, fmt, ...)       \
-	if (!(cond))                              \
-	{                                         \
-		lval *err = lval_err(fmt, __VA_ARGS__); \
-		lval_del(args);                         \
-		return err;                             \
-	}
+/********************************************************/
 
-#define LASSERT_TYPE(func, args, index, expect)                                        \
-	LASSERT(args, args->cell[index]->type == expect,                                     \
-					"Function '%s' passed incorrect type for argument %i. Got %s, Expected %s.", \
-					func, index, ltype_name(args->cell[index]->type), ltype_name(expect))
+/*         AOT Compiler (--compile)          */
 
-#define LASSERT_NUM(func, args, num)                                                  \
-	LASSERT(args, args->count == num,                                                   \
-					"Function '%s' passed incorrect number of arguments. Got %i, Expected %i.", \
-					func, args->count, num)
+/* --compile foo.lspy [-o foo] : 파일을 REPL 처럼 한 줄씩 하나의 식으로 읽어서 C 로 바꾸고
+	 system compiler ($CC, 없으면 cc) 로 build 한다. 만든 foo.c 는 이 파일을 include 해서 runtime 으로 쓰고
+	 (LISPY_AOT 로 build 하면 parser 와 REPL 없이 laot_main 만 실행), 각 식의 결과를 REPL 처럼 출력한다.
+	 - 최상위의 (\ {formal} {body}) 는 평소처럼 lambda 값을 만들고, 그 body 를 C 함수로도 만든다.
+		 def 로 붙인 이름을 인자 수가 맞게 부를 때 그 값이 아직 그 lambda 면 C 함수를 바로 부르고
+		 (자기 자신의 꼬리 호출은 goto), 아니면 (부분 적용, 다시 def 한 경우 등) 보통처럼 호출한다.
+		 formal 과 let 변수는 root stack 의 slot 이다.
+	 - 인자가 둘인 + - * / < > <= >= == != 는 fixnum 이면 C 연산으로 계산한다.
+	 - 전역 심볼은 inline cache 로 찾고, 호출할 때 그 값이 예상한 builtin 이나 함수인지 확인한다.
+	 - eval, = 을 쓰거나 let 안에서 lambda 를 만드는 식은 변수를 이름으로 찾아야 하므로 읽은 그대로 평가한다.
+	 runtime 위치는 $LISPY_HOME, 없으면 Makefile 이 넘긴 LISPY_HOME (main.c 가 있는 directory) */
 
-#define LASSERT_NOT_EMPTY(func, args, index)   \
-	LASSERT(args, args->cell[index]->count != 0, \
-					"Function '%s' passed {} for argument %i.", func, index);
+/* compile 된 code 가 쓰는 전역 환경 */
+lenv *laot_env = NULL;
 
-lval *lval_eval(lenv *e, lval *v);
+#define LAOT_S(i) (((lval **)lgc_roots.items)[i])
+#define LAOT_BUILTIN_P(f, fn) (LTYPE(f) == LVAL_FUN && (f)->as.fun.builtin == (fn))
 
-lval *builtin_lambda(lenv *e, lval *a)
+/* 전역 심볼 k 의 값 (c 는 호출하는 자리의 inline cache) */
+lval *laot_global(lval *k, licache *c)
 {
-	LASSERT_NUM("\\", a, 2);
-	LASSERT_TYPE("\\", a, 0, LVAL_QEXPR);
-	LASSERT_TYPE("\\", a, 1, LVAL_QEXPR);
-
-	for (int i = 0; i < a->cell[0]->count; i++)
+	if (c->version == lenv_version)
 	{
-		LASSERT(a, (a->cell[0]->cell[i]->type == LVAL_SYM),
-						"Cannot define non-symbol. Got %s, Expected %s.",
-						ltype_name(a->cell[0]->cell[i]->type), ltype_name(LVAL_SYM));
+		return c->value;
+	}
+	lval *x = lenv_get(laot_env, k);
+	if (LTYPE(x) != LVAL_ERR)
+	{
+		c->value = x;
+		c->version = lenv_version;
 	}
-	lval *formals = lval_pop(a, 0);
-	lval *body = lval_pop(a, 0);
-	lval_del(a);
+	return x;
+}
 
-	return lval_lambda(formals, body);
+lval *laot_pop(void)
+{
+	return lgc_roots.items[--lgc_roots.count];
 }
 
-lval *builtin_list(lenv *e, lval *a)
+/* stack 맨 위의 값을 리턴값으로 하고 fp 까지 되돌린다 */
+lval *laot_return(int fp)
 {
-	a->type = LVAL_QEXPR;
-	return a;
+	lval *r = lgc_roots.items[lgc_save() - 1];
+	lgc_restore(fp);
+	return r;
 }
 
-lval *builtin_head(lenv *e, lval *a)
+/* base 부터 n 개 중 첫 에러, 없으면 NULL */
+lval *laot_args_err(int base, int n)
 {
-	/* 에러 확인 */
-	LASSERT_NUM("head", a, 1);
-	LASSERT_TYPE("head", a, 0, LVAL_QEXPR);
-	LASSERT_NOT_EMPTY("head", a, 0);
+	for (int i = 0; i < n; i++)
+	{
+		if (LTYPE(LAOT_S(base + i)) == LVAL_ERR)
+		{
+			return LAOT_S(base + i);
+		}
+	}
+	return NULL;
+}
 
-	/*에러 없으면 첫번째 인자 가져오기*/
-	lval *v = lval_take(a, 0);
+/* stack 위의 n 개 (함수와 인자) 를 적용한 결과로 바꾼다 */
+void laot_call(int n)
+{
+	int base = lgc_save() - n;
+	lval *r = lval_call(laot_env, base, n);
+	lgc_restore(base);
+	lgc_push(r);
+}
 
-	/*모든 요소(head가 없는) 삭제 그리고 리턴*/
-	while (v->count > 1)
+/* 상수 list 를 만든다 (init 에서만 사용) */
+lval *laot_list(int type, int n, ...)
+{
+	lval *v = type == LVAL_SEXPR ? lval_sexpr() : lval_qexpr();
+	va_list va;
+	va_start(va, n);
+	for (int i = 0; i < n; i++)
 	{
-		lval_del(lval_pop(v, 1));
+		lval_add(v, va_arg(va, lval *));
 	}
+	va_end(va);
 	return v;
 }
 
-lval *builtin_tail(lenv *e, lval *a)
-{
-	/* 에러 확인 */
-	LASSERT_NUM("tail", a, 1);
-	LASSERT_TYPE("tail", a, 0, LVAL_QEXPR);
-	LASSERT_NOT_EMPTY("tail", a, 0);
+#ifdef LISPY_AOT
 
-	/*에러 없으면 첫번째 인자 가져오기*/
-	lval *v = lval_take(a, 0);
+/* --compile 이 만든 C 파일에 있다 */
+void laot_main(lenv *e);
 
-	/*첫번째 요소 삭제 그리고 리턴*/
-	lval_del(lval_pop(v, 0));
-	return v;
-}
+#else
 
-lval *builtin_eval(lenv *e, lval *a)
+/* 상수 : 읽은 자료 그대로, 자료를 평가한 값 */
+enum
 {
-	LASSERT_NUM("eval", a, 1);
-	LASSERT_TYPE("eval", a, 0, LVAL_QEXPR);
+	LAOT_DATA,
+	LAOT_EVAL
+};
 
-	lval *x = lval_take(a, 0);
-	x->type = LVAL_SEXPR;
-	return lval_eval(e, x);
+/* 인자가 둘일 때 바로 계산하는 builtin. guard 가 참이어야 하고 x, y 는 fixnum 값 */
+typedef struct
+{
+	char *name;
+	char *builtin;
+	char *guard;
+	char *expr;
+} laot_op;
+
+laot_op laot_ops[] = {
+		{"+", "builtin_add", "1", "lval_num(x + y)"},
+		{"-", "builtin_sub", "1", "lval_num(x - y)"},
+		{"*", "builtin_mul", "labs(x) <= 0x7fffffffL && labs(y) <= 0x7fffffffL", "lval_num(x * y)"},
+		{"/", "builtin_div", "y != 0", "lval_num(x / y)"},
+		{"<", "builtin_lt", "1", "lval_num(x < y)"},
+		{">", "builtin_gt", "1", "lval_num(x > y)"},
+		{"<=", "builtin_le", "1", "lval_num(x <= y)"},
+		{">=", "builtin_ge", "1", "lval_num(x >= y)"},
+		{"==", "builtin_eq", "1", "lval_num(x == y)"},
+		{"!=", "builtin_ne", "1", "lval_num(x != y)"},
+		{NULL, NULL, NULL, NULL}};
+
+typedef struct
+{
+	FILE *out;
+
+	/* 상수 (laot_main 에서 만든다) */
+	lval **kv;
+	int *kind;
+	int nk;
+
+	/* C 함수로 바꾸는 lambda : 읽은 (\ ..) 식, def 로 붙인 이름, 원래 lambda 의 상수 번호 */
+	lval **fns;
+	latom **names;
+	int *source;
+	int nfns;
+
+	/* 지금 만드는 함수 (-1 은 최상위 식) 의 formal 과 let 변수 : 이름과 root stack slot */
+	int self;
+	latom **syms;
+	int *slots;
+	int nsyms;
+	int nslots;
+
+	/* goto label 번호 */
+	int nlabels;
+} laot;
+
+latom *latom_lambda;
+latom *latom_eval;
+latom *latom_put;
+latom *latom_def;
+
+int laot_const(laot *c, lval *v, int kind)
+{
+	if ((c->nk & (c->nk - 1)) == 0)
+	{
+		c->kv = realloc(c->kv, sizeof(lval *) * (c->nk ? c->nk * 2 : 1));
+		c->kind = realloc(c->kind, sizeof(int) * (c->nk ? c->nk * 2 : 1));
+	}
+	c->kv[c->nk] = v;
+	c->kind[c->nk] = kind;
+	return c->nk++;
 }
 
-lval *builtin_join(lenv *e, lval *a)
+/* (\ {심볼..} {body}) 이고 & 가 없으면 1 */
+int laot_lambda_p(lval *v)
 {
-	for (int i = 0; i < a->count; i++)
+	if (LTYPE(v) != LVAL_SEXPR || v->count != 3 ||
+			LTYPE(v->as.list.cell[0]) != LVAL_SYM || v->as.list.cell[0]->as.sym != latom_lambda ||
+			LTYPE(v->as.list.cell[1]) != LVAL_QEXPR || LTYPE(v->as.list.cell[2]) != LVAL_QEXPR)
 	{
-		LASSERT_TYPE("join", a, i, LVAL_QEXPR);
+		return 0;
 	}
-
-	lval *x = lval_pop(a, 0);
-
-	while (a->count)
+	lval *formals = v->as.list.cell[1];
+	for (int i = 0; i < formals->count; i++)
 	{
-		lval *y = lval_pop(a, 0);
-		x = lval_join(x, y);
+		if (LTYPE(formals->as.list.cell[i]) != LVAL_SYM || formals->as.list.cell[i]->as.sym == latom_amp)
+		{
+			return 0;
+		}
 	}
-	lval_del(a);
-	return x;
+	return 1;
 }
 
-lval *builtin_op(lenv *e, lval *a, char *op)
+/* 변수를 slot 에 두어도 되는 식이면 1. top 이면 최상위 (let 밖) 이므로 lambda 를 만들어도 된다 */
+int laot_ok(lval *v, int top)
 {
-	/* Numbers 아닌 데이터 찾기 */
-	for (int i = 0; i < a->count; i++)
+	if (top && laot_lambda_p(v))
 	{
-		LASSERT_TYPE(op, a, i, LVAL_NUM);
+		return 1;
 	}
-
-	/* 첫번째 요소 POP */
-	lval *x = lval_pop(a, 0);
-
-	/* 다음 요소에 숫자가 아닌 빼기(-)만 존재한다면 음수 기호로 수행하라 */
-
-	if ((strcmp(op, "-") == 0) && a->count == 0)
+	int inner = top && lform_kind(v) != LFORM_LET;
+	for (int i = 0; i < v->count; i++)
 	{
-		x->num = -x->num;
+		lval *x = v->as.list.cell[i];
+		if (LTYPE(x) == LVAL_SYM &&
+				(x->as.sym == latom_eval || x->as.sym == latom_put || x->as.sym == latom_lambda))
+		{
+			return 0;
+		}
+		if (lval_list_p(x) && !laot_ok(x, inner))
+		{
+			return 0;
+		}
 	}
+	return 1;
+}
 
-	/* 남아있는 요소가 있다면 */
-
-	while (a->count > 0)
+/* 최상위 식 v 에서 C 함수로 바꿀 lambda 를 찾는다 */
+void laot_find_fns(laot *c, lval *v)
+{
+	if (laot_lambda_p(v))
 	{
-		/* 다음 요소 POP */
-		lval *y = lval_pop(a, 0);
-
-		/* 연산 수행 */
-		if (strcmp(op, "+") == 0)
-		{
-			x->num += y->num;
-		}
-		if (strcmp(op, "-") == 0)
+		if (laot_ok(v->as.list.cell[2], 0))
 		{
-			x->num -= y->num;
+			c->fns = realloc(c->fns, sizeof(lval *) * (c->nfns + 1));
+			c->names = realloc(c->names, sizeof(latom *) * (c->nfns + 1));
+			c->source = realloc(c->source, sizeof(int) * (c->nfns + 1));
+			c->fns[c->nfns] = v;
+			c->names[c->nfns] = NULL;
+			c->source[c->nfns] = laot_const(c, v, LAOT_EVAL);
+			c->nfns++;
 		}
-		if (strcmp(op, "*") == 0)
+		return;
+	}
+	if (lform_kind(v) == LFORM_LET)
+	{
+		return;
+	}
+	for (int i = 0; i < v->count; i++)
+	{
+		if (lval_list_p(v->as.list.cell[i]))
 		{
-			x->num *= y->num;
+			laot_find_fns(c, v->as.list.cell[i]);
 		}
-		if (strcmp(op, "/") == 0)
+	}
+
+	/* def {이름..} 값.. 으로 정의한 함수는 그 이름으로 직접 호출한다 */
+	lval **cell = v->as.list.cell;
+	if (v->count >= 2 && LTYPE(cell[0]) == LVAL_SYM && cell[0]->as.sym == latom_def &&
+			LTYPE(cell[1]) == LVAL_QEXPR && cell[1]->count == v->count - 2)
+	{
+		for (int i = 0; i < cell[1]->count; i++)
 		{
-			if (y->num == 0)
+			for (int j = 0; j < c->nfns; j++)
 			{
-				lval_del(x);
-				lval_del(y);
-				x = lval_err("Division By Zero.");
-				break;
+				if (c->fns[j] == cell[i + 2] && LTYPE(cell[1]->as.list.cell[i]) == LVAL_SYM)
+				{
+					c->names[j] = cell[1]->as.list.cell[i]->as.sym;
+				}
 			}
-			x->num /= y->num;
 		}
-
-		lval_del(y);
 	}
-
-	lval_del(a);
-	return x;
 }
 
-lval *builtin_add(lenv *e, lval *a)
-{
-	return builtin_op(e, a, "+");
-}
-lval *builtin_sub(lenv *e, lval *a)
+/* formal 이나 let 변수의 slot (안쪽 것 먼저), 아니면 -1 */
+int laot_local(laot *c, latom *k)
 {
-	return builtin_op(e, a, "-");
-}
-lval *builtin_mul(lenv *e, lval *a)
-{
-	return builtin_op(e, a, "*");
+	for (int i = c->nsyms - 1; i >= 0; i--)
+	{
+		if (c->syms[i] == k)
+		{
+			return c->slots[i];
+		}
+	}
+	return -1;
 }
-lval *builtin_div(lenv *e, lval *a)
+
+void laot_bind(laot *c, latom *k, int slot)
 {
-	return builtin_op(e, a, "/");
+	c->syms = realloc(c->syms, sizeof(latom *) * (c->nsyms + 1));
+	c->slots = realloc(c->slots, sizeof(int) * (c->nsyms + 1));
+	c->syms[c->nsyms] = k;
+	c->slots[c->nsyms] = slot;
+	c->nsyms++;
 }
 
-lval *builtin_def(lenv *e, lval *a)
+/* v 안의 let 변수 수 (slot 을 미리 잡아둔다) */
+int laot_count_lets(lval *v)
 {
-	LASSERT_TYPE("def", a, 0, LVAL_QEXPR);
-
-	/*첫번째 인자는 심볼리스트이다.*/
-	lval *syms = a->cell[0];
-
-	/*첫번째 리스트의 모든 요소는 심볼이라는 것을 보장한다.*/
-	for (int i = 0; i < syms->count; i++)
+	int n = 0;
+	if (lform_kind(v) == LFORM_LET && !lform_check(v))
 	{
-		LASSERT(a, (syms->cell[i]->type == LVAL_SYM),
-						"Function 'def' cannot define non-symbol. "
-						"Got %s, Expected %s.",
-						ltype_name(syms->cell[i]->type), ltype_name(LVAL_SYM));
+		n += v->as.list.cell[1]->count;
 	}
-
-	/*정확한 심볼과 value값들을 확인한다.*/
-	LASSERT(a, (syms->count == a->count - 1),
-					"Function 'def' passed too many arguments for symbols. "
-					"Got %i, Expected %i.",
-					syms->count, a->count - 1);
-
-	/*심볼에 있는 value값들의 복사본을 할당한다.*/
-	for (int i = 0; i < syms->count; i++)
+	for (int i = 0; i < v->count; i++)
 	{
-		lenv_put(e, syms->cell[i], a->cell[i + 1]);
+		if (lval_list_p(v->as.list.cell[i]))
+		{
+			n += laot_count_lets(v->as.list.cell[i]);
+		}
 	}
-	lval_del(a);
-	return lval_sexpr();
+	return n;
 }
 
-lval *builtin_var(lenv *e, lval *a, char *func)
+/* 꼬리 위치라면 stack 맨 위의 값을 리턴 */
+void laot_ret(laot *c, int tail)
 {
-	LASSERT_TYPE(func, a, 0, LVAL_QEXPR);
-
-	lval *syms = a->cell[0];
-	for (int i = 0; i < syms->count; i++)
+	if (tail)
 	{
-		LASSERT(a, (syms->cell[i]->type == LVAL_SYM),
-						"Function '%s' cannot define non-symbol. "
-						"Got %s, Expected %s.",
-						func,
-						ltype_name(syms->cell[i]->type),
-						ltype_name(LVAL_SYM));
+		fprintf(c->out, "\treturn laot_return(fp);\n");
 	}
+}
 
-	LASSERT(a, (syms->count == a->count - 1),
-					"Function '%s' passed too many arguments for symbols. "
-					"Got %i, Expected %i.",
-					func, syms->count, a->count - 1);
+/* stack 맨 위를 꺼내서 c 에. 에러라면 리턴 */
+void laot_pop_check(laot *c)
+{
+	fprintf(c->out, "\t{\n\tlval *c = laot_pop();\n"
+									"\tif (LTYPE(c) == LVAL_ERR)\n\t{\n\t\tlgc_restore(fp);\n\t\treturn c;\n\t}\n");
+}
 
-	for (int i = 0; i < syms->count; i++)
+void laot_sexpr(laot *c, lval *v, int tail);
+
+/* 식 하나의 값을 push 하는 code. 꼬리 위치라면 리턴까지 */
+void laot_expr(laot *c, lval *v, int tail)
+{
+	switch (LTYPE(v))
 	{
-		/* If 'def' define in globally. If 'put' define in locally */
-		if (strcmp(func, "def") == 0)
+	case LVAL_SEXPR:
+		laot_sexpr(c, v, tail);
+		return;
+	case LVAL_SYM:
+	{
+		int slot = laot_local(c, v->as.sym);
+		if (slot >= 0)
 		{
-			lenv_def(e, syms->cell[i], a->cell[i + 1]);
+			fprintf(c->out, "\tlgc_push(LAOT_S(fp + %i));\n", slot);
 		}
-
-		if (strcmp(func, "=") == 0)
+		else
 		{
-			lenv_put(e, syms->cell[i], a->cell[i + 1]);
+			int k = laot_const(c, v, LAOT_DATA);
+			fprintf(c->out, "\tlgc_push(laot_global(laot_k[%i], &laot_c[%i]));\n", k, k);
 		}
+		break;
 	}
-
-	lval_del(a);
-	return lval_sexpr();
-}
-
-lval *builtin_put(lenv *e, lval *a)
-{
-	return builtin_var(e, a, "=");
-}
-
-void lenv_add_builtin(lenv *e, char *name, lbuiltin func)
-{
-	lval *k = lval_sym(name);
-	lval *v = lval_builtin(func);
-	lenv_put(e, k, v);
-	lval_del(k);
-	lval_del(v);
-}
-
-void lenv_add_builtins(lenv *e)
-{
-
-	/*Function */
-	lenv_add_builtin(e, "\\", builtin_lambda);
-
-	/* Variable Functions */
-	lenv_add_builtin(e, "def", builtin_def);
-	lenv_add_builtin(e, "=", builtin_put);
-
-	/*list 함수*/
-	lenv_add_builtin(e, "list", builtin_list);
-	lenv_add_builtin(e, "head", builtin_head);
-	lenv_add_builtin(e, "tail", builtin_tail);
-	lenv_add_builtin(e, "eval", builtin_eval);
-	lenv_add_builtin(e, "join", builtin_join);
-
-	/*수학적 함수*/
-	lenv_add_builtin(e, "+", builtin_add);
-	lenv_add_builtin(e, "-", builtin_sub);
-	lenv_add_builtin(e, "*", builtin_mul);
-	lenv_add_builtin(e, "/", builtin_div);
+	default:
+		if (LFIXNUM_P(v))
+		{
+			fprintf(c->out, "\tlgc_push(lval_num(%liL));\n", LNUM(v));
+		}
+		else
+		{
+			fprintf(c->out, "\tlgc_push(laot_k[%i]);\n", laot_const(c, v, LAOT_DATA));
+		}
+		break;
+	}
+	laot_ret(c, tail);
 }
 
-/*평가*/
-lval *lval_call(lenv *e, lval *f, lval *a)
+/* branch 자리의 Q-Expression 은 S-Expression 으로 */
+void laot_branch(laot *c, lval *x, int tail)
 {
+	if (lval_list_p(x))
+	{
+		laot_sexpr(c, x, tail);
+		return;
+	}
+	laot_expr(c, x, tail);
+}
 
-	/* If Builtin then simply apply that */
-	if (f->builtin)
+void laot_form(laot *c, lval *v, int tail)
+{
+	lval *err = lform_check(v);
+	if (err)
 	{
-		return f->builtin(e, a);
+		laot_expr(c, err, tail);
+		return;
 	}
 
-	/* Record Argument Counts */
-	int given = a->count;
-	int total = f->formals->count;
+	lval **cell = v->as.list.cell;
+	int form = lform_kind(v);
+	int close = 0;
 
-	/* While arguments still remain to be processed */
-	while (a->count)
+	switch (form)
 	{
-
-		/* If we've ran out of formal arguments to bind */
-		if (f->formals->count == 0)
+	case LFORM_IF:
+		laot_expr(c, cell[1], 0);
+		laot_pop_check(c);
+		fprintf(c->out, "\tif (lval_true(c))\n\t{\n");
+		laot_branch(c, cell[2], tail);
+		fprintf(c->out, "\t}\n\telse\n\t{\n");
+		if (v->count == 4)
 		{
-			lval_del(a);
-			return lval_err("Function passed too many arguments. "
-											"Got %i, Expected %i.",
-											given, total);
+			laot_branch(c, cell[3], tail);
 		}
-
-		/* Pop the first symbol from the formals */
-		lval *sym = lval_pop(f->formals, 0);
-
-		/* Special Case to deal with '&' */
-		if (strcmp(sym->sym, "&") == 0)
+		else
 		{
-
-			/* Ensure '&' is followed by another symbol */
-			if (f->formals->count != 1)
+			fprintf(c->out, "\tlgc_push(lval_sexpr());\n");
+			laot_ret(c, tail);
+		}
+		fprintf(c->out, "\t}\n\t}\n");
+		break;
+	case LFORM_COND:
+		for (int i = 1; i < v->count; i++)
+		{
+			lval *clause = cell[i];
+			laot_expr(c, clause->as.list.cell[0], 0);
+			laot_pop_check(c);
+			fprintf(c->out, "\tif (lval_true(c))\n\t{\n");
+			if (clause->count == 1)
 			{
-				lval_del(a);
-				return lval_err("Function format invalid. "
-												"Symbol '&' not followed by single symbol.");
+				fprintf(c->out, "\tlgc_push(c);\n");
+				laot_ret(c, tail);
 			}
-
-			/* Next formal should be bound to remaining arguments */
-			lval *nsym = lval_pop(f->formals, 0);
-			lenv_put(f->env, nsym, builtin_list(e, a));
-			lval_del(sym);
-			lval_del(nsym);
+			else
+			{
+				laot_branch(c, clause->as.list.cell[1], tail);
+			}
+			fprintf(c->out, "\t}\n\telse\n\t{\n");
+			close++;
+		}
+		fprintf(c->out, "\tlgc_push(lval_sexpr());\n");
+		laot_ret(c, tail);
+		for (int i = 0; i < close; i++)
+		{
+			fprintf(c->out, "\t}\n\t}\n");
+		}
+		break;
+	case LFORM_LET:
+	{
+		int nsyms = c->nsyms;
+		for (int i = 0; i < cell[1]->count; i++)
+		{
+			lval *b = cell[1]->as.list.cell[i];
+			int slot = c->nslots++;
+			laot_expr(c, b->as.list.cell[1], 0);
+			laot_pop_check(c);
+			fprintf(c->out, "\tLAOT_S(fp + %i) = c;\n\t}\n", slot);
+			laot_bind(c, b->as.list.cell[0]->as.sym, slot);
+		}
+		laot_branch(c, cell[2], tail);
+		c->nsyms = nsyms;
+		break;
+	}
+	case LFORM_AND:
+	case LFORM_OR:
+		if (v->count == 1)
+		{
+			fprintf(c->out, "\tlgc_push(lval_num(%i));\n", form == LFORM_AND);
+			laot_ret(c, tail);
 			break;
 		}
-
-		/* Pop the next argument from the list */
-		lval *val = lval_pop(a, 0);
-
-		/* Bind a copy into the function's environment */
-		lenv_put(f->env, sym, val);
-
-		/* Delete symbol and value */
-		lval_del(sym);
-		lval_del(val);
+		for (int i = 1; i < v->count - 1; i++)
+		{
+			/* 결과가 정해지면 그 값을 남긴다 */
+			laot_expr(c, cell[i], 0);
+			fprintf(c->out, "\t{\n\tlval *c = LAOT_S(lgc_save() - 1);\n"
+											"\tif (LTYPE(c) == LVAL_ERR)\n\t{\n\t\tlgc_restore(fp);\n\t\treturn c;\n\t}\n"
+											"\tif (lval_true(c) == %i)\n\t{\n",
+							form == LFORM_OR);
+			laot_ret(c, tail);
+			fprintf(c->out, "\t}\n\telse\n\t{\n\tlaot_pop();\n");
+			close++;
+		}
+		laot_expr(c, cell[v->count - 1], tail);
+		for (int i = 0; i < close; i++)
+		{
+			fprintf(c->out, "\t}\n\t}\n");
+		}
+		break;
 	}
+}
 
-	/* Argument list is now bound so can be cleaned up */
-	lval_del(a);
+/* 리스트 v 를 S-Expression 으로 평가하는 code */
+void laot_sexpr(laot *c, lval *v, int tail)
+{
+	if (v->count == 0)
+	{
+		fprintf(c->out, "\tlgc_push(lval_sexpr());\n");
+		laot_ret(c, tail);
+		return;
+	}
 
-	/* If '&' remains in formal list bind to empty list */
-	if (f->formals->count > 0 &&
-			strcmp(f->formals->cell[0]->sym, "&") == 0)
+	lval *head = v->as.list.cell[0];
+	int global = LTYPE(head) == LVAL_SYM && laot_local(c, head->as.sym) < 0;
+	if (global && lform_kind(v) != LFORM_NONE)
 	{
+		laot_form(c, v, tail);
+		return;
+	}
 
-		/* Check to ensure that & is not passed invalidly. */
-		if (f->formals->count != 2)
+	/* C 함수로도 만든 lambda 는 미리 만든 lambda 값 */
+	for (int i = 0; i < c->nfns; i++)
+	{
+		if (c->fns[i] == v)
 		{
-			return lval_err("Function format invalid. "
-											"Symbol '&' not followed by single symbol.");
+			fprintf(c->out, "\tlgc_push(laot_k[%i]);\n", c->source[i]);
+			laot_ret(c, tail);
+			return;
 		}
+	}
 
-		/* Pop and delete '&' symbol */
-		lval_del(lval_pop(f->formals, 0));
-
-		/* Pop next symbol and create empty list */
-		lval *sym = lval_pop(f->formals, 0);
-		lval *val = lval_qexpr();
-
-		/* Bind to environment and delete */
-		lenv_put(f->env, sym, val);
-		lval_del(sym);
-		lval_del(val);
+	for (int i = 0; i < v->count; i++)
+	{
+		laot_expr(c, v->as.list.cell[i], 0);
 	}
+	int n = v->count;
 
-	/* If all formals have been bound evaluate */
-	if (f->formals->count == 0)
+	/* 인자가 둘인 산술, 비교 */
+	for (laot_op *op = laot_ops; global && n == 3 && op->name; op++)
 	{
+		if (strcmp(head->as.sym->name, op->name) == 0)
+		{
+			fprintf(c->out,
+							"\t{\n\tlval **s = &LAOT_S(lgc_save() - 3);\n"
+							"\tif (LAOT_BUILTIN_P(s[0], %s) && LFIXNUM_P((uintptr_t)s[1] & (uintptr_t)s[2]))\n\t{\n"
+							"\tlong x = LFIX_VALUE(s[1]);\n\tlong y = LFIX_VALUE(s[2]);\n"
+							"\tif (%s)\n\t{\n\tlval *r = %s;\n\tlgc_restore(lgc_save() - 3);\n\tlgc_push(r);\n\tgoto done%i;\n\t}\n\t}\n"
+							"\tlaot_call(3);\n\t}\n\tdone%i:\n",
+							op->builtin, op->guard, op->expr, c->nlabels, c->nlabels);
+			c->nlabels++;
+			laot_ret(c, tail);
+			return;
+		}
+	}
 
-		/* Set environment parent to evaluation environment */
-		f->env->par = e;
+	/* def 로 정의한 compile 된 함수는 그 함수가 아직 그 이름이면 C 로 직접 호출 */
+	int fn = -1;
+	for (int i = 0; global && i < c->nfns; i++)
+	{
+		if (c->names[i] == head->as.sym && c->fns[i]->as.list.cell[1]->count == n - 1)
+		{
+			fn = i;
+		}
+	}
+	if (fn < 0)
+	{
+		fprintf(c->out, "\tlaot_call(%i);\n", n);
+		laot_ret(c, tail);
+		return;
+	}
 
-		/* Evaluate and return */
-		return builtin_eval(f->env,
-												lval_add(lval_sexpr(), lval_copy(f->body)));
+	fprintf(c->out, "\t{\n\tint b = lgc_save() - %i;\n"
+									"\tif (LAOT_S(b) == laot_k[%i] && !laot_args_err(b + 1, %i))\n\t{\n",
+					n, c->source[fn], n - 1);
+	if (tail && fn == c->self)
+	{
+		/* 자기 자신의 꼬리 호출은 인자를 바꾸고 처음부터 */
+		fprintf(c->out, "\tfor (int i = 0; i < %i; i++)\n\t{\n\t\tLAOT_S(fp + i) = LAOT_S(b + 1 + i);\n\t}\n"
+										"\tlgc_restore(fp + %i);\n\tgoto top;\n\t}\n",
+						n - 1, n - 1);
 	}
 	else
 	{
-		/* Otherwise return partially evaluated function */
-		return lval_copy(f);
+		fprintf(c->out, "\tlval *r = laot_fn_%i(b + 1);\n\tlgc_restore(b);\n\tlgc_push(r);\n\t}\n"
+										"\telse\n\t{\n\tlaot_call(%i);\n\t}\n",
+						fn, n);
+	}
+	if (tail && fn == c->self)
+	{
+		fprintf(c->out, "\tlaot_call(%i);\n", n);
 	}
+	fprintf(c->out, "\t}\n");
+	laot_ret(c, tail);
 }
 
-lval *lval_eval_sexpr(lenv *e, lval *v)
+void laot_cstring(FILE *f, char *s)
 {
-	/* 자식 요소 평가 */
-	for (int i = 0; i < v->count; i++)
+	fputc('"', f);
+	for (; *s; s++)
 	{
-		v->cell[i] = lval_eval(e, v->cell[i]);
+		if (*s == '\\' || *s == '"')
+		{
+			fputc('\\', f);
+		}
+		if (*s == '\n')
+		{
+			fputs("\\n", f);
+			continue;
+		}
+		fputc(*s, f);
 	}
+	fputc('"', f);
+}
 
-	/* Error 체크 */
-
-	for (int i = 0; i < v->count; i++)
+/* v 를 만드는 C 식 */
+void laot_data(FILE *f, lval *v)
+{
+	switch (LTYPE(v))
 	{
-		if (v->cell[i]->type == LVAL_ERR)
+	case LVAL_NUM:
+		if (LNUM(v) == LONG_MIN)
+		{
+			fputs("lval_num(LONG_MIN)", f);
+		}
+		else
 		{
-			return lval_take(v, i);
+			fprintf(f, "lval_num(%liL)", LNUM(v));
 		}
+		break;
+	case LVAL_DBL:
+		fprintf(f, "lval_dbl(strtod(\"%.17g\", NULL))", v->as.dbl);
+		break;
+	case LVAL_BIG:
+		fputs("lbig_parse(\"", f);
+		lbig_print(f, v);
+		fputs("\")", f);
+		break;
+	case LVAL_SYM:
+		fputs("lval_sym(", f);
+		laot_cstring(f, v->as.sym->name);
+		fputc(')', f);
+		break;
+	case LVAL_ERR:
+		fputs("lval_err(\"%s\", ", f);
+		laot_cstring(f, v->as.err);
+		fputc(')', f);
+		break;
+	case LVAL_SEXPR:
+	case LVAL_QEXPR:
+		fprintf(f, "laot_list(%s, %i", LTYPE(v) == LVAL_SEXPR ? "LVAL_SEXPR" : "LVAL_QEXPR", v->count);
+		for (int i = 0; i < v->count; i++)
+		{
+			fputs(", ", f);
+			laot_data(f, v->as.list.cell[i]);
+		}
+		fputc(')', f);
+		break;
+	default:
+		fputs("lval_sexpr()", f);
+		break;
 	}
+}
 
-	/* 표현식(Expression)이 비어있다면 */
-	if (v->count == 0)
-		return v;
-
-	/* 단일 표현식이라면 */
-	if (v->count == 1)
-		return lval_take(v, 0);
-
-	/* 첫번째 요소가 Symbol 보장 */
-
-	lval *f = lval_pop(v, 0);
-	if (f->type != LVAL_FUN)
+/* lambda i 의 body 를 C 함수로 : formal 은 fp 부터, let 변수는 그 뒤 */
+void laot_fn(laot *c, int i)
+{
+	lval *formals = c->fns[i]->as.list.cell[1];
+	lval *body = c->fns[i]->as.list.cell[2];
+	int n = formals->count;
+
+	c->self = i;
+	c->nsyms = 0;
+	c->nslots = n;
+	for (int j = 0; j < n; j++)
 	{
-		lval *err = lval_err(
-				"S-Expression starts with incorrect type. "
-				"Got %s, Expected %s.",
-				ltype_name(f->type), ltype_name(LVAL_FUN));
-
-		lval_del(f);
-		lval_del(v);
-		return err;
+		laot_bind(c, formals->as.list.cell[j]->as.sym, j);
 	}
 
-	/* builtin 함수 호출 */
-
-	lval *result = lval_call(e, f, v);
-	lval_del(f);
-	return result;
+	fprintf(c->out, "lval *laot_fn_%i(int fp)\n{\n", i);
+	fprintf(c->out, "top:\n\tlgc_restore(fp + %i);\n\tfor (int i = 0; i < %i; i++)\n\t{\n\t\tlgc_push(NULL);\n\t}\n"
+									"\tlgc_poll();\n",
+					n, laot_count_lets(body));
+	laot_sexpr(c, body, 1);
+	fprintf(c->out, "}\n\n");
 }
 
-lval *lval_eval(lenv *e, lval *v)
+/* 파일 전체를 읽는다 */
+char *laot_slurp(char *path)
 {
-	if (v->type == LVAL_SYM)
+	FILE *f = fopen(path, "rb");
+	if (!f)
 	{
-		lval *x = lenv_get(e, v);
-		lval_del(v);
-		return x;
+		return NULL;
 	}
-	/* SexPression 평가 */
-	if (v->type == LVAL_SEXPR)
-		return lval_eval_sexpr(e, v);
-
-	/* 나머지 lval type들이 같다면 */
-	return v;
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *s = malloc(n + 1);
+	n = (long)fread(s, 1, n, f);
+	s[n] = '\0';
+	fclose(f);
+	return s;
 }
 
-// mpc.h 에 있는 mpc_ast_t 구조체(Tree)
-/*
-typedef struct mpc_ast_t {
-	char *tag; //expr,number,regex 등의 구문 분석 목록
-	char *contents; // 실제 input값
-	mpc_state_t state; //Node를 찾았을 때의 state의 대한 정보(사용하지 않음)
-	int children_num; //Node에 자식의 수가 저장되어있는 변수
-	struct mpc_ast_t** children; //자식의 목록(이중포인터)
-} mpc_ast_t;
-*/
+/* path 를 compile 해서 실행 파일 exe 를 만든다. 성공하면 0 */
+int laot_compile(char *path, char *exe, mpc_parser_t *Lispy)
+{
+	latom_lambda = latom_intern("\\");
+	latom_eval = latom_intern("eval");
+	latom_put = latom_intern("=");
+	latom_def = latom_intern("def");
 
-/* Reading */
+	char *src = laot_slurp(path);
+	if (!src)
+	{
+		fprintf(stderr, "Could not open '%s'.\n", path);
+		return 1;
+	}
 
-lval *lval_read_num(mpc_ast_t *t)
-{
-	errno = 0;
-	long x = strtol(t->contents, NULL, 10);
-	return errno != ERANGE ? lval_num(x) : lval_err("invalid number");
-}
+	/* REPL 과 같이 한 줄이 하나의 식 (마지막 줄바꿈 뒤는 제외) */
+	lval *forms = lval_qexpr();
+	lgc_push(forms);
+	for (char *line = src; *line;)
+	{
+		char *end = strchr(line, '\n');
+		char *next = end ? end + 1 : line + strlen(line);
+		if (end)
+		{
+			*end = '\0';
+			if (end > line && end[-1] == '\r')
+			{
+				end[-1] = '\0';
+			}
+		}
 
-lval *lval_read(mpc_ast_t *t)
-{
-	/* Symbol이나 Number 라면 형변환 */
-	if (strstr(t->tag, "number"))
-		return lval_read_num(t);
-	if (strstr(t->tag, "symbol"))
-		return lval_sym(t->contents);
+		lval *x = lval_parse(path, line, Lispy);
+		if (!x)
+		{
+			free(src);
+			return 1;
+		}
+		lval_add(forms, x);
+		line = next;
+	}
+	free(src);
+
+	char *cpath = malloc(strlen(exe) + 3);
+	sprintf(cpath, "%s.c", exe);
+	FILE *out = fopen(cpath, "w");
+	if (!out)
+	{
+		fprintf(stderr, "Could not write '%s'.\n", cpath);
+		free(cpath);
+		return 1;
+	}
 
-	/* root(>) 또는 sexpr 이면 빈 list를 만든다 */
-	lval *x = NULL;
-	if (strcmp(t->tag, ">") == 0)
+	laot c;
+	memset(&c, 0, sizeof(c));
+	c.out = out;
+
+	/* slot 을 쓸 수 없는 식은 읽은 자료 그대로 평가 */
+	int *native = malloc(sizeof(int) * (forms->count ? forms->count : 1));
+	for (int i = 0; i < forms->count; i++)
 	{
-		x = lval_sexpr();
+		native[i] = laot_ok(forms->as.list.cell[i], 1);
+		if (native[i])
+		{
+			laot_find_fns(&c, forms->as.list.cell[i]);
+		}
 	}
-	if (strstr(t->tag, "sexpr"))
+
+	fprintf(out, "/* lispy --compile %s */\n#define LISPY_AOT\n#include \"main.c\"\n\n"
+							 "lval **laot_k;\nlicache *laot_c;\n\n",
+					path);
+	for (int i = 0; i < c.nfns; i++)
 	{
-		x = lval_sexpr();
+		fprintf(out, "lval *laot_fn_%i(int fp);\n", i);
 	}
-	if (strstr(t->tag, "qexpr"))
+	fputc('\n', out);
+	for (int i = 0; i < c.nfns; i++)
 	{
-		x = lval_qexpr();
+		laot_fn(&c, i);
 	}
 
-	/* 유효한 표현식이 포함되어 있는 리스트 채우기*/
-	for (int i = 0; i < t->children_num; i++)
+	for (int i = 0; i < forms->count; i++)
 	{
-		if (strcmp(t->children[i]->contents, "(") == 0)
-			continue;
-		if (strcmp(t->children[i]->contents, ")") == 0)
-			continue;
-		if (strcmp(t->children[i]->contents, "{") == 0)
-			continue;
-		if (strcmp(t->children[i]->contents, "}") == 0)
+		lval *form = forms->as.list.cell[i];
+		fprintf(out, "lval *laot_form_%i(void)\n{\n", i);
+		if (!native[i])
+		{
+			fprintf(out, "\treturn lval_eval(laot_env, laot_k[%i]);\n}\n\n", laot_const(&c, form, LAOT_DATA));
 			continue;
+		}
+		c.self = -1;
+		c.nsyms = 0;
+		c.nslots = 0;
+		fprintf(out, "\tint fp = lgc_save();\n\tfor (int i = 0; i < %i; i++)\n\t{\n\t\tlgc_push(NULL);\n\t}\n",
+						laot_count_lets(form));
+		laot_sexpr(&c, form, 1);
+		fprintf(out, "}\n\n");
+	}
 
-		if (strcmp(t->children[i]->tag, "regex") == 0)
-			continue;
+	/* 상수를 만들고 (모두 GC root) 식을 차례로 평가 */
+	fprintf(out, "void laot_main(lenv *e)\n{\n\tlaot_env = e;\n"
+							 "\tlaot_k = calloc(%i, sizeof(lval *));\n\tlaot_c = calloc(%i, sizeof(licache));\n",
+					c.nk + 1, c.nk + 1);
+	for (int i = 0; i < c.nk; i++)
+	{
+		fprintf(out, "\tlgc_push(laot_k[%i] = ", i);
+		switch (c.kind[i])
+		{
+		case LAOT_DATA:
+			laot_data(out, c.kv[i]);
+			break;
+		case LAOT_EVAL:
+			fputs("lval_eval(e, ", out);
+			laot_data(out, c.kv[i]);
+			fputc(')', out);
+			break;
+		}
+		fputs(");\n", out);
+	}
+	for (int i = 0; i < forms->count; i++)
+	{
+		fprintf(out, "\tlval_println(laot_form_%i());\n", i);
+	}
+	fprintf(out, "}\n");
+	fclose(out);
 
-		x = lval_add(x, lval_read(t->children[i]));
+	/* runtime (main.c) 이 있는 directory. Makefile 은 LISPY_HOME 으로 절대 경로를 넘긴다 */
+	char *home = getenv("LISPY_HOME");
+#ifdef LISPY_HOME
+	if (!home)
+	{
+		home = LISPY_HOME;
+	}
+#endif
+	char here[4096];
+	if (!home)
+	{
+		strncpy(here, __FILE__, sizeof(here) - 1);
+		here[sizeof(here) - 1] = '\0';
+		char *slash = strrchr(here, '/');
+		if (slash)
+		{
+			*slash = '\0';
+		}
+		else
+		{
+			strcpy(here, ".");
+		}
+		home = here;
 	}
+	char *cc = getenv("CC") ? getenv("CC") : "cc";
 
-	return x;
+	/* shell 을 거치지 않으므로 경로에 공백이나 따옴표가 있어도 그대로 넘어간다 */
+	char *inc = malloc(strlen(home) + 3);
+	sprintf(inc, "-I%s", home);
+	char *argv[] = {cc, "-std=c99", "-O2", inc, "-o", exe, cpath, NULL};
+#ifdef _WIN32
+	int status = (int)_spawnvp(_P_WAIT, cc, (const char *const *)argv);
+#else
+	int status = -1;
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execvp(cc, argv);
+		fprintf(stderr, "Could not run '%s'.\n", cc);
+		_exit(127);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) != pid)
+	{
+		status = -1;
+	}
+#endif
+
+	free(inc);
+	free(cpath);
+	free(native);
+	return status == 0 ? 0 : 1;
 }
 
+#endif
+
+#ifndef LISPY_AOT
+
+/* lispy 문법. lgrammar.h 는 이 문법으로 만든 parser 를 mpc_table_export 로 저장한 table 이라서
+	 시작할 때 mpca_lang 으로 문법을 parse 하지 않고 바로 parser 를 만든다.
+	 문법을 바꾸면 main.exe --grammar > lgrammar.h 로 다시 만든다 (그 전까지는 mpca_lang 을 쓴다) */
+#define LGRAMMAR                                            \
+	"number : /-?[0-9]+(\\.[0-9]+)?([eE][-+]?[0-9]+)?/ ;\n" \
+	"symbol : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;\n"           \
+	"sexpr  : '(' <expr>* ')' ;\n"                         \
+	"qexpr  : '{' <expr>* '}' ;\n"                         \
+	"expr   : <number> | <symbol> | <sexpr> | <qexpr> ;\n" \
+	"lispy  : /^/ <expr>* /$/ ;\n"
+
+#include "lgrammar.h"
+
+#endif
+
 /* main 함수 */
 int main(int argc, char **argv)
 {
+#ifdef LISPY_AOT
+	/* --compile 로 만든 program : 읽지 않고 compile 된 식들만 실행 */
+	latom_init();
+	lenv *g = lenv_new();
+	lenv_add_builtins(g);
+	lgc_push_env(g);
+	laot_main(g);
+	return 0;
+#else
 	/*전위표현식 parser 프로그램*/
 
 	/*몇몇 parser 만들기*/
@@ -1033,51 +5543,130 @@ int main(int argc, char **argv)
 	mpc_parser_t *Expr = mpc_new("expr");
 	mpc_parser_t *Lispy = mpc_new("lispy");
 
-	// parser들을 정의한다.(정규 표현식)
-	mpca_lang(MPCA_LANG_DEFAULT,
-						" 															\
-      number : /-?[0-9]+/ ;                             \
-      symbol : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/;                  \
-			sexpr	: '(' <expr>* ')' ; \
-			qexpr : '{' <expr>* '}'; \
-			expr : <number> | <symbol> | <sexpr> | <qexpr>; \
-			lispy : /^/ <expr>* /$/ ; \
-		",
-						Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+	/* --tree : lambda 를 bytecode 로 compile 하지 않고 tree walker 로 평가
+		 --compile 파일 [-o 실행파일] : C 로 compile 해서 실행 파일을 만들고 끝낸다
+		 --grammar : 문법을 mpca_lang 으로 만들어서 lgrammar.h 를 출력하고 끝낸다
+		 --stream : prompt 없이 stdin 의 식을 하나씩 다 읽는 대로 평가하고 결과를 출력한다.
+								(줄 단위가 아니라 식 단위라서 여러 줄에 걸친 식도 되고, 최상위 식은 괄호로 감싸야 한다) */
+	char *compile = NULL;
+	char *exe = NULL;
+	int grammar = 0;
+	int stream = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--tree") == 0)
+		{
+			lval_tree = 1;
+		}
+		if (strcmp(argv[i], "--grammar") == 0)
+		{
+			grammar = 1;
+		}
+		if (strcmp(argv[i], "--stream") == 0)
+		{
+			stream = 1;
+		}
+		if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc)
+		{
+			compile = argv[++i];
+		}
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+		{
+			exe = argv[++i];
+		}
+	}
+
+	// parser들을 정의한다. table 이 이 문법의 것이 아니면 문법을 parse 해서 만든다
+	if (grammar || strcmp(lgrammar.key, LGRAMMAR) != 0 ||
+			!mpc_table_import(&lgrammar, 6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy))
+	{
+		mpca_lang(MPCA_LANG_TAG_IDS, LGRAMMAR, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+	}
+	if (grammar)
+	{
+		mpc_table_export(stdout, "lgrammar", LGRAMMAR, 6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+		mpc_cleanup(6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+		return 0;
+	}
+
+	if (compile)
+	{
+		/* 실행 파일 이름은 주어지지 않으면 확장자를 뺀 이름 */
+		if (!exe)
+		{
+			exe = malloc(strlen(compile) + 7);
+			strcpy(exe, compile);
+			char *dot = strrchr(exe, '.');
+			if (dot && !strchr(dot, '/'))
+			{
+				*dot = '\0';
+			}
+			else
+			{
+				strcat(exe, ".out");
+			}
+		}
+		latom_init();
+		int status = laot_compile(compile, exe, Lispy);
+		mpc_cleanup(6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+		return status;
+	}
+
+	if (stream)
+	{
+		latom_init();
+		lenv *e = lenv_new();
+		lenv_add_builtins(e);
+		lgc_push_env(e);
+
+		/* 식 앞의 공백을 건너뛰고, 공백 뒤에 입력이 끝나면 NULL */
+		mpc_parser_t *Form = mpc_stripl(mpc_or(2, Expr, mpc_eoi()));
+		mpc_result_t r;
+		int status = 0;
+		if (!mpc_parse_stream("<stdin>", stdin, Form, (mpc_dtor_t)mpc_ast_delete, lval_stream_eval, e, &r))
+		{
+			mpc_err_print(r.error);
+			mpc_err_delete(r.error);
+			status = 1;
+		}
+		mpc_delete(Form);
+		mpc_cleanup(6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
+		return status;
+	}
+
 	/*Information print*/
 	puts("Lispy Version 1.0.1");
 	puts("Press Ctrl + C to Exit\n");
 
+	latom_init();
 	lenv *e = lenv_new();
 	lenv_add_builtins(e);
 
+	/* 전역 환경은 항상 GC root */
+	lgc_push_env(e);
+
 	/*never ending loop*/
 	while (1)
 	{
 		char *input = readline("lispy> ");
 		add_history(input);
 
-		// input 값을 parse 시도
-		mpc_result_t r;
-		if (mpc_parse("<stdin>", input, Lispy, &r))
-		{
-			lval *x = lval_eval(e, lval_read(r.output));
-			lval_println(x);
-			lval_del(x);
-			mpc_ast_delete(r.output);
-		}
-		else
+		// input 값을 parse 시도 (실패하면 lval_parse 가 error 를 출력)
+		lval *x = lval_parse("<stdin>", input, Lispy);
+		if (x)
 		{
-			/*parse 실패시 error 출력과 제거*/
-			mpc_err_print(r.error);
-			mpc_err_delete(r.error);
+			/* 읽은 값은 평가가 끝날 때까지 GC root */
+			int sp = lgc_save();
+			lgc_push(x);
+			lval_println(lval_eval(e, x));
+			lgc_restore(sp);
 		}
 
 		free(input);
 	}
 
-	lenv_del(e);
 	/*parser들 해제*/
 	mpc_cleanup(6, Number, Symbol, Sexpr, Qexpr, Expr, Lispy);
 	return 0;
+#endif
 }
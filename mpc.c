@@ -1,6 +1,16 @@
 #define _CRT_SECURE_NO_WARNINGS
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define MPC_MMAP
+#endif
 #include "mpc.h"
 
+#ifdef MPC_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /*
 ** State Type
 */
@@ -54,6 +64,10 @@ static mpc_state_t mpc_state_new(void)
 ** back we can simply start reading from the
 ** buffer instead of the input.
 **
+** Regular files are memory mapped where the
+** platform allows it and then parsed as a
+** String, without copying the contents.
+**
 ** Of course using `mpc_predictive` will disable
 ** backtracking and make LL(1) grammars easy
 ** to parse for all input methods.
@@ -64,7 +78,8 @@ enum
 {
   MPC_INPUT_STRING = 0,
   MPC_INPUT_FILE = 1,
-  MPC_INPUT_PIPE = 2
+  MPC_INPUT_PIPE = 2,
+  MPC_INPUT_STREAM = 3
 };
 
 enum
@@ -77,11 +92,49 @@ enum
   MPC_INPUT_MEM_NUM = 512
 };
 
+enum
+{
+  MPC_INPUT_STREAM_LINE_MAX = 4096,
+  MPC_INPUT_STREAM_GROW_MIN = 256
+};
+
 typedef struct
 {
   char mem[64];
 } mpc_mem_t;
 
+/*
+** Packrat results: what a memoized parser did at
+** a position. `output` and `error` are private
+** copies, handed out again as fresh copies.
+*/
+
+typedef struct mpc_memo_t
+{
+  struct mpc_memo_t *next;
+  mpc_parser_t *parser;
+  long pos;
+  int suppress;
+  int success;
+  mpc_state_t state;
+  char last;
+  mpc_val_t *output;
+  mpc_err_t *error;
+  mpc_err_t *merged;
+} mpc_memo_t;
+
+enum
+{
+  MPC_MEMO_BLOCK = 256
+};
+
+typedef struct mpc_memo_block_t
+{
+  struct mpc_memo_block_t *next;
+  int used;
+  mpc_memo_t items[MPC_MEMO_BLOCK];
+} mpc_memo_block_t;
+
 typedef struct
 {
 
@@ -93,6 +146,10 @@ typedef struct
   char *buffer;
   FILE *file;
 
+  /* MPC_INPUT_STRING: mapping `string` points into, NULL if `string` was malloced */
+  char *map;
+  size_t map_size;
+
   int suppress;
   int backtrack;
   int marks_slots;
@@ -102,6 +159,22 @@ typedef struct
   char *lasts;
   char last;
 
+  /* MPC_INPUT_STREAM: `string` holds `length` bytes starting at `offset` */
+  long offset;
+  long length;
+  long slots;
+  int starved;
+
+  /* Regex DFAs are skipped while `exact`. `inexact` is set once one has skipped errors */
+  int exact;
+  int inexact;
+
+  /* Packrat table for the current mpc_parse_input, NULL until a memoized parser runs */
+  mpc_memo_t **memo;
+  size_t memo_slots;
+  size_t memo_num;
+  mpc_memo_block_t *memo_blocks;
+
   size_t mem_index;
   char mem_full[MPC_INPUT_MEM_NUM];
   mpc_mem_t mem[MPC_INPUT_MEM_NUM];
@@ -121,17 +194,25 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
 
   i->string = malloc(strlen(string) + 1);
   strcpy(i->string, string);
+  i->map = NULL;
   i->buffer = NULL;
   i->file = NULL;
 
   i->suppress = 0;
   i->backtrack = 1;
+  i->exact = 0;
+  i->inexact = 0;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->memo = NULL;
+  i->memo_slots = 0;
+  i->memo_num = 0;
+  i->memo_blocks = NULL;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -152,17 +233,25 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->string = malloc(length + 1);
   strncpy(i->string, string, length);
   i->string[length] = '\0';
+  i->map = NULL;
   i->buffer = NULL;
   i->file = NULL;
 
   i->suppress = 0;
   i->backtrack = 1;
+  i->exact = 0;
+  i->inexact = 0;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->memo = NULL;
+  i->memo_slots = 0;
+  i->memo_num = 0;
+  i->memo_blocks = NULL;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -186,12 +275,19 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe)
 
   i->suppress = 0;
   i->backtrack = 1;
+  i->exact = 0;
+  i->inexact = 0;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->memo = NULL;
+  i->memo_slots = 0;
+  i->memo_num = 0;
+  i->memo_blocks = NULL;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -214,24 +310,145 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file)
 
   i->suppress = 0;
   i->backtrack = 1;
+  i->exact = 0;
+  i->inexact = 0;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->memo = NULL;
+  i->memo_slots = 0;
+  i->memo_num = 0;
+  i->memo_blocks = NULL;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
   return i;
 }
 
+/*
+** Maps the rest of a regular file as a String input. The byte after
+** the contents must read as the terminating '\0', which the zero fill
+** of the last page provides unless the size is a multiple of the page
+** size. Returns NULL when the file can't be mapped, and the caller
+** falls back to a File input.
+*/
+static mpc_input_t *mpc_input_new_mmap(const char *filename, FILE *file)
+{
+#ifdef MPC_MMAP
+  struct stat st;
+  long start, page;
+  char *map;
+  mpc_input_t *i;
+
+  if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    return NULL;
+  }
+
+  start = ftell(file);
+  page = sysconf(_SC_PAGESIZE);
+  if (start < 0 || page <= 0 || st.st_size <= start || st.st_size % page == 0)
+  {
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  if (map == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  i = mpc_input_new_file(filename, file);
+  i->type = MPC_INPUT_STRING;
+  i->string = map + start;
+  i->map = map;
+  i->map_size = st.st_size;
+  return i;
+#else
+  (void)filename;
+  (void)file;
+  return NULL;
+#endif
+}
+
+static mpc_input_t *mpc_input_new_stream(const char *filename, FILE *file)
+{
+
+  mpc_input_t *i = mpc_input_new_pipe(filename, file);
+
+  i->type = MPC_INPUT_STREAM;
+  i->offset = 0;
+  i->length = 0;
+  i->slots = MPC_INPUT_STREAM_LINE_MAX;
+  i->string = malloc(i->slots);
+  i->starved = 0;
+
+  return i;
+}
+
+/* Reads one more line (or at most MPC_INPUT_STREAM_LINE_MAX bytes). Returns 0 at end of input */
+static int mpc_input_stream_fill(mpc_input_t *i)
+{
+  int c = EOF;
+  long n = 0;
+
+  while (n < MPC_INPUT_STREAM_LINE_MAX && (c = getc(i->file)) != EOF)
+  {
+    if (i->length == i->slots)
+    {
+      i->slots *= 2;
+      i->string = realloc(i->string, i->slots);
+    }
+    i->string[i->length++] = (char)c;
+    n++;
+    if (c == '\n')
+    {
+      break;
+    }
+  }
+
+  return n > 0 || c != EOF;
+}
+
+/* Drops input that has been parsed once it is most of the window */
+static void mpc_input_stream_compact(mpc_input_t *i)
+{
+  long k = i->state.pos - i->offset;
+  if (k > 0 && k * 2 >= i->length)
+  {
+    memmove(i->string, i->string + k, i->length - k);
+    i->offset += k;
+    i->length -= k;
+  }
+}
+
+static char mpc_input_stream_get(mpc_input_t *i)
+{
+  long k = i->state.pos - i->offset;
+  if (k >= i->length)
+  {
+    i->starved = 1;
+    return '\0';
+  }
+  return i->string[k];
+}
+
 static void mpc_input_delete(mpc_input_t *i)
 {
 
   free(i->filename);
 
-  if (i->type == MPC_INPUT_STRING)
+  if (i->type == MPC_INPUT_STRING && i->map)
+  {
+#ifdef MPC_MMAP
+    munmap(i->map, i->map_size);
+#endif
+  }
+  else if (i->type == MPC_INPUT_STRING || i->type == MPC_INPUT_STREAM)
   {
     free(i->string);
   }
@@ -430,6 +647,8 @@ static char mpc_input_getc(mpc_input_t *i)
 
   case MPC_INPUT_STRING:
     return i->string[i->state.pos];
+  case MPC_INPUT_STREAM:
+    return mpc_input_stream_get(i);
   case MPC_INPUT_FILE:
     c = fgetc(i->file);
     return c;
@@ -466,6 +685,8 @@ static char mpc_input_peekc(mpc_input_t *i)
   {
   case MPC_INPUT_STRING:
     return i->string[i->state.pos];
+  case MPC_INPUT_STREAM:
+    return mpc_input_stream_get(i);
   case MPC_INPUT_FILE:
 
     c = fgetc(i->file);
@@ -1156,9 +1377,13 @@ enum
   MPC_TYPE_CHECK_WITH = 26,
 
   MPC_TYPE_SOI = 27,
-  MPC_TYPE_EOI = 28
+  MPC_TYPE_EOI = 28,
+
+  MPC_TYPE_DFA = 29
 };
 
+typedef struct mpc_dfa_t mpc_dfa_t;
+
 typedef struct
 {
   char *m;
@@ -1249,6 +1474,11 @@ typedef struct
   mpc_parser_t **xs;
   mpc_dtor_t *dxs;
 } mpc_pdata_and_t;
+typedef struct
+{
+  mpc_parser_t *x;
+  mpc_dfa_t *d;
+} mpc_pdata_dfa_t;
 
 typedef union
 {
@@ -1269,6 +1499,7 @@ typedef union
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or ;
+  mpc_pdata_dfa_t dfa;
 } mpc_pdata_t;
 
 struct mpc_parser_t
@@ -1277,3960 +1508,5698 @@ struct mpc_parser_t
   mpc_pdata_t data;
   char type;
   char retained;
+  char memo;
+  int tag_id;
 };
 
-static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x)
+/*
+** Regular Expression DFAs
+**
+** A regex parser is a tree of `or`, `and` and
+** repeat combinators over single characters. If
+** every choice in it is decided by the next
+** character, mpc's ordered, non-backtracking
+** matching finds the longest match, and the tree
+** can run as a DFA instead.
+**
+** The DFA comes from the Glushkov automaton of
+** the tree: one position per character parser
+** and the positions that can follow each one.
+** Its states are sets of positions, made the
+** first time a scan reaches them. Bytes that no
+** character parser tells apart share a class, so
+** each state has a column per class, not per byte.
+**
+** Only String inputs are scanned by a DFA, and it
+** skips the errors its combinators would have
+** merged, so a failed parse that used one is run
+** again without. Regexes it can't express (anchors,
+** lookahead, too many positions) keep the
+** combinators.
+*/
+
+enum
+{
+  MPC_DFA_POS_MAX = 256,
+  MPC_DFA_STATES_MAX = 1024,
+  MPC_DFA_UNKNOWN = -1,
+  MPC_DFA_DEAD = -2,
+  MPC_DFA_FULL = -3
+};
+
+/* Set of bytes or positions, 32 to a word */
+typedef struct
+{
+  unsigned long w[8];
+} mpc_dfa_set_t;
+
+typedef struct
+{
+  mpc_dfa_set_t first;
+  mpc_dfa_set_t last;
+  int nullable;
+} mpc_dfa_frag_t;
+
+struct mpc_dfa_t
+{
+  int failed;
+
+  /* Positions, 0 being the start */
+  int pos_num;
+  mpc_dfa_set_t *bytes;
+  mpc_dfa_set_t *follow;
+  mpc_dfa_set_t last;
+
+  /* Byte classes and the positions each matches */
+  int classes_num;
+  unsigned char classes[256];
+  mpc_dfa_set_t *matches;
+
+  /* States, 0 being the start */
+  int states_num;
+  int states_slots;
+  mpc_dfa_set_t *states;
+  char *accept;
+  int *trans;
+};
+
+static void mpc_dfa_set_add(mpc_dfa_set_t *s, int k) { s->w[k / 32] |= 1UL << (k % 32); }
+static int mpc_dfa_set_has(mpc_dfa_set_t *s, int k) { return (s->w[k / 32] >> (k % 32)) & 1; }
+static int mpc_dfa_set_eq(mpc_dfa_set_t *s, mpc_dfa_set_t *t) { return memcmp(s, t, sizeof(mpc_dfa_set_t)) == 0; }
+
+static void mpc_dfa_set_union(mpc_dfa_set_t *s, mpc_dfa_set_t *t)
 {
   int j;
-  for (j = 0; j < n; j++)
+  for (j = 0; j < 8; j++)
   {
-    if (j != x)
-    {
-      mpc_free(i, xs[j]);
-    }
+    s->w[j] |= t->w[j];
   }
-  return xs[x];
 }
 
-static mpc_val_t *mpcf_input_fst_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 0); }
-static mpc_val_t *mpcf_input_snd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 1); }
-static mpc_val_t *mpcf_input_trd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 2); }
-
-static mpc_val_t *mpcf_input_strfold(mpc_input_t *i, int n, mpc_val_t **xs)
+static int mpc_dfa_set_meets(mpc_dfa_set_t *s, mpc_dfa_set_t *t)
 {
   int j;
-  size_t l = 0;
-  if (n == 0)
-  {
-    return mpc_calloc(i, 1, 1);
-  }
-  for (j = 0; j < n; j++)
-  {
-    l += strlen(xs[j]);
-  }
-  xs[0] = mpc_realloc(i, xs[0], l + 1);
-  for (j = 1; j < n; j++)
+  for (j = 0; j < 8; j++)
   {
-    strcat(xs[0], xs[j]);
-    mpc_free(i, xs[j]);
+    if (s->w[j] & t->w[j])
+    {
+      return 1;
+    }
   }
-  return xs[0];
+  return 0;
 }
 
-static mpc_val_t *mpcf_input_state_ast(mpc_input_t *i, int n, mpc_val_t **xs)
+/* Bytes taken by a character parser, as in `mpc_input_char` and friends. '\0' ends a String */
+static int mpc_dfa_leaf(mpc_parser_t *p, mpc_dfa_set_t *s)
 {
-  mpc_state_t *s = ((mpc_state_t **)xs)[0];
-  mpc_ast_t *a = ((mpc_ast_t **)xs)[1];
-  a = mpc_ast_state(a, *s);
-  mpc_free(i, s);
-  (void)n;
-  return a;
-}
+  int b;
+  char c;
 
-static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t **xs)
-{
-  int j;
-  if (f == mpcf_null)
-  {
-    return mpcf_null(n, xs);
-  }
-  if (f == mpcf_fst)
-  {
-    return mpcf_fst(n, xs);
-  }
-  if (f == mpcf_snd)
-  {
-    return mpcf_snd(n, xs);
-  }
-  if (f == mpcf_trd)
-  {
-    return mpcf_trd(n, xs);
-  }
-  if (f == mpcf_fst_free)
-  {
-    return mpcf_input_fst_free(i, n, xs);
-  }
-  if (f == mpcf_snd_free)
-  {
-    return mpcf_input_snd_free(i, n, xs);
-  }
-  if (f == mpcf_trd_free)
-  {
-    return mpcf_input_trd_free(i, n, xs);
-  }
-  if (f == mpcf_strfold)
+  while (p->type == MPC_TYPE_EXPECT)
   {
-    return mpcf_input_strfold(i, n, xs);
+    p = p->data.expect.x;
   }
-  if (f == mpcf_state_ast)
+
+  if (p->type != MPC_TYPE_ANY && p->type != MPC_TYPE_SINGLE && p->type != MPC_TYPE_RANGE &&
+      p->type != MPC_TYPE_ONEOF && p->type != MPC_TYPE_NONEOF)
   {
-    return mpcf_input_state_ast(i, n, xs);
+    return 0;
   }
-  for (j = 0; j < n; j++)
+
+  memset(s, 0, sizeof(mpc_dfa_set_t));
+  for (b = 1; b < 256; b++)
   {
-    xs[j] = mpc_export(i, xs[j]);
+    c = (char)b;
+    if ((p->type == MPC_TYPE_ANY) ||
+        (p->type == MPC_TYPE_SINGLE && c == p->data.single.x) ||
+        (p->type == MPC_TYPE_RANGE && c >= p->data.range.x && c <= p->data.range.y) ||
+        (p->type == MPC_TYPE_ONEOF && strchr(p->data.string.x, c) != 0) ||
+        (p->type == MPC_TYPE_NONEOF && strchr(p->data.string.x, c) == 0))
+    {
+      mpc_dfa_set_add(s, b);
+    }
   }
-  return f(j, xs);
-}
-
-static mpc_val_t *mpcf_input_free(mpc_input_t *i, mpc_val_t *x)
-{
-  mpc_free(i, x);
-  return NULL;
+  return 1;
 }
 
-static mpc_val_t *mpcf_input_str_ast(mpc_input_t *i, mpc_val_t *c)
+/* Adds the bytes `p` can start with to `s`. Returns if `p` can match nothing */
+static int mpc_dfa_first(mpc_parser_t *p, mpc_dfa_set_t *s)
 {
-  mpc_ast_t *a = mpc_ast_new("", c);
-  mpc_free(i, c);
-  return a;
-}
+  int j, n;
+  mpc_dfa_set_t t;
 
-static mpc_val_t *mpc_parse_apply(mpc_input_t *i, mpc_apply_t f, mpc_val_t *x)
-{
-  if (f == mpcf_free)
+  if (mpc_dfa_leaf(p, &t))
   {
-    return mpcf_input_free(i, x);
+    mpc_dfa_set_union(s, &t);
+    return 0;
   }
-  if (f == mpcf_str_ast)
+
+  switch (p->type)
   {
-    return mpcf_input_str_ast(i, x);
+  case MPC_TYPE_EXPECT:
+    return mpc_dfa_first(p->data.expect.x, s);
+  case MPC_TYPE_AND:
+    for (j = 0; j < p->data.and.n; j++)
+    {
+      if (!mpc_dfa_first(p->data.and.xs[j], s))
+      {
+        return 0;
+      }
+    }
+    return 1;
+  case MPC_TYPE_OR:
+    n = 0;
+    for (j = 0; j < p->data.or.n; j++)
+    {
+      n = mpc_dfa_first(p->data.or.xs[j], s) || n;
+    }
+    return n;
+  case MPC_TYPE_MAYBE:
+    mpc_dfa_first(p->data.not .x, s);
+    return 1;
+  case MPC_TYPE_MANY:
+    mpc_dfa_first(p->data.repeat.x, s);
+    return 1;
+  case MPC_TYPE_MANY1:
+  case MPC_TYPE_COUNT:
+    return mpc_dfa_first(p->data.repeat.x, s);
+  default:
+    return 1;
   }
-  return f(mpc_export(i, x));
 }
 
-static mpc_val_t *mpc_parse_apply_to(mpc_input_t *i, mpc_apply_to_t f, mpc_val_t *x, mpc_val_t *d)
+/*
+** Checks that `p` only uses parsers a DFA can
+** express and that each choice in it is decided
+** by the next byte, given the bytes `follow` that
+** can come after it. Options and repeats must not
+** start like what follows them, `or` alternatives
+** must not start alike and only the last may
+** match nothing.
+**
+** A `count` that fails halfway isn't rewound, so
+** unless `rewound` says an `and` above it will do
+** that, it must not repeat more than once.
+*/
+static int mpc_dfa_check(mpc_parser_t *p, mpc_dfa_set_t *follow, int rewound)
 {
-  return f(mpc_export(i, x), d);
-}
+  int j;
+  mpc_dfa_set_t s, t;
 
-static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x)
-{
-  if (d == free)
+  if (mpc_dfa_leaf(p, &s))
   {
-    mpc_free(i, x);
-    return;
+    return 1;
   }
-  d(mpc_export(i, x));
-}
 
-enum
-{
-  MPC_PARSE_STACK_MIN = 4
-};
-
-#define MPC_SUCCESS(x) \
-  r->output = x;       \
-  return 1
-#define MPC_FAILURE(x) \
-  r->error = x;        \
-  return 0
-#define MPC_PRIMITIVE(x)    \
-  if (x)                    \
-  {                         \
-    MPC_SUCCESS(r->output); \
-  }                         \
-  else                      \
-  {                         \
-    MPC_FAILURE(NULL);      \
-  }
-
-#define MPC_MAX_RECURSION_DEPTH 1000
-
-static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth)
-{
-
-  int j = 0, k = 0;
-  mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
-  mpc_result_t *results;
-  int results_slots = MPC_PARSE_STACK_MIN;
-
-  if (depth == MPC_MAX_RECURSION_DEPTH)
-  {
-    MPC_FAILURE(mpc_err_fail(i, "Maximum recursion depth exceeded!"));
-  }
+  memset(&s, 0, sizeof(mpc_dfa_set_t));
 
   switch (p->type)
   {
+  case MPC_TYPE_EXPECT:
+    return mpc_dfa_check(p->data.expect.x, follow, rewound);
 
-    /* Basic Parsers */
-
-  case MPC_TYPE_ANY:
-    MPC_PRIMITIVE(mpc_input_any(i, (char **)&r->output));
-  case MPC_TYPE_SINGLE:
-    MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char **)&r->output));
-  case MPC_TYPE_RANGE:
-    MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char **)&r->output));
-  case MPC_TYPE_ONEOF:
-    MPC_PRIMITIVE(mpc_input_oneof(i, p->data.string.x, (char **)&r->output));
-  case MPC_TYPE_NONEOF:
-    MPC_PRIMITIVE(mpc_input_noneof(i, p->data.string.x, (char **)&r->output));
-  case MPC_TYPE_SATISFY:
-    MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char **)&r->output));
-  case MPC_TYPE_STRING:
-    MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char **)&r->output));
-  case MPC_TYPE_ANCHOR:
-    MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char **)&r->output));
-  case MPC_TYPE_SOI:
-    MPC_PRIMITIVE(mpc_input_soi(i, (char **)&r->output));
-  case MPC_TYPE_EOI:
-    MPC_PRIMITIVE(mpc_input_eoi(i, (char **)&r->output));
-
-    /* Other parsers */
-
-  case MPC_TYPE_UNDEFINED:
-    MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
-  case MPC_TYPE_PASS:
-    MPC_SUCCESS(NULL);
-  case MPC_TYPE_FAIL:
-    MPC_FAILURE(mpc_err_fail(i, p->data.fail.m));
   case MPC_TYPE_LIFT:
-    MPC_SUCCESS(p->data.lift.lf());
-  case MPC_TYPE_LIFT_VAL:
-    MPC_SUCCESS(p->data.lift.x);
-  case MPC_TYPE_STATE:
-    MPC_SUCCESS(mpc_input_state_copy(i));
-
-    /* Application Parsers */
-
-  case MPC_TYPE_APPLY:
-    if (mpc_parse_run(i, p->data.apply.x, r, e, depth + 1))
-    {
-      MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, r->output));
-    }
-    else
-    {
-      MPC_FAILURE(r->output);
-    }
+    return p->data.lift.lf == mpcf_ctor_str;
 
-  case MPC_TYPE_APPLY_TO:
-    if (mpc_parse_run(i, p->data.apply_to.x, r, e, depth + 1))
-    {
-      MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, r->output, p->data.apply_to.d));
-    }
-    else
+  case MPC_TYPE_AND:
+    if (p->data.and.f != mpcf_strfold)
     {
-      MPC_FAILURE(r->error);
+      return 0;
     }
-
-  case MPC_TYPE_CHECK:
-    if (mpc_parse_run(i, p->data.check.x, r, e, depth + 1))
+    t = *follow;
+    for (j = p->data.and.n - 1; j >= 0; j--)
     {
-      if (p->data.check.f(&r->output))
+      if (!mpc_dfa_check(p->data.and.xs[j], &t, 1))
       {
-        MPC_SUCCESS(r->output);
+        return 0;
+      }
+      memset(&s, 0, sizeof(mpc_dfa_set_t));
+      if (mpc_dfa_first(p->data.and.xs[j], &s))
+      {
+        mpc_dfa_set_union(&t, &s);
       }
       else
       {
-        mpc_parse_dtor(i, p->data.check.dx, r->output);
-        MPC_FAILURE(mpc_err_fail(i, p->data.check.e));
+        t = s;
       }
     }
-    else
-    {
-      MPC_FAILURE(r->error);
-    }
+    return 1;
 
-  case MPC_TYPE_CHECK_WITH:
-    if (mpc_parse_run(i, p->data.check_with.x, r, e, depth + 1))
+  case MPC_TYPE_OR:
+    for (j = 0; j < p->data.or.n; j++)
     {
-      if (p->data.check_with.f(&r->output, p->data.check_with.d))
+      memset(&t, 0, sizeof(mpc_dfa_set_t));
+      if (mpc_dfa_first(p->data.or.xs[j], &t) &&
+          (j != p->data.or.n - 1 || mpc_dfa_set_meets(&s, follow)))
       {
-        MPC_SUCCESS(r->output);
+        return 0;
       }
-      else
+      if (mpc_dfa_set_meets(&s, &t) || !mpc_dfa_check(p->data.or.xs[j], follow, 0))
       {
-        mpc_parse_dtor(i, p->data.check.dx, r->output);
-        MPC_FAILURE(mpc_err_fail(i, p->data.check_with.e));
+        return 0;
       }
+      mpc_dfa_set_union(&s, &t);
     }
-    else
-    {
-      MPC_FAILURE(r->error);
-    }
+    return 1;
 
-  case MPC_TYPE_EXPECT:
-    mpc_input_suppress_enable(i);
-    if (mpc_parse_run(i, p->data.expect.x, r, e, depth + 1))
-    {
-      mpc_input_suppress_disable(i);
-      MPC_SUCCESS(r->output);
-    }
-    else
+  case MPC_TYPE_MAYBE:
+    if (p->data.not .lf != mpcf_ctor_str ||
+        mpc_dfa_first(p->data.not .x, &s) ||
+        mpc_dfa_set_meets(&s, follow))
     {
-      mpc_input_suppress_disable(i);
-      MPC_FAILURE(mpc_err_new(i, p->data.expect.m));
+      return 0;
     }
+    return mpc_dfa_check(p->data.not .x, follow, 0);
 
-  case MPC_TYPE_PREDICT:
-    mpc_input_backtrack_disable(i);
-    if (mpc_parse_run(i, p->data.predict.x, r, e, depth + 1))
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+    if (p->data.repeat.f != mpcf_strfold ||
+        mpc_dfa_first(p->data.repeat.x, &s) ||
+        mpc_dfa_set_meets(&s, follow))
     {
-      mpc_input_backtrack_enable(i);
-      MPC_SUCCESS(r->output);
+      return 0;
     }
-    else
+    mpc_dfa_set_union(&s, follow);
+    return mpc_dfa_check(p->data.repeat.x, &s, 0);
+
+  case MPC_TYPE_COUNT:
+    if (p->data.repeat.f != mpcf_strfold ||
+        p->data.repeat.n < 1 ||
+        (p->data.repeat.n > 1 && !rewound) ||
+        mpc_dfa_first(p->data.repeat.x, &s))
     {
-      mpc_input_backtrack_enable(i);
-      MPC_FAILURE(r->error);
+      return 0;
     }
+    mpc_dfa_set_union(&s, follow);
+    return mpc_dfa_check(p->data.repeat.x, &s, rewound);
 
-    /* Optional Parsers */
-
-    /* TODO: Update Not Error Message */
+  default:
+    return 0;
+  }
+}
 
-  case MPC_TYPE_NOT:
-    mpc_input_mark(i);
-    mpc_input_suppress_enable(i);
-    if (mpc_parse_run(i, p->data.not .x, r, e, depth + 1))
-    {
-      mpc_input_rewind(i);
-      mpc_input_suppress_disable(i);
-      mpc_parse_dtor(i, p->data.not .dx, r->output);
-      MPC_FAILURE(mpc_err_new(i, "opposite"));
-    }
-    else
+/* Lets every position in `last` be followed by those in `first` */
+static void mpc_dfa_link(mpc_dfa_t *d, mpc_dfa_set_t *last, mpc_dfa_set_t *first)
+{
+  int k;
+  for (k = 0; k < d->pos_num; k++)
+  {
+    if (mpc_dfa_set_has(last, k))
     {
-      mpc_input_unmark(i);
-      mpc_input_suppress_disable(i);
-      MPC_SUCCESS(p->data.not .lf());
+      mpc_dfa_set_union(&d->follow[k], first);
     }
+  }
+}
 
-  case MPC_TYPE_MAYBE:
-    if (mpc_parse_run(i, p->data.not .x, r, e, depth + 1))
-    {
-      MPC_SUCCESS(r->output);
-    }
-    else
+/* Adds the positions of `p`. Returns 0 if there are too many */
+static int mpc_dfa_build(mpc_dfa_t *d, mpc_parser_t *p, mpc_dfa_frag_t *f)
+{
+  int j, n;
+  mpc_dfa_frag_t g;
+  mpc_dfa_set_t s;
+
+  memset(f, 0, sizeof(mpc_dfa_frag_t));
+
+  if (mpc_dfa_leaf(p, &s))
+  {
+    if (d->pos_num == MPC_DFA_POS_MAX)
     {
-      *e = mpc_err_merge(i, *e, r->error);
-      MPC_SUCCESS(p->data.not .lf());
+      return 0;
     }
+    d->bytes[d->pos_num] = s;
+    mpc_dfa_set_add(&f->first, d->pos_num);
+    mpc_dfa_set_add(&f->last, d->pos_num);
+    d->pos_num++;
+    return 1;
+  }
 
-    /* Repeat Parsers */
-
-  case MPC_TYPE_MANY:
+  switch (p->type)
+  {
+  case MPC_TYPE_EXPECT:
+    return mpc_dfa_build(d, p->data.expect.x, f);
 
-    results = results_stk;
+  case MPC_TYPE_LIFT:
+    f->nullable = 1;
+    return 1;
 
-    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+  case MPC_TYPE_AND:
+  case MPC_TYPE_COUNT:
+    f->nullable = 1;
+    n = p->type == MPC_TYPE_AND ? p->data.and.n : p->data.repeat.n;
+    for (j = 0; j < n; j++)
     {
-      j++;
-      if (j == MPC_PARSE_STACK_MIN)
+      if (!mpc_dfa_build(d, p->type == MPC_TYPE_AND ? p->data.and.xs[j] : p->data.repeat.x, &g))
       {
-        results_slots = j + j / 2;
-        results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-        memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
+        return 0;
       }
-      else if (j >= results_slots)
+      mpc_dfa_link(d, &f->last, &g.first);
+      if (f->nullable)
       {
-        results_slots = j + j / 2;
-        results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+        mpc_dfa_set_union(&f->first, &g.first);
+      }
+      if (!g.nullable)
+      {
+        memset(&f->last, 0, sizeof(mpc_dfa_set_t));
       }
+      mpc_dfa_set_union(&f->last, &g.last);
+      f->nullable = f->nullable && g.nullable;
     }
+    return 1;
 
-    *e = mpc_err_merge(i, *e, results[j].error);
-
-    MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
-        if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-
-  case MPC_TYPE_MANY1:
-
-    results = results_stk;
-
-    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+  case MPC_TYPE_OR:
+    for (j = 0; j < p->data.or.n; j++)
     {
-      j++;
-      if (j == MPC_PARSE_STACK_MIN)
+      if (!mpc_dfa_build(d, p->data.or.xs[j], &g))
       {
-        results_slots = j + j / 2;
-        results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-        memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
-      }
-      else if (j >= results_slots)
-      {
-        results_slots = j + j / 2;
-        results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+        return 0;
       }
+      mpc_dfa_set_union(&f->first, &g.first);
+      mpc_dfa_set_union(&f->last, &g.last);
+      f->nullable = f->nullable || g.nullable;
     }
+    return 1;
 
-    if (j == 0)
+  case MPC_TYPE_MAYBE:
+    if (!mpc_dfa_build(d, p->data.not .x, f))
     {
-      MPC_FAILURE(
-          mpc_err_many1(i, results[j].error);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      return 0;
     }
-    else
+    f->nullable = 1;
+    return 1;
+
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+    if (!mpc_dfa_build(d, p->data.repeat.x, f))
     {
+      return 0;
+    }
+    mpc_dfa_link(d, &f->last, &f->first);
+    f->nullable = f->nullable || p->type == MPC_TYPE_MANY;
+    return 1;
 
-      *e = mpc_err_merge(i, *e, results[j].error);
+  default:
+    return 0;
+  }
+}
 
-      MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    }
+static void mpc_dfa_delete(mpc_dfa_t *d)
+{
+  if (d == NULL)
+  {
+    return;
+  }
+  free(d->bytes);
+  free(d->follow);
+  free(d->matches);
+  free(d->states);
+  free(d->accept);
+  free(d->trans);
+  free(d);
+}
 
-  case MPC_TYPE_COUNT:
+/* Finds the state for the positions `s`, adding it if it is new */
+static int mpc_dfa_state(mpc_dfa_t *d, mpc_dfa_set_t *s)
+{
+  int j;
 
-    results = p->data.repeat.n > MPC_PARSE_STACK_MIN
-                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
-                  : results_stk;
-
-    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+  for (j = 0; j < d->states_num; j++)
+  {
+    if (mpc_dfa_set_eq(&d->states[j], s))
     {
-      j++;
-      if (j == p->data.repeat.n)
-      {
-        break;
-      }
+      return j;
     }
+  }
 
-    if (j == p->data.repeat.n)
-    {
-      MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    }
-    else
-    {
-      for (k = 0; k < j; k++)
-      {
-        mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
-      }
-      MPC_FAILURE(
-          mpc_err_count(i, results[j].error, p->data.repeat.n);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-    }
+  if (d->states_num == MPC_DFA_STATES_MAX)
+  {
+    return MPC_DFA_FULL;
+  }
 
-    /* Combinatory Parsers */
+  if (d->states_num == d->states_slots)
+  {
+    d->states_slots = d->states_slots ? d->states_slots * 2 : 16;
+    d->states = realloc(d->states, sizeof(mpc_dfa_set_t) * d->states_slots);
+    d->accept = realloc(d->accept, sizeof(char) * d->states_slots);
+    d->trans = realloc(d->trans, sizeof(int) * d->states_slots * d->classes_num);
+  }
 
-  case MPC_TYPE_OR:
+  d->states[d->states_num] = *s;
+  d->accept[d->states_num] = (char)mpc_dfa_set_meets(s, &d->last);
+  for (j = 0; j < d->classes_num; j++)
+  {
+    d->trans[d->states_num * d->classes_num + j] = MPC_DFA_UNKNOWN;
+  }
+  return d->states_num++;
+}
 
-    if (p->data.or.n == 0)
-    {
-      MPC_SUCCESS(NULL);
-    }
+/*
+** Makes the positions and byte classes for the
+** regex parser `x`. States are added as scans
+** need them. Sets `failed` if `x` has no DFA.
+*/
+static mpc_dfa_t *mpc_dfa_new(mpc_parser_t *x)
+{
+  int b, j, k;
+  mpc_dfa_frag_t f;
+  mpc_dfa_set_t s;
+  mpc_dfa_t *d = calloc(1, sizeof(mpc_dfa_t));
 
-    results = p->data.or.n > MPC_PARSE_STACK_MIN
-                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-                  : results_stk;
+  memset(&s, 0, sizeof(mpc_dfa_set_t));
+  if (!mpc_dfa_check(x, &s, 0))
+  {
+    d->failed = 1;
+    return d;
+  }
 
-    for (j = 0; j < p->data.or.n; j++)
-    {
-      if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e, depth + 1))
-      {
-        MPC_SUCCESS(results[j].output;
-                    if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      }
-      else
-      {
-        *e = mpc_err_merge(i, *e, results[j].error);
-      }
-    }
+  d->bytes = calloc(MPC_DFA_POS_MAX, sizeof(mpc_dfa_set_t));
+  d->follow = calloc(MPC_DFA_POS_MAX, sizeof(mpc_dfa_set_t));
+  d->pos_num = 1;
 
-    MPC_FAILURE(NULL;
-                if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+  if (!mpc_dfa_build(d, x, &f))
+  {
+    d->failed = 1;
+    return d;
+  }
 
-  case MPC_TYPE_AND:
+  d->follow[0] = f.first;
+  d->last = f.last;
+  if (f.nullable)
+  {
+    mpc_dfa_set_add(&d->last, 0);
+  }
 
-    if (p->data.and.n == 0)
+  /* Class 0 is '\0' and the bytes no position takes */
+  d->matches = calloc(256, sizeof(mpc_dfa_set_t));
+  d->classes_num = 1;
+  for (b = 1; b < 256; b++)
+  {
+    memset(&s, 0, sizeof(mpc_dfa_set_t));
+    for (j = 1; j < d->pos_num; j++)
     {
-      MPC_SUCCESS(NULL);
+      if (mpc_dfa_set_has(&d->bytes[j], b))
+      {
+        mpc_dfa_set_add(&s, j);
+      }
     }
-
-    results = p->data.or.n > MPC_PARSE_STACK_MIN
-                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-                  : results_stk;
-
-    mpc_input_mark(i);
-    for (j = 0; j < p->data.and.n; j++)
+    for (k = 0; k < d->classes_num; k++)
     {
-      if (!mpc_parse_run(i, p->data.and.xs[j], &results[j], e, depth + 1))
+      if (mpc_dfa_set_eq(&d->matches[k], &s))
       {
-        mpc_input_rewind(i);
-        for (k = 0; k < j; k++)
-        {
-          mpc_parse_dtor(i, p->data.and.dxs[k], results[k].output);
-        }
-        MPC_FAILURE(results[j].error;
-                    if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+        break;
       }
     }
-    mpc_input_unmark(i);
-    MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t **)results);
-        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-
-    /* End */
-
-  default:
-
-    MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
+    if (k == d->classes_num)
+    {
+      d->matches[d->classes_num++] = s;
+    }
+    d->classes[b] = (unsigned char)k;
   }
 
-  return 0;
-}
+  free(d->bytes);
+  d->bytes = NULL;
+  d->follow = realloc(d->follow, sizeof(mpc_dfa_set_t) * d->pos_num);
+  d->matches = realloc(d->matches, sizeof(mpc_dfa_set_t) * d->classes_num);
 
-#undef MPC_SUCCESS
-#undef MPC_FAILURE
-#undef MPC_PRIMITIVE
+  memset(&s, 0, sizeof(mpc_dfa_set_t));
+  mpc_dfa_set_add(&s, 0);
+  mpc_dfa_state(d, &s);
+  return d;
+}
 
-int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r)
+/* Works out and records where `state` goes on byte class `c` */
+static int mpc_dfa_step(mpc_dfa_t *d, int state, int c)
 {
-  int x;
-  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
-  e->state = mpc_state_invalid();
-  x = mpc_parse_run(i, p, r, &e, 0);
-  if (x)
+  int j, t;
+  mpc_dfa_set_t s, none;
+
+  memset(&s, 0, sizeof(mpc_dfa_set_t));
+  memset(&none, 0, sizeof(mpc_dfa_set_t));
+  for (j = 0; j < d->pos_num; j++)
   {
-    mpc_err_delete_internal(i, e);
-    r->output = mpc_export(i, r->output);
+    if (mpc_dfa_set_has(&d->states[state], j))
+    {
+      mpc_dfa_set_union(&s, &d->follow[j]);
+    }
   }
-  else
+  for (j = 0; j < 8; j++)
   {
-    r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
+    s.w[j] &= d->matches[c].w[j];
   }
-  return x;
-}
 
-int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r)
-{
-  int x;
-  mpc_input_t *i = mpc_input_new_string(filename, string);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
+  t = mpc_dfa_set_eq(&s, &none) ? MPC_DFA_DEAD : mpc_dfa_state(d, &s);
+  if (t != MPC_DFA_FULL)
+  {
+    d->trans[state * d->classes_num + c] = t;
+  }
+  return t;
 }
 
-int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r)
+/* Length of the longest match at the start of `s`, -1 if there is none or MPC_DFA_FULL if it needs too many states */
+static long mpc_dfa_match(mpc_dfa_t *d, const char *s)
 {
-  int x;
-  mpc_input_t *i = mpc_input_new_nstring(filename, string, length);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
+  int state = 0, t;
+  long n, m = d->accept[0] ? 0 : -1;
 
-int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r)
-{
-  int x;
-  mpc_input_t *i = mpc_input_new_file(filename, file);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
-}
+  for (n = 0; s[n] != '\0'; n++)
+  {
+    t = d->trans[state * d->classes_num + d->classes[(unsigned char)s[n]]];
+    if (t == MPC_DFA_UNKNOWN)
+    {
+      t = mpc_dfa_step(d, state, d->classes[(unsigned char)s[n]]);
+    }
+    if (t == MPC_DFA_DEAD)
+    {
+      break;
+    }
+    if (t == MPC_DFA_FULL)
+    {
+      return MPC_DFA_FULL;
+    }
+    state = t;
+    if (d->accept[state])
+    {
+      m = n + 1;
+    }
+  }
 
-int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r)
-{
-  int x;
-  mpc_input_t *i = mpc_input_new_pipe(filename, pipe);
-  x = mpc_parse_input(i, p, r);
-  mpc_input_delete(i);
-  return x;
+  return m;
 }
 
-int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r)
+/* Runs the DFA of `p` on a String input. Returns -1 where the combinators must be used */
+static int mpc_input_dfa(mpc_input_t *i, mpc_parser_t *p, char **o)
 {
+  long j, n;
+  const char *s;
 
-  FILE *f = fopen(filename, "rb");
-  int res;
+  if (i->type != MPC_INPUT_STRING || i->backtrack < 1 || i->exact)
+  {
+    return -1;
+  }
 
-  if (f == NULL)
+  if (p->data.dfa.d == NULL)
   {
-    r->output = NULL;
-    r->error = mpc_err_file(filename, "Unable to open file!");
-    return 0;
+    p->data.dfa.d = mpc_dfa_new(p->data.dfa.x);
   }
 
-  res = mpc_parse_file(filename, f, p, r);
-  fclose(f);
-  return res;
-}
+  if (p->data.dfa.d->failed)
+  {
+    return -1;
+  }
 
-/*
-** Building a Parser
-*/
+  s = i->string + i->state.pos;
+  n = mpc_dfa_match(p->data.dfa.d, s);
+  if (n == MPC_DFA_FULL)
+  {
+    return -1;
+  }
 
-static void mpc_undefine_unretained(mpc_parser_t *p, int force);
+  if (!i->suppress)
+  {
+    i->inexact = 1;
+  }
 
-static void mpc_undefine_or(mpc_parser_t *p)
-{
+  if (n < 0)
+  {
+    return 0;
+  }
 
-  int i;
-  for (i = 0; i < p->data.or.n; i++)
+  for (j = 0; j < n; j++)
   {
-    mpc_undefine_unretained(p->data.or.xs[i], 0);
+    i->state.col++;
+    if (s[j] == '\n')
+    {
+      i->state.col = 0;
+      i->state.row++;
+    }
   }
-  free(p->data.or.xs);
+
+  if (n > 0)
+  {
+    i->last = s[n - 1];
+  }
+  i->state.pos += n;
+
+  *o = mpc_malloc(i, n + 1);
+  memcpy(*o, s, n);
+  (*o)[n] = '\0';
+  return 1;
 }
 
-static void mpc_undefine_and(mpc_parser_t *p)
+static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x)
 {
-
-  int i;
-  for (i = 0; i < p->data.and.n; i++)
+  int j;
+  for (j = 0; j < n; j++)
   {
-    mpc_undefine_unretained(p->data.and.xs[i], 0);
+    if (j != x)
+    {
+      mpc_free(i, xs[j]);
+    }
   }
-  free(p->data.and.xs);
-  free(p->data.and.dxs);
+  return xs[x];
 }
 
-static void mpc_undefine_unretained(mpc_parser_t *p, int force)
-{
+static mpc_val_t *mpcf_input_fst_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 0); }
+static mpc_val_t *mpcf_input_snd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 1); }
+static mpc_val_t *mpcf_input_trd_free(mpc_input_t *i, int n, mpc_val_t **xs) { return mpcf_input_nth_free(i, n, xs, 2); }
 
-  if (p->retained && !force)
+static mpc_val_t *mpcf_input_strfold(mpc_input_t *i, int n, mpc_val_t **xs)
+{
+  int j;
+  size_t l = 0;
+  if (n == 0)
   {
-    return;
+    return mpc_calloc(i, 1, 1);
   }
-
-  switch (p->type)
+  for (j = 0; j < n; j++)
+  {
+    l += strlen(xs[j]);
+  }
+  xs[0] = mpc_realloc(i, xs[0], l + 1);
+  for (j = 1; j < n; j++)
   {
+    strcat(xs[0], xs[j]);
+    mpc_free(i, xs[j]);
+  }
+  return xs[0];
+}
 
-  case MPC_TYPE_FAIL:
-    free(p->data.fail.m);
-    break;
+static mpc_val_t *mpcf_input_state_ast(mpc_input_t *i, int n, mpc_val_t **xs)
+{
+  mpc_state_t *s = ((mpc_state_t **)xs)[0];
+  mpc_ast_t *a = ((mpc_ast_t **)xs)[1];
+  a = mpc_ast_state(a, *s);
+  mpc_free(i, s);
+  (void)n;
+  return a;
+}
 
-  case MPC_TYPE_ONEOF:
-  case MPC_TYPE_NONEOF:
-  case MPC_TYPE_STRING:
-    free(p->data.string.x);
-    break;
-
-  case MPC_TYPE_APPLY:
-    mpc_undefine_unretained(p->data.apply.x, 0);
-    break;
-  case MPC_TYPE_APPLY_TO:
-    mpc_undefine_unretained(p->data.apply_to.x, 0);
-    break;
-  case MPC_TYPE_PREDICT:
-    mpc_undefine_unretained(p->data.predict.x, 0);
-    break;
-
-  case MPC_TYPE_MAYBE:
-  case MPC_TYPE_NOT:
-    mpc_undefine_unretained(p->data.not .x, 0);
-    break;
-
-  case MPC_TYPE_EXPECT:
-    mpc_undefine_unretained(p->data.expect.x, 0);
-    free(p->data.expect.m);
-    break;
-
-  case MPC_TYPE_MANY:
-  case MPC_TYPE_MANY1:
-  case MPC_TYPE_COUNT:
-    mpc_undefine_unretained(p->data.repeat.x, 0);
-    break;
-
-  case MPC_TYPE_OR:
-    mpc_undefine_or(p);
-    break;
-  case MPC_TYPE_AND:
-    mpc_undefine_and(p);
-    break;
-
-  case MPC_TYPE_CHECK:
-    mpc_undefine_unretained(p->data.check.x, 0);
-    free(p->data.check.e);
-    break;
-
-  case MPC_TYPE_CHECK_WITH:
-    mpc_undefine_unretained(p->data.check_with.x, 0);
-    free(p->data.check_with.e);
-    break;
-
-  default:
-    break;
+static mpc_val_t *mpc_parse_fold(mpc_input_t *i, mpc_fold_t f, int n, mpc_val_t **xs)
+{
+  int j;
+  if (f == mpcf_null)
+  {
+    return mpcf_null(n, xs);
   }
-
-  if (!force)
+  if (f == mpcf_fst)
   {
-    free(p->name);
-    free(p);
+    return mpcf_fst(n, xs);
   }
-}
-
-void mpc_delete(mpc_parser_t *p)
-{
-  if (p->retained)
+  if (f == mpcf_snd)
   {
-
-    if (p->type != MPC_TYPE_UNDEFINED)
-    {
-      mpc_undefine_unretained(p, 0);
-    }
-
-    free(p->name);
-    free(p);
+    return mpcf_snd(n, xs);
   }
-  else
+  if (f == mpcf_trd)
   {
-    mpc_undefine_unretained(p, 0);
+    return mpcf_trd(n, xs);
+  }
+  if (f == mpcf_fst_free)
+  {
+    return mpcf_input_fst_free(i, n, xs);
+  }
+  if (f == mpcf_snd_free)
+  {
+    return mpcf_input_snd_free(i, n, xs);
+  }
+  if (f == mpcf_trd_free)
+  {
+    return mpcf_input_trd_free(i, n, xs);
+  }
+  if (f == mpcf_strfold)
+  {
+    return mpcf_input_strfold(i, n, xs);
+  }
+  if (f == mpcf_state_ast)
+  {
+    return mpcf_input_state_ast(i, n, xs);
+  }
+  for (j = 0; j < n; j++)
+  {
+    xs[j] = mpc_export(i, xs[j]);
   }
+  return f(j, xs);
 }
 
-static void mpc_soft_delete(mpc_val_t *x)
+static mpc_val_t *mpcf_input_free(mpc_input_t *i, mpc_val_t *x)
 {
-  mpc_undefine_unretained(x, 0);
+  mpc_free(i, x);
+  return NULL;
 }
 
-static mpc_parser_t *mpc_undefined(void)
+static mpc_val_t *mpcf_input_str_ast(mpc_input_t *i, mpc_val_t *c)
 {
-  mpc_parser_t *p = calloc(1, sizeof(mpc_parser_t));
-  p->retained = 0;
-  p->type = MPC_TYPE_UNDEFINED;
-  p->name = NULL;
-  return p;
+  mpc_ast_t *a = mpc_ast_new("", c);
+  mpc_free(i, c);
+  return a;
 }
 
-mpc_parser_t *mpc_new(const char *name)
+static mpc_val_t *mpc_parse_apply(mpc_input_t *i, mpc_apply_t f, mpc_val_t *x)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->retained = 1;
-  p->name = realloc(p->name, strlen(name) + 1);
-  strcpy(p->name, name);
-  return p;
+  if (f == mpcf_free)
+  {
+    return mpcf_input_free(i, x);
+  }
+  if (f == mpcf_str_ast)
+  {
+    return mpcf_input_str_ast(i, x);
+  }
+  return f(mpc_export(i, x));
 }
 
-mpc_parser_t *mpc_copy(mpc_parser_t *a)
+static mpc_val_t *mpc_parse_apply_to(mpc_input_t *i, mpc_apply_to_t f, mpc_val_t *x, mpc_val_t *d)
 {
-  int i = 0;
-  mpc_parser_t *p;
+  return f(mpc_export(i, x), d);
+}
 
-  if (a->retained)
+static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x)
+{
+  if (d == free)
   {
-    return a;
+    mpc_free(i, x);
+    return;
   }
+  d(mpc_export(i, x));
+}
 
-  p = mpc_undefined();
-  p->retained = a->retained;
-  p->type = a->type;
-  p->data = a->data;
+enum
+{
+  MPC_PARSE_STACK_MIN = 4
+};
 
-  if (a->name)
+#define MPC_SUCCESS(x) \
+  r->output = x;       \
+  return 1
+#define MPC_FAILURE(x) \
+  r->error = x;        \
+  return 0
+#define MPC_PRIMITIVE(x)    \
+  if (x)                    \
+  {                         \
+    MPC_SUCCESS(r->output); \
+  }                         \
+  else                      \
+  {                         \
+    MPC_FAILURE(NULL);      \
+  }
+
+#define MPC_MAX_RECURSION_DEPTH 1000
+
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth);
+
+static int mpc_parse_node(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth)
+{
+
+  int j = 0, k = 0;
+  mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
+  mpc_result_t *results;
+  int results_slots = MPC_PARSE_STACK_MIN;
+
+  if (depth == MPC_MAX_RECURSION_DEPTH)
   {
-    p->name = malloc(strlen(a->name) + 1);
-    strcpy(p->name, a->name);
+    MPC_FAILURE(mpc_err_fail(i, "Maximum recursion depth exceeded!"));
   }
 
-  switch (a->type)
+  switch (p->type)
   {
 
-  case MPC_TYPE_FAIL:
-    p->data.fail.m = malloc(strlen(a->data.fail.m) + 1);
-    strcpy(p->data.fail.m, a->data.fail.m);
-    break;
+    /* Basic Parsers */
 
+  case MPC_TYPE_ANY:
+    MPC_PRIMITIVE(mpc_input_any(i, (char **)&r->output));
+  case MPC_TYPE_SINGLE:
+    MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char **)&r->output));
+  case MPC_TYPE_RANGE:
+    MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char **)&r->output));
   case MPC_TYPE_ONEOF:
+    MPC_PRIMITIVE(mpc_input_oneof(i, p->data.string.x, (char **)&r->output));
   case MPC_TYPE_NONEOF:
+    MPC_PRIMITIVE(mpc_input_noneof(i, p->data.string.x, (char **)&r->output));
+  case MPC_TYPE_SATISFY:
+    MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char **)&r->output));
   case MPC_TYPE_STRING:
-    p->data.string.x = malloc(strlen(a->data.string.x) + 1);
-    strcpy(p->data.string.x, a->data.string.x);
-    break;
-
-  case MPC_TYPE_APPLY:
-    p->data.apply.x = mpc_copy(a->data.apply.x);
-    break;
-  case MPC_TYPE_APPLY_TO:
-    p->data.apply_to.x = mpc_copy(a->data.apply_to.x);
-    break;
-  case MPC_TYPE_PREDICT:
-    p->data.predict.x = mpc_copy(a->data.predict.x);
-    break;
+    MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char **)&r->output));
+  case MPC_TYPE_ANCHOR:
+    MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char **)&r->output));
+  case MPC_TYPE_SOI:
+    MPC_PRIMITIVE(mpc_input_soi(i, (char **)&r->output));
+  case MPC_TYPE_EOI:
+    MPC_PRIMITIVE(mpc_input_eoi(i, (char **)&r->output));
 
-  case MPC_TYPE_MAYBE:
-  case MPC_TYPE_NOT:
-    p->data.not .x = mpc_copy(a->data.not .x);
-    break;
+    /* Other parsers */
 
-  case MPC_TYPE_EXPECT:
-    p->data.expect.x = mpc_copy(a->data.expect.x);
-    p->data.expect.m = malloc(strlen(a->data.expect.m) + 1);
-    strcpy(p->data.expect.m, a->data.expect.m);
-    break;
+  case MPC_TYPE_UNDEFINED:
+    MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
+  case MPC_TYPE_PASS:
+    MPC_SUCCESS(NULL);
+  case MPC_TYPE_FAIL:
+    MPC_FAILURE(mpc_err_fail(i, p->data.fail.m));
+  case MPC_TYPE_LIFT:
+    MPC_SUCCESS(p->data.lift.lf());
+  case MPC_TYPE_LIFT_VAL:
+    MPC_SUCCESS(p->data.lift.x);
+  case MPC_TYPE_STATE:
+    MPC_SUCCESS(mpc_input_state_copy(i));
 
-  case MPC_TYPE_MANY:
-  case MPC_TYPE_MANY1:
-  case MPC_TYPE_COUNT:
-    p->data.repeat.x = mpc_copy(a->data.repeat.x);
-    break;
+    /* Regex Parsers */
 
-  case MPC_TYPE_OR:
-    p->data.or.xs = malloc(a->data.or.n * sizeof(mpc_parser_t *));
-    for (i = 0; i < a->data.or.n; i++)
+  case MPC_TYPE_DFA:
+    j = mpc_input_dfa(i, p, (char **)&r->output);
+    if (j == 1)
     {
-      p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
+      MPC_SUCCESS(r->output);
     }
-    break;
-  case MPC_TYPE_AND:
-    p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t *));
-    for (i = 0; i < a->data.and.n; i++)
+    if (j == 0)
     {
-      p->data.and.xs[i] = mpc_copy(a->data.and.xs[i]);
+      MPC_FAILURE(NULL);
     }
-    p->data.and.dxs = malloc((a->data.and.n - 1) * sizeof(mpc_dtor_t));
-    for (i = 0; i < a->data.and.n - 1; i++)
+    return mpc_parse_run(i, p->data.dfa.x, r, e, depth + 1);
+
+    /* Application Parsers */
+
+  case MPC_TYPE_APPLY:
+    if (mpc_parse_run(i, p->data.apply.x, r, e, depth + 1))
     {
-      p->data.and.dxs[i] = a->data.and.dxs[i];
+      MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, r->output));
+    }
+    else
+    {
+      MPC_FAILURE(r->output);
+    }
+
+  case MPC_TYPE_APPLY_TO:
+    if (mpc_parse_run(i, p->data.apply_to.x, r, e, depth + 1))
+    {
+      MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, r->output, p->data.apply_to.d));
+    }
+    else
+    {
+      MPC_FAILURE(r->error);
     }
-    break;
 
   case MPC_TYPE_CHECK:
-    p->data.check.x = mpc_copy(a->data.check.x);
-    p->data.check.e = malloc(strlen(a->data.check.e) + 1);
-    strcpy(p->data.check.e, a->data.check.e);
-    break;
+    if (mpc_parse_run(i, p->data.check.x, r, e, depth + 1))
+    {
+      if (p->data.check.f(&r->output))
+      {
+        MPC_SUCCESS(r->output);
+      }
+      else
+      {
+        mpc_parse_dtor(i, p->data.check.dx, r->output);
+        MPC_FAILURE(mpc_err_fail(i, p->data.check.e));
+      }
+    }
+    else
+    {
+      MPC_FAILURE(r->error);
+    }
+
   case MPC_TYPE_CHECK_WITH:
-    p->data.check_with.x = mpc_copy(a->data.check_with.x);
-    p->data.check_with.e = malloc(strlen(a->data.check_with.e) + 1);
-    strcpy(p->data.check_with.e, a->data.check_with.e);
-    break;
+    if (mpc_parse_run(i, p->data.check_with.x, r, e, depth + 1))
+    {
+      if (p->data.check_with.f(&r->output, p->data.check_with.d))
+      {
+        MPC_SUCCESS(r->output);
+      }
+      else
+      {
+        mpc_parse_dtor(i, p->data.check.dx, r->output);
+        MPC_FAILURE(mpc_err_fail(i, p->data.check_with.e));
+      }
+    }
+    else
+    {
+      MPC_FAILURE(r->error);
+    }
 
-  default:
-    break;
-  }
+  case MPC_TYPE_EXPECT:
+    mpc_input_suppress_enable(i);
+    if (mpc_parse_run(i, p->data.expect.x, r, e, depth + 1))
+    {
+      mpc_input_suppress_disable(i);
+      MPC_SUCCESS(r->output);
+    }
+    else
+    {
+      mpc_input_suppress_disable(i);
+      MPC_FAILURE(mpc_err_new(i, p->data.expect.m));
+    }
 
-  return p;
-}
+  case MPC_TYPE_PREDICT:
+    mpc_input_backtrack_disable(i);
+    if (mpc_parse_run(i, p->data.predict.x, r, e, depth + 1))
+    {
+      mpc_input_backtrack_enable(i);
+      MPC_SUCCESS(r->output);
+    }
+    else
+    {
+      mpc_input_backtrack_enable(i);
+      MPC_FAILURE(r->error);
+    }
 
-mpc_parser_t *mpc_undefine(mpc_parser_t *p)
-{
-  mpc_undefine_unretained(p, 1);
-  p->type = MPC_TYPE_UNDEFINED;
-  return p;
-}
+    /* Optional Parsers */
 
-mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a)
-{
+    /* TODO: Update Not Error Message */
 
-  if (p->retained)
-  {
-    p->type = a->type;
-    p->data = a->data;
-  }
-  else
-  {
-    mpc_parser_t *a2 = mpc_failf("Attempt to assign to Unretained Parser!");
-    p->type = a2->type;
-    p->data = a2->data;
-    free(a2);
-  }
+  case MPC_TYPE_NOT:
+    mpc_input_mark(i);
+    mpc_input_suppress_enable(i);
+    if (mpc_parse_run(i, p->data.not .x, r, e, depth + 1))
+    {
+      mpc_input_rewind(i);
+      mpc_input_suppress_disable(i);
+      mpc_parse_dtor(i, p->data.not .dx, r->output);
+      MPC_FAILURE(mpc_err_new(i, "opposite"));
+    }
+    else
+    {
+      mpc_input_unmark(i);
+      mpc_input_suppress_disable(i);
+      MPC_SUCCESS(p->data.not .lf());
+    }
 
-  free(a);
-  return p;
-}
+  case MPC_TYPE_MAYBE:
+    if (mpc_parse_run(i, p->data.not .x, r, e, depth + 1))
+    {
+      MPC_SUCCESS(r->output);
+    }
+    else
+    {
+      *e = mpc_err_merge(i, *e, r->error);
+      MPC_SUCCESS(p->data.not .lf());
+    }
 
-void mpc_cleanup(int n, ...)
-{
-  int i;
-  mpc_parser_t **list = malloc(sizeof(mpc_parser_t *) * n);
+    /* Repeat Parsers */
 
-  va_list va;
-  va_start(va, n);
-  for (i = 0; i < n; i++)
-  {
-    list[i] = va_arg(va, mpc_parser_t *);
-  }
-  for (i = 0; i < n; i++)
-  {
-    mpc_undefine(list[i]);
-  }
-  for (i = 0; i < n; i++)
-  {
-    mpc_delete(list[i]);
-  }
-  va_end(va);
+  case MPC_TYPE_MANY:
 
-  free(list);
-}
+    results = results_stk;
 
-mpc_parser_t *mpc_pass(void)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_PASS;
-  return p;
-}
+    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+    {
+      j++;
+      if (j == MPC_PARSE_STACK_MIN)
+      {
+        results_slots = j + j / 2;
+        results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
+        memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
+      }
+      else if (j >= results_slots)
+      {
+        results_slots = j + j / 2;
+        results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+      }
+    }
 
-mpc_parser_t *mpc_fail(const char *m)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_FAIL;
-  p->data.fail.m = malloc(strlen(m) + 1);
-  strcpy(p->data.fail.m, m);
-  return p;
-}
+    *e = mpc_err_merge(i, *e, results[j].error);
 
-/*
-** As `snprintf` is not ANSI standard this
-** function `mpc_failf` should be considered
-** unsafe.
-**
-** You have a few options if this is going to be
-** trouble.
-**
-** - Ensure the format string does not exceed
-**   the buffer length using precision specifiers
-**   such as `%.512s`.
-**
-** - Patch this function in your code base to
-**   use `snprintf` or whatever variant your
-**   system supports.
-**
-** - Avoid it altogether.
-**
-*/
+    MPC_SUCCESS(
+        mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
+        if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
 
-mpc_parser_t *mpc_failf(const char *fmt, ...)
-{
+  case MPC_TYPE_MANY1:
 
-  va_list va;
-  char *buffer;
+    results = results_stk;
 
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_FAIL;
+    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+    {
+      j++;
+      if (j == MPC_PARSE_STACK_MIN)
+      {
+        results_slots = j + j / 2;
+        results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
+        memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
+      }
+      else if (j >= results_slots)
+      {
+        results_slots = j + j / 2;
+        results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
+      }
+    }
 
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
+    if (j == 0)
+    {
+      MPC_FAILURE(
+          mpc_err_many1(i, results[j].error);
+          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    }
+    else
+    {
 
-  buffer = realloc(buffer, strlen(buffer) + 1);
-  p->data.fail.m = buffer;
-  return p;
-}
+      *e = mpc_err_merge(i, *e, results[j].error);
 
-mpc_parser_t *mpc_lift_val(mpc_val_t *x)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_LIFT_VAL;
-  p->data.lift.x = x;
-  return p;
-}
+      MPC_SUCCESS(
+          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
+          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    }
 
-mpc_parser_t *mpc_lift(mpc_ctor_t lf)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_LIFT;
-  p->data.lift.lf = lf;
-  return p;
-}
+  case MPC_TYPE_COUNT:
 
-mpc_parser_t *mpc_anchor(int (*f)(char, char))
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ANCHOR;
-  p->data.anchor.f = f;
-  return mpc_expect(p, "anchor");
-}
+    results = p->data.repeat.n > MPC_PARSE_STACK_MIN
+                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
+                  : results_stk;
 
-mpc_parser_t *mpc_state(void)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_STATE;
-  return p;
-}
+    while (mpc_parse_run(i, p->data.repeat.x, &results[j], e, depth + 1))
+    {
+      j++;
+      if (j == p->data.repeat.n)
+      {
+        break;
+      }
+    }
 
-mpc_parser_t *mpc_expect(mpc_parser_t *a, const char *expected)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_EXPECT;
-  p->data.expect.x = a;
-  p->data.expect.m = malloc(strlen(expected) + 1);
-  strcpy(p->data.expect.m, expected);
-  return p;
-}
+    if (j == p->data.repeat.n)
+    {
+      MPC_SUCCESS(
+          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t **)results);
+          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    }
+    else
+    {
+      for (k = 0; k < j; k++)
+      {
+        mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
+      }
+      MPC_FAILURE(
+          mpc_err_count(i, results[j].error, p->data.repeat.n);
+          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    }
 
-/*
-** As `snprintf` is not ANSI standard this
-** function `mpc_expectf` should be considered
-** unsafe.
-**
-** You have a few options if this is going to be
-** trouble.
-**
-** - Ensure the format string does not exceed
-**   the buffer length using precision specifiers
-**   such as `%.512s`.
-**
-** - Patch this function in your code base to
-**   use `snprintf` or whatever variant your
-**   system supports.
-**
-** - Avoid it altogether.
-**
-*/
+    /* Combinatory Parsers */
 
-mpc_parser_t *mpc_expectf(mpc_parser_t *a, const char *fmt, ...)
-{
-  va_list va;
-  char *buffer;
+  case MPC_TYPE_OR:
 
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_EXPECT;
+    if (p->data.or.n == 0)
+    {
+      MPC_SUCCESS(NULL);
+    }
 
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
+    results = p->data.or.n > MPC_PARSE_STACK_MIN
+                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
+                  : results_stk;
 
-  buffer = realloc(buffer, strlen(buffer) + 1);
-  p->data.expect.x = a;
-  p->data.expect.m = buffer;
-  return p;
+    for (j = 0; j < p->data.or.n; j++)
+    {
+      if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e, depth + 1))
+      {
+        MPC_SUCCESS(results[j].output;
+                    if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      }
+      else
+      {
+        *e = mpc_err_merge(i, *e, results[j].error);
+      }
+    }
+
+    MPC_FAILURE(NULL;
+                if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+
+  case MPC_TYPE_AND:
+
+    if (p->data.and.n == 0)
+    {
+      MPC_SUCCESS(NULL);
+    }
+
+    results = p->data.or.n > MPC_PARSE_STACK_MIN
+                  ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
+                  : results_stk;
+
+    mpc_input_mark(i);
+    for (j = 0; j < p->data.and.n; j++)
+    {
+      if (!mpc_parse_run(i, p->data.and.xs[j], &results[j], e, depth + 1))
+      {
+        mpc_input_rewind(i);
+        for (k = 0; k < j; k++)
+        {
+          mpc_parse_dtor(i, p->data.and.dxs[k], results[k].output);
+        }
+        MPC_FAILURE(results[j].error;
+                    if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+      }
+    }
+    mpc_input_unmark(i);
+    MPC_SUCCESS(
+        mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t **)results);
+        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+
+    /* End */
+
+  default:
+
+    MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
+  }
+
+  return 0;
 }
 
+#undef MPC_SUCCESS
+#undef MPC_FAILURE
+#undef MPC_PRIMITIVE
+
 /*
-** Basic Parsers
+** Packrat Memoization
+**
+** Parsers with `memo` set (the rules of a grammar
+** built with MPCA_LANG_PACKRAT) record what they
+** did at each position, so backtracking into the
+** same rule at the same position is a lookup
+** instead of a parse. Outputs are assumed to be
+** `mpc_ast_t` and are copied in and out of the
+** table. The table lasts for one `mpc_parse_input`
+** and only String and File inputs, which can seek,
+** use it.
 */
 
-mpc_parser_t *mpc_any(void)
+static mpc_err_t *mpc_err_copy(mpc_err_t *x)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ANY;
-  return mpc_expect(p, "any character");
-}
+  int j;
+  mpc_err_t *y;
 
-mpc_parser_t *mpc_char(char c)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_SINGLE;
-  p->data.single.x = c;
-  return mpc_expectf(p, "'%c'", c);
+  if (x == NULL)
+  {
+    return NULL;
+  }
+
+  y = malloc(sizeof(mpc_err_t));
+  *y = *x;
+  y->filename = malloc(strlen(x->filename) + 1);
+  strcpy(y->filename, x->filename);
+  if (x->failure)
+  {
+    y->failure = malloc(strlen(x->failure) + 1);
+    strcpy(y->failure, x->failure);
+  }
+  y->expected = x->expected_num ? malloc(sizeof(char *) * x->expected_num) : NULL;
+  for (j = 0; j < x->expected_num; j++)
+  {
+    y->expected[j] = malloc(strlen(x->expected[j]) + 1);
+    strcpy(y->expected[j], x->expected[j]);
+  }
+  return y;
 }
 
-mpc_parser_t *mpc_range(char s, char e)
+static size_t mpc_memo_hash(mpc_parser_t *p, long pos, int suppress)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_RANGE;
-  p->data.range.x = s;
-  p->data.range.y = e;
-  return mpc_expectf(p, "character between '%c' and '%c'", s, e);
+  return ((size_t)p >> 4) * 31 + (size_t)pos * 2 + (size_t)suppress;
 }
 
-mpc_parser_t *mpc_oneof(const char *s)
+static mpc_memo_t *mpc_memo_find(mpc_input_t *i, mpc_parser_t *p)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_ONEOF;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "one of '%s'", s);
+  mpc_memo_t *m;
+  int suppress = i->suppress != 0;
+
+  if (!i->memo)
+  {
+    return NULL;
+  }
+
+  m = i->memo[mpc_memo_hash(p, i->state.pos, suppress) & (i->memo_slots - 1)];
+  while (m && (m->parser != p || m->pos != i->state.pos || m->suppress != suppress))
+  {
+    m = m->next;
+  }
+  return m;
 }
 
-mpc_parser_t *mpc_noneof(const char *s)
+static void mpc_memo_link(mpc_input_t *i, mpc_memo_t *m)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_NONEOF;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "none of '%s'", s);
+  size_t h = mpc_memo_hash(m->parser, m->pos, m->suppress) & (i->memo_slots - 1);
+  m->next = i->memo[h];
+  i->memo[h] = m;
 }
 
-mpc_parser_t *mpc_satisfy(int (*f)(char))
+static mpc_memo_t *mpc_memo_add(mpc_input_t *i, mpc_parser_t *p, long pos, int suppress)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_SATISFY;
-  p->data.satisfy.f = f;
-  return mpc_expectf(p, "character satisfying function %p", f);
+  int j;
+  mpc_memo_t *m;
+  mpc_memo_block_t *b;
+
+  /* Keep about one entry per slot */
+  if (i->memo_num >= i->memo_slots)
+  {
+    free(i->memo);
+    i->memo_slots = i->memo_slots ? i->memo_slots * 2 : 256;
+    i->memo = calloc(i->memo_slots, sizeof(mpc_memo_t *));
+    for (b = i->memo_blocks; b; b = b->next)
+    {
+      for (j = 0; j < b->used; j++)
+      {
+        mpc_memo_link(i, &b->items[j]);
+      }
+    }
+  }
+
+  if (!i->memo_blocks || i->memo_blocks->used == MPC_MEMO_BLOCK)
+  {
+    b = malloc(sizeof(mpc_memo_block_t));
+    b->next = i->memo_blocks;
+    b->used = 0;
+    i->memo_blocks = b;
+  }
+
+  m = &i->memo_blocks->items[i->memo_blocks->used++];
+  m->parser = p;
+  m->pos = pos;
+  m->suppress = suppress;
+  mpc_memo_link(i, m);
+  i->memo_num++;
+  return m;
 }
 
-mpc_parser_t *mpc_string(const char *s)
+static void mpc_memo_clear(mpc_input_t *i)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_STRING;
-  p->data.string.x = malloc(strlen(s) + 1);
-  strcpy(p->data.string.x, s);
-  return mpc_expectf(p, "\"%s\"", s);
-}
-
-/*
-** Core Parsers
-*/
-
-mpc_parser_t *mpc_apply(mpc_parser_t *a, mpc_apply_t f)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_APPLY;
-  p->data.apply.x = a;
-  p->data.apply.f = f;
-  return p;
-}
+  int j;
+  mpc_memo_block_t *b;
 
-mpc_parser_t *mpc_apply_to(mpc_parser_t *a, mpc_apply_to_t f, void *x)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_APPLY_TO;
-  p->data.apply_to.x = a;
-  p->data.apply_to.f = f;
-  p->data.apply_to.d = x;
-  return p;
-}
+  while (i->memo_blocks)
+  {
+    b = i->memo_blocks;
+    for (j = 0; j < b->used; j++)
+    {
+      mpc_ast_delete(b->items[j].output);
+      if (b->items[j].error)
+      {
+        mpc_err_delete(b->items[j].error);
+      }
+      if (b->items[j].merged)
+      {
+        mpc_err_delete(b->items[j].merged);
+      }
+    }
+    i->memo_blocks = b->next;
+    free(b);
+  }
 
-mpc_parser_t *mpc_check(mpc_parser_t *a, mpc_dtor_t da, mpc_check_t f, const char *e)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_CHECK;
-  p->data.check.x = a;
-  p->data.check.dx = da;
-  p->data.check.f = f;
-  p->data.check.e = malloc(strlen(e) + 1);
-  strcpy(p->data.check.e, e);
-  return p;
+  free(i->memo);
+  i->memo = NULL;
+  i->memo_slots = 0;
+  i->memo_num = 0;
 }
 
-mpc_parser_t *mpc_check_with(mpc_parser_t *a, mpc_dtor_t da, mpc_check_with_t f, void *x, const char *e)
+static int mpc_parse_memo(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_CHECK_WITH;
-  p->data.check_with.x = a;
-  p->data.check_with.dx = da;
-  p->data.check_with.f = f;
-  p->data.check_with.d = x;
-  p->data.check_with.e = malloc(strlen(e) + 1);
-  strcpy(p->data.check_with.e, e);
-  return p;
-}
+  int x;
+  long pos = i->state.pos;
+  mpc_err_t *f = NULL;
+  mpc_memo_t *m = mpc_memo_find(i, p);
 
-mpc_parser_t *mpc_checkf(mpc_parser_t *a, mpc_dtor_t da, mpc_check_t f, const char *fmt, ...)
-{
-  va_list va;
-  char *buffer;
-  mpc_parser_t *p;
+  if (m)
+  {
+    if (m->success)
+    {
+      i->state = m->state;
+      i->last = m->last;
+      if (i->type == MPC_INPUT_FILE)
+      {
+        fseek(i->file, i->state.pos, SEEK_SET);
+      }
+      r->output = mpc_ast_copy(m->output);
+    }
+    else
+    {
+      r->error = mpc_err_copy(m->error);
+    }
+    *e = mpc_err_merge(i, *e, mpc_err_copy(m->merged));
+    return m->success;
+  }
 
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
+  /* Errors merged inside `p` are collected apart so they can be replayed */
+  x = mpc_parse_node(i, p, r, &f, depth);
 
-  p = mpc_check(a, da, f, buffer);
-  free(buffer);
+  m = mpc_memo_add(i, p, pos, i->suppress != 0);
+  m->success = x;
+  m->state = i->state;
+  m->last = i->last;
+  m->output = x ? mpc_ast_copy(r->output) : NULL;
+  m->error = x ? NULL : mpc_err_copy(r->error);
+  m->merged = mpc_err_copy(f);
 
-  return p;
+  *e = mpc_err_merge(i, *e, f);
+  return x;
 }
 
-mpc_parser_t *mpc_check_withf(mpc_parser_t *a, mpc_dtor_t da, mpc_check_with_t f, void *x, const char *fmt, ...)
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e, int depth)
 {
-  va_list va;
-  char *buffer;
-  mpc_parser_t *p;
-
-  va_start(va, fmt);
-  buffer = malloc(2048);
-  vsprintf(buffer, fmt, va);
-  va_end(va);
-
-  p = mpc_check_with(a, da, f, x, buffer);
-  free(buffer);
-
-  return p;
+  if (p->memo && i->backtrack > 0 && (i->type == MPC_INPUT_STRING || i->type == MPC_INPUT_FILE))
+  {
+    return mpc_parse_memo(i, p, r, e, depth);
+  }
+  return mpc_parse_node(i, p, r, e, depth);
 }
 
-mpc_parser_t *mpc_predictive(mpc_parser_t *a)
+int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_PREDICT;
-  p->data.predict.x = a;
-  return p;
-}
+  int x;
+  char last = i->last;
+  mpc_state_t state = i->state;
+  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
+  e->state = mpc_state_invalid();
+  i->inexact = 0;
+  x = mpc_parse_run(i, p, r, &e, 0);
+  mpc_memo_clear(i);
 
-mpc_parser_t *mpc_not_lift(mpc_parser_t *a, mpc_dtor_t da, mpc_ctor_t lf)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_NOT;
-  p->data.not .x = a;
-  p->data.not .dx = da;
-  p->data.not .lf = lf;
-  return p;
+  /* Regex DFAs don't report what they expected, so get the error from their combinators */
+  if (!x && i->inexact)
+  {
+    mpc_err_delete_internal(i, mpc_err_merge(i, e, r->error));
+    i->state = state;
+    i->last = last;
+    i->exact = 1;
+    e = mpc_err_fail(i, "Unknown Error");
+    e->state = mpc_state_invalid();
+    x = mpc_parse_run(i, p, r, &e, 0);
+    mpc_memo_clear(i);
+    i->exact = 0;
+  }
+  if (x)
+  {
+    mpc_err_delete_internal(i, e);
+    r->output = mpc_export(i, r->output);
+  }
+  else
+  {
+    r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
+  }
+  return x;
 }
 
-mpc_parser_t *mpc_not(mpc_parser_t *a, mpc_dtor_t da)
+int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r)
 {
-  return mpc_not_lift(a, da, mpcf_ctor_null);
+  int x;
+  mpc_input_t *i = mpc_input_new_string(filename, string);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
 }
 
-mpc_parser_t *mpc_maybe_lift(mpc_parser_t *a, mpc_ctor_t lf)
+int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MAYBE;
-  p->data.not .x = a;
-  p->data.not .lf = lf;
-  return p;
+  int x;
+  mpc_input_t *i = mpc_input_new_nstring(filename, string, length);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
 }
 
-mpc_parser_t *mpc_maybe(mpc_parser_t *a)
+int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r)
 {
-  return mpc_maybe_lift(a, mpcf_ctor_null);
-}
+  int x;
+  mpc_input_t *i = mpc_input_new_mmap(filename, file);
 
-mpc_parser_t *mpc_many(mpc_fold_t f, mpc_parser_t *a)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MANY;
-  p->data.repeat.x = a;
-  p->data.repeat.f = f;
-  return p;
-}
+  if (i)
+  {
+    x = mpc_parse_input(i, p, r);
+    /* Leave the file where the parse stopped, as reading it would */
+    fseek(file, (long)(i->string - i->map) + i->state.pos, SEEK_SET);
+    mpc_input_delete(i);
+    return x;
+  }
 
-mpc_parser_t *mpc_many1(mpc_fold_t f, mpc_parser_t *a)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_MANY1;
-  p->data.repeat.x = a;
-  p->data.repeat.f = f;
-  return p;
+  i = mpc_input_new_file(filename, file);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
 }
 
-mpc_parser_t *mpc_count(int n, mpc_fold_t f, mpc_parser_t *a, mpc_dtor_t da)
+int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_COUNT;
-  p->data.repeat.n = n;
-  p->data.repeat.f = f;
-  p->data.repeat.x = a;
-  p->data.repeat.dx = da;
-  return p;
+  int x;
+  mpc_input_t *i = mpc_input_new_pipe(filename, pipe);
+  x = mpc_parse_input(i, p, r);
+  mpc_input_delete(i);
+  return x;
 }
 
-mpc_parser_t *mpc_or(int n, ...)
+int mpc_parse_stream(const char *filename, FILE *file, mpc_parser_t *p, mpc_dtor_t da,
+                     mpc_stream_t f, void *d, mpc_result_t *r)
 {
+  int x = 1;
+  int eof = 0;
+  mpc_state_t s;
+  char last;
+  mpc_input_t *i = mpc_input_new_stream(filename, file);
 
-  int i;
-  va_list va;
-
-  mpc_parser_t *p = mpc_undefined();
-
-  p->type = MPC_TYPE_OR;
-  p->data.or.n = n;
-  p->data.or.xs = malloc(sizeof(mpc_parser_t *) * n);
-
-  va_start(va, n);
-  for (i = 0; i < n; i++)
+  while (1)
   {
-    p->data.or.xs[i] = va_arg(va, mpc_parser_t *);
-  }
-  va_end(va);
 
-  return p;
-}
+    mpc_input_stream_compact(i);
 
-mpc_parser_t *mpc_and(int n, mpc_fold_t f, ...)
-{
+    /* Nothing left to parse */
+    if (i->state.pos - i->offset == i->length)
+    {
+      if (eof)
+      {
+        x = 1;
+        break;
+      }
+      eof = !mpc_input_stream_fill(i);
+      continue;
+    }
 
-  int i;
-  va_list va;
+    s = i->state;
+    last = i->last;
+    i->starved = 0;
+    x = mpc_parse_input(i, p, r);
 
-  mpc_parser_t *p = mpc_undefined();
+    /* The result might change with more input, so parse it again once there is more */
+    if (i->starved && !eof)
+    {
+      if (x)
+      {
+        da(r->output);
+      }
+      else
+      {
+        mpc_err_delete(r->error);
+      }
+      i->state = s;
+      i->last = last;
 
-  p->type = MPC_TYPE_AND;
-  p->data.and.n = n;
-  p->data.and.f = f;
-  p->data.and.xs = malloc(sizeof(mpc_parser_t *) * n);
-  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n - 1));
+      /* Each retry parses the form from its start again, so once the form is
+         large read at least as much again as is pending. This keeps long
+         multi-line forms linear, while short forms still wait for one line */
+      {
+        long pending = i->offset + i->length - s.pos;
+        long target = i->length + (pending >= MPC_INPUT_STREAM_GROW_MIN ? pending : 1);
+        while (!eof && i->length < target)
+        {
+          eof = !mpc_input_stream_fill(i);
+        }
+      }
+      continue;
+    }
 
-  va_start(va, f);
-  for (i = 0; i < n; i++)
-  {
-    p->data.and.xs[i] = va_arg(va, mpc_parser_t *);
+    if (!x)
+    {
+      break;
+    }
+
+    /* A parser that consumes nothing would match forever */
+    if (!f(r->output, d) || i->state.pos == s.pos)
+    {
+      break;
+    }
   }
-  for (i = 0; i < (n - 1); i++)
+
+  if (x)
   {
-    p->data.and.dxs[i] = va_arg(va, mpc_dtor_t);
+    r->output = NULL;
   }
-  va_end(va);
-
-  return p;
+  mpc_input_delete(i);
+  return x;
+}
+
+int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r)
+{
+
+  FILE *f = fopen(filename, "rb");
+  int res;
+
+  if (f == NULL)
+  {
+    r->output = NULL;
+    r->error = mpc_err_file(filename, "Unable to open file!");
+    return 0;
+  }
+
+  res = mpc_parse_file(filename, f, p, r);
+  fclose(f);
+  return res;
 }
 
 /*
-** Common Parsers
+** Building a Parser
 */
 
-mpc_parser_t *mpc_soi(void)
-{
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_SOI;
-  return mpc_expect(p, "start of input");
-}
+static void mpc_undefine_unretained(mpc_parser_t *p, int force);
 
-mpc_parser_t *mpc_eoi(void)
+static void mpc_undefine_or(mpc_parser_t *p)
 {
-  mpc_parser_t *p = mpc_undefined();
-  p->type = MPC_TYPE_EOI;
-  return mpc_expect(p, "end of input");
-}
 
-static int mpc_boundary_anchor(char prev, char next)
-{
-  const char *word = "abcdefghijklmnopqrstuvwxyz"
-                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                     "0123456789_";
-  if (strchr(word, next) && prev == '\0')
-  {
-    return 1;
-  }
-  if (strchr(word, prev) && next == '\0')
-  {
-    return 1;
-  }
-  if (strchr(word, next) && !strchr(word, prev))
+  int i;
+  for (i = 0; i < p->data.or.n; i++)
   {
-    return 1;
+    mpc_undefine_unretained(p->data.or.xs[i], 0);
   }
-  if (!strchr(word, next) && strchr(word, prev))
+  free(p->data.or.xs);
+}
+
+static void mpc_undefine_and(mpc_parser_t *p)
+{
+
+  int i;
+  for (i = 0; i < p->data.and.n; i++)
   {
-    return 1;
+    mpc_undefine_unretained(p->data.and.xs[i], 0);
   }
-  return 0;
+  free(p->data.and.xs);
+  free(p->data.and.dxs);
 }
 
-static int mpc_boundary_newline_anchor(char prev, char next)
+static void mpc_undefine_unretained(mpc_parser_t *p, int force)
 {
-  (void)next;
-  return prev == '\n';
-}
 
-mpc_parser_t *mpc_boundary(void) { return mpc_expect(mpc_anchor(mpc_boundary_anchor), "word boundary"); }
-mpc_parser_t *mpc_boundary_newline(void) { return mpc_expect(mpc_anchor(mpc_boundary_newline_anchor), "start of newline"); }
+  if (p->retained && !force)
+  {
+    return;
+  }
 
-mpc_parser_t *mpc_whitespace(void) { return mpc_expect(mpc_oneof(" \f\n\r\t\v"), "whitespace"); }
-mpc_parser_t *mpc_whitespaces(void) { return mpc_expect(mpc_many(mpcf_strfold, mpc_whitespace()), "spaces"); }
-mpc_parser_t *mpc_blank(void) { return mpc_expect(mpc_apply(mpc_whitespaces(), mpcf_free), "whitespace"); }
+  switch (p->type)
+  {
 
-mpc_parser_t *mpc_newline(void) { return mpc_expect(mpc_char('\n'), "newline"); }
-mpc_parser_t *mpc_tab(void) { return mpc_expect(mpc_char('\t'), "tab"); }
-mpc_parser_t *mpc_escape(void) { return mpc_and(2, mpcf_strfold, mpc_char('\\'), mpc_any(), free); }
+  case MPC_TYPE_FAIL:
+    free(p->data.fail.m);
+    break;
 
-mpc_parser_t *mpc_digit(void) { return mpc_expect(mpc_oneof("0123456789"), "digit"); }
-mpc_parser_t *mpc_hexdigit(void) { return mpc_expect(mpc_oneof("0123456789ABCDEFabcdef"), "hex digit"); }
-mpc_parser_t *mpc_octdigit(void) { return mpc_expect(mpc_oneof("01234567"), "oct digit"); }
-mpc_parser_t *mpc_digits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_digit()), "digits"); }
-mpc_parser_t *mpc_hexdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_hexdigit()), "hex digits"); }
-mpc_parser_t *mpc_octdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_octdigit()), "oct digits"); }
+  case MPC_TYPE_ONEOF:
+  case MPC_TYPE_NONEOF:
+  case MPC_TYPE_STRING:
+    free(p->data.string.x);
+    break;
 
-mpc_parser_t *mpc_lower(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyz"), "lowercase letter"); }
-mpc_parser_t *mpc_upper(void) { return mpc_expect(mpc_oneof("ABCDEFGHIJKLMNOPQRSTUVWXYZ"), "uppercase letter"); }
-mpc_parser_t *mpc_alpha(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"), "letter"); }
-mpc_parser_t *mpc_underscore(void) { return mpc_expect(mpc_char('_'), "underscore"); }
-mpc_parser_t *mpc_alphanum(void) { return mpc_expect(mpc_or(3, mpc_alpha(), mpc_digit(), mpc_underscore()), "alphanumeric"); }
+  case MPC_TYPE_APPLY:
+    mpc_undefine_unretained(p->data.apply.x, 0);
+    break;
+  case MPC_TYPE_APPLY_TO:
+    mpc_undefine_unretained(p->data.apply_to.x, 0);
+    break;
+  case MPC_TYPE_PREDICT:
+    mpc_undefine_unretained(p->data.predict.x, 0);
+    break;
+  case MPC_TYPE_DFA:
+    mpc_undefine_unretained(p->data.dfa.x, 0);
+    mpc_dfa_delete(p->data.dfa.d);
+    break;
 
-mpc_parser_t *mpc_int(void) { return mpc_expect(mpc_apply(mpc_digits(), mpcf_int), "integer"); }
-mpc_parser_t *mpc_hex(void) { return mpc_expect(mpc_apply(mpc_hexdigits(), mpcf_hex), "hexadecimal"); }
-mpc_parser_t *mpc_oct(void) { return mpc_expect(mpc_apply(mpc_octdigits(), mpcf_oct), "octadecimal"); }
-mpc_parser_t *mpc_number(void) { return mpc_expect(mpc_or(3, mpc_int(), mpc_hex(), mpc_oct()), "number"); }
+  case MPC_TYPE_MAYBE:
+  case MPC_TYPE_NOT:
+    mpc_undefine_unretained(p->data.not .x, 0);
+    break;
 
-mpc_parser_t *mpc_real(void)
-{
+  case MPC_TYPE_EXPECT:
+    mpc_undefine_unretained(p->data.expect.x, 0);
+    free(p->data.expect.m);
+    break;
 
-  /* [+-]?\d+(\.\d+)?([eE][+-]?[0-9]+)? */
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+  case MPC_TYPE_COUNT:
+    mpc_undefine_unretained(p->data.repeat.x, 0);
+    break;
 
-  mpc_parser_t *p0, *p1, *p2, *p30, *p31, *p32, *p3;
+  case MPC_TYPE_OR:
+    mpc_undefine_or(p);
+    break;
+  case MPC_TYPE_AND:
+    mpc_undefine_and(p);
+    break;
 
-  p0 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
-  p1 = mpc_digits();
-  p2 = mpc_maybe_lift(mpc_and(2, mpcf_strfold, mpc_char('.'), mpc_digits(), free), mpcf_ctor_str);
-  p30 = mpc_oneof("eE");
-  p31 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
-  p32 = mpc_digits();
-  p3 = mpc_maybe_lift(mpc_and(3, mpcf_strfold, p30, p31, p32, free, free), mpcf_ctor_str);
+  case MPC_TYPE_CHECK:
+    mpc_undefine_unretained(p->data.check.x, 0);
+    free(p->data.check.e);
+    break;
 
-  return mpc_expect(mpc_and(4, mpcf_strfold, p0, p1, p2, p3, free, free, free), "real");
+  case MPC_TYPE_CHECK_WITH:
+    mpc_undefine_unretained(p->data.check_with.x, 0);
+    free(p->data.check_with.e);
+    break;
+
+  default:
+    break;
+  }
+
+  if (!force)
+  {
+    free(p->name);
+    free(p);
+  }
 }
 
-mpc_parser_t *mpc_float(void)
+void mpc_delete(mpc_parser_t *p)
 {
-  return mpc_expect(mpc_apply(mpc_real(), mpcf_float), "float");
+  if (p->retained)
+  {
+
+    if (p->type != MPC_TYPE_UNDEFINED)
+    {
+      mpc_undefine_unretained(p, 0);
+    }
+
+    free(p->name);
+    free(p);
+  }
+  else
+  {
+    mpc_undefine_unretained(p, 0);
+  }
 }
 
-mpc_parser_t *mpc_char_lit(void)
+static void mpc_soft_delete(mpc_val_t *x)
 {
-  return mpc_expect(mpc_between(mpc_or(2, mpc_escape(), mpc_any()), free, "'", "'"), "char");
+  mpc_undefine_unretained(x, 0);
 }
 
-mpc_parser_t *mpc_string_lit(void)
+static mpc_parser_t *mpc_undefined(void)
 {
-  mpc_parser_t *strchar = mpc_or(2, mpc_escape(), mpc_noneof("\""));
-  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, strchar), free, "\"", "\""), "string");
+  mpc_parser_t *p = calloc(1, sizeof(mpc_parser_t));
+  p->retained = 0;
+  p->type = MPC_TYPE_UNDEFINED;
+  p->name = NULL;
+  return p;
 }
 
-mpc_parser_t *mpc_regex_lit(void)
+mpc_parser_t *mpc_new(const char *name)
 {
-  mpc_parser_t *regexchar = mpc_or(2, mpc_escape(), mpc_noneof("/"));
-  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, regexchar), free, "/", "/"), "regex");
+  mpc_parser_t *p = mpc_undefined();
+  p->retained = 1;
+  p->name = realloc(p->name, strlen(name) + 1);
+  strcpy(p->name, name);
+  return p;
 }
 
-mpc_parser_t *mpc_ident(void)
+mpc_parser_t *mpc_copy(mpc_parser_t *a)
 {
-  mpc_parser_t *p0, *p1;
-  p0 = mpc_or(2, mpc_alpha(), mpc_underscore());
-  p1 = mpc_many(mpcf_strfold, mpc_alphanum());
-  return mpc_and(2, mpcf_strfold, p0, p1, free);
-}
+  int i = 0;
+  mpc_parser_t *p;
 
-/*
-** Useful Parsers
-*/
+  if (a->retained)
+  {
+    return a;
+  }
 
-mpc_parser_t *mpc_startwith(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_soi(), a, mpcf_dtor_null); }
-mpc_parser_t *mpc_endwith(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(2, mpcf_fst, a, mpc_eoi(), da); }
-mpc_parser_t *mpc_whole(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(3, mpcf_snd, mpc_soi(), a, mpc_eoi(), mpcf_dtor_null, da); }
+  p = mpc_undefined();
+  p->retained = a->retained;
+  p->type = a->type;
+  p->data = a->data;
+  p->memo = a->memo;
+  p->tag_id = a->tag_id;
 
-mpc_parser_t *mpc_stripl(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_blank(), a, mpcf_dtor_null); }
-mpc_parser_t *mpc_stripr(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
-mpc_parser_t *mpc_strip(mpc_parser_t *a) { return mpc_and(3, mpcf_snd, mpc_blank(), a, mpc_blank(), mpcf_dtor_null, mpcf_dtor_null); }
-mpc_parser_t *mpc_tok(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
-mpc_parser_t *mpc_sym(const char *s) { return mpc_tok(mpc_string(s)); }
+  if (a->name)
+  {
+    p->name = malloc(strlen(a->name) + 1);
+    strcpy(p->name, a->name);
+  }
 
-mpc_parser_t *mpc_total(mpc_parser_t *a, mpc_dtor_t da) { return mpc_whole(mpc_strip(a), da); }
+  switch (a->type)
+  {
 
-mpc_parser_t *mpc_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c)
-{
-  return mpc_and(3, mpcf_snd_free,
-                 mpc_string(o), a, mpc_string(c),
-                 free, ad);
-}
+  case MPC_TYPE_FAIL:
+    p->data.fail.m = malloc(strlen(a->data.fail.m) + 1);
+    strcpy(p->data.fail.m, a->data.fail.m);
+    break;
 
-mpc_parser_t *mpc_parens(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "(", ")"); }
-mpc_parser_t *mpc_braces(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "<", ">"); }
-mpc_parser_t *mpc_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "{", "}"); }
-mpc_parser_t *mpc_squares(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "[", "]"); }
+  case MPC_TYPE_ONEOF:
+  case MPC_TYPE_NONEOF:
+  case MPC_TYPE_STRING:
+    p->data.string.x = malloc(strlen(a->data.string.x) + 1);
+    strcpy(p->data.string.x, a->data.string.x);
+    break;
 
-mpc_parser_t *mpc_tok_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c)
-{
-  return mpc_and(3, mpcf_snd_free,
-                 mpc_sym(o), mpc_tok(a), mpc_sym(c),
-                 free, ad);
-}
+  case MPC_TYPE_APPLY:
+    p->data.apply.x = mpc_copy(a->data.apply.x);
+    break;
+  case MPC_TYPE_APPLY_TO:
+    p->data.apply_to.x = mpc_copy(a->data.apply_to.x);
+    break;
+  case MPC_TYPE_PREDICT:
+    p->data.predict.x = mpc_copy(a->data.predict.x);
+    break;
+  case MPC_TYPE_DFA:
+    p->data.dfa.x = mpc_copy(a->data.dfa.x);
+    p->data.dfa.d = NULL;
+    break;
 
-mpc_parser_t *mpc_tok_parens(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "(", ")"); }
-mpc_parser_t *mpc_tok_braces(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "<", ">"); }
-mpc_parser_t *mpc_tok_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "{", "}"); }
-mpc_parser_t *mpc_tok_squares(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "[", "]"); }
+  case MPC_TYPE_MAYBE:
+  case MPC_TYPE_NOT:
+    p->data.not .x = mpc_copy(a->data.not .x);
+    break;
 
-/*
-** Regular Expression Parsers
-*/
+  case MPC_TYPE_EXPECT:
+    p->data.expect.x = mpc_copy(a->data.expect.x);
+    p->data.expect.m = malloc(strlen(a->data.expect.m) + 1);
+    strcpy(p->data.expect.m, a->data.expect.m);
+    break;
 
-/*
-** So here is a cute bootstrapping.
-**
-** I'm using the previously defined
-** mpc constructs and functions to
-** parse the user regex string and
-** construct a parser from it.
-**
-** As it turns out lots of the standard
-** mpc functions look a lot like `fold`
-** functions and so can be used indirectly
-** by many of the parsing functions to build
-** a parser directly - as we are parsing.
-**
-** This is certainly something that
-** would be less elegant/interesting
-** in a two-phase parser which first
-** builds an AST and then traverses it
-** to generate the object.
-**
-** This whole thing acts as a great
-** case study for how trivial it can be
-** to write a great parser in a few
-** lines of code using mpc.
-*/
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+  case MPC_TYPE_COUNT:
+    p->data.repeat.x = mpc_copy(a->data.repeat.x);
+    break;
 
-/*
-**
-**  ### Regular Expression Grammar
-**
-**      <regex> : <term> | (<term> "|" <regex>)
-**
-**      <term> : <factor>*
-**
-**      <factor> : <base>
-**               | <base> "*"
-**               | <base> "+"
-**               | <base> "?"
-**               | <base> "{" <digits> "}"
-**
-**      <base> : <char>
-**             | "\" <char>
-**             | "(" <regex> ")"
-**             | "[" <range> "]"
-*/
+  case MPC_TYPE_OR:
+    p->data.or.xs = malloc(a->data.or.n * sizeof(mpc_parser_t *));
+    for (i = 0; i < a->data.or.n; i++)
+    {
+      p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
+    }
+    break;
+  case MPC_TYPE_AND:
+    p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t *));
+    for (i = 0; i < a->data.and.n; i++)
+    {
+      p->data.and.xs[i] = mpc_copy(a->data.and.xs[i]);
+    }
+    p->data.and.dxs = malloc((a->data.and.n - 1) * sizeof(mpc_dtor_t));
+    for (i = 0; i < a->data.and.n - 1; i++)
+    {
+      p->data.and.dxs[i] = a->data.and.dxs[i];
+    }
+    break;
 
-static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs)
+  case MPC_TYPE_CHECK:
+    p->data.check.x = mpc_copy(a->data.check.x);
+    p->data.check.e = malloc(strlen(a->data.check.e) + 1);
+    strcpy(p->data.check.e, a->data.check.e);
+    break;
+  case MPC_TYPE_CHECK_WITH:
+    p->data.check_with.x = mpc_copy(a->data.check_with.x);
+    p->data.check_with.e = malloc(strlen(a->data.check_with.e) + 1);
+    strcpy(p->data.check_with.e, a->data.check_with.e);
+    break;
+
+  default:
+    break;
+  }
+
+  return p;
+}
+
+mpc_parser_t *mpc_undefine(mpc_parser_t *p)
 {
-  (void)n;
-  if (xs[1] == NULL)
+  mpc_undefine_unretained(p, 1);
+  p->type = MPC_TYPE_UNDEFINED;
+  return p;
+}
+
+mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a)
+{
+
+  if (p->retained)
   {
-    return xs[0];
+    p->type = a->type;
+    p->data = a->data;
   }
   else
   {
-    return mpc_or(2, xs[0], xs[1]);
+    mpc_parser_t *a2 = mpc_failf("Attempt to assign to Unretained Parser!");
+    p->type = a2->type;
+    p->data = a2->data;
+    free(a2);
   }
+
+  free(a);
+  return p;
 }
 
-static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs)
+void mpc_cleanup(int n, ...)
 {
   int i;
-  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
+  mpc_parser_t **list = malloc(sizeof(mpc_parser_t *) * n);
+
+  va_list va;
+  va_start(va, n);
   for (i = 0; i < n; i++)
   {
-    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
+    list[i] = va_arg(va, mpc_parser_t *);
   }
-  return p;
-}
-
-static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs)
-{
-  int num;
-  (void)n;
-  if (xs[1] == NULL)
+  for (i = 0; i < n; i++)
   {
-    return xs[0];
+    mpc_undefine(list[i]);
   }
-  switch (((char *)xs[1])[0])
-  {
-  case '*':
-  {
-    free(xs[1]);
-    return mpc_many(mpcf_strfold, xs[0]);
-  };
-  break;
-  case '+':
-  {
-    free(xs[1]);
-    return mpc_many1(mpcf_strfold, xs[0]);
-  };
-  break;
-  case '?':
+  for (i = 0; i < n; i++)
   {
-    free(xs[1]);
-    return mpc_maybe_lift(xs[0], mpcf_ctor_str);
-  };
-  break;
-  default:
-    num = *(int *)xs[1];
-    free(xs[1]);
+    mpc_delete(list[i]);
   }
+  va_end(va);
 
-  return mpc_count(num, mpcf_strfold, xs[0], free);
+  free(list);
 }
 
-static mpc_parser_t *mpc_re_escape_char(char c)
+mpc_parser_t *mpc_pass(void)
 {
-  switch (c)
-  {
-  case 'a':
-    return mpc_char('\a');
-  case 'f':
-    return mpc_char('\f');
-  case 'n':
-    return mpc_char('\n');
-  case 'r':
-    return mpc_char('\r');
-  case 't':
-    return mpc_char('\t');
-  case 'v':
-    return mpc_char('\v');
-  case 'b':
-    return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
-  case 'B':
-    return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
-  case 'A':
-    return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
-  case 'Z':
-    return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
-  case 'd':
-    return mpc_digit();
-  case 'D':
-    return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
-  case 's':
-    return mpc_whitespace();
-  case 'S':
-    return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
-  case 'w':
-    return mpc_alphanum();
-  case 'W':
-    return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
-  default:
-    return NULL;
-  }
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_PASS;
+  return p;
 }
 
-static mpc_val_t *mpcf_re_escape(mpc_val_t *x, void *data)
+mpc_parser_t *mpc_fail(const char *m)
 {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_FAIL;
+  p->data.fail.m = malloc(strlen(m) + 1);
+  strcpy(p->data.fail.m, m);
+  return p;
+}
 
-  int mode = *((int *)data);
-  char *s = x;
-  mpc_parser_t *p;
-
-  /* Any Character */
-  if (s[0] == '.')
-  {
-    free(s);
-    if (mode & MPC_RE_DOTALL)
-    {
-      return mpc_any();
-    }
-    else
-    {
-      return mpc_expect(mpc_noneof("\n"), "any character except a newline");
-    }
-  }
+/*
+** As `snprintf` is not ANSI standard this
+** function `mpc_failf` should be considered
+** unsafe.
+**
+** You have a few options if this is going to be
+** trouble.
+**
+** - Ensure the format string does not exceed
+**   the buffer length using precision specifiers
+**   such as `%.512s`.
+**
+** - Patch this function in your code base to
+**   use `snprintf` or whatever variant your
+**   system supports.
+**
+** - Avoid it altogether.
+**
+*/
 
-  /* Start of Input */
-  if (s[0] == '^')
-  {
-    free(s);
-    if (mode & MPC_RE_MULTILINE)
-    {
-      return mpc_and(2, mpcf_snd, mpc_or(2, mpc_soi(), mpc_boundary_newline()), mpc_lift(mpcf_ctor_str), free);
-    }
-    else
-    {
-      return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
-    }
-  }
+mpc_parser_t *mpc_failf(const char *fmt, ...)
+{
 
-  /* End of Input */
-  if (s[0] == '$')
-  {
-    free(s);
-    if (mode & MPC_RE_MULTILINE)
-    {
-      return mpc_or(2,
-                    mpc_newline(),
-                    mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
-    }
-    else
-    {
-      return mpc_or(2,
-                    mpc_and(2, mpcf_fst, mpc_newline(), mpc_eoi(), free),
-                    mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
-    }
-  }
+  va_list va;
+  char *buffer;
 
-  /* Regex Escape */
-  if (s[0] == '\\')
-  {
-    p = mpc_re_escape_char(s[1]);
-    p = (p == NULL) ? mpc_char(s[1]) : p;
-    free(s);
-    return p;
-  }
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_FAIL;
 
-  /* Regex Standard */
-  p = mpc_char(s[0]);
-  free(s);
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
+
+  buffer = realloc(buffer, strlen(buffer) + 1);
+  p->data.fail.m = buffer;
   return p;
 }
 
-static const char *mpc_re_range_escape_char(char c)
+mpc_parser_t *mpc_lift_val(mpc_val_t *x)
 {
-  switch (c)
-  {
-  case '-':
-    return "-";
-  case 'a':
-    return "\a";
-  case 'f':
-    return "\f";
-  case 'n':
-    return "\n";
-  case 'r':
-    return "\r";
-  case 't':
-    return "\t";
-  case 'v':
-    return "\v";
-  case 'b':
-    return "\b";
-  case 'd':
-    return "0123456789";
-  case 's':
-    return " \f\n\r\t\v";
-  case 'w':
-    return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
-  default:
-    return NULL;
-  }
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_LIFT_VAL;
+  p->data.lift.x = x;
+  return p;
 }
 
-static mpc_val_t *mpcf_re_range(mpc_val_t *x)
+mpc_parser_t *mpc_lift(mpc_ctor_t lf)
 {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_LIFT;
+  p->data.lift.lf = lf;
+  return p;
+}
 
-  mpc_parser_t *out;
-  size_t i, j;
-  size_t start, end;
-  const char *tmp = NULL;
-  const char *s = x;
-  int comp = s[0] == '^' ? 1 : 0;
-  char *range = calloc(1, 1);
-
-  if (s[0] == '\0')
-  {
-    free(range);
-    free(x);
-    return mpc_fail("Invalid Regex Range Expression");
-  }
-  if (s[0] == '^' &&
-      s[1] == '\0')
-  {
-    free(range);
-    free(x);
-    return mpc_fail("Invalid Regex Range Expression");
-  }
+mpc_parser_t *mpc_anchor(int (*f)(char, char))
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ANCHOR;
+  p->data.anchor.f = f;
+  return mpc_expect(p, "anchor");
+}
 
-  for (i = comp; i < strlen(s); i++)
-  {
+mpc_parser_t *mpc_state(void)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_STATE;
+  return p;
+}
 
-    /* Regex Range Escape */
-    if (s[i] == '\\')
-    {
-      tmp = mpc_re_range_escape_char(s[i + 1]);
-      if (tmp != NULL)
-      {
-        range = realloc(range, strlen(range) + strlen(tmp) + 1);
-        strcat(range, tmp);
-      }
-      else
-      {
-        range = realloc(range, strlen(range) + 1 + 1);
-        range[strlen(range) + 1] = '\0';
-        range[strlen(range) + 0] = s[i + 1];
-      }
-      i++;
-    }
+mpc_parser_t *mpc_expect(mpc_parser_t *a, const char *expected)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_EXPECT;
+  p->data.expect.x = a;
+  p->data.expect.m = malloc(strlen(expected) + 1);
+  strcpy(p->data.expect.m, expected);
+  return p;
+}
 
-    /* Regex Range...Range */
-    else if (s[i] == '-')
-    {
-      if (s[i + 1] == '\0' || i == 0)
-      {
-        range = realloc(range, strlen(range) + strlen("-") + 1);
-        strcat(range, "-");
-      }
-      else
-      {
-        start = s[i - 1] + 1;
-        end = s[i + 1] - 1;
-        for (j = start; j <= end; j++)
-        {
-          range = realloc(range, strlen(range) + 1 + 1 + 1);
-          range[strlen(range) + 1] = '\0';
-          range[strlen(range) + 0] = (char)j;
-        }
-      }
-    }
+/*
+** As `snprintf` is not ANSI standard this
+** function `mpc_expectf` should be considered
+** unsafe.
+**
+** You have a few options if this is going to be
+** trouble.
+**
+** - Ensure the format string does not exceed
+**   the buffer length using precision specifiers
+**   such as `%.512s`.
+**
+** - Patch this function in your code base to
+**   use `snprintf` or whatever variant your
+**   system supports.
+**
+** - Avoid it altogether.
+**
+*/
 
-    /* Regex Range Normal */
-    else
-    {
-      range = realloc(range, strlen(range) + 1 + 1);
-      range[strlen(range) + 1] = '\0';
-      range[strlen(range) + 0] = s[i];
-    }
-  }
+mpc_parser_t *mpc_expectf(mpc_parser_t *a, const char *fmt, ...)
+{
+  va_list va;
+  char *buffer;
 
-  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_EXPECT;
 
-  free(x);
-  free(range);
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
 
-  return out;
+  buffer = realloc(buffer, strlen(buffer) + 1);
+  p->data.expect.x = a;
+  p->data.expect.m = buffer;
+  return p;
 }
 
-mpc_parser_t *mpc_re(const char *re)
+/*
+** Basic Parsers
+*/
+
+mpc_parser_t *mpc_any(void)
 {
-  return mpc_re_mode(re, MPC_RE_DEFAULT);
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ANY;
+  return mpc_expect(p, "any character");
 }
 
-mpc_parser_t *mpc_re_mode(const char *re, int mode)
+mpc_parser_t *mpc_char(char c)
 {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_SINGLE;
+  p->data.single.x = c;
+  return mpc_expectf(p, "'%c'", c);
+}
 
-  char *err_msg;
-  mpc_parser_t *err_out;
-  mpc_result_t r;
-  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose;
+mpc_parser_t *mpc_range(char s, char e)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_RANGE;
+  p->data.range.x = s;
+  p->data.range.y = e;
+  return mpc_expectf(p, "character between '%c' and '%c'", s, e);
+}
 
-  Regex = mpc_new("regex");
-  Term = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base = mpc_new("base");
-  Range = mpc_new("range");
+mpc_parser_t *mpc_oneof(const char *s)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_ONEOF;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  return mpc_expectf(p, "one of '%s'", s);
+}
 
-  mpc_define(Regex, mpc_and(2, mpcf_re_or,
-                            Term,
-                            mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
-                            (mpc_dtor_t)mpc_delete));
+mpc_parser_t *mpc_noneof(const char *s)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_NONEOF;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  return mpc_expectf(p, "none of '%s'", s);
+}
 
-  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
+mpc_parser_t *mpc_satisfy(int (*f)(char))
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_SATISFY;
+  p->data.satisfy.f = f;
+  return mpc_expectf(p, "character satisfying function %p", f);
+}
 
-  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
-                             Base,
-                             mpc_or(5,
-                                    mpc_char('*'), mpc_char('+'), mpc_char('?'),
-                                    mpc_brackets(mpc_int(), free),
-                                    mpc_pass()),
-                             (mpc_dtor_t)mpc_delete));
+mpc_parser_t *mpc_string(const char *s)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_STRING;
+  p->data.string.x = malloc(strlen(s) + 1);
+  strcpy(p->data.string.x, s);
+  return mpc_expectf(p, "\"%s\"", s);
+}
 
-  mpc_define(Base, mpc_or(4,
-                          mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
-                          mpc_squares(Range, (mpc_dtor_t)mpc_delete),
-                          mpc_apply_to(mpc_escape(), mpcf_re_escape, &mode),
-                          mpc_apply_to(mpc_noneof(")|"), mpcf_re_escape, &mode)));
+/*
+** Core Parsers
+*/
 
-  mpc_define(Range, mpc_apply(
-                        mpc_many(mpcf_strfold, mpc_or(2, mpc_escape(), mpc_noneof("]"))),
-                        mpcf_re_range));
+mpc_parser_t *mpc_apply(mpc_parser_t *a, mpc_apply_t f)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_APPLY;
+  p->data.apply.x = a;
+  p->data.apply.f = f;
+  return p;
+}
 
-  RegexEnclose = mpc_whole(mpc_predictive(Regex), (mpc_dtor_t)mpc_delete);
+mpc_parser_t *mpc_apply_to(mpc_parser_t *a, mpc_apply_to_t f, void *x)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_APPLY_TO;
+  p->data.apply_to.x = a;
+  p->data.apply_to.f = f;
+  p->data.apply_to.d = x;
+  return p;
+}
 
-  mpc_optimise(RegexEnclose);
-  mpc_optimise(Regex);
-  mpc_optimise(Term);
-  mpc_optimise(Factor);
-  mpc_optimise(Base);
-  mpc_optimise(Range);
+mpc_parser_t *mpc_check(mpc_parser_t *a, mpc_dtor_t da, mpc_check_t f, const char *e)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_CHECK;
+  p->data.check.x = a;
+  p->data.check.dx = da;
+  p->data.check.f = f;
+  p->data.check.e = malloc(strlen(e) + 1);
+  strcpy(p->data.check.e, e);
+  return p;
+}
 
-  if (!mpc_parse("<mpc_re_compiler>", re, RegexEnclose, &r))
-  {
-    err_msg = mpc_err_string(r.error);
-    err_out = mpc_failf("Invalid Regex: %s", err_msg);
-    mpc_err_delete(r.error);
-    free(err_msg);
-    r.output = err_out;
-  }
+mpc_parser_t *mpc_check_with(mpc_parser_t *a, mpc_dtor_t da, mpc_check_with_t f, void *x, const char *e)
+{
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_CHECK_WITH;
+  p->data.check_with.x = a;
+  p->data.check_with.dx = da;
+  p->data.check_with.f = f;
+  p->data.check_with.d = x;
+  p->data.check_with.e = malloc(strlen(e) + 1);
+  strcpy(p->data.check_with.e, e);
+  return p;
+}
 
-  mpc_cleanup(6, RegexEnclose, Regex, Term, Factor, Base, Range);
+mpc_parser_t *mpc_checkf(mpc_parser_t *a, mpc_dtor_t da, mpc_check_t f, const char *fmt, ...)
+{
+  va_list va;
+  char *buffer;
+  mpc_parser_t *p;
 
-  mpc_optimise(r.output);
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
 
-  return r.output;
-}
+  p = mpc_check(a, da, f, buffer);
+  free(buffer);
 
-/*
-** Common Fold Functions
-*/
+  return p;
+}
 
-void mpcf_dtor_null(mpc_val_t *x)
+mpc_parser_t *mpc_check_withf(mpc_parser_t *a, mpc_dtor_t da, mpc_check_with_t f, void *x, const char *fmt, ...)
 {
-  (void)x;
-  return;
+  va_list va;
+  char *buffer;
+  mpc_parser_t *p;
+
+  va_start(va, fmt);
+  buffer = malloc(2048);
+  vsprintf(buffer, fmt, va);
+  va_end(va);
+
+  p = mpc_check_with(a, da, f, x, buffer);
+  free(buffer);
+
+  return p;
 }
 
-mpc_val_t *mpcf_ctor_null(void) { return NULL; }
-mpc_val_t *mpcf_ctor_str(void) { return calloc(1, 1); }
-mpc_val_t *mpcf_free(mpc_val_t *x)
+mpc_parser_t *mpc_predictive(mpc_parser_t *a)
 {
-  free(x);
-  return NULL;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_PREDICT;
+  p->data.predict.x = a;
+  return p;
 }
 
-mpc_val_t *mpcf_int(mpc_val_t *x)
+mpc_parser_t *mpc_not_lift(mpc_parser_t *a, mpc_dtor_t da, mpc_ctor_t lf)
 {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 10);
-  free(x);
-  return y;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_NOT;
+  p->data.not .x = a;
+  p->data.not .dx = da;
+  p->data.not .lf = lf;
+  return p;
 }
 
-mpc_val_t *mpcf_hex(mpc_val_t *x)
+mpc_parser_t *mpc_not(mpc_parser_t *a, mpc_dtor_t da)
 {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 16);
-  free(x);
-  return y;
+  return mpc_not_lift(a, da, mpcf_ctor_null);
 }
 
-mpc_val_t *mpcf_oct(mpc_val_t *x)
+mpc_parser_t *mpc_maybe_lift(mpc_parser_t *a, mpc_ctor_t lf)
 {
-  int *y = malloc(sizeof(int));
-  *y = strtol(x, NULL, 8);
-  free(x);
-  return y;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MAYBE;
+  p->data.not .x = a;
+  p->data.not .lf = lf;
+  return p;
 }
 
-mpc_val_t *mpcf_float(mpc_val_t *x)
+mpc_parser_t *mpc_maybe(mpc_parser_t *a)
 {
-  float *y = malloc(sizeof(float));
-  *y = strtod(x, NULL);
-  free(x);
-  return y;
+  return mpc_maybe_lift(a, mpcf_ctor_null);
 }
 
-mpc_val_t *mpcf_strtriml(mpc_val_t *x)
+mpc_parser_t *mpc_many(mpc_fold_t f, mpc_parser_t *a)
 {
-  char *s = x;
-  while (isspace((unsigned char)*s))
-  {
-    memmove(s, s + 1, strlen(s));
-  }
-  return s;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MANY;
+  p->data.repeat.x = a;
+  p->data.repeat.f = f;
+  return p;
 }
 
-mpc_val_t *mpcf_strtrimr(mpc_val_t *x)
+mpc_parser_t *mpc_many1(mpc_fold_t f, mpc_parser_t *a)
 {
-  char *s = x;
-  size_t l = strlen(s);
-  while (l > 0 && isspace((unsigned char)s[l - 1]))
-  {
-    s[l - 1] = '\0';
-    l--;
-  }
-  return s;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MANY1;
+  p->data.repeat.x = a;
+  p->data.repeat.f = f;
+  return p;
 }
 
-mpc_val_t *mpcf_strtrim(mpc_val_t *x)
+mpc_parser_t *mpc_count(int n, mpc_fold_t f, mpc_parser_t *a, mpc_dtor_t da)
 {
-  return mpcf_strtriml(mpcf_strtrimr(x));
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_COUNT;
+  p->data.repeat.n = n;
+  p->data.repeat.f = f;
+  p->data.repeat.x = a;
+  p->data.repeat.dx = da;
+  return p;
 }
 
-static const char mpc_escape_input_c[] = {
-    '\a', '\b', '\f', '\n', '\r',
-    '\t', '\v', '\\', '\'', '\"', '\0'};
-
-static const char *mpc_escape_output_c[] = {
-    "\\a", "\\b", "\\f", "\\n", "\\r", "\\t",
-    "\\v", "\\\\", "\\'", "\\\"", "\\0", NULL};
-
-static const char mpc_escape_input_raw_re[] = {'/'};
-static const char *mpc_escape_output_raw_re[] = {"\\/", NULL};
-
-static const char mpc_escape_input_raw_cstr[] = {'"'};
-static const char *mpc_escape_output_raw_cstr[] = {"\\\"", NULL};
-
-static const char mpc_escape_input_raw_cchar[] = {'\''};
-static const char *mpc_escape_output_raw_cchar[] = {"\\'", NULL};
-
-static mpc_val_t *mpcf_escape_new(mpc_val_t *x, const char *input, const char **output)
+mpc_parser_t *mpc_or(int n, ...)
 {
 
   int i;
-  int found;
-  char buff[2];
-  char *s = x;
-  char *y = calloc(1, 1);
-
-  while (*s)
-  {
-
-    i = 0;
-    found = 0;
+  va_list va;
 
-    while (output[i])
-    {
-      if (*s == input[i])
-      {
-        y = realloc(y, strlen(y) + strlen(output[i]) + 1);
-        strcat(y, output[i]);
-        found = 1;
-        break;
-      }
-      i++;
-    }
+  mpc_parser_t *p = mpc_undefined();
 
-    if (!found)
-    {
-      y = realloc(y, strlen(y) + 2);
-      buff[0] = *s;
-      buff[1] = '\0';
-      strcat(y, buff);
-    }
+  p->type = MPC_TYPE_OR;
+  p->data.or.n = n;
+  p->data.or.xs = malloc(sizeof(mpc_parser_t *) * n);
 
-    s++;
+  va_start(va, n);
+  for (i = 0; i < n; i++)
+  {
+    p->data.or.xs[i] = va_arg(va, mpc_parser_t *);
   }
+  va_end(va);
 
-  return y;
+  return p;
 }
 
-static mpc_val_t *mpcf_unescape_new(mpc_val_t *x, const char *input, const char **output)
+mpc_parser_t *mpc_and(int n, mpc_fold_t f, ...)
 {
 
   int i;
-  int found = 0;
-  char buff[2];
-  char *s = x;
-  char *y = calloc(1, 1);
-
-  while (*s)
-  {
-
-    i = 0;
-    found = 0;
+  va_list va;
 
-    while (output[i])
-    {
-      if ((*(s + 0)) == output[i][0] &&
-          (*(s + 1)) == output[i][1])
-      {
-        y = realloc(y, strlen(y) + 1 + 1);
-        buff[0] = input[i];
-        buff[1] = '\0';
-        strcat(y, buff);
-        found = 1;
-        s++;
-        break;
-      }
-      i++;
-    }
+  mpc_parser_t *p = mpc_undefined();
 
-    if (!found)
-    {
-      y = realloc(y, strlen(y) + 1 + 1);
-      buff[0] = *s;
-      buff[1] = '\0';
-      strcat(y, buff);
-    }
+  p->type = MPC_TYPE_AND;
+  p->data.and.n = n;
+  p->data.and.f = f;
+  p->data.and.xs = malloc(sizeof(mpc_parser_t *) * n);
+  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n - 1));
 
-    if (*s == '\0')
-    {
-      break;
-    }
-    else
-    {
-      s++;
-    }
+  va_start(va, f);
+  for (i = 0; i < n; i++)
+  {
+    p->data.and.xs[i] = va_arg(va, mpc_parser_t *);
+  }
+  for (i = 0; i < (n - 1); i++)
+  {
+    p->data.and.dxs[i] = va_arg(va, mpc_dtor_t);
   }
+  va_end(va);
 
-  return y;
+  return p;
 }
 
-mpc_val_t *mpcf_escape(mpc_val_t *x)
+/*
+** Common Parsers
+*/
+
+mpc_parser_t *mpc_soi(void)
 {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_c, mpc_escape_output_c);
-  free(x);
-  return y;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_SOI;
+  return mpc_expect(p, "start of input");
 }
 
-mpc_val_t *mpcf_unescape(mpc_val_t *x)
+mpc_parser_t *mpc_eoi(void)
 {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_c, mpc_escape_output_c);
-  free(x);
-  return y;
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_EOI;
+  return mpc_expect(p, "end of input");
 }
 
-mpc_val_t *mpcf_escape_regex(mpc_val_t *x)
+static int mpc_boundary_anchor(char prev, char next)
 {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
-  free(x);
-  return y;
+  const char *word = "abcdefghijklmnopqrstuvwxyz"
+                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                     "0123456789_";
+  if (strchr(word, next) && prev == '\0')
+  {
+    return 1;
+  }
+  if (strchr(word, prev) && next == '\0')
+  {
+    return 1;
+  }
+  if (strchr(word, next) && !strchr(word, prev))
+  {
+    return 1;
+  }
+  if (!strchr(word, next) && strchr(word, prev))
+  {
+    return 1;
+  }
+  return 0;
 }
 
-mpc_val_t *mpcf_unescape_regex(mpc_val_t *x)
+static int mpc_boundary_newline_anchor(char prev, char next)
 {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
-  free(x);
-  return y;
+  (void)next;
+  return prev == '\n';
 }
 
-mpc_val_t *mpcf_escape_string_raw(mpc_val_t *x)
+mpc_parser_t *mpc_boundary(void) { return mpc_expect(mpc_anchor(mpc_boundary_anchor), "word boundary"); }
+mpc_parser_t *mpc_boundary_newline(void) { return mpc_expect(mpc_anchor(mpc_boundary_newline_anchor), "start of newline"); }
+
+mpc_parser_t *mpc_whitespace(void) { return mpc_expect(mpc_oneof(" \f\n\r\t\v"), "whitespace"); }
+mpc_parser_t *mpc_whitespaces(void) { return mpc_expect(mpc_many(mpcf_strfold, mpc_whitespace()), "spaces"); }
+mpc_parser_t *mpc_blank(void) { return mpc_expect(mpc_apply(mpc_whitespaces(), mpcf_free), "whitespace"); }
+
+mpc_parser_t *mpc_newline(void) { return mpc_expect(mpc_char('\n'), "newline"); }
+mpc_parser_t *mpc_tab(void) { return mpc_expect(mpc_char('\t'), "tab"); }
+mpc_parser_t *mpc_escape(void) { return mpc_and(2, mpcf_strfold, mpc_char('\\'), mpc_any(), free); }
+
+mpc_parser_t *mpc_digit(void) { return mpc_expect(mpc_oneof("0123456789"), "digit"); }
+mpc_parser_t *mpc_hexdigit(void) { return mpc_expect(mpc_oneof("0123456789ABCDEFabcdef"), "hex digit"); }
+mpc_parser_t *mpc_octdigit(void) { return mpc_expect(mpc_oneof("01234567"), "oct digit"); }
+mpc_parser_t *mpc_digits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_digit()), "digits"); }
+mpc_parser_t *mpc_hexdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_hexdigit()), "hex digits"); }
+mpc_parser_t *mpc_octdigits(void) { return mpc_expect(mpc_many1(mpcf_strfold, mpc_octdigit()), "oct digits"); }
+
+mpc_parser_t *mpc_lower(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyz"), "lowercase letter"); }
+mpc_parser_t *mpc_upper(void) { return mpc_expect(mpc_oneof("ABCDEFGHIJKLMNOPQRSTUVWXYZ"), "uppercase letter"); }
+mpc_parser_t *mpc_alpha(void) { return mpc_expect(mpc_oneof("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"), "letter"); }
+mpc_parser_t *mpc_underscore(void) { return mpc_expect(mpc_char('_'), "underscore"); }
+mpc_parser_t *mpc_alphanum(void) { return mpc_expect(mpc_or(3, mpc_alpha(), mpc_digit(), mpc_underscore()), "alphanumeric"); }
+
+mpc_parser_t *mpc_int(void) { return mpc_expect(mpc_apply(mpc_digits(), mpcf_int), "integer"); }
+mpc_parser_t *mpc_hex(void) { return mpc_expect(mpc_apply(mpc_hexdigits(), mpcf_hex), "hexadecimal"); }
+mpc_parser_t *mpc_oct(void) { return mpc_expect(mpc_apply(mpc_octdigits(), mpcf_oct), "octadecimal"); }
+mpc_parser_t *mpc_number(void) { return mpc_expect(mpc_or(3, mpc_int(), mpc_hex(), mpc_oct()), "number"); }
+
+mpc_parser_t *mpc_real(void)
 {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
-  free(x);
-  return y;
+
+  /* [+-]?\d+(\.\d+)?([eE][+-]?[0-9]+)? */
+
+  mpc_parser_t *p0, *p1, *p2, *p30, *p31, *p32, *p3;
+
+  p0 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
+  p1 = mpc_digits();
+  p2 = mpc_maybe_lift(mpc_and(2, mpcf_strfold, mpc_char('.'), mpc_digits(), free), mpcf_ctor_str);
+  p30 = mpc_oneof("eE");
+  p31 = mpc_maybe_lift(mpc_oneof("+-"), mpcf_ctor_str);
+  p32 = mpc_digits();
+  p3 = mpc_maybe_lift(mpc_and(3, mpcf_strfold, p30, p31, p32, free, free), mpcf_ctor_str);
+
+  return mpc_expect(mpc_and(4, mpcf_strfold, p0, p1, p2, p3, free, free, free), "real");
 }
 
-mpc_val_t *mpcf_unescape_string_raw(mpc_val_t *x)
+mpc_parser_t *mpc_float(void)
 {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
-  free(x);
-  return y;
+  return mpc_expect(mpc_apply(mpc_real(), mpcf_float), "float");
 }
 
-mpc_val_t *mpcf_escape_char_raw(mpc_val_t *x)
+mpc_parser_t *mpc_char_lit(void)
 {
-  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
-  free(x);
-  return y;
+  return mpc_expect(mpc_between(mpc_or(2, mpc_escape(), mpc_any()), free, "'", "'"), "char");
 }
 
-mpc_val_t *mpcf_unescape_char_raw(mpc_val_t *x)
+mpc_parser_t *mpc_string_lit(void)
 {
-  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
-  free(x);
-  return y;
+  mpc_parser_t *strchar = mpc_or(2, mpc_escape(), mpc_noneof("\""));
+  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, strchar), free, "\"", "\""), "string");
 }
 
-mpc_val_t *mpcf_null(int n, mpc_val_t **xs)
+mpc_parser_t *mpc_regex_lit(void)
 {
-  (void)n;
-  (void)xs;
-  return NULL;
+  mpc_parser_t *regexchar = mpc_or(2, mpc_escape(), mpc_noneof("/"));
+  return mpc_expect(mpc_between(mpc_many(mpcf_strfold, regexchar), free, "/", "/"), "regex");
 }
-mpc_val_t *mpcf_fst(int n, mpc_val_t **xs)
+
+mpc_parser_t *mpc_ident(void)
 {
-  (void)n;
-  return xs[0];
+  mpc_parser_t *p0, *p1;
+  p0 = mpc_or(2, mpc_alpha(), mpc_underscore());
+  p1 = mpc_many(mpcf_strfold, mpc_alphanum());
+  return mpc_and(2, mpcf_strfold, p0, p1, free);
 }
-mpc_val_t *mpcf_snd(int n, mpc_val_t **xs)
-{
-  (void)n;
-  return xs[1];
-}
-mpc_val_t *mpcf_trd(int n, mpc_val_t **xs)
+
+/*
+** Useful Parsers
+*/
+
+mpc_parser_t *mpc_startwith(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_soi(), a, mpcf_dtor_null); }
+mpc_parser_t *mpc_endwith(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(2, mpcf_fst, a, mpc_eoi(), da); }
+mpc_parser_t *mpc_whole(mpc_parser_t *a, mpc_dtor_t da) { return mpc_and(3, mpcf_snd, mpc_soi(), a, mpc_eoi(), mpcf_dtor_null, da); }
+
+mpc_parser_t *mpc_stripl(mpc_parser_t *a) { return mpc_and(2, mpcf_snd, mpc_blank(), a, mpcf_dtor_null); }
+mpc_parser_t *mpc_stripr(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
+mpc_parser_t *mpc_strip(mpc_parser_t *a) { return mpc_and(3, mpcf_snd, mpc_blank(), a, mpc_blank(), mpcf_dtor_null, mpcf_dtor_null); }
+mpc_parser_t *mpc_tok(mpc_parser_t *a) { return mpc_and(2, mpcf_fst, a, mpc_blank(), mpcf_dtor_null); }
+mpc_parser_t *mpc_sym(const char *s) { return mpc_tok(mpc_string(s)); }
+
+mpc_parser_t *mpc_total(mpc_parser_t *a, mpc_dtor_t da) { return mpc_whole(mpc_strip(a), da); }
+
+mpc_parser_t *mpc_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c)
 {
-  (void)n;
-  return xs[2];
+  return mpc_and(3, mpcf_snd_free,
+                 mpc_string(o), a, mpc_string(c),
+                 free, ad);
 }
 
-static mpc_val_t *mpcf_nth_free(int n, mpc_val_t **xs, int x)
+mpc_parser_t *mpc_parens(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "(", ")"); }
+mpc_parser_t *mpc_braces(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "<", ">"); }
+mpc_parser_t *mpc_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "{", "}"); }
+mpc_parser_t *mpc_squares(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_between(a, ad, "[", "]"); }
+
+mpc_parser_t *mpc_tok_between(mpc_parser_t *a, mpc_dtor_t ad, const char *o, const char *c)
 {
-  int i;
-  for (i = 0; i < n; i++)
-  {
-    if (i != x)
-    {
-      free(xs[i]);
-    }
-  }
-  return xs[x];
+  return mpc_and(3, mpcf_snd_free,
+                 mpc_sym(o), mpc_tok(a), mpc_sym(c),
+                 free, ad);
 }
 
-mpc_val_t *mpcf_fst_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 0); }
-mpc_val_t *mpcf_snd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 1); }
-mpc_val_t *mpcf_trd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 2); }
-mpc_val_t *mpcf_all_free(int n, mpc_val_t **xs)
+mpc_parser_t *mpc_tok_parens(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "(", ")"); }
+mpc_parser_t *mpc_tok_braces(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "<", ">"); }
+mpc_parser_t *mpc_tok_brackets(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "{", "}"); }
+mpc_parser_t *mpc_tok_squares(mpc_parser_t *a, mpc_dtor_t ad) { return mpc_tok_between(a, ad, "[", "]"); }
+
+/*
+** Regular Expression Parsers
+*/
+
+/*
+** So here is a cute bootstrapping.
+**
+** I'm using the previously defined
+** mpc constructs and functions to
+** parse the user regex string and
+** construct a parser from it.
+**
+** As it turns out lots of the standard
+** mpc functions look a lot like `fold`
+** functions and so can be used indirectly
+** by many of the parsing functions to build
+** a parser directly - as we are parsing.
+**
+** This is certainly something that
+** would be less elegant/interesting
+** in a two-phase parser which first
+** builds an AST and then traverses it
+** to generate the object.
+**
+** This whole thing acts as a great
+** case study for how trivial it can be
+** to write a great parser in a few
+** lines of code using mpc.
+*/
+
+/*
+**
+**  ### Regular Expression Grammar
+**
+**      <regex> : <term> | (<term> "|" <regex>)
+**
+**      <term> : <factor>*
+**
+**      <factor> : <base>
+**               | <base> "*"
+**               | <base> "+"
+**               | <base> "?"
+**               | <base> "{" <digits> "}"
+**
+**      <base> : <char>
+**             | "\" <char>
+**             | "(" <regex> ")"
+**             | "[" <range> "]"
+*/
+
+static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs)
 {
-  int i;
-  for (i = 0; i < n; i++)
+  (void)n;
+  if (xs[1] == NULL)
   {
-    free(xs[i]);
+    return xs[0];
+  }
+  else
+  {
+    return mpc_or(2, xs[0], xs[1]);
   }
-  return NULL;
 }
 
-mpc_val_t *mpcf_strfold(int n, mpc_val_t **xs)
+static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs)
 {
   int i;
-  size_t l = 0;
-
-  if (n == 0)
-  {
-    return calloc(1, 1);
-  }
-
+  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
   for (i = 0; i < n; i++)
   {
-    l += strlen(xs[i]);
-  }
-
-  xs[0] = realloc(xs[0], l + 1);
-
-  for (i = 1; i < n; i++)
-  {
-    strcat(xs[0], xs[i]);
-    free(xs[i]);
+    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
   }
-
-  return xs[0];
+  return p;
 }
 
-mpc_val_t *mpcf_maths(int n, mpc_val_t **xs)
+static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs)
 {
-  int **vs = (int **)xs;
+  int num;
   (void)n;
-
+  if (xs[1] == NULL)
+  {
+    return xs[0];
+  }
   switch (((char *)xs[1])[0])
   {
   case '*':
   {
-    *vs[0] *= *vs[2];
-  };
-  break;
-  case '/':
-  {
-    *vs[0] /= *vs[2];
-  };
-  break;
-  case '%':
-  {
-    *vs[0] %= *vs[2];
+    free(xs[1]);
+    return mpc_many(mpcf_strfold, xs[0]);
   };
   break;
   case '+':
   {
-    *vs[0] += *vs[2];
+    free(xs[1]);
+    return mpc_many1(mpcf_strfold, xs[0]);
   };
   break;
-  case '-':
+  case '?':
   {
-    *vs[0] -= *vs[2];
+    free(xs[1]);
+    return mpc_maybe_lift(xs[0], mpcf_ctor_str);
   };
   break;
   default:
-    break;
+    num = *(int *)xs[1];
+    free(xs[1]);
   }
 
-  free(xs[1]);
-  free(xs[2]);
-
-  return xs[0];
+  return mpc_count(num, mpcf_strfold, xs[0], free);
 }
 
-/*
-** Printing
-*/
-
-static void mpc_print_unretained(mpc_parser_t *p, int force)
+static mpc_parser_t *mpc_re_escape_char(char c)
 {
+  switch (c)
+  {
+  case 'a':
+    return mpc_char('\a');
+  case 'f':
+    return mpc_char('\f');
+  case 'n':
+    return mpc_char('\n');
+  case 'r':
+    return mpc_char('\r');
+  case 't':
+    return mpc_char('\t');
+  case 'v':
+    return mpc_char('\v');
+  case 'b':
+    return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
+  case 'B':
+    return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
+  case 'A':
+    return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+  case 'Z':
+    return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
+  case 'd':
+    return mpc_digit();
+  case 'D':
+    return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
+  case 's':
+    return mpc_whitespace();
+  case 'S':
+    return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
+  case 'w':
+    return mpc_alphanum();
+  case 'W':
+    return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
+  default:
+    return NULL;
+  }
+}
 
-  /* TODO: Print Everything Escaped */
+static mpc_val_t *mpcf_re_escape(mpc_val_t *x, void *data)
+{
 
-  int i;
-  char *s, *e;
-  char buff[2];
+  int mode = *((int *)data);
+  char *s = x;
+  mpc_parser_t *p;
 
-  if (p->retained && !force)
+  /* Any Character */
+  if (s[0] == '.')
   {
-    ;
-    if (p->name)
+    free(s);
+    if (mode & MPC_RE_DOTALL)
     {
-      printf("<%s>", p->name);
+      return mpc_any();
     }
     else
     {
-      printf("<anon>");
+      return mpc_expect(mpc_noneof("\n"), "any character except a newline");
     }
-    return;
   }
 
-  if (p->type == MPC_TYPE_UNDEFINED)
+  /* Start of Input */
+  if (s[0] == '^')
   {
-    printf("<?>");
-  }
-  if (p->type == MPC_TYPE_PASS)
-  {
-    printf("<:>");
-  }
-  if (p->type == MPC_TYPE_FAIL)
-  {
-    printf("<!>");
-  }
-  if (p->type == MPC_TYPE_LIFT)
-  {
-    printf("<#>");
-  }
-  if (p->type == MPC_TYPE_STATE)
-  {
-    printf("<S>");
-  }
-  if (p->type == MPC_TYPE_ANCHOR)
-  {
-    printf("<@>");
-  }
-  if (p->type == MPC_TYPE_EXPECT)
-  {
-    printf("%s", p->data.expect.m);
-    /*mpc_print_unretained(p->data.expect.x, 0);*/
-  }
-
-  if (p->type == MPC_TYPE_ANY)
-  {
-    printf("<.>");
-  }
-  if (p->type == MPC_TYPE_SATISFY)
-  {
-    printf("<f>");
+    free(s);
+    if (mode & MPC_RE_MULTILINE)
+    {
+      return mpc_and(2, mpcf_snd, mpc_or(2, mpc_soi(), mpc_boundary_newline()), mpc_lift(mpcf_ctor_str), free);
+    }
+    else
+    {
+      return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+    }
   }
 
-  if (p->type == MPC_TYPE_SINGLE)
+  /* End of Input */
+  if (s[0] == '$')
   {
-    buff[0] = p->data.single.x;
-    buff[1] = '\0';
-    s = mpcf_escape_new(
-        buff,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    printf("'%s'", s);
     free(s);
+    if (mode & MPC_RE_MULTILINE)
+    {
+      return mpc_or(2,
+                    mpc_newline(),
+                    mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+    }
+    else
+    {
+      return mpc_or(2,
+                    mpc_and(2, mpcf_fst, mpc_newline(), mpc_eoi(), free),
+                    mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+    }
   }
 
-  if (p->type == MPC_TYPE_RANGE)
+  /* Regex Escape */
+  if (s[0] == '\\')
   {
-    buff[0] = p->data.range.x;
-    buff[1] = '\0';
-    s = mpcf_escape_new(
-        buff,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    buff[0] = p->data.range.y;
-    buff[1] = '\0';
-    e = mpcf_escape_new(
-        buff,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    printf("[%s-%s]", s, e);
+    p = mpc_re_escape_char(s[1]);
+    p = (p == NULL) ? mpc_char(s[1]) : p;
     free(s);
-    free(e);
+    return p;
   }
 
-  if (p->type == MPC_TYPE_ONEOF)
-  {
-    s = mpcf_escape_new(
-        p->data.string.x,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    printf("[%s]", s);
-    free(s);
-  }
+  /* Regex Standard */
+  p = mpc_char(s[0]);
+  free(s);
+  return p;
+}
 
-  if (p->type == MPC_TYPE_NONEOF)
+static const char *mpc_re_range_escape_char(char c)
+{
+  switch (c)
   {
-    s = mpcf_escape_new(
-        p->data.string.x,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    printf("[^%s]", s);
-    free(s);
+  case '-':
+    return "-";
+  case 'a':
+    return "\a";
+  case 'f':
+    return "\f";
+  case 'n':
+    return "\n";
+  case 'r':
+    return "\r";
+  case 't':
+    return "\t";
+  case 'v':
+    return "\v";
+  case 'b':
+    return "\b";
+  case 'd':
+    return "0123456789";
+  case 's':
+    return " \f\n\r\t\v";
+  case 'w':
+    return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+  default:
+    return NULL;
   }
+}
 
-  if (p->type == MPC_TYPE_STRING)
-  {
-    s = mpcf_escape_new(
-        p->data.string.x,
-        mpc_escape_input_c,
-        mpc_escape_output_c);
-    printf("\"%s\"", s);
-    free(s);
-  }
+static mpc_val_t *mpcf_re_range(mpc_val_t *x)
+{
 
-  if (p->type == MPC_TYPE_APPLY)
-  {
-    mpc_print_unretained(p->data.apply.x, 0);
-  }
-  if (p->type == MPC_TYPE_APPLY_TO)
-  {
-    mpc_print_unretained(p->data.apply_to.x, 0);
-  }
-  if (p->type == MPC_TYPE_PREDICT)
-  {
-    mpc_print_unretained(p->data.predict.x, 0);
-  }
+  mpc_parser_t *out;
+  size_t i, j;
+  size_t start, end;
+  const char *tmp = NULL;
+  const char *s = x;
+  int comp = s[0] == '^' ? 1 : 0;
+  char *range = calloc(1, 1);
 
-  if (p->type == MPC_TYPE_NOT)
+  if (s[0] == '\0')
   {
-    mpc_print_unretained(p->data.not .x, 0);
-    printf("!");
+    free(range);
+    free(x);
+    return mpc_fail("Invalid Regex Range Expression");
   }
-  if (p->type == MPC_TYPE_MAYBE)
+  if (s[0] == '^' &&
+      s[1] == '\0')
   {
-    mpc_print_unretained(p->data.not .x, 0);
-    printf("?");
+    free(range);
+    free(x);
+    return mpc_fail("Invalid Regex Range Expression");
   }
 
-  if (p->type == MPC_TYPE_MANY)
-  {
-    mpc_print_unretained(p->data.repeat.x, 0);
-    printf("*");
-  }
-  if (p->type == MPC_TYPE_MANY1)
-  {
-    mpc_print_unretained(p->data.repeat.x, 0);
-    printf("+");
-  }
-  if (p->type == MPC_TYPE_COUNT)
+  for (i = comp; i < strlen(s); i++)
   {
-    mpc_print_unretained(p->data.repeat.x, 0);
-    printf("{%i}", p->data.repeat.n);
-  }
 
-  if (p->type == MPC_TYPE_OR)
-  {
-    printf("(");
-    for (i = 0; i < p->data.or.n - 1; i++)
+    /* Regex Range Escape */
+    if (s[i] == '\\')
     {
-      mpc_print_unretained(p->data.or.xs[i], 0);
-      printf(" | ");
+      tmp = mpc_re_range_escape_char(s[i + 1]);
+      if (tmp != NULL)
+      {
+        range = realloc(range, strlen(range) + strlen(tmp) + 1);
+        strcat(range, tmp);
+      }
+      else
+      {
+        range = realloc(range, strlen(range) + 1 + 1);
+        range[strlen(range) + 1] = '\0';
+        range[strlen(range) + 0] = s[i + 1];
+      }
+      i++;
     }
-    mpc_print_unretained(p->data.or.xs[p->data.or.n - 1], 0);
-    printf(")");
-  }
 
-  if (p->type == MPC_TYPE_AND)
-  {
-    printf("(");
-    for (i = 0; i < p->data.and.n - 1; i++)
+    /* Regex Range...Range */
+    else if (s[i] == '-')
     {
-      mpc_print_unretained(p->data.and.xs[i], 0);
-      printf(" ");
+      if (s[i + 1] == '\0' || i == 0)
+      {
+        range = realloc(range, strlen(range) + strlen("-") + 1);
+        strcat(range, "-");
+      }
+      else
+      {
+        start = s[i - 1] + 1;
+        end = s[i + 1] - 1;
+        for (j = start; j <= end; j++)
+        {
+          range = realloc(range, strlen(range) + 1 + 1 + 1);
+          range[strlen(range) + 1] = '\0';
+          range[strlen(range) + 0] = (char)j;
+        }
+      }
     }
-    mpc_print_unretained(p->data.and.xs[p->data.and.n - 1], 0);
-    printf(")");
-  }
 
-  if (p->type == MPC_TYPE_CHECK)
-  {
-    mpc_print_unretained(p->data.check.x, 0);
-    printf("->?");
-  }
-  if (p->type == MPC_TYPE_CHECK_WITH)
-  {
-    mpc_print_unretained(p->data.check_with.x, 0);
-    printf("->?");
+    /* Regex Range Normal */
+    else
+    {
+      range = realloc(range, strlen(range) + 1 + 1);
+      range[strlen(range) + 1] = '\0';
+      range[strlen(range) + 0] = s[i];
+    }
   }
-}
 
-void mpc_print(mpc_parser_t *p)
-{
-  mpc_print_unretained(p, 1);
-  printf("\n");
-}
+  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
 
-/*
-** Testing
-*/
+  free(x);
+  free(range);
 
-/*
-** These functions are slightly unwieldy and
-** also the whole of the testing suite for mpc
-** mpc is pretty shaky.
-**
-** It could do with a lot more tests and more
-** precision. Currently I am only really testing
-** changes off of the examples.
-**
-*/
+  return out;
+}
 
-int mpc_test_fail(mpc_parser_t *p, const char *s, const void *d,
-                  int (*tester)(const void *, const void *),
-                  mpc_dtor_t destructor,
-                  void (*printer)(const void *))
+mpc_parser_t *mpc_re(const char *re)
 {
-  mpc_result_t r;
-  (void)printer;
-  if (mpc_parse("<test>", s, p, &r))
-  {
-
-    if (tester(r.output, d))
-    {
-      destructor(r.output);
-      return 0;
-    }
-    else
-    {
-      destructor(r.output);
-      return 1;
-    }
-  }
-  else
-  {
-    mpc_err_delete(r.error);
-    return 1;
-  }
+  return mpc_re_mode(re, MPC_RE_DEFAULT);
 }
 
-int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
-                  int (*tester)(const void *, const void *),
-                  mpc_dtor_t destructor,
-                  void (*printer)(const void *))
+mpc_parser_t *mpc_re_mode(const char *re, int mode)
 {
 
+  char *err_msg;
+  mpc_parser_t *err_out, *p;
+  mpc_dfa_t *d;
   mpc_result_t r;
-  if (mpc_parse("<test>", s, p, &r))
-  {
+  mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose;
 
-    if (tester(r.output, d))
-    {
-      destructor(r.output);
-      return 1;
-    }
-    else
-    {
-      printf("Got ");
-      printer(r.output);
-      printf("\n");
-      printf("Expected ");
-      printer(d);
-      printf("\n");
-      destructor(r.output);
-      return 0;
-    }
-  }
-  else
-  {
-    mpc_err_print(r.error);
-    mpc_err_delete(r.error);
-    return 0;
-  }
-}
+  Regex = mpc_new("regex");
+  Term = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base = mpc_new("base");
+  Range = mpc_new("range");
 
-/*
-** AST
-*/
+  mpc_define(Regex, mpc_and(2, mpcf_re_or,
+                            Term,
+                            mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_char('|'), Regex, free)),
+                            (mpc_dtor_t)mpc_delete));
 
-void mpc_ast_delete(mpc_ast_t *a)
-{
+  mpc_define(Term, mpc_many(mpcf_re_and, Factor));
 
-  int i;
+  mpc_define(Factor, mpc_and(2, mpcf_re_repeat,
+                             Base,
+                             mpc_or(5,
+                                    mpc_char('*'), mpc_char('+'), mpc_char('?'),
+                                    mpc_brackets(mpc_int(), free),
+                                    mpc_pass()),
+                             (mpc_dtor_t)mpc_delete));
 
-  if (a == NULL)
+  mpc_define(Base, mpc_or(4,
+                          mpc_parens(Regex, (mpc_dtor_t)mpc_delete),
+                          mpc_squares(Range, (mpc_dtor_t)mpc_delete),
+                          mpc_apply_to(mpc_escape(), mpcf_re_escape, &mode),
+                          mpc_apply_to(mpc_noneof(")|"), mpcf_re_escape, &mode)));
+
+  mpc_define(Range, mpc_apply(
+                        mpc_many(mpcf_strfold, mpc_or(2, mpc_escape(), mpc_noneof("]"))),
+                        mpcf_re_range));
+
+  RegexEnclose = mpc_whole(mpc_predictive(Regex), (mpc_dtor_t)mpc_delete);
+
+  mpc_optimise(RegexEnclose);
+  mpc_optimise(Regex);
+  mpc_optimise(Term);
+  mpc_optimise(Factor);
+  mpc_optimise(Base);
+  mpc_optimise(Range);
+
+  if (!mpc_parse("<mpc_re_compiler>", re, RegexEnclose, &r))
   {
-    return;
+    err_msg = mpc_err_string(r.error);
+    err_out = mpc_failf("Invalid Regex: %s", err_msg);
+    mpc_err_delete(r.error);
+    free(err_msg);
+    r.output = err_out;
   }
 
-  for (i = 0; i < a->children_num; i++)
+  mpc_cleanup(6, RegexEnclose, Regex, Term, Factor, Base, Range);
+
+  mpc_optimise(r.output);
+
+  d = mpc_dfa_new(r.output);
+  if (d->failed)
   {
-    mpc_ast_delete(a->children[i]);
+    mpc_dfa_delete(d);
+    return r.output;
   }
 
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
+  p = mpc_undefined();
+  p->type = MPC_TYPE_DFA;
+  p->data.dfa.x = r.output;
+  p->data.dfa.d = d;
+  return p;
 }
 
-static void mpc_ast_delete_no_children(mpc_ast_t *a)
+/*
+** Common Fold Functions
+*/
+
+void mpcf_dtor_null(mpc_val_t *x)
 {
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
+  (void)x;
+  return;
 }
 
-mpc_ast_t *mpc_ast_new(const char *tag, const char *contents)
+mpc_val_t *mpcf_ctor_null(void) { return NULL; }
+mpc_val_t *mpcf_ctor_str(void) { return calloc(1, 1); }
+mpc_val_t *mpcf_free(mpc_val_t *x)
 {
+  free(x);
+  return NULL;
+}
 
-  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
-
-  a->tag = malloc(strlen(tag) + 1);
-  strcpy(a->tag, tag);
-
-  a->contents = malloc(strlen(contents) + 1);
-  strcpy(a->contents, contents);
-
-  a->state = mpc_state_new();
-
-  a->children_num = 0;
-  a->children = NULL;
-  return a;
+mpc_val_t *mpcf_int(mpc_val_t *x)
+{
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 10);
+  free(x);
+  return y;
 }
 
-mpc_ast_t *mpc_ast_build(int n, const char *tag, ...)
+mpc_val_t *mpcf_hex(mpc_val_t *x)
 {
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 16);
+  free(x);
+  return y;
+}
 
-  mpc_ast_t *a = mpc_ast_new(tag, "");
+mpc_val_t *mpcf_oct(mpc_val_t *x)
+{
+  int *y = malloc(sizeof(int));
+  *y = strtol(x, NULL, 8);
+  free(x);
+  return y;
+}
 
-  int i;
-  va_list va;
-  va_start(va, tag);
+mpc_val_t *mpcf_float(mpc_val_t *x)
+{
+  float *y = malloc(sizeof(float));
+  *y = strtod(x, NULL);
+  free(x);
+  return y;
+}
 
-  for (i = 0; i < n; i++)
+mpc_val_t *mpcf_strtriml(mpc_val_t *x)
+{
+  char *s = x;
+  while (isspace((unsigned char)*s))
   {
-    mpc_ast_add_child(a, va_arg(va, mpc_ast_t *));
+    memmove(s, s + 1, strlen(s));
   }
-
-  va_end(va);
-
-  return a;
+  return s;
 }
 
-mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a)
+mpc_val_t *mpcf_strtrimr(mpc_val_t *x)
 {
-
-  mpc_ast_t *r;
-
-  if (a == NULL)
-  {
-    return a;
-  }
-  if (a->children_num == 0)
-  {
-    return a;
-  }
-  if (a->children_num == 1)
+  char *s = x;
+  size_t l = strlen(s);
+  while (l > 0 && isspace((unsigned char)s[l - 1]))
   {
-    return a;
+    s[l - 1] = '\0';
+    l--;
   }
-
-  r = mpc_ast_new(">", "");
-  mpc_ast_add_child(r, a);
-  return r;
+  return s;
 }
 
-int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b)
+mpc_val_t *mpcf_strtrim(mpc_val_t *x)
 {
+  return mpcf_strtriml(mpcf_strtrimr(x));
+}
 
-  int i;
+static const char mpc_escape_input_c[] = {
+    '\a', '\b', '\f', '\n', '\r',
+    '\t', '\v', '\\', '\'', '\"', '\0'};
 
-  if (strcmp(a->tag, b->tag) != 0)
-  {
-    return 0;
-  }
-  if (strcmp(a->contents, b->contents) != 0)
-  {
-    return 0;
-  }
-  if (a->children_num != b->children_num)
-  {
-    return 0;
-  }
+static const char *mpc_escape_output_c[] = {
+    "\\a", "\\b", "\\f", "\\n", "\\r", "\\t",
+    "\\v", "\\\\", "\\'", "\\\"", "\\0", NULL};
 
-  for (i = 0; i < a->children_num; i++)
+static const char mpc_escape_input_raw_re[] = {'/'};
+static const char *mpc_escape_output_raw_re[] = {"\\/", NULL};
+
+static const char mpc_escape_input_raw_cstr[] = {'"'};
+static const char *mpc_escape_output_raw_cstr[] = {"\\\"", NULL};
+
+static const char mpc_escape_input_raw_cchar[] = {'\''};
+static const char *mpc_escape_output_raw_cchar[] = {"\\'", NULL};
+
+static mpc_val_t *mpcf_escape_new(mpc_val_t *x, const char *input, const char **output)
+{
+
+  int i;
+  int found;
+  char buff[2];
+  char *s = x;
+  char *y = calloc(1, 1);
+
+  while (*s)
   {
-    if (!mpc_ast_eq(a->children[i], b->children[i]))
+
+    i = 0;
+    found = 0;
+
+    while (output[i])
     {
-      return 0;
+      if (*s == input[i])
+      {
+        y = realloc(y, strlen(y) + strlen(output[i]) + 1);
+        strcat(y, output[i]);
+        found = 1;
+        break;
+      }
+      i++;
+    }
+
+    if (!found)
+    {
+      y = realloc(y, strlen(y) + 2);
+      buff[0] = *s;
+      buff[1] = '\0';
+      strcat(y, buff);
     }
+
+    s++;
   }
 
-  return 1;
+  return y;
 }
 
-mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a)
+static mpc_val_t *mpcf_unescape_new(mpc_val_t *x, const char *input, const char **output)
 {
-  r->children_num++;
-  r->children = realloc(r->children, sizeof(mpc_ast_t *) * r->children_num);
-  r->children[r->children_num - 1] = a;
-  return r;
-}
 
-mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t)
-{
-  if (a == NULL)
+  int i;
+  int found = 0;
+  char buff[2];
+  char *s = x;
+  char *y = calloc(1, 1);
+
+  while (*s)
   {
-    return a;
+
+    i = 0;
+    found = 0;
+
+    while (output[i])
+    {
+      if ((*(s + 0)) == output[i][0] &&
+          (*(s + 1)) == output[i][1])
+      {
+        y = realloc(y, strlen(y) + 1 + 1);
+        buff[0] = input[i];
+        buff[1] = '\0';
+        strcat(y, buff);
+        found = 1;
+        s++;
+        break;
+      }
+      i++;
+    }
+
+    if (!found)
+    {
+      y = realloc(y, strlen(y) + 1 + 1);
+      buff[0] = *s;
+      buff[1] = '\0';
+      strcat(y, buff);
+    }
+
+    if (*s == '\0')
+    {
+      break;
+    }
+    else
+    {
+      s++;
+    }
   }
-  a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
-  memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag) + 1);
-  memmove(a->tag, t, strlen(t));
-  memmove(a->tag + strlen(t), "|", 1);
-  return a;
+
+  return y;
 }
 
-mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t)
+mpc_val_t *mpcf_escape(mpc_val_t *x)
 {
-  if (a == NULL)
-  {
-    return a;
-  }
-  a->tag = realloc(a->tag, (strlen(t) - 1) + strlen(a->tag) + 1);
-  memmove(a->tag + (strlen(t) - 1), a->tag, strlen(a->tag) + 1);
-  memmove(a->tag, t, (strlen(t) - 1));
-  return a;
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_c, mpc_escape_output_c);
+  free(x);
+  return y;
 }
 
-mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t)
+mpc_val_t *mpcf_unescape(mpc_val_t *x)
 {
-  a->tag = realloc(a->tag, strlen(t) + 1);
-  strcpy(a->tag, t);
-  return a;
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_c, mpc_escape_output_c);
+  free(x);
+  return y;
 }
 
-mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s)
+mpc_val_t *mpcf_escape_regex(mpc_val_t *x)
 {
-  if (a == NULL)
-  {
-    return a;
-  }
-  a->state = s;
-  return a;
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
+  free(x);
+  return y;
 }
 
-static void mpc_ast_print_depth(mpc_ast_t *a, int d, FILE *fp)
+mpc_val_t *mpcf_unescape_regex(mpc_val_t *x)
 {
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_re, mpc_escape_output_raw_re);
+  free(x);
+  return y;
+}
 
-  int i;
-
-  if (a == NULL)
-  {
-    fprintf(fp, "NULL\n");
-    return;
-  }
-
-  for (i = 0; i < d; i++)
-  {
-    fprintf(fp, "  ");
-  }
-
-  if (strlen(a->contents))
-  {
-    fprintf(fp, "%s:%lu:%lu '%s'\n", a->tag,
-            (long unsigned int)(a->state.row + 1),
-            (long unsigned int)(a->state.col + 1),
-            a->contents);
-  }
-  else
-  {
-    fprintf(fp, "%s \n", a->tag);
-  }
+mpc_val_t *mpcf_escape_string_raw(mpc_val_t *x)
+{
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
+  free(x);
+  return y;
+}
 
-  for (i = 0; i < a->children_num; i++)
-  {
-    mpc_ast_print_depth(a->children[i], d + 1, fp);
-  }
+mpc_val_t *mpcf_unescape_string_raw(mpc_val_t *x)
+{
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cstr, mpc_escape_output_raw_cstr);
+  free(x);
+  return y;
 }
 
-void mpc_ast_print(mpc_ast_t *a)
+mpc_val_t *mpcf_escape_char_raw(mpc_val_t *x)
 {
-  mpc_ast_print_depth(a, 0, stdout);
+  mpc_val_t *y = mpcf_escape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
+  free(x);
+  return y;
 }
 
-void mpc_ast_print_to(mpc_ast_t *a, FILE *fp)
+mpc_val_t *mpcf_unescape_char_raw(mpc_val_t *x)
 {
-  mpc_ast_print_depth(a, 0, fp);
+  mpc_val_t *y = mpcf_unescape_new(x, mpc_escape_input_raw_cchar, mpc_escape_output_raw_cchar);
+  free(x);
+  return y;
 }
 
-int mpc_ast_get_index(mpc_ast_t *ast, const char *tag)
+mpc_val_t *mpcf_null(int n, mpc_val_t **xs)
 {
-  return mpc_ast_get_index_lb(ast, tag, 0);
+  (void)n;
+  (void)xs;
+  return NULL;
+}
+mpc_val_t *mpcf_fst(int n, mpc_val_t **xs)
+{
+  (void)n;
+  return xs[0];
+}
+mpc_val_t *mpcf_snd(int n, mpc_val_t **xs)
+{
+  (void)n;
+  return xs[1];
+}
+mpc_val_t *mpcf_trd(int n, mpc_val_t **xs)
+{
+  (void)n;
+  return xs[2];
 }
 
-int mpc_ast_get_index_lb(mpc_ast_t *ast, const char *tag, int lb)
+static mpc_val_t *mpcf_nth_free(int n, mpc_val_t **xs, int x)
 {
   int i;
-
-  for (i = lb; i < ast->children_num; i++)
+  for (i = 0; i < n; i++)
   {
-    if (strcmp(ast->children[i]->tag, tag) == 0)
+    if (i != x)
     {
-      return i;
+      free(xs[i]);
     }
   }
-
-  return -1;
+  return xs[x];
 }
 
-mpc_ast_t *mpc_ast_get_child(mpc_ast_t *ast, const char *tag)
+mpc_val_t *mpcf_fst_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 0); }
+mpc_val_t *mpcf_snd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 1); }
+mpc_val_t *mpcf_trd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 2); }
+mpc_val_t *mpcf_all_free(int n, mpc_val_t **xs)
 {
-  return mpc_ast_get_child_lb(ast, tag, 0);
+  int i;
+  for (i = 0; i < n; i++)
+  {
+    free(xs[i]);
+  }
+  return NULL;
 }
 
-mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb)
+mpc_val_t *mpcf_strfold(int n, mpc_val_t **xs)
 {
   int i;
+  size_t l = 0;
 
-  for (i = lb; i < ast->children_num; i++)
+  if (n == 0)
   {
-    if (strcmp(ast->children[i]->tag, tag) == 0)
-    {
-      return ast->children[i];
-    }
+    return calloc(1, 1);
   }
 
-  return NULL;
-}
-
-mpc_ast_trav_t *mpc_ast_traverse_start(mpc_ast_t *ast,
-                                       mpc_ast_trav_order_t order)
-{
-  mpc_ast_trav_t *trav, *n_trav;
-  mpc_ast_t *cnode = ast;
-
-  /* Create the traversal structure */
-  trav = malloc(sizeof(mpc_ast_trav_t));
-  trav->curr_node = cnode;
-  trav->parent = NULL;
-  trav->curr_child = 0;
-  trav->order = order;
-
-  /* Get start node */
-  switch (order)
+  for (i = 0; i < n; i++)
   {
-  case mpc_ast_trav_order_pre:
-    /* Nothing else is needed for pre order start */
-    break;
-
-  case mpc_ast_trav_order_post:
-    while (cnode->children_num > 0)
-    {
-      cnode = cnode->children[0];
-
-      n_trav = malloc(sizeof(mpc_ast_trav_t));
-      n_trav->curr_node = cnode;
-      n_trav->parent = trav;
-      n_trav->curr_child = 0;
-      n_trav->order = order;
-
-      trav = n_trav;
-    }
+    l += strlen(xs[i]);
+  }
 
-    break;
+  xs[0] = realloc(xs[0], l + 1);
 
-  default:
-    /* Unreachable, but compiler complaints */
-    break;
+  for (i = 1; i < n; i++)
+  {
+    strcat(xs[0], xs[i]);
+    free(xs[i]);
   }
 
-  return trav;
+  return xs[0];
 }
 
-mpc_ast_t *mpc_ast_traverse_next(mpc_ast_trav_t **trav)
+mpc_val_t *mpcf_maths(int n, mpc_val_t **xs)
 {
-  mpc_ast_trav_t *n_trav, *to_free;
-  mpc_ast_t *ret = NULL;
-  int cchild;
-
-  /* The end of traversal was reached */
-  if (*trav == NULL)
-    return NULL;
+  int **vs = (int **)xs;
+  (void)n;
 
-  switch ((*trav)->order)
+  switch (((char *)xs[1])[0])
   {
-  case mpc_ast_trav_order_pre:
-    ret = (*trav)->curr_node;
-
-    /* If there aren't any more children, go up */
-    while (*trav != NULL &&
-           (*trav)->curr_child >= (*trav)->curr_node->children_num)
-    {
-      to_free = *trav;
-      *trav = (*trav)->parent;
-      free(to_free);
-    }
-
-    /* If trav is NULL, the end was reached */
-    if (*trav == NULL)
-    {
-      break;
-    }
-
-    /* Go to next child */
-    n_trav = malloc(sizeof(mpc_ast_trav_t));
-
-    cchild = (*trav)->curr_child;
-    n_trav->curr_node = (*trav)->curr_node->children[cchild];
-    n_trav->parent = *trav;
-    n_trav->curr_child = 0;
-    n_trav->order = (*trav)->order;
+  case '*':
+  {
+    *vs[0] *= *vs[2];
+  };
+  break;
+  case '/':
+  {
+    *vs[0] /= *vs[2];
+  };
+  break;
+  case '%':
+  {
+    *vs[0] %= *vs[2];
+  };
+  break;
+  case '+':
+  {
+    *vs[0] += *vs[2];
+  };
+  break;
+  case '-':
+  {
+    *vs[0] -= *vs[2];
+  };
+  break;
+  default:
+    break;
+  }
 
-    (*trav)->curr_child++;
-    *trav = n_trav;
+  free(xs[1]);
+  free(xs[2]);
 
-    break;
+  return xs[0];
+}
 
-  case mpc_ast_trav_order_post:
-    ret = (*trav)->curr_node;
+/*
+** Printing
+*/
 
-    /* Move up tree to the parent If the parent doesn't have any more nodes,
-     * then this is the current node. If it does, move down to its left most
-     * child. Also, free the previous traversal node */
-    to_free = *trav;
-    *trav = (*trav)->parent;
-    free(to_free);
+static void mpc_print_unretained(mpc_parser_t *p, int force)
+{
 
-    if (*trav == NULL)
-      break;
+  /* TODO: Print Everything Escaped */
 
-    /* Next child */
-    (*trav)->curr_child++;
+  int i;
+  char *s, *e;
+  char buff[2];
 
-    /* If there aren't any more children, this is the next node */
-    if ((*trav)->curr_child >= (*trav)->curr_node->children_num)
+  if (p->retained && !force)
+  {
+    ;
+    if (p->name)
     {
-      break;
+      printf("<%s>", p->name);
     }
-
-    /* If there are still more children, find the leftmost child from this
-     * node */
-    while ((*trav)->curr_node->children_num > 0)
+    else
     {
-      n_trav = malloc(sizeof(mpc_ast_trav_t));
-
-      cchild = (*trav)->curr_child;
-      n_trav->curr_node = (*trav)->curr_node->children[cchild];
-      n_trav->parent = *trav;
-      n_trav->curr_child = 0;
-      n_trav->order = (*trav)->order;
-
-      *trav = n_trav;
+      printf("<anon>");
     }
-
-  default:
-    /* Unreachable, but compiler complaints */
-    break;
+    return;
   }
 
-  return ret;
-}
-
-void mpc_ast_traverse_free(mpc_ast_trav_t **trav)
-{
-  mpc_ast_trav_t *n_trav;
-
-  /* Go through parents until all are free */
-  while (*trav != NULL)
+  if (p->type == MPC_TYPE_UNDEFINED)
   {
-    n_trav = (*trav)->parent;
-    free(*trav);
-    *trav = n_trav;
+    printf("<?>");
   }
-}
-
-mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs)
-{
-
-  int i, j;
-  mpc_ast_t **as = (mpc_ast_t **)xs;
-  mpc_ast_t *r;
-
-  if (n == 0)
+  if (p->type == MPC_TYPE_PASS)
   {
-    return NULL;
+    printf("<:>");
   }
-  if (n == 1)
+  if (p->type == MPC_TYPE_FAIL)
   {
-    return xs[0];
+    printf("<!>");
   }
-  if (n == 2 && xs[1] == NULL)
+  if (p->type == MPC_TYPE_LIFT)
   {
-    return xs[0];
+    printf("<#>");
   }
-  if (n == 2 && xs[0] == NULL)
+  if (p->type == MPC_TYPE_STATE)
   {
-    return xs[1];
+    printf("<S>");
   }
-
-  r = mpc_ast_new(">", "");
-
-  for (i = 0; i < n; i++)
+  if (p->type == MPC_TYPE_ANCHOR)
   {
-
-    if (as[i] == NULL)
-    {
-      continue;
-    }
-
-    if (as[i] && as[i]->children_num == 0)
-    {
-      mpc_ast_add_child(r, as[i]);
-    }
-    else if (as[i] && as[i]->children_num == 1)
-    {
-      mpc_ast_add_child(r, mpc_ast_add_root_tag(as[i]->children[0], as[i]->tag));
-      mpc_ast_delete_no_children(as[i]);
-    }
-    else if (as[i] && as[i]->children_num >= 2)
-    {
-      for (j = 0; j < as[i]->children_num; j++)
-      {
-        mpc_ast_add_child(r, as[i]->children[j]);
-      }
-      mpc_ast_delete_no_children(as[i]);
-    }
+    printf("<@>");
+  }
+  if (p->type == MPC_TYPE_EXPECT)
+  {
+    printf("%s", p->data.expect.m);
+    /*mpc_print_unretained(p->data.expect.x, 0);*/
   }
 
-  if (r->children_num)
+  if (p->type == MPC_TYPE_ANY)
   {
-    r->state = r->children[0]->state;
+    printf("<.>");
+  }
+  if (p->type == MPC_TYPE_SATISFY)
+  {
+    printf("<f>");
   }
 
-  return r;
-}
-
-mpc_val_t *mpcf_str_ast(mpc_val_t *c)
-{
-  mpc_ast_t *a = mpc_ast_new("", c);
-  free(c);
-  return a;
-}
-
-mpc_val_t *mpcf_state_ast(int n, mpc_val_t **xs)
-{
-  mpc_state_t *s = ((mpc_state_t **)xs)[0];
-  mpc_ast_t *a = ((mpc_ast_t **)xs)[1];
-  (void)n;
-  a = mpc_ast_state(a, *s);
-  free(s);
-  return a;
-}
-
-mpc_parser_t *mpca_state(mpc_parser_t *a)
-{
-  return mpc_and(2, mpcf_state_ast, mpc_state(), a, free);
-}
-
-mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t)
-{
-  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_tag, (void *)t);
-}
-
-mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t)
-{
-  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_tag, (void *)t);
-}
-
-mpc_parser_t *mpca_root(mpc_parser_t *a)
-{
-  return mpc_apply(a, (mpc_apply_t)mpc_ast_add_root);
-}
-
-mpc_parser_t *mpca_not(mpc_parser_t *a) { return mpc_not(a, (mpc_dtor_t)mpc_ast_delete); }
-mpc_parser_t *mpca_maybe(mpc_parser_t *a) { return mpc_maybe(a); }
-mpc_parser_t *mpca_many(mpc_parser_t *a) { return mpc_many(mpcf_fold_ast, a); }
-mpc_parser_t *mpca_many1(mpc_parser_t *a) { return mpc_many1(mpcf_fold_ast, a); }
-mpc_parser_t *mpca_count(int n, mpc_parser_t *a) { return mpc_count(n, mpcf_fold_ast, a, (mpc_dtor_t)mpc_ast_delete); }
-
-mpc_parser_t *mpca_or(int n, ...)
-{
+  if (p->type == MPC_TYPE_SINGLE)
+  {
+    buff[0] = p->data.single.x;
+    buff[1] = '\0';
+    s = mpcf_escape_new(
+        buff,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    printf("'%s'", s);
+    free(s);
+  }
 
-  int i;
-  va_list va;
+  if (p->type == MPC_TYPE_RANGE)
+  {
+    buff[0] = p->data.range.x;
+    buff[1] = '\0';
+    s = mpcf_escape_new(
+        buff,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    buff[0] = p->data.range.y;
+    buff[1] = '\0';
+    e = mpcf_escape_new(
+        buff,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    printf("[%s-%s]", s, e);
+    free(s);
+    free(e);
+  }
 
-  mpc_parser_t *p = mpc_undefined();
+  if (p->type == MPC_TYPE_ONEOF)
+  {
+    s = mpcf_escape_new(
+        p->data.string.x,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    printf("[%s]", s);
+    free(s);
+  }
 
-  p->type = MPC_TYPE_OR;
-  p->data.or.n = n;
-  p->data.or.xs = malloc(sizeof(mpc_parser_t *) * n);
+  if (p->type == MPC_TYPE_NONEOF)
+  {
+    s = mpcf_escape_new(
+        p->data.string.x,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    printf("[^%s]", s);
+    free(s);
+  }
 
-  va_start(va, n);
-  for (i = 0; i < n; i++)
+  if (p->type == MPC_TYPE_STRING)
   {
-    p->data.or.xs[i] = va_arg(va, mpc_parser_t *);
+    s = mpcf_escape_new(
+        p->data.string.x,
+        mpc_escape_input_c,
+        mpc_escape_output_c);
+    printf("\"%s\"", s);
+    free(s);
   }
-  va_end(va);
 
-  return p;
-}
+  if (p->type == MPC_TYPE_APPLY)
+  {
+    mpc_print_unretained(p->data.apply.x, 0);
+  }
+  if (p->type == MPC_TYPE_APPLY_TO)
+  {
+    mpc_print_unretained(p->data.apply_to.x, 0);
+  }
+  if (p->type == MPC_TYPE_PREDICT)
+  {
+    mpc_print_unretained(p->data.predict.x, 0);
+  }
+  if (p->type == MPC_TYPE_DFA)
+  {
+    mpc_print_unretained(p->data.dfa.x, 0);
+  }
 
-mpc_parser_t *mpca_and(int n, ...)
-{
+  if (p->type == MPC_TYPE_NOT)
+  {
+    mpc_print_unretained(p->data.not .x, 0);
+    printf("!");
+  }
+  if (p->type == MPC_TYPE_MAYBE)
+  {
+    mpc_print_unretained(p->data.not .x, 0);
+    printf("?");
+  }
 
-  int i;
-  va_list va;
+  if (p->type == MPC_TYPE_MANY)
+  {
+    mpc_print_unretained(p->data.repeat.x, 0);
+    printf("*");
+  }
+  if (p->type == MPC_TYPE_MANY1)
+  {
+    mpc_print_unretained(p->data.repeat.x, 0);
+    printf("+");
+  }
+  if (p->type == MPC_TYPE_COUNT)
+  {
+    mpc_print_unretained(p->data.repeat.x, 0);
+    printf("{%i}", p->data.repeat.n);
+  }
 
-  mpc_parser_t *p = mpc_undefined();
+  if (p->type == MPC_TYPE_OR)
+  {
+    printf("(");
+    for (i = 0; i < p->data.or.n - 1; i++)
+    {
+      mpc_print_unretained(p->data.or.xs[i], 0);
+      printf(" | ");
+    }
+    mpc_print_unretained(p->data.or.xs[p->data.or.n - 1], 0);
+    printf(")");
+  }
 
-  p->type = MPC_TYPE_AND;
-  p->data.and.n = n;
-  p->data.and.f = mpcf_fold_ast;
-  p->data.and.xs = malloc(sizeof(mpc_parser_t *) * n);
-  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n - 1));
+  if (p->type == MPC_TYPE_AND)
+  {
+    printf("(");
+    for (i = 0; i < p->data.and.n - 1; i++)
+    {
+      mpc_print_unretained(p->data.and.xs[i], 0);
+      printf(" ");
+    }
+    mpc_print_unretained(p->data.and.xs[p->data.and.n - 1], 0);
+    printf(")");
+  }
 
-  va_start(va, n);
-  for (i = 0; i < n; i++)
+  if (p->type == MPC_TYPE_CHECK)
   {
-    p->data.and.xs[i] = va_arg(va, mpc_parser_t *);
+    mpc_print_unretained(p->data.check.x, 0);
+    printf("->?");
   }
-  for (i = 0; i < (n - 1); i++)
+  if (p->type == MPC_TYPE_CHECK_WITH)
   {
-    p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+    mpc_print_unretained(p->data.check_with.x, 0);
+    printf("->?");
   }
-  va_end(va);
-
-  return p;
 }
 
-mpc_parser_t *mpca_total(mpc_parser_t *a) { return mpc_total(a, (mpc_dtor_t)mpc_ast_delete); }
-
-/*
-** Grammar Parser
-*/
+void mpc_print(mpc_parser_t *p)
+{
+  mpc_print_unretained(p, 1);
+  printf("\n");
+}
 
 /*
-** This is another interesting bootstrapping.
-**
-** Having a general purpose AST type allows
-** users to specify the grammar alone and
-** let all fold rules be automatically taken
-** care of by existing functions.
-**
-** You don't get to control the type spat
-** out but this means you can make a nice
-** parser to take in some grammar in nice
-** syntax and spit out a parser that works.
-**
-** The grammar for this looks surprisingly
-** like regex but the main difference is that
-** it is now whitespace insensitive and the
-** base type takes literals of some form.
+** Testing
 */
 
 /*
+** These functions are slightly unwieldy and
+** also the whole of the testing suite for mpc
+** mpc is pretty shaky.
 **
-**  ### Grammar Grammar
-**
-**      <grammar> : (<term> "|" <grammar>) | <term>
-**
-**      <term> : <factor>*
-**
-**      <factor> : <base>
-**               | <base> "*"
-**               | <base> "+"
-**               | <base> "?"
-**               | <base> "{" <digits> "}"
+** It could do with a lot more tests and more
+** precision. Currently I am only really testing
+** changes off of the examples.
 **
-**      <base> : "<" (<digits> | <ident>) ">"
-**             | <string_lit>
-**             | <char_lit>
-**             | <regex_lit> <regex_mode>
-**             | "(" <grammar> ")"
 */
 
-typedef struct
+int mpc_test_fail(mpc_parser_t *p, const char *s, const void *d,
+                  int (*tester)(const void *, const void *),
+                  mpc_dtor_t destructor,
+                  void (*printer)(const void *))
 {
-  va_list *va;
-  int parsers_num;
-  mpc_parser_t **parsers;
-  int flags;
-} mpca_grammar_st_t;
-
-static mpc_val_t *mpcaf_grammar_or(int n, mpc_val_t **xs)
-{
-  (void)n;
-  if (xs[1] == NULL)
+  mpc_result_t r;
+  (void)printer;
+  if (mpc_parse("<test>", s, p, &r))
   {
-    return xs[0];
+
+    if (tester(r.output, d))
+    {
+      destructor(r.output);
+      return 0;
+    }
+    else
+    {
+      destructor(r.output);
+      return 1;
+    }
   }
   else
   {
-    return mpca_or(2, xs[0], xs[1]);
+    mpc_err_delete(r.error);
+    return 1;
   }
 }
 
-static mpc_val_t *mpcaf_grammar_and(int n, mpc_val_t **xs)
+int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
+                  int (*tester)(const void *, const void *),
+                  mpc_dtor_t destructor,
+                  void (*printer)(const void *))
 {
-  int i;
-  mpc_parser_t *p = mpc_pass();
-  for (i = 0; i < n; i++)
+
+  mpc_result_t r;
+  if (mpc_parse("<test>", s, p, &r))
   {
-    if (xs[i] != NULL)
+
+    if (tester(r.output, d))
     {
-      p = mpca_and(2, p, xs[i]);
+      destructor(r.output);
+      return 1;
+    }
+    else
+    {
+      printf("Got ");
+      printer(r.output);
+      printf("\n");
+      printf("Expected ");
+      printer(d);
+      printf("\n");
+      destructor(r.output);
+      return 0;
     }
   }
-  return p;
+  else
+  {
+    mpc_err_print(r.error);
+    mpc_err_delete(r.error);
+    return 0;
+  }
 }
 
-static mpc_val_t *mpcaf_grammar_repeat(int n, mpc_val_t **xs)
+/*
+** AST
+*/
+
+void mpc_ast_delete(mpc_ast_t *a)
 {
-  int num;
-  (void)n;
-  if (xs[1] == NULL)
+
+  int i;
+
+  if (a == NULL)
   {
-    return xs[0];
+    return;
   }
-  switch (((char *)xs[1])[0])
-  {
-  case '*':
-  {
-    free(xs[1]);
-    return mpca_many(xs[0]);
-  };
-  break;
-  case '+':
-  {
-    free(xs[1]);
-    return mpca_many1(xs[0]);
-  };
-  break;
-  case '?':
-  {
-    free(xs[1]);
-    return mpca_maybe(xs[0]);
-  };
-  break;
-  case '!':
+
+  for (i = 0; i < a->children_num; i++)
   {
-    free(xs[1]);
-    return mpca_not(xs[0]);
-  };
-  break;
-  default:
-    num = *((int *)xs[1]);
-    free(xs[1]);
+    mpc_ast_delete(a->children[i]);
   }
-  return mpca_count(num, xs[0]);
+
+  free(a->children);
+  free(a->tag);
+  free(a->contents);
+  free(a);
 }
 
-static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s)
+static void mpc_ast_delete_no_children(mpc_ast_t *a)
 {
-  mpca_grammar_st_t *st = s;
-  char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
-  free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "string"));
+  free(a->children);
+  free(a->tag);
+  free(a->contents);
+  free(a);
 }
 
-static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s)
+mpc_ast_t *mpc_ast_new(const char *tag, const char *contents)
 {
-  mpca_grammar_st_t *st = s;
-  char *y = mpcf_unescape(x);
-  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
-  free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "char"));
+
+  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
+
+  a->tag = malloc(strlen(tag) + 1);
+  strcpy(a->tag, tag);
+
+  a->contents = malloc(strlen(contents) + 1);
+  strcpy(a->contents, contents);
+
+  a->state = mpc_state_new();
+
+  a->children_num = 0;
+  a->children = NULL;
+  a->tag_id = 0;
+  a->tag_ids = 0;
+  return a;
 }
 
-static mpc_val_t *mpcaf_fold_regex(int n, mpc_val_t **xs)
+mpc_ast_t *mpc_ast_copy(mpc_ast_t *a)
 {
-  char *y = xs[0];
-  char *m = xs[1];
-  mpca_grammar_st_t *st = xs[2];
-  mpc_parser_t *p;
-  int mode = MPC_RE_DEFAULT;
 
-  (void)n;
-  if (strchr(m, 'm'))
+  int i;
+  mpc_ast_t *b;
+
+  if (a == NULL)
   {
-    mode |= MPC_RE_MULTILINE;
+    return NULL;
   }
-  if (strchr(m, 's'))
+
+  b = mpc_ast_new(a->tag, a->contents);
+  b->state = a->state;
+  b->tag_id = a->tag_id;
+  b->tag_ids = a->tag_ids;
+  b->children_num = a->children_num;
+  b->children = a->children_num ? malloc(sizeof(mpc_ast_t *) * a->children_num) : NULL;
+  for (i = 0; i < a->children_num; i++)
   {
-    mode |= MPC_RE_DOTALL;
+    b->children[i] = mpc_ast_copy(a->children[i]);
   }
-  y = mpcf_unescape_regex(y);
-  p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_re_mode(y, mode) : mpc_tok(mpc_re_mode(y, mode));
-  free(y);
-  free(m);
-
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "regex"));
+  return b;
 }
 
-/* Should this just use `isdigit` instead? */
-static int is_number(const char *s)
+mpc_ast_t *mpc_ast_build(int n, const char *tag, ...)
 {
-  size_t i;
-  for (i = 0; i < strlen(s); i++)
+
+  mpc_ast_t *a = mpc_ast_new(tag, "");
+
+  int i;
+  va_list va;
+  va_start(va, tag);
+
+  for (i = 0; i < n; i++)
   {
-    if (!strchr("0123456789", s[i]))
-    {
-      return 0;
-    }
+    mpc_ast_add_child(a, va_arg(va, mpc_ast_t *));
   }
-  return 1;
+
+  va_end(va);
+
+  return a;
 }
 
-static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st)
+mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a)
 {
 
-  int i;
-  mpc_parser_t *p;
+  mpc_ast_t *r;
 
-  /* Case of Number */
-  if (is_number(x))
+  if (a == NULL)
+  {
+    return a;
+  }
+  if (a->children_num == 0)
+  {
+    return a;
+  }
+  if (a->children_num == 1)
   {
+    return a;
+  }
 
-    i = strtol(x, NULL, 10);
+  r = mpc_ast_new(">", "");
+  mpc_ast_add_child(r, a);
+  return r;
+}
 
-    while (st->parsers_num <= i)
-    {
-      st->parsers_num++;
-      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t *) * st->parsers_num);
-      st->parsers[st->parsers_num - 1] = va_arg(*st->va, mpc_parser_t *);
-      if (st->parsers[st->parsers_num - 1] == NULL)
-      {
-        return mpc_failf("No Parser in position %i! Only supplied %i Parsers!", i, st->parsers_num);
-      }
-    }
+int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b)
+{
 
-    return st->parsers[st->parsers_num - 1];
+  int i;
 
-    /* Case of Identifier */
+  if (strcmp(a->tag, b->tag) != 0)
+  {
+    return 0;
   }
-  else
+  if (strcmp(a->contents, b->contents) != 0)
+  {
+    return 0;
+  }
+  if (a->children_num != b->children_num)
   {
+    return 0;
+  }
 
-    /* Search Existing Parsers */
-    for (i = 0; i < st->parsers_num; i++)
+  for (i = 0; i < a->children_num; i++)
+  {
+    if (!mpc_ast_eq(a->children[i], b->children[i]))
     {
-      mpc_parser_t *q = st->parsers[i];
-      if (q == NULL)
-      {
-        return mpc_failf("Unknown Parser '%s'!", x);
-      }
-      if (q->name && strcmp(q->name, x) == 0)
-      {
-        return q;
-      }
+      return 0;
     }
+  }
 
-    /* Search New Parsers */
-    while (1)
-    {
-
-      p = va_arg(*st->va, mpc_parser_t *);
+  return 1;
+}
 
-      st->parsers_num++;
-      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t *) * st->parsers_num);
-      st->parsers[st->parsers_num - 1] = p;
+mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a)
+{
+  r->children_num++;
+  r->children = realloc(r->children, sizeof(mpc_ast_t *) * r->children_num);
+  r->children[r->children_num - 1] = a;
+  return r;
+}
 
-      if (p == NULL || p->name == NULL)
-      {
-        return mpc_failf("Unknown Parser '%s'!", x);
-      }
-      if (p->name && strcmp(p->name, x) == 0)
-      {
-        return p;
-      }
-    }
+mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t)
+{
+  if (a == NULL)
+  {
+    return a;
   }
+  a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
+  memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag) + 1);
+  memmove(a->tag, t, strlen(t));
+  memmove(a->tag + strlen(t), "|", 1);
+  return a;
 }
 
-static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s)
+mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t)
 {
+  if (a == NULL || strlen(t) <= 1)
+  {
+    return a;
+  }
+  a->tag = realloc(a->tag, (strlen(t) - 1) + strlen(a->tag) + 1);
+  memmove(a->tag + (strlen(t) - 1), a->tag, strlen(a->tag) + 1);
+  memmove(a->tag, t, (strlen(t) - 1));
+  return a;
+}
 
-  mpca_grammar_st_t *st = s;
-  mpc_parser_t *p = mpca_grammar_find_parser(x, st);
-  free(x);
+mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t)
+{
+  a->tag = realloc(a->tag, strlen(t) + 1);
+  strcpy(a->tag, t);
+  return a;
+}
 
-  if (p->name)
+mpc_ast_t *mpc_ast_add_tag_id(mpc_ast_t *a, int id)
+{
+  if (a == NULL || id <= 0)
   {
-    return mpca_state(mpca_root(mpca_add_tag(p, p->name)));
+    return a;
   }
-  else
+  if (a->tag_id == 0)
   {
-    return mpca_state(mpca_root(p));
+    a->tag_id = id;
   }
+  if ((unsigned long)id < sizeof(unsigned long) * 8)
+  {
+    a->tag_ids |= 1UL << id;
+  }
+  return a;
 }
 
-mpc_parser_t *mpca_grammar_st(const char *grammar, mpca_grammar_st_t *st)
+int mpc_ast_has_tag_id(mpc_ast_t *a, int id)
 {
+  if ((unsigned long)id < sizeof(unsigned long) * 8)
+  {
+    return (a->tag_ids >> id) & 1;
+  }
+  return a->tag_id == id;
+}
 
-  char *err_msg;
-  mpc_parser_t *err_out;
-  mpc_result_t r;
-  mpc_parser_t *GrammarTotal, *Grammar, *Term, *Factor, *Base;
-
-  GrammarTotal = mpc_new("grammar_total");
-  Grammar = mpc_new("grammar");
-  Term = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base = mpc_new("base");
-
-  mpc_define(GrammarTotal,
-             mpc_predictive(mpc_total(Grammar, mpc_soft_delete)));
-
-  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
-                              Term,
-                              mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
-                              mpc_soft_delete));
-
-  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
-
-  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
-                             Base,
-                             mpc_or(6,
-                                    mpc_sym("*"),
-                                    mpc_sym("+"),
-                                    mpc_sym("?"),
-                                    mpc_sym("!"),
-                                    mpc_tok_brackets(mpc_int(), free),
-                                    mpc_pass()),
-                             mpc_soft_delete));
+mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s)
+{
+  if (a == NULL)
+  {
+    return a;
+  }
+  a->state = s;
+  return a;
+}
 
-  mpc_define(Base, mpc_or(5,
-                          mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
-                          mpc_apply_to(mpc_tok(mpc_char_lit()), mpcaf_grammar_char, st),
-                          mpc_tok(mpc_and(3, mpcaf_fold_regex, mpc_regex_lit(), mpc_many(mpcf_strfold, mpc_oneof("ms")), mpc_lift_val(st), free, free)),
-                          mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
-                          mpc_tok_parens(Grammar, mpc_soft_delete)));
+static void mpc_ast_print_depth(mpc_ast_t *a, int d, FILE *fp)
+{
 
-  mpc_optimise(GrammarTotal);
-  mpc_optimise(Grammar);
-  mpc_optimise(Factor);
-  mpc_optimise(Term);
-  mpc_optimise(Base);
+  int i;
 
-  if (!mpc_parse("<mpc_grammar_compiler>", grammar, GrammarTotal, &r))
+  if (a == NULL)
   {
-    err_msg = mpc_err_string(r.error);
-    err_out = mpc_failf("Invalid Grammar: %s", err_msg);
-    mpc_err_delete(r.error);
-    free(err_msg);
-    r.output = err_out;
+    fprintf(fp, "NULL\n");
+    return;
   }
 
-  mpc_cleanup(5, GrammarTotal, Grammar, Term, Factor, Base);
+  for (i = 0; i < d; i++)
+  {
+    fprintf(fp, "  ");
+  }
 
-  mpc_optimise(r.output);
+  if (strlen(a->contents))
+  {
+    fprintf(fp, "%s:%lu:%lu '%s'\n", a->tag,
+            (long unsigned int)(a->state.row + 1),
+            (long unsigned int)(a->state.col + 1),
+            a->contents);
+  }
+  else
+  {
+    fprintf(fp, "%s \n", a->tag);
+  }
 
-  return (st->flags & MPCA_LANG_PREDICTIVE) ? mpc_predictive(r.output) : r.output;
+  for (i = 0; i < a->children_num; i++)
+  {
+    mpc_ast_print_depth(a->children[i], d + 1, fp);
+  }
 }
 
-mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...)
+void mpc_ast_print(mpc_ast_t *a)
 {
-  mpca_grammar_st_t st;
-  mpc_parser_t *res;
-  va_list va;
-  va_start(va, grammar);
-
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
-
-  res = mpca_grammar_st(grammar, &st);
-  free(st.parsers);
-  va_end(va);
-  return res;
+  mpc_ast_print_depth(a, 0, stdout);
 }
 
-typedef struct
+void mpc_ast_print_to(mpc_ast_t *a, FILE *fp)
 {
-  char *ident;
-  char *name;
-  mpc_parser_t *grammar;
-} mpca_stmt_t;
+  mpc_ast_print_depth(a, 0, fp);
+}
 
-static mpc_val_t *mpca_stmt_afold(int n, mpc_val_t **xs)
+int mpc_ast_get_index(mpc_ast_t *ast, const char *tag)
 {
-  mpca_stmt_t *stmt = malloc(sizeof(mpca_stmt_t));
-  stmt->ident = ((char **)xs)[0];
-  stmt->name = ((char **)xs)[1];
-  stmt->grammar = ((mpc_parser_t **)xs)[3];
-  (void)n;
-  free(((char **)xs)[2]);
-  free(((char **)xs)[4]);
-
-  return stmt;
+  return mpc_ast_get_index_lb(ast, tag, 0);
 }
 
-static mpc_val_t *mpca_stmt_fold(int n, mpc_val_t **xs)
+int mpc_ast_get_index_lb(mpc_ast_t *ast, const char *tag, int lb)
 {
-
   int i;
-  mpca_stmt_t **stmts = malloc(sizeof(mpca_stmt_t *) * (n + 1));
 
-  for (i = 0; i < n; i++)
+  for (i = lb; i < ast->children_num; i++)
   {
-    stmts[i] = xs[i];
+    if (strcmp(ast->children[i]->tag, tag) == 0)
+    {
+      return i;
+    }
   }
-  stmts[n] = NULL;
 
-  return stmts;
+  return -1;
 }
 
-static void mpca_stmt_list_delete(mpc_val_t *x)
+mpc_ast_t *mpc_ast_get_child(mpc_ast_t *ast, const char *tag)
 {
-
-  mpca_stmt_t **stmts = x;
-
-  while (*stmts)
-  {
-    mpca_stmt_t *stmt = *stmts;
-    free(stmt->ident);
-    free(stmt->name);
-    mpc_soft_delete(stmt->grammar);
-    free(stmt);
-    stmts++;
-  }
-  free(x);
+  return mpc_ast_get_child_lb(ast, tag, 0);
 }
 
-static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s)
+mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb)
 {
+  int i;
 
-  mpca_grammar_st_t *st = s;
-  mpca_stmt_t *stmt;
-  mpca_stmt_t **stmts = x;
-  mpc_parser_t *left;
-
-  while (*stmts)
+  for (i = lb; i < ast->children_num; i++)
   {
-    stmt = *stmts;
-    left = mpca_grammar_find_parser(stmt->ident, st);
-    if (st->flags & MPCA_LANG_PREDICTIVE)
-    {
-      stmt->grammar = mpc_predictive(stmt->grammar);
-    }
-    if (stmt->name)
+    if (strcmp(ast->children[i]->tag, tag) == 0)
     {
-      stmt->grammar = mpc_expect(stmt->grammar, stmt->name);
+      return ast->children[i];
     }
-    mpc_optimise(stmt->grammar);
-    mpc_define(left, stmt->grammar);
-    free(stmt->ident);
-    free(stmt->name);
-    free(stmt);
-    stmts++;
   }
 
-  free(x);
-
   return NULL;
 }
 
-static mpc_err_t *mpca_lang_st(mpc_input_t *i, mpca_grammar_st_t *st)
+mpc_ast_trav_t *mpc_ast_traverse_start(mpc_ast_t *ast,
+                                       mpc_ast_trav_order_t order)
 {
+  mpc_ast_trav_t *trav, *n_trav;
+  mpc_ast_t *cnode = ast;
 
-  mpc_result_t r;
-  mpc_err_t *e;
-  mpc_parser_t *Lang, *Stmt, *Grammar, *Term, *Factor, *Base;
-
-  Lang = mpc_new("lang");
-  Stmt = mpc_new("stmt");
-  Grammar = mpc_new("grammar");
-  Term = mpc_new("term");
-  Factor = mpc_new("factor");
-  Base = mpc_new("base");
+  /* Create the traversal structure */
+  trav = malloc(sizeof(mpc_ast_trav_t));
+  trav->curr_node = cnode;
+  trav->parent = NULL;
+  trav->curr_child = 0;
+  trav->order = order;
 
-  mpc_define(Lang, mpc_apply_to(
-                       mpc_total(mpc_predictive(mpc_many(mpca_stmt_fold, Stmt)), mpca_stmt_list_delete),
-                       mpca_stmt_list_apply_to, st));
+  /* Get start node */
+  switch (order)
+  {
+  case mpc_ast_trav_order_pre:
+    /* Nothing else is needed for pre order start */
+    break;
 
-  mpc_define(Stmt, mpc_and(5, mpca_stmt_afold,
-                           mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_sym(":"), Grammar, mpc_sym(";"),
-                           free, free, free, mpc_soft_delete));
+  case mpc_ast_trav_order_post:
+    while (cnode->children_num > 0)
+    {
+      cnode = cnode->children[0];
 
-  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
-                              Term,
-                              mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
-                              mpc_soft_delete));
+      n_trav = malloc(sizeof(mpc_ast_trav_t));
+      n_trav->curr_node = cnode;
+      n_trav->parent = trav;
+      n_trav->curr_child = 0;
+      n_trav->order = order;
 
-  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
+      trav = n_trav;
+    }
 
-  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
-                             Base,
-                             mpc_or(6,
-                                    mpc_sym("*"),
-                                    mpc_sym("+"),
-                                    mpc_sym("?"),
-                                    mpc_sym("!"),
-                                    mpc_tok_brackets(mpc_int(), free),
-                                    mpc_pass()),
-                             mpc_soft_delete));
+    break;
 
-  mpc_define(Base, mpc_or(5,
-                          mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
-                          mpc_apply_to(mpc_tok(mpc_char_lit()), mpcaf_grammar_char, st),
-                          mpc_tok(mpc_and(3, mpcaf_fold_regex, mpc_regex_lit(), mpc_many(mpcf_strfold, mpc_oneof("ms")), mpc_lift_val(st), free, free)),
-                          mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
-                          mpc_tok_parens(Grammar, mpc_soft_delete)));
+  default:
+    /* Unreachable, but compiler complaints */
+    break;
+  }
 
-  mpc_optimise(Lang);
-  mpc_optimise(Stmt);
-  mpc_optimise(Grammar);
-  mpc_optimise(Term);
-  mpc_optimise(Factor);
-  mpc_optimise(Base);
+  return trav;
+}
 
-  if (!mpc_parse_input(i, Lang, &r))
-  {
-    e = r.error;
-  }
-  else
+mpc_ast_t *mpc_ast_traverse_next(mpc_ast_trav_t **trav)
+{
+  mpc_ast_trav_t *n_trav, *to_free;
+  mpc_ast_t *ret = NULL;
+  int cchild;
+
+  /* The end of traversal was reached */
+  if (*trav == NULL)
+    return NULL;
+
+  switch ((*trav)->order)
   {
-    e = NULL;
-  }
+  case mpc_ast_trav_order_pre:
+    ret = (*trav)->curr_node;
 
-  mpc_cleanup(6, Lang, Stmt, Grammar, Term, Factor, Base);
+    /* If there aren't any more children, go up */
+    while (*trav != NULL &&
+           (*trav)->curr_child >= (*trav)->curr_node->children_num)
+    {
+      to_free = *trav;
+      *trav = (*trav)->parent;
+      free(to_free);
+    }
 
-  return e;
-}
+    /* If trav is NULL, the end was reached */
+    if (*trav == NULL)
+    {
+      break;
+    }
 
-mpc_err_t *mpca_lang_file(int flags, FILE *f, ...)
-{
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
+    /* Go to next child */
+    n_trav = malloc(sizeof(mpc_ast_trav_t));
 
-  va_list va;
-  va_start(va, f);
+    cchild = (*trav)->curr_child;
+    n_trav->curr_node = (*trav)->curr_node->children[cchild];
+    n_trav->parent = *trav;
+    n_trav->curr_child = 0;
+    n_trav->order = (*trav)->order;
 
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
+    (*trav)->curr_child++;
+    *trav = n_trav;
 
-  i = mpc_input_new_file("<mpca_lang_file>", f);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
+    break;
 
-  free(st.parsers);
-  va_end(va);
-  return err;
-}
+  case mpc_ast_trav_order_post:
+    ret = (*trav)->curr_node;
 
-mpc_err_t *mpca_lang_pipe(int flags, FILE *p, ...)
-{
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
+    /* Move up tree to the parent If the parent doesn't have any more nodes,
+     * then this is the current node. If it does, move down to its left most
+     * child. Also, free the previous traversal node */
+    to_free = *trav;
+    *trav = (*trav)->parent;
+    free(to_free);
 
-  va_list va;
-  va_start(va, p);
+    if (*trav == NULL)
+      break;
 
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
+    /* Next child */
+    (*trav)->curr_child++;
 
-  i = mpc_input_new_pipe("<mpca_lang_pipe>", p);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
+    /* If there aren't any more children, this is the next node */
+    if ((*trav)->curr_child >= (*trav)->curr_node->children_num)
+    {
+      break;
+    }
 
-  free(st.parsers);
-  va_end(va);
-  return err;
+    /* If there are still more children, find the leftmost child from this
+     * node */
+    while ((*trav)->curr_node->children_num > 0)
+    {
+      n_trav = malloc(sizeof(mpc_ast_trav_t));
+
+      cchild = (*trav)->curr_child;
+      n_trav->curr_node = (*trav)->curr_node->children[cchild];
+      n_trav->parent = *trav;
+      n_trav->curr_child = 0;
+      n_trav->order = (*trav)->order;
+
+      *trav = n_trav;
+    }
+
+  default:
+    /* Unreachable, but compiler complaints */
+    break;
+  }
+
+  return ret;
 }
 
-mpc_err_t *mpca_lang(int flags, const char *language, ...)
+void mpc_ast_traverse_free(mpc_ast_trav_t **trav)
 {
+  mpc_ast_trav_t *n_trav;
 
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
+  /* Go through parents until all are free */
+  while (*trav != NULL)
+  {
+    n_trav = (*trav)->parent;
+    free(*trav);
+    *trav = n_trav;
+  }
+}
 
-  va_list va;
-  va_start(va, language);
+mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs)
+{
 
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
+  int i, j;
+  mpc_ast_t **as = (mpc_ast_t **)xs;
+  mpc_ast_t *r;
 
-  i = mpc_input_new_string("<mpca_lang>", language);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
+  if (n == 0)
+  {
+    return NULL;
+  }
+  if (n == 1)
+  {
+    return xs[0];
+  }
+  if (n == 2 && xs[1] == NULL)
+  {
+    return xs[0];
+  }
+  if (n == 2 && xs[0] == NULL)
+  {
+    return xs[1];
+  }
 
-  free(st.parsers);
-  va_end(va);
-  return err;
+  r = mpc_ast_new(">", "");
+
+  for (i = 0; i < n; i++)
+  {
+
+    if (as[i] == NULL)
+    {
+      continue;
+    }
+
+    if (as[i] && as[i]->children_num == 0)
+    {
+      mpc_ast_add_child(r, as[i]);
+    }
+    else if (as[i] && as[i]->children_num == 1)
+    {
+      mpc_ast_t *c = mpc_ast_add_root_tag(as[i]->children[0], as[i]->tag);
+      if (c->tag_id == 0)
+      {
+        c->tag_id = as[i]->tag_id;
+      }
+      c->tag_ids |= as[i]->tag_ids;
+      mpc_ast_add_child(r, c);
+      mpc_ast_delete_no_children(as[i]);
+    }
+    else if (as[i] && as[i]->children_num >= 2)
+    {
+      for (j = 0; j < as[i]->children_num; j++)
+      {
+        mpc_ast_add_child(r, as[i]->children[j]);
+      }
+      mpc_ast_delete_no_children(as[i]);
+    }
+  }
+
+  if (r->children_num)
+  {
+    r->state = r->children[0]->state;
+  }
+
+  return r;
+}
+
+mpc_val_t *mpcf_str_ast(mpc_val_t *c)
+{
+  mpc_ast_t *a = mpc_ast_new("", c);
+  free(c);
+  return a;
+}
+
+mpc_val_t *mpcf_state_ast(int n, mpc_val_t **xs)
+{
+  mpc_state_t *s = ((mpc_state_t **)xs)[0];
+  mpc_ast_t *a = ((mpc_ast_t **)xs)[1];
+  (void)n;
+  a = mpc_ast_state(a, *s);
+  free(s);
+  return a;
+}
+
+mpc_parser_t *mpca_state(mpc_parser_t *a)
+{
+  return mpc_and(2, mpcf_state_ast, mpc_state(), a, free);
+}
+
+mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t)
+{
+  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_tag, (void *)t);
+}
+
+mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t)
+{
+  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_tag, (void *)t);
+}
+
+mpc_parser_t *mpca_root(mpc_parser_t *a)
+{
+  return mpc_apply(a, (mpc_apply_t)mpc_ast_add_root);
+}
+
+mpc_parser_t *mpca_not(mpc_parser_t *a) { return mpc_not(a, (mpc_dtor_t)mpc_ast_delete); }
+mpc_parser_t *mpca_maybe(mpc_parser_t *a) { return mpc_maybe(a); }
+mpc_parser_t *mpca_many(mpc_parser_t *a) { return mpc_many(mpcf_fold_ast, a); }
+mpc_parser_t *mpca_many1(mpc_parser_t *a) { return mpc_many1(mpcf_fold_ast, a); }
+mpc_parser_t *mpca_count(int n, mpc_parser_t *a) { return mpc_count(n, mpcf_fold_ast, a, (mpc_dtor_t)mpc_ast_delete); }
+
+mpc_parser_t *mpca_or(int n, ...)
+{
+
+  int i;
+  va_list va;
+
+  mpc_parser_t *p = mpc_undefined();
+
+  p->type = MPC_TYPE_OR;
+  p->data.or.n = n;
+  p->data.or.xs = malloc(sizeof(mpc_parser_t *) * n);
+
+  va_start(va, n);
+  for (i = 0; i < n; i++)
+  {
+    p->data.or.xs[i] = va_arg(va, mpc_parser_t *);
+  }
+  va_end(va);
+
+  return p;
+}
+
+mpc_parser_t *mpca_and(int n, ...)
+{
+
+  int i;
+  va_list va;
+
+  mpc_parser_t *p = mpc_undefined();
+
+  p->type = MPC_TYPE_AND;
+  p->data.and.n = n;
+  p->data.and.f = mpcf_fold_ast;
+  p->data.and.xs = malloc(sizeof(mpc_parser_t *) * n);
+  p->data.and.dxs = malloc(sizeof(mpc_dtor_t) * (n - 1));
+
+  va_start(va, n);
+  for (i = 0; i < n; i++)
+  {
+    p->data.and.xs[i] = va_arg(va, mpc_parser_t *);
+  }
+  for (i = 0; i < (n - 1); i++)
+  {
+    p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+  }
+  va_end(va);
+
+  return p;
+}
+
+mpc_parser_t *mpca_total(mpc_parser_t *a) { return mpc_total(a, (mpc_dtor_t)mpc_ast_delete); }
+
+/*
+** Grammar Parser
+*/
+
+/*
+** This is another interesting bootstrapping.
+**
+** Having a general purpose AST type allows
+** users to specify the grammar alone and
+** let all fold rules be automatically taken
+** care of by existing functions.
+**
+** You don't get to control the type spat
+** out but this means you can make a nice
+** parser to take in some grammar in nice
+** syntax and spit out a parser that works.
+**
+** The grammar for this looks surprisingly
+** like regex but the main difference is that
+** it is now whitespace insensitive and the
+** base type takes literals of some form.
+*/
+
+/*
+**
+**  ### Grammar Grammar
+**
+**      <grammar> : (<term> "|" <grammar>) | <term>
+**
+**      <term> : <factor>*
+**
+**      <factor> : <base>
+**               | <base> "*"
+**               | <base> "+"
+**               | <base> "?"
+**               | <base> "{" <digits> "}"
+**
+**      <base> : "<" (<digits> | <ident>) ">"
+**             | <string_lit>
+**             | <char_lit>
+**             | <regex_lit> <regex_mode>
+**             | "(" <grammar> ")"
+*/
+
+typedef struct
+{
+  va_list *va;
+  int parsers_num;
+  mpc_parser_t **parsers;
+  int flags;
+} mpca_grammar_st_t;
+
+static mpc_val_t *mpcaf_grammar_or(int n, mpc_val_t **xs)
+{
+  (void)n;
+  if (xs[1] == NULL)
+  {
+    return xs[0];
+  }
+  else
+  {
+    return mpca_or(2, xs[0], xs[1]);
+  }
+}
+
+static mpc_val_t *mpcaf_grammar_and(int n, mpc_val_t **xs)
+{
+  int i;
+  mpc_parser_t *p = mpc_pass();
+  for (i = 0; i < n; i++)
+  {
+    if (xs[i] != NULL)
+    {
+      p = mpca_and(2, p, xs[i]);
+    }
+  }
+  return p;
+}
+
+static mpc_val_t *mpcaf_grammar_repeat(int n, mpc_val_t **xs)
+{
+  int num;
+  (void)n;
+  if (xs[1] == NULL)
+  {
+    return xs[0];
+  }
+  switch (((char *)xs[1])[0])
+  {
+  case '*':
+  {
+    free(xs[1]);
+    return mpca_many(xs[0]);
+  };
+  break;
+  case '+':
+  {
+    free(xs[1]);
+    return mpca_many1(xs[0]);
+  };
+  break;
+  case '?':
+  {
+    free(xs[1]);
+    return mpca_maybe(xs[0]);
+  };
+  break;
+  case '!':
+  {
+    free(xs[1]);
+    return mpca_not(xs[0]);
+  };
+  break;
+  default:
+    num = *((int *)xs[1]);
+    free(xs[1]);
+  }
+  return mpca_count(num, xs[0]);
+}
+
+/* Leaf tags are strings only, so MPCA_LANG_TAG_IDS leaves them empty */
+static mpc_parser_t *mpca_leaf_tag(mpc_parser_t *p, const char *t, mpca_grammar_st_t *st)
+{
+  return (st->flags & MPCA_LANG_TAG_IDS) ? p : mpca_tag(p, t);
+}
+
+static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s)
+{
+  mpca_grammar_st_t *st = s;
+  char *y = mpcf_unescape(x);
+  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
+  free(y);
+  return mpca_state(mpca_leaf_tag(mpc_apply(p, mpcf_str_ast), "string", st));
+}
+
+static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s)
+{
+  mpca_grammar_st_t *st = s;
+  char *y = mpcf_unescape(x);
+  mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
+  free(y);
+  return mpca_state(mpca_leaf_tag(mpc_apply(p, mpcf_str_ast), "char", st));
+}
+
+static mpc_val_t *mpcaf_fold_regex(int n, mpc_val_t **xs)
+{
+  char *y = xs[0];
+  char *m = xs[1];
+  mpca_grammar_st_t *st = xs[2];
+  mpc_parser_t *p;
+  int mode = MPC_RE_DEFAULT;
+
+  (void)n;
+  if (strchr(m, 'm'))
+  {
+    mode |= MPC_RE_MULTILINE;
+  }
+  if (strchr(m, 's'))
+  {
+    mode |= MPC_RE_DOTALL;
+  }
+  y = mpcf_unescape_regex(y);
+  p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_re_mode(y, mode) : mpc_tok(mpc_re_mode(y, mode));
+  free(y);
+  free(m);
+
+  return mpca_state(mpca_leaf_tag(mpc_apply(p, mpcf_str_ast), "regex", st));
+}
+
+/* Should this just use `isdigit` instead? */
+static int is_number(const char *s)
+{
+  size_t i;
+  for (i = 0; i < strlen(s); i++)
+  {
+    if (!strchr("0123456789", s[i]))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static mpc_parser_t *mpca_grammar_find_parser(char *x, mpca_grammar_st_t *st)
+{
+
+  int i;
+  mpc_parser_t *p;
+
+  /* Case of Number */
+  if (is_number(x))
+  {
+
+    i = strtol(x, NULL, 10);
+
+    while (st->parsers_num <= i)
+    {
+      st->parsers_num++;
+      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t *) * st->parsers_num);
+      st->parsers[st->parsers_num - 1] = va_arg(*st->va, mpc_parser_t *);
+      if (st->parsers[st->parsers_num - 1] == NULL)
+      {
+        return mpc_failf("No Parser in position %i! Only supplied %i Parsers!", i, st->parsers_num);
+      }
+    }
+
+    return st->parsers[st->parsers_num - 1];
+
+    /* Case of Identifier */
+  }
+  else
+  {
+
+    /* Search Existing Parsers */
+    for (i = 0; i < st->parsers_num; i++)
+    {
+      mpc_parser_t *q = st->parsers[i];
+      if (q == NULL)
+      {
+        return mpc_failf("Unknown Parser '%s'!", x);
+      }
+      if (q->name && strcmp(q->name, x) == 0)
+      {
+        return q;
+      }
+    }
+
+    /* Search New Parsers */
+    while (1)
+    {
+
+      p = va_arg(*st->va, mpc_parser_t *);
+
+      st->parsers_num++;
+      st->parsers = realloc(st->parsers, sizeof(mpc_parser_t *) * st->parsers_num);
+      st->parsers[st->parsers_num - 1] = p;
+
+      if (p == NULL || p->name == NULL)
+      {
+        return mpc_failf("Unknown Parser '%s'!", x);
+      }
+      if (p->name && strcmp(p->name, x) == 0)
+      {
+        return p;
+      }
+    }
+  }
+}
+
+int mpc_tag_id(mpc_parser_t *p)
+{
+  return p->tag_id;
+}
+
+/* Number a rule by its position in the argument list (first grammar wins) */
+static void mpca_grammar_tag_id(mpc_parser_t *p, mpca_grammar_st_t *st)
+{
+  int i;
+  if (p->tag_id)
+  {
+    return;
+  }
+  for (i = 0; i < st->parsers_num; i++)
+  {
+    if (st->parsers[i] == p)
+    {
+      p->tag_id = i + 1;
+      return;
+    }
+  }
+}
+
+static mpc_val_t *mpcaf_ast_rule_tag(mpc_val_t *x, void *p)
+{
+  mpc_ast_add_tag(x, ((mpc_parser_t *)p)->name);
+  return mpc_ast_add_tag_id(x, ((mpc_parser_t *)p)->tag_id);
+}
+
+static mpc_val_t *mpcaf_ast_rule_id(mpc_val_t *x, void *p)
+{
+  return mpc_ast_add_tag_id(x, ((mpc_parser_t *)p)->tag_id);
+}
+
+static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s)
+{
+
+  mpca_grammar_st_t *st = s;
+  mpc_parser_t *p = mpca_grammar_find_parser(x, st);
+  free(x);
+
+  if (p->name)
+  {
+    /* With MPCA_LANG_TAG_IDS only the rule id is recorded, no tag string is built */
+    mpca_grammar_tag_id(p, st);
+    return mpca_state(mpca_root(mpc_apply_to(p,
+                                             (st->flags & MPCA_LANG_TAG_IDS) ? mpcaf_ast_rule_id : mpcaf_ast_rule_tag, p)));
+  }
+  else
+  {
+    return mpca_state(mpca_root(p));
+  }
+}
+
+mpc_parser_t *mpca_grammar_st(const char *grammar, mpca_grammar_st_t *st)
+{
+
+  char *err_msg;
+  mpc_parser_t *err_out;
+  mpc_result_t r;
+  mpc_parser_t *GrammarTotal, *Grammar, *Term, *Factor, *Base;
+
+  GrammarTotal = mpc_new("grammar_total");
+  Grammar = mpc_new("grammar");
+  Term = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base = mpc_new("base");
+
+  mpc_define(GrammarTotal,
+             mpc_predictive(mpc_total(Grammar, mpc_soft_delete)));
+
+  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
+                              Term,
+                              mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
+                              mpc_soft_delete));
+
+  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
+
+  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
+                             Base,
+                             mpc_or(6,
+                                    mpc_sym("*"),
+                                    mpc_sym("+"),
+                                    mpc_sym("?"),
+                                    mpc_sym("!"),
+                                    mpc_tok_brackets(mpc_int(), free),
+                                    mpc_pass()),
+                             mpc_soft_delete));
+
+  mpc_define(Base, mpc_or(5,
+                          mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
+                          mpc_apply_to(mpc_tok(mpc_char_lit()), mpcaf_grammar_char, st),
+                          mpc_tok(mpc_and(3, mpcaf_fold_regex, mpc_regex_lit(), mpc_many(mpcf_strfold, mpc_oneof("ms")), mpc_lift_val(st), free, free)),
+                          mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
+                          mpc_tok_parens(Grammar, mpc_soft_delete)));
+
+  mpc_optimise(GrammarTotal);
+  mpc_optimise(Grammar);
+  mpc_optimise(Factor);
+  mpc_optimise(Term);
+  mpc_optimise(Base);
+
+  if (!mpc_parse("<mpc_grammar_compiler>", grammar, GrammarTotal, &r))
+  {
+    err_msg = mpc_err_string(r.error);
+    err_out = mpc_failf("Invalid Grammar: %s", err_msg);
+    mpc_err_delete(r.error);
+    free(err_msg);
+    r.output = err_out;
+  }
+
+  mpc_cleanup(5, GrammarTotal, Grammar, Term, Factor, Base);
+
+  mpc_optimise(r.output);
+
+  return (st->flags & MPCA_LANG_PREDICTIVE) ? mpc_predictive(r.output) : r.output;
+}
+
+mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...)
+{
+  mpca_grammar_st_t st;
+  mpc_parser_t *res;
+  va_list va;
+  va_start(va, grammar);
+
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+
+  res = mpca_grammar_st(grammar, &st);
+  free(st.parsers);
+  va_end(va);
+  return res;
+}
+
+typedef struct
+{
+  char *ident;
+  char *name;
+  mpc_parser_t *grammar;
+} mpca_stmt_t;
+
+static mpc_val_t *mpca_stmt_afold(int n, mpc_val_t **xs)
+{
+  mpca_stmt_t *stmt = malloc(sizeof(mpca_stmt_t));
+  stmt->ident = ((char **)xs)[0];
+  stmt->name = ((char **)xs)[1];
+  stmt->grammar = ((mpc_parser_t **)xs)[3];
+  (void)n;
+  free(((char **)xs)[2]);
+  free(((char **)xs)[4]);
+
+  return stmt;
+}
+
+static mpc_val_t *mpca_stmt_fold(int n, mpc_val_t **xs)
+{
+
+  int i;
+  mpca_stmt_t **stmts = malloc(sizeof(mpca_stmt_t *) * (n + 1));
+
+  for (i = 0; i < n; i++)
+  {
+    stmts[i] = xs[i];
+  }
+  stmts[n] = NULL;
+
+  return stmts;
+}
+
+static void mpca_stmt_list_delete(mpc_val_t *x)
+{
+
+  mpca_stmt_t **stmts = x;
+
+  while (*stmts)
+  {
+    mpca_stmt_t *stmt = *stmts;
+    free(stmt->ident);
+    free(stmt->name);
+    mpc_soft_delete(stmt->grammar);
+    free(stmt);
+    stmts++;
+  }
+  free(x);
+}
+
+static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s)
+{
+
+  mpca_grammar_st_t *st = s;
+  mpca_stmt_t *stmt;
+  mpca_stmt_t **stmts = x;
+  mpc_parser_t *left;
+
+  while (*stmts)
+  {
+    stmt = *stmts;
+    left = mpca_grammar_find_parser(stmt->ident, st);
+    mpca_grammar_tag_id(left, st);
+    if (st->flags & MPCA_LANG_PREDICTIVE)
+    {
+      stmt->grammar = mpc_predictive(stmt->grammar);
+    }
+    if (stmt->name)
+    {
+      stmt->grammar = mpc_expect(stmt->grammar, stmt->name);
+    }
+    mpc_optimise(stmt->grammar);
+    mpc_define(left, stmt->grammar);
+    left->memo = (st->flags & MPCA_LANG_PACKRAT) != 0;
+    free(stmt->ident);
+    free(stmt->name);
+    free(stmt);
+    stmts++;
+  }
+
+  free(x);
+
+  return NULL;
+}
+
+static mpc_err_t *mpca_lang_st(mpc_input_t *i, mpca_grammar_st_t *st)
+{
+
+  mpc_result_t r;
+  mpc_err_t *e;
+  mpc_parser_t *Lang, *Stmt, *Grammar, *Term, *Factor, *Base;
+
+  Lang = mpc_new("lang");
+  Stmt = mpc_new("stmt");
+  Grammar = mpc_new("grammar");
+  Term = mpc_new("term");
+  Factor = mpc_new("factor");
+  Base = mpc_new("base");
+
+  mpc_define(Lang, mpc_apply_to(
+                       mpc_total(mpc_predictive(mpc_many(mpca_stmt_fold, Stmt)), mpca_stmt_list_delete),
+                       mpca_stmt_list_apply_to, st));
+
+  mpc_define(Stmt, mpc_and(5, mpca_stmt_afold,
+                           mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_sym(":"), Grammar, mpc_sym(";"),
+                           free, free, free, mpc_soft_delete));
+
+  mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
+                              Term,
+                              mpc_maybe(mpc_and(2, mpcf_snd_free, mpc_sym("|"), Grammar, free)),
+                              mpc_soft_delete));
+
+  mpc_define(Term, mpc_many1(mpcaf_grammar_and, Factor));
+
+  mpc_define(Factor, mpc_and(2, mpcaf_grammar_repeat,
+                             Base,
+                             mpc_or(6,
+                                    mpc_sym("*"),
+                                    mpc_sym("+"),
+                                    mpc_sym("?"),
+                                    mpc_sym("!"),
+                                    mpc_tok_brackets(mpc_int(), free),
+                                    mpc_pass()),
+                             mpc_soft_delete));
+
+  mpc_define(Base, mpc_or(5,
+                          mpc_apply_to(mpc_tok(mpc_string_lit()), mpcaf_grammar_string, st),
+                          mpc_apply_to(mpc_tok(mpc_char_lit()), mpcaf_grammar_char, st),
+                          mpc_tok(mpc_and(3, mpcaf_fold_regex, mpc_regex_lit(), mpc_many(mpcf_strfold, mpc_oneof("ms")), mpc_lift_val(st), free, free)),
+                          mpc_apply_to(mpc_tok_braces(mpc_or(2, mpc_digits(), mpc_ident()), free), mpcaf_grammar_id, st),
+                          mpc_tok_parens(Grammar, mpc_soft_delete)));
+
+  mpc_optimise(Lang);
+  mpc_optimise(Stmt);
+  mpc_optimise(Grammar);
+  mpc_optimise(Term);
+  mpc_optimise(Factor);
+  mpc_optimise(Base);
+
+  if (!mpc_parse_input(i, Lang, &r))
+  {
+    e = r.error;
+  }
+  else
+  {
+    e = NULL;
+  }
+
+  mpc_cleanup(6, Lang, Stmt, Grammar, Term, Factor, Base);
+
+  return e;
+}
+
+mpc_err_t *mpca_lang_file(int flags, FILE *f, ...)
+{
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;
+  va_start(va, f);
+
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+
+  i = mpc_input_new_file("<mpca_lang_file>", f);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang_pipe(int flags, FILE *p, ...)
+{
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;
+  va_start(va, p);
+
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+
+  i = mpc_input_new_pipe("<mpca_lang_pipe>", p);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang(int flags, const char *language, ...)
+{
+
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;
+  va_start(va, language);
+
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+
+  i = mpc_input_new_string("<mpca_lang>", language);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+
+  free(st.parsers);
+  va_end(va);
+  return err;
+}
+
+mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...)
+{
+
+  mpca_grammar_st_t st;
+  mpc_input_t *i;
+  mpc_err_t *err;
+
+  va_list va;
+
+  FILE *f = fopen(filename, "rb");
+
+  if (f == NULL)
+  {
+    err = mpc_err_file(filename, "Unable to open file!");
+    return err;
+  }
+
+  va_start(va, filename);
+
+  st.va = &va;
+  st.parsers_num = 0;
+  st.parsers = NULL;
+  st.flags = flags;
+
+  i = mpc_input_new_file(filename, f);
+  err = mpca_lang_st(i, &st);
+  mpc_input_delete(i);
+
+  free(st.parsers);
+  va_end(va);
+
+  fclose(f);
+
+  return err;
+}
+
+static int mpc_nodecount_unretained(mpc_parser_t *p, int force)
+{
+
+  int i, total;
+
+  if (p->retained && !force)
+  {
+    return 0;
+  }
+
+  if (p->type == MPC_TYPE_EXPECT)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.expect.x, 0);
+  }
+
+  if (p->type == MPC_TYPE_APPLY)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.apply.x, 0);
+  }
+  if (p->type == MPC_TYPE_APPLY_TO)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0);
+  }
+  if (p->type == MPC_TYPE_PREDICT)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.predict.x, 0);
+  }
+  if (p->type == MPC_TYPE_DFA)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0);
+  }
+
+  if (p->type == MPC_TYPE_CHECK)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.check.x, 0);
+  }
+  if (p->type == MPC_TYPE_CHECK_WITH)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.check_with.x, 0);
+  }
+
+  if (p->type == MPC_TYPE_NOT)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.not .x, 0);
+  }
+  if (p->type == MPC_TYPE_MAYBE)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.not .x, 0);
+  }
+
+  if (p->type == MPC_TYPE_MANY)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
+  }
+  if (p->type == MPC_TYPE_MANY1)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
+  }
+  if (p->type == MPC_TYPE_COUNT)
+  {
+    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
+  }
+
+  if (p->type == MPC_TYPE_OR)
+  {
+    total = 1;
+    for (i = 0; i < p->data.or.n; i++)
+    {
+      total += mpc_nodecount_unretained(p->data.or.xs[i], 0);
+    }
+    return total;
+  }
+
+  if (p->type == MPC_TYPE_AND)
+  {
+    total = 1;
+    for (i = 0; i < p->data.and.n; i++)
+    {
+      total += mpc_nodecount_unretained(p->data.and.xs[i], 0);
+    }
+    return total;
+  }
+
+  return 1;
+}
+
+void mpc_stats(mpc_parser_t *p)
+{
+  printf("Stats\n");
+  printf("=====\n");
+  printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
+}
+
+static void mpc_optimise_unretained(mpc_parser_t *p, int force)
+{
+
+  int i, n, m;
+  mpc_parser_t *t;
+
+  if (p->retained && !force)
+  {
+    return;
+  }
+
+  /* Optimise Subexpressions */
+
+  if (p->type == MPC_TYPE_EXPECT)
+  {
+    mpc_optimise_unretained(p->data.expect.x, 0);
+  }
+  if (p->type == MPC_TYPE_APPLY)
+  {
+    mpc_optimise_unretained(p->data.apply.x, 0);
+  }
+  if (p->type == MPC_TYPE_APPLY_TO)
+  {
+    mpc_optimise_unretained(p->data.apply_to.x, 0);
+  }
+  if (p->type == MPC_TYPE_CHECK)
+  {
+    mpc_optimise_unretained(p->data.check.x, 0);
+  }
+  if (p->type == MPC_TYPE_CHECK_WITH)
+  {
+    mpc_optimise_unretained(p->data.check_with.x, 0);
+  }
+  if (p->type == MPC_TYPE_PREDICT)
+  {
+    mpc_optimise_unretained(p->data.predict.x, 0);
+  }
+  if (p->type == MPC_TYPE_DFA)
+  {
+    mpc_optimise_unretained(p->data.dfa.x, 0);
+  }
+  if (p->type == MPC_TYPE_NOT)
+  {
+    mpc_optimise_unretained(p->data.not .x, 0);
+  }
+  if (p->type == MPC_TYPE_MAYBE)
+  {
+    mpc_optimise_unretained(p->data.not .x, 0);
+  }
+  if (p->type == MPC_TYPE_MANY)
+  {
+    mpc_optimise_unretained(p->data.repeat.x, 0);
+  }
+  if (p->type == MPC_TYPE_MANY1)
+  {
+    mpc_optimise_unretained(p->data.repeat.x, 0);
+  }
+  if (p->type == MPC_TYPE_COUNT)
+  {
+    mpc_optimise_unretained(p->data.repeat.x, 0);
+  }
+
+  if (p->type == MPC_TYPE_OR)
+  {
+    for (i = 0; i < p->data.or.n; i++)
+    {
+      mpc_optimise_unretained(p->data.or.xs[i], 0);
+    }
+  }
+
+  if (p->type == MPC_TYPE_AND)
+  {
+    for (i = 0; i < p->data.and.n; i++)
+    {
+      mpc_optimise_unretained(p->data.and.xs[i], 0);
+    }
+  }
+
+  /* Perform optimisations */
+
+  while (1)
+  {
+
+    /* Merge rhs `or` */
+    if (p->type == MPC_TYPE_OR && p->data.or.xs[p->data.or.n - 1]->type == MPC_TYPE_OR && !p->data.or.xs[p->data.or.n - 1]->retained)
+    {
+      t = p->data.or.xs[p->data.or.n - 1];
+      n = p->data.or.n;
+      m = t->data.or.n;
+      p->data.or.n = n + m - 1;
+      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t *));
+      free(t->data.or.xs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    /* Merge lhs `or` */
+    if (p->type == MPC_TYPE_OR && p->data.or.xs[0]->type == MPC_TYPE_OR && !p->data.or.xs[0]->retained)
+    {
+      t = p->data.or.xs[0];
+      n = p->data.or.n;
+      m = t->data.or.n;
+      p->data.or.n = n + m - 1;
+      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
+      memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t *));
+      free(t->data.or.xs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    /* Remove ast `pass` */
+    if (p->type == MPC_TYPE_AND && p->data.and.n == 2 && p->data.and.xs[0]->type == MPC_TYPE_PASS && !p->data.and.xs[0]->retained && p->data.and.f == mpcf_fold_ast)
+    {
+      t = p->data.and.xs[1];
+      mpc_delete(p->data.and.xs[0]);
+      free(p->data.and.xs);
+      free(p->data.and.dxs);
+      free(p->name);
+      memcpy(p, t, sizeof(mpc_parser_t));
+      free(t);
+      continue;
+    }
+
+    /* Merge ast lhs `and` */
+    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_fold_ast && p->data.and.xs[0]->type == MPC_TYPE_AND && !p->data.and.xs[0]->retained && p->data.and.xs[0]->data.and.f == mpcf_fold_ast)
+    {
+      t = p->data.and.xs[0];
+      n = p->data.and.n;
+      m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
+      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t *));
+      for (i = 0; i < p->data.and.n - 1; i++)
+      {
+        p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+      }
+      free(t->data.and.xs);
+      free(t->data.and.dxs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    /* Merge ast rhs `and` */
+    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_fold_ast && p->data.and.xs[p->data.and.n - 1]->type == MPC_TYPE_AND && !p->data.and.xs[p->data.and.n - 1]->retained && p->data.and.xs[p->data.and.n - 1]->data.and.f == mpcf_fold_ast)
+    {
+      t = p->data.and.xs[p->data.and.n - 1];
+      n = p->data.and.n;
+      m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t *));
+      for (i = 0; i < p->data.and.n - 1; i++)
+      {
+        p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+      }
+      free(t->data.and.xs);
+      free(t->data.and.dxs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    /* Remove re `lift` */
+    if (p->type == MPC_TYPE_AND && p->data.and.n == 2 && p->data.and.xs[0]->type == MPC_TYPE_LIFT && p->data.and.xs[0]->data.lift.lf == mpcf_ctor_str && !p->data.and.xs[0]->retained && p->data.and.f == mpcf_strfold)
+    {
+      t = p->data.and.xs[1];
+      mpc_delete(p->data.and.xs[0]);
+      free(p->data.and.xs);
+      free(p->data.and.dxs);
+      free(p->name);
+      memcpy(p, t, sizeof(mpc_parser_t));
+      free(t);
+      continue;
+    }
+
+    /* Merge re lhs `and` */
+    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_strfold && p->data.and.xs[0]->type == MPC_TYPE_AND && !p->data.and.xs[0]->retained && p->data.and.xs[0]->data.and.f == mpcf_strfold)
+    {
+      t = p->data.and.xs[0];
+      n = p->data.and.n;
+      m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
+      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t *));
+      for (i = 0; i < p->data.and.n - 1; i++)
+      {
+        p->data.and.dxs[i] = free;
+      }
+      free(t->data.and.xs);
+      free(t->data.and.dxs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    /* Merge re rhs `and` */
+    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_strfold && p->data.and.xs[p->data.and.n - 1]->type == MPC_TYPE_AND && !p->data.and.xs[p->data.and.n - 1]->retained && p->data.and.xs[p->data.and.n - 1]->data.and.f == mpcf_strfold)
+    {
+      t = p->data.and.xs[p->data.and.n - 1];
+      n = p->data.and.n;
+      m = t->data.and.n;
+      p->data.and.n = n + m - 1;
+      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
+      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
+      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t *));
+      for (i = 0; i < p->data.and.n - 1; i++)
+      {
+        p->data.and.dxs[i] = free;
+      }
+      free(t->data.and.xs);
+      free(t->data.and.dxs);
+      free(t->name);
+      free(t);
+      continue;
+    }
+
+    return;
+  }
 }
 
-mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...)
+void mpc_optimise(mpc_parser_t *p)
 {
+  mpc_optimise_unretained(p, 1);
+}
 
-  mpca_grammar_st_t st;
-  mpc_input_t *i;
-  mpc_err_t *err;
-
-  va_list va;
-
-  FILE *f = fopen(filename, "rb");
-
-  if (f == NULL)
-  {
-    err = mpc_err_file(filename, "Unable to open file!");
-    return err;
-  }
-
-  va_start(va, filename);
+/*
+** Precompiled Grammars
+*/
 
-  st.va = &va;
-  st.parsers_num = 0;
-  st.parsers = NULL;
-  st.flags = flags;
+typedef void (*mpc_table_fn_t)(void);
+
+/* Every callback mpc's own constructors and mpca_lang put in a parser */
+static const mpc_table_fn_t mpc_table_fns[] = {
+    NULL,
+    (mpc_table_fn_t)free,
+    (mpc_table_fn_t)mpc_delete,
+    (mpc_table_fn_t)mpc_ast_delete,
+    (mpc_table_fn_t)mpcf_dtor_null,
+    (mpc_table_fn_t)mpcf_ctor_null,
+    (mpc_table_fn_t)mpcf_ctor_str,
+    (mpc_table_fn_t)mpcf_free,
+    (mpc_table_fn_t)mpcf_int,
+    (mpc_table_fn_t)mpcf_hex,
+    (mpc_table_fn_t)mpcf_oct,
+    (mpc_table_fn_t)mpcf_float,
+    (mpc_table_fn_t)mpcf_strtriml,
+    (mpc_table_fn_t)mpcf_strtrimr,
+    (mpc_table_fn_t)mpcf_strtrim,
+    (mpc_table_fn_t)mpcf_escape,
+    (mpc_table_fn_t)mpcf_unescape,
+    (mpc_table_fn_t)mpcf_escape_regex,
+    (mpc_table_fn_t)mpcf_unescape_regex,
+    (mpc_table_fn_t)mpcf_escape_string_raw,
+    (mpc_table_fn_t)mpcf_unescape_string_raw,
+    (mpc_table_fn_t)mpcf_escape_char_raw,
+    (mpc_table_fn_t)mpcf_unescape_char_raw,
+    (mpc_table_fn_t)mpcf_null,
+    (mpc_table_fn_t)mpcf_fst,
+    (mpc_table_fn_t)mpcf_snd,
+    (mpc_table_fn_t)mpcf_trd,
+    (mpc_table_fn_t)mpcf_fst_free,
+    (mpc_table_fn_t)mpcf_snd_free,
+    (mpc_table_fn_t)mpcf_trd_free,
+    (mpc_table_fn_t)mpcf_all_free,
+    (mpc_table_fn_t)mpcf_strfold,
+    (mpc_table_fn_t)mpcf_maths,
+    (mpc_table_fn_t)mpcf_fold_ast,
+    (mpc_table_fn_t)mpcf_str_ast,
+    (mpc_table_fn_t)mpcf_state_ast,
+    (mpc_table_fn_t)mpc_ast_add_root,
+    (mpc_table_fn_t)mpc_ast_tag,
+    (mpc_table_fn_t)mpc_ast_add_tag,
+    (mpc_table_fn_t)mpcaf_ast_rule_tag,
+    (mpc_table_fn_t)mpcaf_ast_rule_id,
+    (mpc_table_fn_t)mpc_boundary_anchor,
+    (mpc_table_fn_t)mpc_boundary_newline_anchor};
 
-  i = mpc_input_new_file(filename, f);
-  err = mpca_lang_st(i, &st);
-  mpc_input_delete(i);
+enum
+{
+  MPC_TABLE_FNS_NUM = sizeof(mpc_table_fns) / sizeof(mpc_table_fns[0])
+};
 
-  free(st.parsers);
-  va_end(va);
+/* What the `void *` of an apply_to points at */
+enum
+{
+  MPC_TABLE_DATA_NONE = 0,
+  MPC_TABLE_DATA_STRING = 1,
+  MPC_TABLE_DATA_PARSER = 2
+};
 
-  fclose(f);
+typedef struct
+{
+  int roots_num;
+  int parsers_num;
+  mpc_parser_t **parsers;
+  int code_num;
+  int *code;
+  int strings_num;
+  const char **strings;
+  int error;
+} mpc_table_export_t;
 
-  return err;
+static void mpc_table_export_int(mpc_table_export_t *e, int x)
+{
+  e->code = realloc(e->code, sizeof(int) * (e->code_num + 1));
+  e->code[e->code_num++] = x;
 }
 
-static int mpc_nodecount_unretained(mpc_parser_t *p, int force)
+static void mpc_table_export_fn(mpc_table_export_t *e, mpc_table_fn_t f)
 {
-
-  int i, total;
-
-  if (p->retained && !force)
-  {
-    return 0;
-  }
-
-  if (p->type == MPC_TYPE_EXPECT)
+  int i;
+  for (i = 0; i < MPC_TABLE_FNS_NUM; i++)
   {
-    return 1 + mpc_nodecount_unretained(p->data.expect.x, 0);
+    if (mpc_table_fns[i] == f)
+    {
+      mpc_table_export_int(e, i);
+      return;
+    }
   }
+  e->error = 1;
+  mpc_table_export_int(e, 0);
+}
 
-  if (p->type == MPC_TYPE_APPLY)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.apply.x, 0);
-  }
-  if (p->type == MPC_TYPE_APPLY_TO)
+static void mpc_table_export_string(mpc_table_export_t *e, const char *s)
+{
+  int i;
+  if (s == NULL)
   {
-    return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0);
+    mpc_table_export_int(e, -1);
+    return;
   }
-  if (p->type == MPC_TYPE_PREDICT)
+  for (i = 0; i < e->strings_num; i++)
   {
-    return 1 + mpc_nodecount_unretained(p->data.predict.x, 0);
+    if (strcmp(e->strings[i], s) == 0)
+    {
+      mpc_table_export_int(e, i);
+      return;
+    }
   }
+  e->strings = realloc(e->strings, sizeof(char *) * (e->strings_num + 1));
+  e->strings[e->strings_num] = s;
+  mpc_table_export_int(e, e->strings_num++);
+}
 
-  if (p->type == MPC_TYPE_CHECK)
+/* Index of `p`, numbering it if it has not been seen. Retained parsers must be roots */
+static int mpc_table_export_parser(mpc_table_export_t *e, mpc_parser_t *p)
+{
+  int i;
+  for (i = 0; i < e->parsers_num; i++)
   {
-    return 1 + mpc_nodecount_unretained(p->data.check.x, 0);
+    if (e->parsers[i] == p)
+    {
+      return i;
+    }
   }
-  if (p->type == MPC_TYPE_CHECK_WITH)
+  if (p->retained)
   {
-    return 1 + mpc_nodecount_unretained(p->data.check_with.x, 0);
+    e->error = 1;
   }
+  e->parsers = realloc(e->parsers, sizeof(mpc_parser_t *) * (e->parsers_num + 1));
+  e->parsers[e->parsers_num] = p;
+  return e->parsers_num++;
+}
 
-  if (p->type == MPC_TYPE_NOT)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.not .x, 0);
-  }
-  if (p->type == MPC_TYPE_MAYBE)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.not .x, 0);
-  }
+static void mpc_table_export_child(mpc_table_export_t *e, mpc_parser_t *p)
+{
+  mpc_table_export_int(e, mpc_table_export_parser(e, p));
+}
 
-  if (p->type == MPC_TYPE_MANY)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
-  }
-  if (p->type == MPC_TYPE_MANY1)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
-  }
-  if (p->type == MPC_TYPE_COUNT)
-  {
-    return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0);
-  }
+/* Node layout: type, name, tag_id, memo, then the fields of its type */
+static void mpc_table_export_node(mpc_table_export_t *e, mpc_parser_t *p)
+{
+  int i;
+  mpc_table_fn_t f;
 
-  if (p->type == MPC_TYPE_OR)
+  mpc_table_export_int(e, p->type);
+  mpc_table_export_string(e, p->name);
+  mpc_table_export_int(e, p->tag_id);
+  mpc_table_export_int(e, p->memo);
+
+  switch (p->type)
   {
-    total = 1;
+  case MPC_TYPE_FAIL:
+    mpc_table_export_string(e, p->data.fail.m);
+    break;
+  case MPC_TYPE_LIFT:
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.lift.lf);
+    break;
+  case MPC_TYPE_LIFT_VAL:
+    e->error |= p->data.lift.x != NULL;
+    break;
+  case MPC_TYPE_EXPECT:
+    mpc_table_export_child(e, p->data.expect.x);
+    mpc_table_export_string(e, p->data.expect.m);
+    break;
+  case MPC_TYPE_ANCHOR:
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.anchor.f);
+    break;
+  case MPC_TYPE_SINGLE:
+    mpc_table_export_int(e, p->data.single.x);
+    break;
+  case MPC_TYPE_RANGE:
+    mpc_table_export_int(e, p->data.range.x);
+    mpc_table_export_int(e, p->data.range.y);
+    break;
+  case MPC_TYPE_SATISFY:
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.satisfy.f);
+    break;
+  case MPC_TYPE_ONEOF:
+  case MPC_TYPE_NONEOF:
+  case MPC_TYPE_STRING:
+    mpc_table_export_string(e, p->data.string.x);
+    break;
+  case MPC_TYPE_APPLY:
+    mpc_table_export_child(e, p->data.apply.x);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.apply.f);
+    break;
+  case MPC_TYPE_APPLY_TO:
+    mpc_table_export_child(e, p->data.apply_to.x);
+    f = (mpc_table_fn_t)p->data.apply_to.f;
+    mpc_table_export_fn(e, f);
+    if (p->data.apply_to.d == NULL)
+    {
+      mpc_table_export_int(e, MPC_TABLE_DATA_NONE);
+    }
+    else if (f == (mpc_table_fn_t)mpc_ast_tag || f == (mpc_table_fn_t)mpc_ast_add_tag)
+    {
+      mpc_table_export_int(e, MPC_TABLE_DATA_STRING);
+      mpc_table_export_string(e, p->data.apply_to.d);
+    }
+    else if (f == (mpc_table_fn_t)mpcaf_ast_rule_tag || f == (mpc_table_fn_t)mpcaf_ast_rule_id)
+    {
+      mpc_table_export_int(e, MPC_TABLE_DATA_PARSER);
+      mpc_table_export_child(e, p->data.apply_to.d);
+    }
+    else
+    {
+      e->error = 1;
+    }
+    break;
+  case MPC_TYPE_CHECK:
+    mpc_table_export_child(e, p->data.check.x);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.check.dx);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.check.f);
+    mpc_table_export_string(e, p->data.check.e);
+    break;
+  case MPC_TYPE_CHECK_WITH:
+    e->error = 1;
+    break;
+  case MPC_TYPE_PREDICT:
+    mpc_table_export_child(e, p->data.predict.x);
+    break;
+  case MPC_TYPE_DFA:
+    mpc_table_export_child(e, p->data.dfa.x);
+    break;
+  case MPC_TYPE_NOT:
+  case MPC_TYPE_MAYBE:
+    mpc_table_export_child(e, p->data.not .x);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.not .dx);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.not .lf);
+    break;
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+  case MPC_TYPE_COUNT:
+    mpc_table_export_int(e, p->data.repeat.n);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.repeat.f);
+    mpc_table_export_child(e, p->data.repeat.x);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.repeat.dx);
+    break;
+  case MPC_TYPE_OR:
+    mpc_table_export_int(e, p->data.or.n);
     for (i = 0; i < p->data.or.n; i++)
     {
-      total += mpc_nodecount_unretained(p->data.or.xs[i], 0);
+      mpc_table_export_child(e, p->data.or.xs[i]);
     }
-    return total;
-  }
-
-  if (p->type == MPC_TYPE_AND)
-  {
-    total = 1;
+    break;
+  case MPC_TYPE_AND:
+    mpc_table_export_int(e, p->data.and.n);
+    mpc_table_export_fn(e, (mpc_table_fn_t)p->data.and.f);
     for (i = 0; i < p->data.and.n; i++)
     {
-      total += mpc_nodecount_unretained(p->data.and.xs[i], 0);
+      mpc_table_export_child(e, p->data.and.xs[i]);
     }
-    return total;
+    for (i = 0; i < p->data.and.n - 1; i++)
+    {
+      mpc_table_export_fn(e, (mpc_table_fn_t)p->data.and.dxs[i]);
+    }
+    break;
+  default:
+    break;
   }
-
-  return 1;
 }
 
-void mpc_stats(mpc_parser_t *p)
+static void mpc_table_export_cstring(FILE *f, const char *s)
 {
-  printf("Stats\n");
-  printf("=====\n");
-  printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
+  const char *escapes = "\a\b\f\n\r\t\v";
+  fputc('"', f);
+  for (; *s; s++)
+  {
+    const char *c = strchr(escapes, *s);
+    if (*s == '"' || *s == '\\')
+    {
+      fprintf(f, "\\%c", *s);
+    }
+    else if (*s && c)
+    {
+      fprintf(f, "\\%c", "abfnrtv"[c - escapes]);
+    }
+    else if (isprint((unsigned char)*s))
+    {
+      fputc(*s, f);
+    }
+    else
+    {
+      fprintf(f, "\\%03o", (unsigned char)*s);
+    }
+  }
+  fputc('"', f);
 }
 
-static void mpc_optimise_unretained(mpc_parser_t *p, int force)
+int mpc_table_export(FILE *f, const char *ident, const char *key, int n, ...)
 {
+  int i;
+  va_list va;
+  mpc_table_export_t e;
 
-  int i, n, m;
-  mpc_parser_t *t;
+  memset(&e, 0, sizeof(e));
 
-  if (p->retained && !force)
+  /* The roots come first, in argument order */
+  va_start(va, n);
+  for (i = 0; i < n; i++)
   {
-    return;
+    mpc_parser_t *p = va_arg(va, mpc_parser_t *);
+    e.parsers = realloc(e.parsers, sizeof(mpc_parser_t *) * (e.parsers_num + 1));
+    e.parsers[e.parsers_num++] = p;
   }
+  va_end(va);
+  e.roots_num = n;
 
-  /* Optimise Subexpressions */
-
-  if (p->type == MPC_TYPE_EXPECT)
-  {
-    mpc_optimise_unretained(p->data.expect.x, 0);
-  }
-  if (p->type == MPC_TYPE_APPLY)
-  {
-    mpc_optimise_unretained(p->data.apply.x, 0);
-  }
-  if (p->type == MPC_TYPE_APPLY_TO)
-  {
-    mpc_optimise_unretained(p->data.apply_to.x, 0);
-  }
-  if (p->type == MPC_TYPE_CHECK)
-  {
-    mpc_optimise_unretained(p->data.check.x, 0);
-  }
-  if (p->type == MPC_TYPE_CHECK_WITH)
-  {
-    mpc_optimise_unretained(p->data.check_with.x, 0);
-  }
-  if (p->type == MPC_TYPE_PREDICT)
-  {
-    mpc_optimise_unretained(p->data.predict.x, 0);
-  }
-  if (p->type == MPC_TYPE_NOT)
+  /* Numbering children as they are found keeps node i at position i */
+  for (i = 0; i < e.parsers_num; i++)
   {
-    mpc_optimise_unretained(p->data.not .x, 0);
+    mpc_table_export_node(&e, e.parsers[i]);
   }
-  if (p->type == MPC_TYPE_MAYBE)
+
+  if (!e.error)
   {
-    mpc_optimise_unretained(p->data.not .x, 0);
+    fprintf(f, "/* Generated by mpc_table_export */\n\n");
+    fprintf(f, "static const int %s_code[] = {", ident);
+    for (i = 0; i < e.code_num; i++)
+    {
+      fprintf(f, i % 16 ? " %i," : "\n  %i,", e.code[i]);
+    }
+    fprintf(f, "};\n\n");
+    fprintf(f, "static const char *const %s_strings[] = {", ident);
+    for (i = 0; i < e.strings_num; i++)
+    {
+      fprintf(f, "\n  ");
+      mpc_table_export_cstring(f, e.strings[i]);
+      fputc(',', f);
+    }
+    fprintf(f, "\n  NULL};\n\n");
+    fprintf(f, "static const mpc_table_t %s = {\n  ", ident);
+    mpc_table_export_cstring(f, key);
+    fprintf(f, ",\n  %i, %i, %i, %s_code, %s_strings};\n", e.roots_num, e.parsers_num, e.code_num, ident, ident);
   }
-  if (p->type == MPC_TYPE_MANY)
+
+  free(e.parsers);
+  free(e.code);
+  free(e.strings);
+  return !e.error;
+}
+
+typedef struct
+{
+  const mpc_table_t *t;
+  mpc_parser_t **parsers;
+  int strings_num;
+  int pos;
+  int error;
+} mpc_table_import_t;
+
+static int mpc_table_import_int(mpc_table_import_t *m)
+{
+  if (m->pos >= m->t->code_num)
   {
-    mpc_optimise_unretained(p->data.repeat.x, 0);
+    m->error = 1;
+    return 0;
   }
-  if (p->type == MPC_TYPE_MANY1)
+  return m->t->code[m->pos++];
+}
+
+static mpc_table_fn_t mpc_table_import_fn(mpc_table_import_t *m)
+{
+  int i = mpc_table_import_int(m);
+  if (i < 0 || i >= MPC_TABLE_FNS_NUM)
   {
-    mpc_optimise_unretained(p->data.repeat.x, 0);
+    m->error = 1;
+    return NULL;
   }
-  if (p->type == MPC_TYPE_COUNT)
+  return mpc_table_fns[i];
+}
+
+static const char *mpc_table_import_string(mpc_table_import_t *m)
+{
+  int i = mpc_table_import_int(m);
+  if (i < -1 || i >= m->strings_num)
   {
-    mpc_optimise_unretained(p->data.repeat.x, 0);
+    m->error = 1;
+    return NULL;
   }
+  return i < 0 ? NULL : m->t->strings[i];
+}
 
-  if (p->type == MPC_TYPE_OR)
+/* Strings owned by a parser are copied, the rest point into the table */
+static char *mpc_table_import_strdup(mpc_table_import_t *m)
+{
+  const char *s = mpc_table_import_string(m);
+  char *r;
+  if (s == NULL || m->parsers == NULL)
   {
-    for (i = 0; i < p->data.or.n; i++)
-    {
-      mpc_optimise_unretained(p->data.or.xs[i], 0);
-    }
+    return NULL;
   }
+  r = malloc(strlen(s) + 1);
+  strcpy(r, s);
+  return r;
+}
 
-  if (p->type == MPC_TYPE_AND)
+static mpc_parser_t *mpc_table_import_child(mpc_table_import_t *m)
+{
+  int i = mpc_table_import_int(m);
+  if (i < 0 || i >= m->t->parsers_num)
   {
-    for (i = 0; i < p->data.and.n; i++)
-    {
-      mpc_optimise_unretained(p->data.and.xs[i], 0);
-    }
+    m->error = 1;
+    return NULL;
   }
+  return m->parsers ? m->parsers[i] : NULL;
+}
 
-  /* Perform optimisations */
+/* Reads node `p` from the table. With no parsers allocated it only checks the table */
+static void mpc_table_import_node(mpc_table_import_t *m, mpc_parser_t *p)
+{
+  int i, type, n;
+  mpc_parser_t dummy;
+  char *name;
 
-  while (1)
+  if (p == NULL)
   {
+    memset(&dummy, 0, sizeof(dummy));
+    p = &dummy;
+  }
 
-    /* Merge rhs `or` */
-    if (p->type == MPC_TYPE_OR && p->data.or.xs[p->data.or.n - 1]->type == MPC_TYPE_OR && !p->data.or.xs[p->data.or.n - 1]->retained)
-    {
-      t = p->data.or.xs[p->data.or.n - 1];
-      n = p->data.or.n;
-      m = t->data.or.n;
-      p->data.or.n = n + m - 1;
-      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t *));
-      free(t->data.or.xs);
-      free(t->name);
-      free(t);
-      continue;
-    }
-
-    /* Merge lhs `or` */
-    if (p->type == MPC_TYPE_OR && p->data.or.xs[0]->type == MPC_TYPE_OR && !p->data.or.xs[0]->retained)
-    {
-      t = p->data.or.xs[0];
-      n = p->data.or.n;
-      m = t->data.or.n;
-      p->data.or.n = n + m - 1;
-      p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
-      memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t *));
-      free(t->data.or.xs);
-      free(t->name);
-      free(t);
-      continue;
-    }
+  type = mpc_table_import_int(m);
+  name = mpc_table_import_strdup(m);
+  if (!p->retained)
+  {
+    p->name = name;
+  }
+  else
+  {
+    free(name);
+  }
+  p->tag_id = mpc_table_import_int(m);
+  p->memo = (char)mpc_table_import_int(m);
+  p->type = type;
 
-    /* Remove ast `pass` */
-    if (p->type == MPC_TYPE_AND && p->data.and.n == 2 && p->data.and.xs[0]->type == MPC_TYPE_PASS && !p->data.and.xs[0]->retained && p->data.and.f == mpcf_fold_ast)
+  switch (type)
+  {
+  case MPC_TYPE_FAIL:
+    p->data.fail.m = mpc_table_import_strdup(m);
+    break;
+  case MPC_TYPE_LIFT:
+    p->data.lift.lf = (mpc_ctor_t)mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_LIFT_VAL:
+    p->data.lift.x = NULL;
+    break;
+  case MPC_TYPE_EXPECT:
+    p->data.expect.x = mpc_table_import_child(m);
+    p->data.expect.m = mpc_table_import_strdup(m);
+    break;
+  case MPC_TYPE_ANCHOR:
+    p->data.anchor.f = (int (*)(char, char))mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_SINGLE:
+    p->data.single.x = (char)mpc_table_import_int(m);
+    break;
+  case MPC_TYPE_RANGE:
+    p->data.range.x = (char)mpc_table_import_int(m);
+    p->data.range.y = (char)mpc_table_import_int(m);
+    break;
+  case MPC_TYPE_SATISFY:
+    p->data.satisfy.f = (int (*)(char))mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_ONEOF:
+  case MPC_TYPE_NONEOF:
+  case MPC_TYPE_STRING:
+    p->data.string.x = mpc_table_import_strdup(m);
+    break;
+  case MPC_TYPE_APPLY:
+    p->data.apply.x = mpc_table_import_child(m);
+    p->data.apply.f = (mpc_apply_t)mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_APPLY_TO:
+    p->data.apply_to.x = mpc_table_import_child(m);
+    p->data.apply_to.f = (mpc_apply_to_t)mpc_table_import_fn(m);
+    switch (mpc_table_import_int(m))
     {
-      t = p->data.and.xs[1];
-      mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs);
-      free(p->data.and.dxs);
-      free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
-      continue;
+    case MPC_TABLE_DATA_NONE:
+      p->data.apply_to.d = NULL;
+      break;
+    case MPC_TABLE_DATA_STRING:
+      p->data.apply_to.d = (void *)mpc_table_import_string(m);
+      break;
+    case MPC_TABLE_DATA_PARSER:
+      p->data.apply_to.d = mpc_table_import_child(m);
+      break;
+    default:
+      m->error = 1;
+      break;
     }
-
-    /* Merge ast lhs `and` */
-    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_fold_ast && p->data.and.xs[0]->type == MPC_TYPE_AND && !p->data.and.xs[0]->retained && p->data.and.xs[0]->data.and.f == mpcf_fold_ast)
+    break;
+  case MPC_TYPE_CHECK:
+    p->data.check.x = mpc_table_import_child(m);
+    p->data.check.dx = (mpc_dtor_t)mpc_table_import_fn(m);
+    p->data.check.f = (mpc_check_t)mpc_table_import_fn(m);
+    p->data.check.e = mpc_table_import_strdup(m);
+    break;
+  case MPC_TYPE_PREDICT:
+    p->data.predict.x = mpc_table_import_child(m);
+    break;
+  case MPC_TYPE_DFA:
+    p->data.dfa.x = mpc_table_import_child(m);
+    p->data.dfa.d = NULL;
+    break;
+  case MPC_TYPE_NOT:
+  case MPC_TYPE_MAYBE:
+    p->data.not .x = mpc_table_import_child(m);
+    p->data.not .dx = (mpc_dtor_t)mpc_table_import_fn(m);
+    p->data.not .lf = (mpc_ctor_t)mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_MANY:
+  case MPC_TYPE_MANY1:
+  case MPC_TYPE_COUNT:
+    p->data.repeat.n = mpc_table_import_int(m);
+    p->data.repeat.f = (mpc_fold_t)mpc_table_import_fn(m);
+    p->data.repeat.x = mpc_table_import_child(m);
+    p->data.repeat.dx = (mpc_dtor_t)mpc_table_import_fn(m);
+    break;
+  case MPC_TYPE_OR:
+    n = mpc_table_import_int(m);
+    if (n < 0 || n > m->t->code_num)
     {
-      t = p->data.and.xs[0];
-      n = p->data.and.n;
-      m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
-      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t *));
-      for (i = 0; i < p->data.and.n - 1; i++)
-      {
-        p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
-      }
-      free(t->data.and.xs);
-      free(t->data.and.dxs);
-      free(t->name);
-      free(t);
-      continue;
+      m->error = 1;
+      break;
     }
-
-    /* Merge ast rhs `and` */
-    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_fold_ast && p->data.and.xs[p->data.and.n - 1]->type == MPC_TYPE_AND && !p->data.and.xs[p->data.and.n - 1]->retained && p->data.and.xs[p->data.and.n - 1]->data.and.f == mpcf_fold_ast)
+    p->data.or.n = n;
+    p->data.or.xs = m->parsers ? malloc(sizeof(mpc_parser_t *) * n) : NULL;
+    for (i = 0; i < n; i++)
     {
-      t = p->data.and.xs[p->data.and.n - 1];
-      n = p->data.and.n;
-      m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t *));
-      for (i = 0; i < p->data.and.n - 1; i++)
+      mpc_parser_t *x = mpc_table_import_child(m);
+      if (m->parsers)
       {
-        p->data.and.dxs[i] = (mpc_dtor_t)mpc_ast_delete;
+        p->data.or.xs[i] = x;
       }
-      free(t->data.and.xs);
-      free(t->data.and.dxs);
-      free(t->name);
-      free(t);
-      continue;
     }
-
-    /* Remove re `lift` */
-    if (p->type == MPC_TYPE_AND && p->data.and.n == 2 && p->data.and.xs[0]->type == MPC_TYPE_LIFT && p->data.and.xs[0]->data.lift.lf == mpcf_ctor_str && !p->data.and.xs[0]->retained && p->data.and.f == mpcf_strfold)
+    break;
+  case MPC_TYPE_AND:
+    n = mpc_table_import_int(m);
+    if (n < 1 || n > m->t->code_num)
     {
-      t = p->data.and.xs[1];
-      mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs);
-      free(p->data.and.dxs);
-      free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
-      continue;
+      m->error = 1;
+      break;
     }
-
-    /* Merge re lhs `and` */
-    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_strfold && p->data.and.xs[0]->type == MPC_TYPE_AND && !p->data.and.xs[0]->retained && p->data.and.xs[0]->data.and.f == mpcf_strfold)
+    p->data.and.n = n;
+    p->data.and.f = (mpc_fold_t)mpc_table_import_fn(m);
+    p->data.and.xs = m->parsers ? malloc(sizeof(mpc_parser_t *) * n) : NULL;
+    p->data.and.dxs = m->parsers ? malloc(sizeof(mpc_dtor_t) * (n - 1)) : NULL;
+    for (i = 0; i < n; i++)
     {
-      t = p->data.and.xs[0];
-      n = p->data.and.n;
-      m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + m, p->data.and.xs + 1, (n - 1) * sizeof(mpc_parser_t *));
-      memmove(p->data.and.xs, t->data.and.xs, m * sizeof(mpc_parser_t *));
-      for (i = 0; i < p->data.and.n - 1; i++)
+      mpc_parser_t *x = mpc_table_import_child(m);
+      if (m->parsers)
       {
-        p->data.and.dxs[i] = free;
+        p->data.and.xs[i] = x;
       }
-      free(t->data.and.xs);
-      free(t->data.and.dxs);
-      free(t->name);
-      free(t);
-      continue;
     }
-
-    /* Merge re rhs `and` */
-    if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_strfold && p->data.and.xs[p->data.and.n - 1]->type == MPC_TYPE_AND && !p->data.and.xs[p->data.and.n - 1]->retained && p->data.and.xs[p->data.and.n - 1]->data.and.f == mpcf_strfold)
+    for (i = 0; i < n - 1; i++)
     {
-      t = p->data.and.xs[p->data.and.n - 1];
-      n = p->data.and.n;
-      m = t->data.and.n;
-      p->data.and.n = n + m - 1;
-      p->data.and.xs = realloc(p->data.and.xs, sizeof(mpc_parser_t *) * (n + m - 1));
-      p->data.and.dxs = realloc(p->data.and.dxs, sizeof(mpc_dtor_t) * (n + m - 1 - 1));
-      memmove(p->data.and.xs + n - 1, t->data.and.xs, m * sizeof(mpc_parser_t *));
-      for (i = 0; i < p->data.and.n - 1; i++)
+      mpc_dtor_t dx = (mpc_dtor_t)mpc_table_import_fn(m);
+      if (m->parsers)
       {
-        p->data.and.dxs[i] = free;
+        p->data.and.dxs[i] = dx;
       }
-      free(t->data.and.xs);
-      free(t->data.and.dxs);
-      free(t->name);
-      free(t);
-      continue;
     }
-
-    return;
+    break;
+  case MPC_TYPE_UNDEFINED:
+  case MPC_TYPE_PASS:
+  case MPC_TYPE_STATE:
+  case MPC_TYPE_ANY:
+  case MPC_TYPE_SOI:
+  case MPC_TYPE_EOI:
+    break;
+  default:
+    m->error = 1;
+    break;
   }
 }
 
-void mpc_optimise(mpc_parser_t *p)
+int mpc_table_import(const mpc_table_t *t, int n, ...)
 {
-  mpc_optimise_unretained(p, 1);
+  int i;
+  va_list va;
+  mpc_table_import_t m;
+  mpc_parser_t **roots;
+
+  if (n != t->roots_num || n > t->parsers_num)
+  {
+    return 0;
+  }
+
+  memset(&m, 0, sizeof(m));
+  m.t = t;
+  while (t->strings[m.strings_num])
+  {
+    m.strings_num++;
+  }
+
+  /* Check the whole table before touching any parser */
+  for (i = 0; i < t->parsers_num && !m.error; i++)
+  {
+    mpc_table_import_node(&m, NULL);
+  }
+  if (m.error || m.pos != t->code_num)
+  {
+    return 0;
+  }
+
+  /* The roots must be the retained parsers the table was exported from */
+  roots = malloc(sizeof(mpc_parser_t *) * n);
+  va_start(va, n);
+  for (i = 0; i < n; i++)
+  {
+    roots[i] = va_arg(va, mpc_parser_t *);
+  }
+  va_end(va);
+
+  m.pos = 0;
+  for (i = 0; i < n; i++)
+  {
+    int name = t->code[m.pos + 1];
+    if (!roots[i]->retained || roots[i]->name == NULL || name < 0 ||
+        strcmp(roots[i]->name, t->strings[name]) != 0)
+    {
+      free(roots);
+      return 0;
+    }
+    mpc_table_import_node(&m, NULL);
+  }
+
+  m.parsers = malloc(sizeof(mpc_parser_t *) * t->parsers_num);
+  for (i = 0; i < t->parsers_num; i++)
+  {
+    m.parsers[i] = i < n ? roots[i] : mpc_undefined();
+  }
+
+  m.pos = 0;
+  for (i = 0; i < t->parsers_num; i++)
+  {
+    mpc_table_import_node(&m, m.parsers[i]);
+  }
+
+  free(m.parsers);
+  free(roots);
+  return 1;
 }
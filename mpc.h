@@ -85,6 +85,23 @@ typedef mpc_val_t*(*mpc_fold_t)(int,mpc_val_t**);
 typedef int(*mpc_check_t)(mpc_val_t**);
 typedef int(*mpc_check_with_t)(mpc_val_t**,void*);
 
+/*
+** Streaming
+**
+** `mpc_parse_stream` applies `p` again and again to `file` and hands each
+** result to `f` as soon as it is complete, so input is read only as far
+** as the current result needs. Input that has been parsed is released as
+** it goes. `f` owns the result and returns 0 to stop early. A result that
+** depended on input not read yet is discarded with `da` and parsed again
+** after reading more. Returns 1 when the input ran out, or `f` stopped,
+** and 0 with `r->error` set on a parse error.
+*/
+
+typedef int(*mpc_stream_t)(mpc_val_t*,void*);
+
+int mpc_parse_stream(const char *filename, FILE *file, mpc_parser_t *p, mpc_dtor_t da,
+  mpc_stream_t f, void *d, mpc_result_t *r);
+
 /*
 ** Building a Parser
 */
@@ -281,21 +298,33 @@ mpc_parser_t *mpc_re_mode(const char *re, int mode);
 ** AST
 */
 
+/*
+** Rules defined by `mpca_lang` are numbered by their position in its
+** argument list, starting at 1. `tag_id` is the innermost rule that
+** matched a node (0 for none) and `tag_ids` has bit `id` set for every
+** rule tag whose id fits in an unsigned long.
+*/
+
 typedef struct mpc_ast_t {
   char *tag;
   char *contents;
   mpc_state_t state;
   int children_num;
   struct mpc_ast_t** children;
+  int tag_id;
+  unsigned long tag_ids;
 } mpc_ast_t;
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents);
+mpc_ast_t *mpc_ast_copy(mpc_ast_t *a);
 mpc_ast_t *mpc_ast_build(int n, const char *tag, ...);
 mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a);
 mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a);
 mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t);
+mpc_ast_t *mpc_ast_add_tag_id(mpc_ast_t *a, int id);
+int mpc_ast_has_tag_id(mpc_ast_t *a, int id);
 mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s);
 
 void mpc_ast_delete(mpc_ast_t *a);
@@ -354,9 +383,13 @@ mpc_parser_t *mpca_and(int n, ...);
 enum {
   MPCA_LANG_DEFAULT              = 0,
   MPCA_LANG_PREDICTIVE           = 1,
-  MPCA_LANG_WHITESPACE_SENSITIVE = 2
+  MPCA_LANG_WHITESPACE_SENSITIVE = 2,
+  MPCA_LANG_TAG_IDS              = 4,
+  MPCA_LANG_PACKRAT              = 8
 };
 
+int mpc_tag_id(mpc_parser_t *p);
+
 mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...);
 
 mpc_err_t *mpca_lang(int flags, const char *language, ...);
@@ -383,6 +416,29 @@ int mpc_test_fail(mpc_parser_t *p, const char *s, const void *d,
   mpc_dtor_t destructor,
   void(*printer)(const void*));
 
+/*
+** Precompiled Grammars
+**
+** `mpc_table_export` writes the fully built and optimised graph of the given
+** parsers to `f` as C source for a static `mpc_table_t` called `ident`.
+** `mpc_table_import` later defines the same parsers (passed in the same order)
+** from that table without parsing anything. `key` is stored verbatim so
+** callers can check that a table still matches the grammar it came from.
+** Only parsers built by mpc itself (e.g. via `mpca_lang`) can be exported.
+*/
+
+typedef struct {
+  const char *key;
+  int roots_num;
+  int parsers_num;
+  int code_num;
+  const int *code;
+  const char *const *strings;
+} mpc_table_t;
+
+int mpc_table_export(FILE *f, const char *ident, const char *key, int n, ...);
+int mpc_table_import(const mpc_table_t *t, int n, ...);
+
 #ifdef __cplusplus
 }
 #endif
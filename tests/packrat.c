@@ -0,0 +1,82 @@
+/*
+** Parses a backtracking grammar with and without
+** MPCA_LANG_PACKRAT. Both must give the same AST or
+** the same error for every input. Prints the plain
+** results, and the packrat one where it differs, so
+** `make test` can diff them.
+*/
+
+#include "../mpc.h"
+
+static const char *grammar =
+  " top : /^/ <a> /$/ ;                  "
+  " a   : <b> 'x' | <b> 'y' ;            "
+  " b   : '(' <a> ')' | 'z' ;            ";
+
+static const char *inputs[] = {
+  "zx", "zy", "(zx)y", "((zy)x)y", "(((zx)y)x)y",
+  "", "z", "zq", "(zx", "(zx)", "((zy)x)q", NULL
+};
+
+/* AST printout or error message for one parse */
+static char *parse_string(mpc_parser_t *top, const char *input)
+{
+  mpc_result_t r;
+  FILE *f;
+  long n;
+  char *s;
+
+  if (!mpc_parse("<test>", input, top, &r))
+  {
+    s = mpc_err_string(r.error);
+    mpc_err_delete(r.error);
+    return s;
+  }
+
+  f = tmpfile();
+  mpc_ast_print_to(r.output, f);
+  mpc_ast_delete(r.output);
+  n = ftell(f);
+  s = malloc(n + 1);
+  fseek(f, 0, SEEK_SET);
+  n = (long)fread(s, 1, n, f);
+  s[n] = '\0';
+  fclose(f);
+  return s;
+}
+
+int main(void)
+{
+  mpc_parser_t *top, *a, *b, *ptop, *pa, *pb;
+  mpc_err_t *err;
+  int i, failed = 0;
+
+  top = mpc_new("top");
+  a = mpc_new("a");
+  b = mpc_new("b");
+  err = mpca_lang(MPCA_LANG_DEFAULT, grammar, top, a, b, NULL);
+  if (err) { mpc_err_print(err); mpc_err_delete(err); return 1; }
+
+  ptop = mpc_new("top");
+  pa = mpc_new("a");
+  pb = mpc_new("b");
+  err = mpca_lang(MPCA_LANG_PACKRAT, grammar, ptop, pa, pb, NULL);
+  if (err) { mpc_err_print(err); mpc_err_delete(err); return 1; }
+
+  for (i = 0; inputs[i]; i++)
+  {
+    char *plain = parse_string(top, inputs[i]);
+    char *memo = parse_string(ptop, inputs[i]);
+    printf("%s", plain);
+    if (strcmp(plain, memo) != 0)
+    {
+      printf("packrat differs on '%s':\n%s", inputs[i], memo);
+      failed = 1;
+    }
+    free(plain);
+    free(memo);
+  }
+
+  mpc_cleanup(6, top, a, b, ptop, pa, pb);
+  return failed;
+}